@@ -66,6 +66,7 @@ void dicomfind_usage(FILE *file, const char *cp)
     "  -q <query.txt>  Provide a file to describe the find query.\n"
     "  -maxdepth n     Set the maximum directory depth.\n"
     "  -name pattern   Set a pattern to match (with \"*\" or \"?\").\n"
+    "  -cache file     Keep file information in a cache for faster rescans.\n"
     "  -image          Restrict the search to files with PixelData.\n"
     "  -series         Find all files in series if even one file matches.\n"
     "  -print          Print the filenames of all matched files (default).\n"
@@ -498,6 +499,7 @@ int main(int argc, char *argv[])
   int scandepth = std::numeric_limits<int>::max();
   bool followSymlinks = true;
   const char *pattern = "";
+  const char *cachefile = 0;
   QueryTagList qtlist;
   vtkDICOMItem query;
   bool requirePixelData = false;
@@ -578,6 +580,16 @@ int main(int argc, char *argv[])
         }
       pattern = argv[argi];
       }
+    else if (strcmp(arg, "-cache") == 0)
+      {
+      ++argi;
+      if (argi == argc)
+        {
+        fprintf(stderr, "%s must be followed by an argument.\n\n", arg);
+        return 1;
+        }
+      cachefile = argv[argi];
+      }
     else if (strcmp(arg, "-image") == 0)
       {
       requirePixelData = true;
@@ -658,6 +670,7 @@ int main(int argc, char *argv[])
       vtkSmartPointer<vtkDICOMDirectory>::New();
     finder->SetInputFileNames(a);
     finder->SetFilePattern(pattern);
+    finder->SetCacheFileName(cachefile);
     finder->SetScanDepth(scandepth);
     finder->SetFindQuery(query);
     finder->SetFollowSymlinks(followSymlinks);
@@ -281,15 +281,20 @@ void dicomtocsv_write(vtkDICOMDirectory *finder,
         continue;
         }
 
+      // use the meta data from the directory scan, if available
       vtkSmartPointer<vtkDICOMMetaData> meta =
-        vtkSmartPointer<vtkDICOMMetaData>::New();
-      vtkSmartPointer<vtkDICOMParser> parser =
-        vtkSmartPointer<vtkDICOMParser>::New();
-
-      parser->SetFileName(a->GetValue(0));
-      parser->SetMetaData(meta);
-      parser->SetQueryItem(query);
-      parser->Update();
+        finder->GetMetaDataForSeries(k);
+      if (meta == 0)
+        {
+        meta = vtkSmartPointer<vtkDICOMMetaData>::New();
+        vtkSmartPointer<vtkDICOMParser> parser =
+          vtkSmartPointer<vtkDICOMParser>::New();
+
+        parser->SetFileName(a->GetValue(0));
+        parser->SetMetaData(meta);
+        parser->SetQueryItem(query);
+        parser->Update();
+        }
 
       // create an adapter, in case of enhanced IOD
       vtkDICOMMetaDataAdapter adapter(meta);
@@ -521,6 +526,7 @@ int main(int argc, char *argv[])
     finder->SetDirectoryName(a->GetValue(i));
     finder->SetScanDepth(8);
     finder->SetFindQuery(query);
+    finder->RetainSeriesMetaDataOn();
     finder->Update();
 
     dicomtocsv_write(finder, query, &qtlist, *osp);
@@ -24,11 +24,16 @@
 #include <vtkStringArray.h>
 #include <vtkUnsignedShortArray.h>
 #include <vtkErrorCode.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkConditionVariable.h>
 
 #include <ctype.h>
 #include <assert.h>
+#include <string.h>
 
 #include <string>
+#include <deque>
 
 vtkStandardNewMacro(vtkDICOMCompiler);
 vtkCxxSetObjectMacro(vtkDICOMCompiler, MetaData, vtkDICOMMetaData);
@@ -468,6 +473,14 @@ template<class T>
 bool Encoder<E>::WriteData(
   unsigned char* &cp, unsigned char* &ep, const T *ptr, size_t n)
 {
+  // the data will be missing if a deferred value could not be read
+  if (ptr == 0 && n != 0)
+    {
+    vtkDICOMCompilerInternalFriendship::CompileError(
+      this->Compiler, "Could not read a value from its source file.");
+    return false;
+    }
+
   while (n != 0 && this->CheckBuffer(cp, ep, sizeof(T)))
     {
     size_t m = (ep - cp)/sizeof(T);
@@ -723,7 +736,8 @@ bool Encoder<E>::WriteElements(
   vtkDICOMDataElementIterator iter,
   vtkDICOMDataElementIterator iterEnd)
 {
-  while (iter != iterEnd)
+  bool r = true;
+  while (r && iter != iterEnd)
     {
     // check for group length tag and length-to-end tag
     if (iter->GetTag().GetElement() == Hx0000 ||
@@ -792,14 +806,14 @@ bool Encoder<E>::WriteElements(
           groupLength -= 12;
           }
         // write out group length with correct value
-        this->WriteDataElement(cp, ep,
+        r = this->WriteDataElement(cp, ep,
           vtkDICOMDataElement(vtkDICOMTag(group, 0x0000),
             vtkDICOMValue(vtkDICOMVR::UL, groupLength)));
         }
-      if (lengthToEnd != HxFFFFFFFF)
+      if (lengthToEnd != HxFFFFFFFF && r)
         {
         // write out LengthToEnd with correct value
-        this->WriteDataElement(cp, ep,
+        r = this->WriteDataElement(cp, ep,
           vtkDICOMDataElement(vtkDICOMTag(0x0008, 0x0001),
             vtkDICOMValue(vtkDICOMVR::UL, lengthToEnd)));
         }
@@ -807,7 +821,7 @@ bool Encoder<E>::WriteElements(
     else if (this->Depth == 0 && this->SOPInstanceUID &&
              iter->GetTag() == vtkDICOMTag(DC::SOPInstanceUID))
       {
-      this->WriteDataElement(cp, ep,
+      r = this->WriteDataElement(cp, ep,
         vtkDICOMDataElement(
           vtkDICOMTag(DC::SOPInstanceUID),
           vtkDICOMValue(vtkDICOMVR::UI, this->SOPInstanceUID)));
@@ -816,7 +830,7 @@ bool Encoder<E>::WriteElements(
     else if (this->Depth == 0 && this->SeriesInstanceUID &&
              iter->GetTag() == vtkDICOMTag(DC::SeriesInstanceUID))
       {
-      this->WriteDataElement(cp, ep,
+      r = this->WriteDataElement(cp, ep,
         vtkDICOMDataElement(
           vtkDICOMTag(DC::SeriesInstanceUID),
           vtkDICOMValue(vtkDICOMVR::UI, this->SeriesInstanceUID)));
@@ -825,7 +839,7 @@ bool Encoder<E>::WriteElements(
     else if (this->Depth == 0 && this->StudyInstanceUID &&
              iter->GetTag() == vtkDICOMTag(DC::StudyInstanceUID))
       {
-      this->WriteDataElement(cp, ep,
+      r = this->WriteDataElement(cp, ep,
         vtkDICOMDataElement(
           vtkDICOMTag(DC::StudyInstanceUID),
           vtkDICOMValue(vtkDICOMVR::UI, this->StudyInstanceUID)));
@@ -833,16 +847,200 @@ bool Encoder<E>::WriteElements(
       }
     else
       {
-      this->WriteDataElement(cp, ep, *iter);
+      r = this->WriteDataElement(cp, ep, *iter);
       ++iter;
       }
     }
 
-  return true;
+  return r;
 }
 
 } // end anonymous namespace
 
+//----------------------------------------------------------------------------
+// A queue of buffers that are written to the file by a background thread.
+class vtkDICOMCompilerPipeline
+{
+public:
+  vtkDICOMCompilerPipeline(vtkDICOMFile *file, int depth);
+  ~vtkDICOMCompilerPipeline();
+
+  // Add a buffer to the queue, wait if the queue is full.  The buffer
+  // must have been allocated with new [], and it will be deleted after
+  // it has been written.  Fragments are written with an item header.
+  void Push(unsigned char *data, size_t size, bool fragment);
+
+  // Check whether any of the writes have failed.
+  bool HasWriteError();
+
+  // Wait until all queued buffers are written, then stop the thread.
+  // The return value is false if any of the writes failed.
+  bool Finish();
+
+private:
+  struct QueuedBuffer
+  {
+    unsigned char *Data;
+    size_t Size;
+    bool Fragment;
+  };
+
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+  void Execute();
+  bool Write(const QueuedBuffer& buffer);
+
+  vtkDICOMFile *File;
+  size_t Depth;
+  size_t Pending;
+  bool Done;
+  bool WriteError;
+  std::deque<QueuedBuffer> Queue;
+  vtkMutexLock *Lock;
+  vtkConditionVariable *Ready;
+  vtkConditionVariable *Space;
+  vtkMultiThreader *Threader;
+  int ThreadID;
+};
+
+//----------------------------------------------------------------------------
+vtkDICOMCompilerPipeline::vtkDICOMCompilerPipeline(
+  vtkDICOMFile *file, int depth)
+  : File(file), Depth(depth), Pending(0), Done(false), WriteError(false)
+{
+  this->Lock = vtkMutexLock::New();
+  this->Ready = vtkConditionVariable::New();
+  this->Space = vtkConditionVariable::New();
+  this->Threader = vtkMultiThreader::New();
+  this->ThreadID = this->Threader->SpawnThread(
+    &vtkDICOMCompilerPipeline::ThreadFunction, this);
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMCompilerPipeline::~vtkDICOMCompilerPipeline()
+{
+  this->Finish();
+  this->Threader->Delete();
+  this->Space->Delete();
+  this->Ready->Delete();
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMCompilerPipeline::Push(
+  unsigned char *data, size_t size, bool fragment)
+{
+  QueuedBuffer buffer;
+  buffer.Data = data;
+  buffer.Size = size;
+  buffer.Fragment = fragment;
+
+  // the pending count includes the buffer that is being written
+  this->Lock->Lock();
+  while (this->Pending >= this->Depth)
+    {
+    this->Space->Wait(this->Lock);
+    }
+  this->Queue.push_back(buffer);
+  this->Pending++;
+  this->Ready->Signal();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMCompilerPipeline::HasWriteError()
+{
+  this->Lock->Lock();
+  bool writeError = this->WriteError;
+  this->Lock->Unlock();
+  return writeError;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMCompilerPipeline::Finish()
+{
+  if (this->ThreadID >= 0)
+    {
+    this->Lock->Lock();
+    this->Done = true;
+    this->Ready->Signal();
+    this->Lock->Unlock();
+
+    // wait for the thread to write the remaining buffers and exit
+    this->Threader->TerminateThread(this->ThreadID);
+    this->ThreadID = -1;
+    }
+
+  return !this->WriteError;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkDICOMCompilerPipeline::ThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkDICOMCompilerPipeline *pipeline =
+    static_cast<vtkDICOMCompilerPipeline *>(info->UserData);
+
+  pipeline->Execute();
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMCompilerPipeline::Execute()
+{
+  this->Lock->Lock();
+  for (;;)
+    {
+    while (this->Queue.empty() && !this->Done)
+      {
+      this->Ready->Wait(this->Lock);
+      }
+    if (this->Queue.empty())
+      {
+      break;
+      }
+    QueuedBuffer buffer = this->Queue.front();
+    this->Queue.pop_front();
+    bool writeError = this->WriteError;
+    this->Lock->Unlock();
+
+    // after an error, the remaining buffers are discarded
+    if (!writeError)
+      {
+      writeError = !this->Write(buffer);
+      }
+    delete [] buffer.Data;
+
+    this->Lock->Lock();
+    this->WriteError |= writeError;
+    this->Pending--;
+    this->Space->Signal();
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMCompilerPipeline::Write(const QueuedBuffer& buffer)
+{
+  if (buffer.Fragment)
+    {
+    // Fragment value header
+    // - Item tag (FFFE, E000)
+    // - Length of item in bytes (4 bytes)
+    unsigned char header[8];
+    Encoder<LE>::PutInt16(header, HxFFFE);
+    Encoder<LE>::PutInt16(header+2, HxE000);
+    Encoder<LE>::PutInt32(header+4, static_cast<unsigned int>(buffer.Size));
+    if (this->File->Write(header, 8) != 8)
+      {
+      return false;
+      }
+    }
+
+  return (this->File->Write(buffer.Data, buffer.Size) == buffer.Size);
+}
+
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 // Constructor
@@ -868,6 +1066,13 @@ vtkDICOMCompiler::vtkDICOMCompiler()
   this->BigEndian = false;
   this->Compressed = false;
   this->KeepOriginalPixelDataVR = false;
+  this->NumberOfThreads = 1;
+  this->StreamFragments = false;
+  this->OffsetTablePosition = 0;
+  this->OffsetTableLength = 0;
+  this->Pipelined = false;
+  this->PipelineDepth = 2;
+  this->Pipeline = 0;
   this->ErrorCode = 0;
   this->SeriesUIDs = 0;
 
@@ -970,6 +1175,12 @@ void vtkDICOMCompiler::WriteHeader()
 //----------------------------------------------------------------------------
 void vtkDICOMCompiler::Close()
 {
+  if (!this->FinishPipeline())
+    {
+    this->DiskFullError();
+    return;
+    }
+
   if (this->Compressed && this->FrameCounter > 0)
     {
     this->WriteFragments();
@@ -986,7 +1197,9 @@ void vtkDICOMCompiler::Close()
 //----------------------------------------------------------------------------
 void vtkDICOMCompiler::CloseAndRemove()
 {
-  if (this->Compressed && this->FrameCounter > 0)
+  this->FinishPipeline();
+
+  if (this->Compressed && this->FrameLength)
     {
     this->FreeFragments();
     }
@@ -1000,74 +1213,110 @@ void vtkDICOMCompiler::CloseAndRemove()
     }
 }
 
+//----------------------------------------------------------------------------
+bool vtkDICOMCompiler::ComputeFrameOffsets(
+  unsigned char *table, unsigned int numFrames)
+{
+  // Each offset is the distance from the first fragment to the item
+  // tag of the fragment for the frame, so the 8-byte item headers of
+  // the preceding fragments are included.
+  const unsigned int maxOffset = HxFFFFFFFF - 1;
+  unsigned int offset = 0;
+  for (unsigned int i = 0; i < numFrames; i++)
+    {
+    Encoder<LE>::PutInt32(table + i*4, offset);
+    unsigned int l = (i < this->FrameCounter ? this->FrameLength[i] : 0);
+    // make sure offsets don't exceed 32-bit limit
+    if (maxOffset - offset >= l && maxOffset - offset - l >= 8)
+      {
+      offset += l + 8;
+      }
+    else if (i + 1 < numFrames)
+      {
+      return false;
+      }
+    }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMCompiler::WriteOffsetTable(unsigned int numFrames)
+{
+  // Offset table:
+  // - Item tag (FFFE, E000)
+  // - Length of table in bytes (4 bytes)
+  // - Offsets to frames(4 bytes each)
+  unsigned int tableLength = 4*numFrames;
+  unsigned char *buffer = new unsigned char[8 + tableLength];
+  Encoder<LE>::PutInt16(buffer, HxFFFE);
+  Encoder<LE>::PutInt16(buffer+2, HxE000);
+  Encoder<LE>::PutInt32(buffer+4, tableLength);
+
+  if (this->StreamFragments)
+    {
+    // reserve space, the offsets will be written by WriteFragments(),
+    // and if numFrames is zero then the table will be left empty
+    memset(buffer + 8, 0, tableLength);
+    this->OffsetTablePosition = this->OutputFile->GetSize();
+    this->OffsetTableLength = tableLength;
+    }
+  else if (!this->ComputeFrameOffsets(buffer + 8, numFrames))
+    {
+    // offsets are too large, so write an empty table
+    tableLength = 0;
+    Encoder<LE>::PutInt32(buffer+4, tableLength);
+    }
+
+  // write the offset table to the file
+  size_t n = this->OutputFile->Write(buffer, tableLength + 8);
+  delete [] buffer;
+
+  return (n == tableLength + 8);
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMCompiler::WriteFragment(
+  const unsigned char *data, unsigned int length)
+{
+  // Fragment value header
+  // - Item tag (FFFE, E000)
+  // - Length of item in bytes (4 bytes)
+  unsigned char buffer[8];
+  Encoder<LE>::PutInt16(buffer, HxFFFE);
+  Encoder<LE>::PutInt16(buffer+2, HxE000);
+  Encoder<LE>::PutInt32(buffer+4, length);
+  size_t n = this->OutputFile->Write(buffer, 8);
+  if (n < 8)
+    {
+    return false;
+    }
+
+  // - Fragment data
+  assert((length & 1) == 0);
+  n = this->OutputFile->Write(data, length);
+  return (n == length);
+}
+
 //----------------------------------------------------------------------------
 bool vtkDICOMCompiler::WriteFragments()
 {
   bool fileError = false;
+  bool tableError = false;
 
   if (this->OutputFile && this->ErrorCode == 0)
     {
     // Compressed frames
     unsigned int numFrames = this->FrameCounter;
-    size_t n = 0;
-
-    // Offset table:
-    // - Item tag (FFFE, E000)
-    // - Length of table in bytes (4 bytes)
-    // - Offsets to frames(4 bytes each)
-    unsigned int tableLength = 4*numFrames;
-    unsigned char *buffer = new unsigned char[8 + tableLength];
-    Encoder<LE>::PutInt16(buffer, HxFFFE);
-    Encoder<LE>::PutInt16(buffer+2, HxE000);
-    Encoder<LE>::PutInt32(buffer+4, tableLength);
-
-    const unsigned int maxOffset = HxFFFFFFFF - 1;
-    unsigned int offset = 0;
-    for (unsigned int i = 0; i < numFrames; i++)
-      {
-      Encoder<LE>::PutInt32(buffer + 8 + i*4, offset);
-      // make sure offsets don't exceed 32-bit limit
-      if (maxOffset - offset >= this->FrameLength[i])
-        {
-        offset += this->FrameLength[i];
-        }
-      else
-        {
-        tableLength = 0;
-        vtkDICOMUtilities::PackUnsignedInt(tableLength, buffer + 4);
-        break;
-        }
-      }
-
-    // write the offset table to the file
-    n = this->OutputFile->Write(buffer, tableLength + 8);
-    if (n < tableLength + 8)
-      {
-      fileError = true;
-      }
 
-    for (unsigned int i = 0; i < numFrames && !fileError; i++)
+    if (!this->StreamFragments)
       {
-      // Fragment value header
-      // - Item tag (FFFE, E000)
-      // - Length of item in bytes (4 bytes)
-      Encoder<LE>::PutInt16(buffer, HxFFFE);
-      Encoder<LE>::PutInt16(buffer+2, HxE000);
-      Encoder<LE>::PutInt32(buffer+4, this->FrameLength[i]);
-      n = this->OutputFile->Write(buffer, 8);
-      if (n < 8)
+      // write the table, followed by all the fragments
+      fileError = !this->WriteOffsetTable(numFrames);
+      for (unsigned int i = 0; i < numFrames && !fileError; i++)
         {
-        fileError = true;
-        break;
-        }
-
-      // - Fragment data
-      assert((this->FrameLength[i] & 1) == 0);
-      n = this->OutputFile->Write(this->FrameData[i], this->FrameLength[i]);
-      if (n < this->FrameLength[i])
-        {
-        fileError = true;
-        break;
+        fileError = !this->WriteFragment(
+          this->FrameData[i], this->FrameLength[i]);
         }
       }
 
@@ -1076,17 +1325,34 @@ bool vtkDICOMCompiler::WriteFragments()
       // After final fragment:
       // - Sequence delimiter tag (FFFE, E0DD)
       // - Zero length
+      unsigned char buffer[8];
       Encoder<LE>::PutInt16(buffer, HxFFFE);
       Encoder<LE>::PutInt16(buffer+2, HxE0DD);
       Encoder<LE>::PutInt32(buffer+4, 0);
-      n = this->OutputFile->Write(buffer, 8);
+      size_t n = this->OutputFile->Write(buffer, 8);
       if (n < 8)
         {
         fileError = true;
         }
       }
 
-    delete [] buffer;
+    if (!fileError && this->StreamFragments)
+      {
+      // go back and fill in the offset table that was reserved
+      unsigned int tableLength = this->OffsetTableLength;
+      unsigned char *table = new unsigned char[tableLength + 4];
+      tableError = !this->ComputeFrameOffsets(table, tableLength/4);
+      if (!tableError && tableLength > 0)
+        {
+        size_t n = 0;
+        if (this->OutputFile->SetPosition(this->OffsetTablePosition + 8))
+          {
+          n = this->OutputFile->Write(table, tableLength);
+          }
+        fileError = (n < tableLength);
+        }
+      delete [] table;
+      }
     }
 
   this->FreeFragments();
@@ -1095,21 +1361,41 @@ bool vtkDICOMCompiler::WriteFragments()
     {
     this->DiskFullError();
     }
+  else if (tableError)
+    {
+    this->SetErrorCode(vtkErrorCode::FileFormatError);
+    vtkErrorMacro("Error while writing file " << this->FileName
+                  << ": The offset table cannot hold offsets over 4GB.");
+    }
+
+  return !(fileError || tableError);
+}
 
-  return !fileError;
+//----------------------------------------------------------------------------
+bool vtkDICOMCompiler::FinishPipeline()
+{
+  bool success = true;
+  if (this->Pipeline)
+    {
+    success = this->Pipeline->Finish();
+    delete this->Pipeline;
+    this->Pipeline = 0;
+    }
+  return success;
 }
 
 //----------------------------------------------------------------------------
 void vtkDICOMCompiler::FreeFragments()
 {
   unsigned int numFrames = this->FrameCounter;
-  for (unsigned int i = 0; i < numFrames; i++)
+  for (unsigned int i = 0; i < numFrames && this->FrameData; i++)
     {
     delete [] this->FrameData[i];
     }
   delete [] this->FrameData;
   delete [] this->FrameLength;
   this->FrameData = 0;
+  this->FrameLength = 0;
   this->FrameCounter = 0;
 }
 
@@ -1226,6 +1512,24 @@ void vtkDICOMCompiler::WriteFrame(const unsigned char *cp, vtkIdType size)
     return;
     }
 
+  if (this->Pipeline)
+    {
+    // check whether the background writes have failed
+    if (this->Pipeline->HasWriteError())
+      {
+      this->DiskFullError();
+      return;
+      }
+    }
+  else if (this->Pipelined && this->ErrorCode == 0 &&
+           (this->StreamFragments || !this->Compressed))
+    {
+    // start the background thread, nothing is queued until the offset
+    // table (for compressed data) has been written
+    this->Pipeline = new vtkDICOMCompilerPipeline(
+      this->OutputFile, this->PipelineDepth);
+    }
+
   union { char c[2]; short s; } endiancheck;
   // this will set endiancheck.s to 1 on little endian architectures
   endiancheck.c[0] = 1;
@@ -1247,12 +1551,32 @@ void vtkDICOMCompiler::WriteFrame(const unsigned char *cp, vtkIdType size)
         this->FrameData[i] = 0;
         this->FrameLength[i] = 0;
         }
+      if (this->StreamFragments && this->ErrorCode == 0)
+        {
+        // if the offsets might not fit in 32 bits, then the table that
+        // is reserved must be empty, since it cannot be resized later
+        vtkDICOMImageCodec codec(this->TransferSyntaxUID);
+        vtkTypeUInt64 maxSize = codec.GetMaximumEncodedSize(
+          vtkDICOMImageCodec::ImageFormat(this->MetaData), size);
+        unsigned int tableFrames = numFrames;
+        if (maxSize == 0 || numFrames*(maxSize + 8) > HxFFFFFFFF)
+          {
+          tableFrames = 0;
+          }
+        if (!this->WriteOffsetTable(tableFrames))
+          {
+          this->DiskFullError();
+          return;
+          }
+        }
       }
 
     vtkDICOMImageCodec codec(this->TransferSyntaxUID);
     size_t fl = 0;
     unsigned char *fd = 0;
-    int errCode = codec.Encode(this->MetaData, cp, size, &fd, &fl);
+    int errCode = codec.EncodeFrames(
+      vtkDICOMImageCodec::ImageFormat(this->MetaData),
+      1, cp, size, &fd, &fl, this->NumberOfThreads);
     this->FrameLength[this->FrameCounter] = static_cast<unsigned int>(fl);
     this->FrameData[this->FrameCounter] = fd;
 
@@ -1262,6 +1586,32 @@ void vtkDICOMCompiler::WriteFrame(const unsigned char *cp, vtkIdType size)
       vtkErrorMacro("Writing compressed DICOM is not supported.");
       }
 
+    // if streaming, write the fragment now instead of keeping it
+    if (this->StreamFragments)
+      {
+      bool success = true;
+      if (this->ErrorCode != 0)
+        {
+        delete [] fd;
+        }
+      else if (this->Pipeline)
+        {
+        // the pipeline will write the fragment and then delete it
+        this->Pipeline->Push(fd, fl, true);
+        }
+      else
+        {
+        success = this->WriteFragment(fd, fl);
+        delete [] fd;
+        }
+      this->FrameData[this->FrameCounter] = 0;
+      if (!success)
+        {
+        this->DiskFullError();
+        return;
+        }
+      }
+
     // mark all data as accepted
     n = size;
     }
@@ -1311,8 +1661,24 @@ void vtkDICOMCompiler::WriteFrame(const unsigned char *cp, vtkIdType size)
         cp += 8;
         }
       }
-    n = this->OutputFile->Write(buf, size);
-    delete [] buf;
+    if (this->Pipeline)
+      {
+      this->Pipeline->Push(buf, size, false);
+      n = size;
+      }
+    else
+      {
+      n = this->OutputFile->Write(buf, size);
+      delete [] buf;
+      }
+    }
+  else if (this->Pipeline)
+    {
+    // Copy the frame, since the caller will reuse its buffer
+    unsigned char *buf = new unsigned char[size];
+    memcpy(buf, cp, size);
+    this->Pipeline->Push(buf, size, false);
+    n = size;
     }
   else
     {
@@ -1417,12 +1783,13 @@ bool vtkDICOMCompiler::WriteMetaHeader(
   vtkDICOMDataElementIterator iter = item.Begin();
   vtkDICOMDataElementIterator iterEnd = item.End();
 
+  bool r = true;
   if (iter != iterEnd)
     {
-    encoder.WriteElements(cp, ep, iter, iterEnd);
+    r = encoder.WriteElements(cp, ep, iter, iterEnd);
     }
 
-  return true;
+  return r;
 }
 
 //----------------------------------------------------------------------------
@@ -1641,4 +2008,10 @@ void vtkDICOMCompiler::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "BufferSize: " << this->BufferSize << "\n";
   os << indent << "KeepOriginalPixelDataVR: "
      << (this->KeepOriginalPixelDataVR ? "On\n" : "Off\n");
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "StreamFragments: "
+     << (this->StreamFragments ? "On\n" : "Off\n");
+  os << indent << "Pipelined: "
+     << (this->Pipelined ? "On\n" : "Off\n");
+  os << indent << "PipelineDepth: " << this->PipelineDepth << "\n";
 }
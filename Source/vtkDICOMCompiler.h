@@ -22,6 +22,7 @@ class vtkStringArray;
 class vtkDICOMFile;
 class vtkDICOMMetaData;
 class vtkDICOMCompilerInternalFriendship;
+class vtkDICOMCompilerPipeline;
 
 //! A writer for DICOM meta data.
 /*!
@@ -163,6 +164,59 @@ public:
   vtkBooleanMacro(KeepOriginalPixelDataVR, bool);
   vtkGetMacro(KeepOriginalPixelDataVR, bool);
 
+  //! Set the number of threads to use for compression (default: 1).
+  /*!
+   *  For RLE compression, the segments (byte planes) of each frame
+   *  are encoded concurrently.  The frames themselves are encoded one
+   *  after another, as they are passed to WriteFrame(), so the number
+   *  of threads that can be used is at most the number of segments,
+   *  i.e. the samples per pixel times the bytes per sample.  The output
+   *  is the same regardless of the number of threads.
+   */
+  vtkSetClampMacro(NumberOfThreads, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfThreads, int);
+
+  //! Write compressed frames to the file as soon as they are encoded.
+  /*!
+   *  By default, compressed frames are kept in memory until Close() is
+   *  called, because the offset table must be written before the frames.
+   *  If this option is on, then space for the offset table is reserved
+   *  when the first frame is written, each frame is written to the file
+   *  as soon as it is encoded, and the offsets are filled in by Close().
+   *  This requires that the output file supports seeking.  The file
+   *  contents are the same whether or not this option is used, except
+   *  when the largest size that the frames could have after encoding
+   *  would give offsets that do not fit in 32 bits.  Then, an empty
+   *  offset table is written (in buffered mode, the table is empty only
+   *  if the actual offsets do not fit).
+   */
+  vtkSetMacro(StreamFragments, bool);
+  vtkBooleanMacro(StreamFragments, bool);
+  vtkGetMacro(StreamFragments, bool);
+
+  //! Write frames to the file from a background thread.
+  /*!
+   *  If this option is on, WriteFrame() encodes (or byte-swaps) the
+   *  frame and then places it in a queue, and a background thread
+   *  writes the queued frames to the file.  This allows the encoding
+   *  of each frame to overlap with the writing of the previous frame.
+   *  For compressed data, this option has no effect unless
+   *  StreamFragments is also on.  Write errors are reported by the
+   *  next call to WriteFrame(), or by Close().
+   */
+  vtkSetMacro(Pipelined, bool);
+  vtkBooleanMacro(Pipelined, bool);
+  vtkGetMacro(Pipelined, bool);
+
+  //! Set the maximum number of frames in the write queue (default: 2).
+  /*!
+   *  When the queue is full, WriteFrame() waits until the background
+   *  thread has written a frame.  This limits the memory that is used
+   *  to hold frames that have not yet been written.
+   */
+  vtkSetClampMacro(PipelineDepth, int, 1, 64);
+  vtkGetMacro(PipelineDepth, int);
+
 protected:
   vtkDICOMCompiler();
   ~vtkDICOMCompiler();
@@ -202,9 +256,27 @@ protected:
   //! Write the fragments of the compressed data
   bool WriteFragments();
 
+  //! Write (or reserve space for) the basic offset table.
+  bool WriteOffsetTable(unsigned int numFrames);
+
+  //! Write a single fragment, with its item header.
+  bool WriteFragment(const unsigned char *data, unsigned int length);
+
+  //! Compute the offset table from the lengths of the frames.
+  /*!
+   *  The return value is false if the offsets exceed 32 bits.
+   */
+  bool ComputeFrameOffsets(unsigned char *table, unsigned int numFrames);
+
   //! Free any fragments that are stored in memory.
   void FreeFragments();
 
+  //! Write all queued frames and stop the background thread.
+  /*!
+   *  The return value is false if any of the queued writes failed.
+   */
+  bool FinishPipeline();
+
   //! Compute the size of the pixel data (0xffffffff if compressed).
   unsigned int ComputePixelDataSize();
 
@@ -229,6 +301,13 @@ protected:
   bool BigEndian;
   bool Compressed;
   bool KeepOriginalPixelDataVR;
+  int NumberOfThreads;
+  bool StreamFragments;
+  unsigned long long OffsetTablePosition;
+  unsigned int OffsetTableLength;
+  bool Pipelined;
+  int PipelineDepth;
+  vtkDICOMCompilerPipeline *Pipeline;
   unsigned long ErrorCode;
 
   static char StudyUID[64];
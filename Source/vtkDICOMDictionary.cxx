@@ -16,10 +16,13 @@
 #include "vtkDICOMVM.h"
 #include "vtkDICOMTag.h"
 #include "vtkDICOMDictEntry.h"
+#include "vtkDICOMReferenceCount.h"
 
 // Including this forces the loading of the private dictionaries.
 #include "vtkDICOMDictPrivate.h"
 
+#include <vtkMutexLock.h>
+
 #include <string.h>
 
 //----------------------------------------------------------------------------
@@ -29,8 +32,16 @@ struct vtkDICOMDictionary::DictHashEntry
   vtkDICOMDictionary::Dict *Dict;
 };
 
+struct vtkDICOMDictionary::RetiredRow
+{
+  vtkDICOMDictionary::DictHashEntry *Row;
+  vtkDICOMDictionary::RetiredRow *Next;
+};
+
 vtkDICOMDictionary::DictHashEntry *
   vtkDICOMDictionary::PrivateDictTable[DICT_PRIVATE_TABLE_SIZE];
+vtkDICOMDictionary::RetiredRow *vtkDICOMDictionary::RetiredRows;
+vtkSimpleMutexLock *vtkDICOMDictionary::WriteLock;
 
 //----------------------------------------------------------------------------
 // A helper class to delete static variables when program exits.
@@ -45,6 +56,8 @@ vtkDICOMDictionaryInitializer::vtkDICOMDictionaryInitializer()
       {
       vtkDICOMDictionary::PrivateDictTable[i] = 0;
       }
+    vtkDICOMDictionary::RetiredRows = 0;
+    vtkDICOMDictionary::WriteLock = new vtkSimpleMutexLock;
     }
 }
 
@@ -57,6 +70,14 @@ vtkDICOMDictionaryInitializer::~vtkDICOMDictionaryInitializer()
       {
       delete [] vtkDICOMDictionary::PrivateDictTable[i];
       }
+    while (vtkDICOMDictionary::RetiredRows)
+      {
+      vtkDICOMDictionary::RetiredRow *r = vtkDICOMDictionary::RetiredRows;
+      vtkDICOMDictionary::RetiredRows = r->Next;
+      delete [] r->Row;
+      delete r;
+      }
+    delete vtkDICOMDictionary::WriteLock;
     }
 }
 
@@ -101,7 +122,9 @@ vtkDICOMDictionary::Dict *vtkDICOMDictionary::FindPrivateDict(
   unsigned int h = vtkDICOMDictionary::HashLongString(name, stripname);
   unsigned int i = (h & m);
 
-  if (htable && (hptr = htable[i]) != NULL)
+  // read the row pointer only once, the row itself is never modified
+  hptr = vtkDICOMAtomicPointer::Load(&htable[i]);
+  if (hptr != NULL)
     {
     while (hptr->Dict != 0)
       {
@@ -116,6 +139,25 @@ vtkDICOMDictionary::Dict *vtkDICOMDictionary::FindPrivateDict(
   return 0;
 }
 
+//----------------------------------------------------------------------------
+void vtkDICOMDictionary::ReplacePrivateRow(unsigned int i, DictHashEntry *row)
+{
+  DictHashEntry **slot = &vtkDICOMDictionary::PrivateDictTable[i];
+  DictHashEntry *oldrow = *slot;
+
+  // the new row must be fully written before it becomes visible
+  vtkDICOMAtomicPointer::Store(slot, row);
+
+  // readers might still be using the old row, so keep it until exit
+  if (oldrow)
+    {
+    RetiredRow *r = new RetiredRow;
+    r->Row = oldrow;
+    r->Next = vtkDICOMDictionary::RetiredRows;
+    vtkDICOMDictionary::RetiredRows = r;
+    }
+}
+
 //----------------------------------------------------------------------------
 vtkDICOMDictEntry vtkDICOMDictionary::FindDictEntry(
   const vtkDICOMTag tag, const char *dictname)
@@ -226,81 +268,87 @@ vtkDICOMDictEntry vtkDICOMDictionary::FindDictEntry(
 void vtkDICOMDictionary::AddPrivateDictionary(Dict *dict)
 {
   unsigned int m = DICT_PRIVATE_TABLE_SIZE - 1;
-  DictHashEntry **htable = vtkDICOMDictionary::PrivateDictTable;
 
   // strip trailing spaces and compute the hash
   char stripname[64];
   unsigned int h = vtkDICOMDictionary::HashLongString(dict->Name, stripname);
   unsigned int i = (h & m);
-  DictHashEntry *hptr = htable[i];
 
-  // create hash table row if it is empty
-  if (hptr == 0)
-    {
-    htable[i] = new DictHashEntry[2];
-    hptr = htable[i];
-    hptr->Hash = 0;
-    hptr->Dict = 0;
-    }
+  vtkDICOMDictionary::WriteLock->Lock();
+  DictHashEntry *oldptr = vtkDICOMDictionary::PrivateDictTable[i];
 
-  // go to the end of the row in the hash table
+  // count the entries in the current row
   int n = 0;
-  while (hptr->Dict != 0)
-    {
-    n++;
-    hptr++;
-    }
-
-  // if n+1 is a power of two, double allocated space
-  if (n > 0 && (n & (n+1)) == 0)
+  if (oldptr)
     {
-    DictHashEntry *oldptr = htable[i];
-    hptr = new DictHashEntry[2*(n+1)];
-    htable[i] = hptr;
-    // copy the old list
-    for (int j = 0; j < n; j++)
+    while (oldptr[n].Dict != 0)
       {
-      *hptr++ = oldptr[j];
+      n++;
       }
-    delete [] oldptr;
     }
 
-  hptr->Hash = h;
-  hptr->Dict = dict;
+  // make a new row with the old entries, the new entry, and a terminator
+  DictHashEntry *hptr = new DictHashEntry[n + 2];
+  for (int j = 0; j < n; j++)
+    {
+    hptr[j] = oldptr[j];
+    }
+  hptr[n].Hash = h;
+  hptr[n].Dict = dict;
+  hptr[n+1].Hash = 0;
+  hptr[n+1].Dict = 0;
 
-  hptr++;
-  hptr->Hash = 0;
-  hptr->Dict = 0;
+  vtkDICOMDictionary::ReplacePrivateRow(i, hptr);
+  vtkDICOMDictionary::WriteLock->Unlock();
 }
 
 //----------------------------------------------------------------------------
 void vtkDICOMDictionary::RemovePrivateDictionary(const char *name)
 {
   unsigned int m = DICT_PRIVATE_TABLE_SIZE - 1;
-  DictHashEntry **htable = vtkDICOMDictionary::PrivateDictTable;
-  DictHashEntry *hptr;
 
   // strip trailing spaces and compute the hash
   char stripname[64];
   unsigned int h = vtkDICOMDictionary::HashLongString(name, stripname);
   unsigned int i = (h & m);
 
-  if (htable && (hptr = htable[i]) != NULL)
+  vtkDICOMDictionary::WriteLock->Lock();
+  DictHashEntry *oldptr = vtkDICOMDictionary::PrivateDictTable[i];
+
+  // find the entry to remove
+  int n = 0;
+  int k = -1;
+  if (oldptr)
     {
-    while (hptr->Dict != 0)
+    while (oldptr[n].Dict != 0)
       {
-      if (hptr->Hash == h && strncmp(hptr->Dict->Name, stripname, 64) == 0)
+      if (k < 0 && oldptr[n].Hash == h &&
+          strncmp(oldptr[n].Dict->Name, stripname, 64) == 0)
         {
-        break;
+        k = n;
         }
-      hptr++;
+      n++;
       }
+    }
 
-    // erase
-    while (hptr->Dict != 0)
+  if (k >= 0)
+    {
+    // make a new row without the entry, or remove the row if empty
+    DictHashEntry *hptr = 0;
+    if (n > 1)
       {
-      *hptr = *(hptr + 1);
-      hptr++;
+      hptr = new DictHashEntry[n];
+      int l = 0;
+      for (int j = 0; j <= n; j++)
+        {
+        if (j != k)
+          {
+          hptr[l++] = oldptr[j];
+          }
+        }
       }
+    vtkDICOMDictionary::ReplacePrivateRow(i, hptr);
     }
+
+  vtkDICOMDictionary::WriteLock->Unlock();
 }
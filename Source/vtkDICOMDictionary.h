@@ -22,6 +22,8 @@
 #define DICT_HASH_TABLE_SIZE 1024
 #define DICT_PRIVATE_TABLE_SIZE 64
 
+class vtkSimpleMutexLock;
+
 //! Provide access to the DICOM tag dictionary.
 class VTK_DICOM_EXPORT vtkDICOMDictionary
 {
@@ -71,11 +73,17 @@ public:
   /*!
    *  The name should be the text that appears in the PrivateCreator
    *  element of the data set when this dictionary is used.  The value
-   *  of "n" is the size of the provided hash table.
+   *  of "n" is the size of the provided hash table.  It is safe to call
+   *  this method while other threads are looking up dictionary entries.
    */
   static void AddPrivateDictionary(Dict *dict);
 
   //! Remove a private dictionary.
+  /*!
+   *  It is safe to call this method while other threads are looking up
+   *  dictionary entries, but the Dict itself must not be freed until
+   *  those lookups are done, since they might still be using it.
+   */
   static void RemovePrivateDictionary(const char *name);
 
 private:
@@ -98,8 +106,24 @@ private:
   //! The lookup table for the dictionary.
   static Dict DictData;
 
+  //! Replace a row of the private dictionary table.
+  /*!
+   *  Rows are never modified after they are placed in the table, which
+   *  allows lookups to proceed without locking.  The old row is kept
+   *  until exit, in case another thread is still reading it.  This must
+   *  only be called while WriteLock is held.
+   */
+  static void ReplacePrivateRow(unsigned int i, DictHashEntry *row);
+
   //! The lookup table for private dictionaries.
   static DictHashEntry *PrivateDictTable[DICT_PRIVATE_TABLE_SIZE];
+
+  //! Rows that were replaced, which will be freed at exit.
+  struct RetiredRow;
+  static RetiredRow *RetiredRows;
+
+  //! A lock to serialize changes to the private dictionary table.
+  static vtkSimpleMutexLock *WriteLock;
 };
 
 //! Initializer (Schwarz counter).
@@ -13,6 +13,7 @@
 =========================================================================*/
 #include "vtkDICOMDirectory.h"
 
+#include "vtkDICOMFile.h"
 #include "vtkDICOMItem.h"
 #include "vtkDICOMMetaData.h"
 #include "vtkDICOMParser.h"
@@ -26,6 +27,8 @@
 #include <vtkErrorCode.h>
 #include <vtkCommand.h>
 #include <vtkUnsignedShortArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 
 #include <string>
 #include <vector>
@@ -48,6 +51,7 @@ struct vtkDICOMDirectory::SeriesItem
 {
   vtkDICOMItem Record;
   vtkSmartPointer<vtkStringArray> Files;
+  vtkSmartPointer<vtkDICOMMetaData> MetaData;
 };
 
 struct vtkDICOMDirectory::StudyItem
@@ -106,6 +110,10 @@ struct vtkDICOMDirectory::SeriesInfo
   unsigned int SeriesNumber;
   std::vector<FileInfo> Files;
   bool QueryMatched;
+  // -- META DATA (for first file, if RetainSeriesMetaData is set) --
+  vtkSmartPointer<vtkDICOMMetaData> MetaData;
+  unsigned int MetaDataInstance;
+  bool MetaDataCached;
 };
 
 bool vtkDICOMDirectory::CompareInstance(
@@ -114,6 +122,68 @@ bool vtkDICOMDirectory::CompareInstance(
   return (fi1.InstanceNumber < fi2.InstanceNumber);
 }
 
+int vtkDICOMDirectory::CompareSeries(
+  const SeriesInfo &si, const SeriesInfo &fi)
+{
+  // Compare patient, then study, then series.
+  const char *patientName = fi.PatientName.GetCharData();
+  patientName = (patientName ? patientName : "");
+  const char *patientID = fi.PatientID.GetCharData();
+  patientID = (patientID ? patientID : "");
+  const char *patientName2 = si.PatientName.GetCharData();
+  patientName2 = (patientName2 ? patientName2 : "");
+  const char *patientID2 = si.PatientID.GetCharData();
+  patientID2 = (patientID2 ? patientID2 : "");
+  int c = strcmp(patientID2, patientID);
+  if (c != 0 || patientID[0] == '\0')
+    {
+    // Use ID to identify patient, but use name to sort.
+    int c2 = strcmp(patientName2, patientName);
+    c = (c2 == 0 ? c : c2);
+    }
+  if (c == 0)
+    {
+    const char *studyUID = fi.StudyUID.GetCharData();
+    c = vtkDICOMUtilities::CompareUIDs(
+      studyUID, si.StudyUID.GetCharData());
+    if (c != 0 || studyUID == 0)
+      {
+      // Use UID to identify study, but use date to sort.
+      int c2 = 0;
+      const char *studyDate = fi.StudyDate.GetCharData();
+      const char *studyDate2 = si.StudyDate.GetCharData();
+      if (studyDate && studyDate2)
+        {
+        c2 = strcmp(studyDate2, studyDate);
+        if (c2 == 0)
+          {
+          const char *studyTime = fi.StudyTime.GetCharData();
+          const char *studyTime2 = si.StudyTime.GetCharData();
+          if (studyTime2 && studyTime)
+            {
+            c2 = strcmp(studyTime, studyTime2);
+            }
+          }
+        }
+      c = (c2 == 0 ? c : c2);
+      }
+    if (c == 0)
+      {
+      const char *seriesUID = fi.SeriesUID.GetCharData();
+      c = vtkDICOMUtilities::CompareUIDs(
+        seriesUID, si.SeriesUID.GetCharData());
+      if (c != 0 || seriesUID == 0)
+        {
+        // Use UID to identify series, but use series number to sort.
+        int c2 = si.SeriesNumber - fi.SeriesNumber;
+        c = (c2 == 0 ? c : c2);
+        }
+      }
+    }
+
+  return c;
+}
+
 //----------------------------------------------------------------------------
 // A temporary container class for use with stl algorithms
 
@@ -121,12 +191,814 @@ class vtkDICOMDirectory::SeriesInfoList
   : public std::list<vtkDICOMDirectory::SeriesInfo>
 {};
 
+//----------------------------------------------------------------------------
+// A hash table, keyed on SeriesInstanceUID, that remembers which series in
+// the sorted list each file was added to.  It is only used to find the
+// series for a file without walking the list, and only returns a series if
+// walking the list would have stopped at that same series.
+
+class vtkDICOMDirectory::SeriesInfoCache
+{
+public:
+  SeriesInfoCache() : Count(0), Buckets(64) {}
+
+  // Find the series that "fi" belongs to, or return l->end() if the
+  // list must be walked.
+  SeriesInfoList::iterator Find(SeriesInfoList *l, const SeriesInfo &fi);
+
+  // Remember that the file "fi" was added to the series "li".
+  void Added(SeriesInfoList::iterator li, const SeriesInfo &fi);
+
+  // Call this after a new series has been inserted into the list.
+  void Inserted(SeriesInfoList::iterator li);
+
+private:
+  struct Entry
+  {
+    // the attributes used by CompareSeries(), copied from the file
+    SeriesInfo Key;
+    SeriesInfoList::iterator Series;
+    size_t InsertCount;
+  };
+
+  typedef std::vector<Entry> Bucket;
+
+  static unsigned int HashUID(const char *uid);
+  static bool SameValue(const vtkDICOMValue &a, const vtkDICOMValue &b);
+  static bool SameKey(const SeriesInfo &a, const SeriesInfo &b);
+
+  size_t Count;
+  std::vector<Bucket> Buckets;
+  std::vector<const SeriesInfo *> Insertions;
+};
+
+unsigned int vtkDICOMDirectory::SeriesInfoCache::HashUID(const char *uid)
+{
+  // the "djb2" string hash
+  unsigned int h = 5381;
+  while (*uid != '\0')
+    {
+    h = (h << 5) + h + static_cast<unsigned char>(*uid++);
+    }
+  return h;
+}
+
+bool vtkDICOMDirectory::SeriesInfoCache::SameValue(
+  const vtkDICOMValue &a, const vtkDICOMValue &b)
+{
+  const char *cp1 = a.GetCharData();
+  const char *cp2 = b.GetCharData();
+  return ((cp1 == 0 || cp2 == 0) ? (cp1 == cp2) : (strcmp(cp1, cp2) == 0));
+}
+
+bool vtkDICOMDirectory::SeriesInfoCache::SameKey(
+  const SeriesInfo &a, const SeriesInfo &b)
+{
+  return (a.SeriesNumber == b.SeriesNumber &&
+          SameValue(a.SeriesUID, b.SeriesUID) &&
+          SameValue(a.StudyUID, b.StudyUID) &&
+          SameValue(a.StudyDate, b.StudyDate) &&
+          SameValue(a.StudyTime, b.StudyTime) &&
+          SameValue(a.PatientID, b.PatientID) &&
+          SameValue(a.PatientName, b.PatientName));
+}
+
+vtkDICOMDirectory::SeriesInfoList::iterator
+vtkDICOMDirectory::SeriesInfoCache::Find(
+  SeriesInfoList *l, const SeriesInfo &fi)
+{
+  const char *uid = fi.SeriesUID.GetCharData();
+  if (uid == 0)
+    {
+    return l->end();
+    }
+
+  Bucket& b = this->Buckets[HashUID(uid) % this->Buckets.size()];
+  for (Bucket::iterator bi = b.begin(); bi != b.end(); ++bi)
+    {
+    if (SameKey(bi->Key, fi))
+      {
+      // The result of CompareSeries() depends only on the key, so the
+      // walk would still stop at the same series unless a series that
+      // compares as greater or equal has been inserted since then.
+      size_t n = this->Insertions.size();
+      size_t i = bi->InsertCount;
+      while (i < n && CompareSeries(*this->Insertions[i], fi) < 0)
+        {
+        i++;
+        }
+      if (i < n)
+        {
+        return l->end();
+        }
+      bi->InsertCount = n;
+      return bi->Series;
+      }
+    }
+
+  return l->end();
+}
+
+void vtkDICOMDirectory::SeriesInfoCache::Added(
+  SeriesInfoList::iterator li, const SeriesInfo &fi)
+{
+  const char *uid = fi.SeriesUID.GetCharData();
+  if (uid == 0)
+    {
+    // files without a UID never join an existing series
+    return;
+    }
+
+  Bucket& b = this->Buckets[HashUID(uid) % this->Buckets.size()];
+  for (Bucket::iterator bi = b.begin(); bi != b.end(); ++bi)
+    {
+    if (SameKey(bi->Key, fi))
+      {
+      bi->Series = li;
+      bi->InsertCount = this->Insertions.size();
+      return;
+      }
+    }
+
+  // grow the table to keep the buckets short
+  if (++this->Count > this->Buckets.size())
+    {
+    std::vector<Bucket> buckets(2*this->Buckets.size());
+    for (size_t i = 0; i < this->Buckets.size(); i++)
+      {
+      const Bucket& ob = this->Buckets[i];
+      for (Bucket::const_iterator bi = ob.begin(); bi != ob.end(); ++bi)
+        {
+        const char *u = bi->Key.SeriesUID.GetCharData();
+        buckets[HashUID(u) % buckets.size()].push_back(*bi);
+        }
+      }
+    this->Buckets.swap(buckets);
+    }
+
+  // copy the key values out of the file's value pool
+  Entry e;
+  e.Key.PatientName = fi.PatientName.GetUnpooledCopy();
+  e.Key.PatientID = fi.PatientID.GetUnpooledCopy();
+  e.Key.StudyDate = fi.StudyDate.GetUnpooledCopy();
+  e.Key.StudyTime = fi.StudyTime.GetUnpooledCopy();
+  e.Key.StudyUID = fi.StudyUID.GetUnpooledCopy();
+  e.Key.SeriesUID = fi.SeriesUID.GetUnpooledCopy();
+  e.Key.SeriesNumber = fi.SeriesNumber;
+  e.Series = li;
+  e.InsertCount = this->Insertions.size();
+  this->Buckets[HashUID(uid) % this->Buckets.size()].push_back(e);
+}
+
+void vtkDICOMDirectory::SeriesInfoCache::Inserted(
+  SeriesInfoList::iterator li)
+{
+  this->Insertions.push_back(&(*li));
+}
+
+//----------------------------------------------------------------------------
+// A persistent cache of the information that is needed to sort the files.
+// The cache file consists of a header, followed by one entry per file:
+//   header:  magic string, version, query signature, number of entries
+//   entry:   path, size, modification time, flags, pixel data offset,
+//            and the attributes (tag, VR, character set, length, data)
+// All integers are stored as little-endian.
+
+class vtkDICOMDirectory::HeaderCache
+{
+public:
+  enum FlagBits
+  {
+    IsDICOM = 1,
+    PixelDataFound = 2,
+    QueryMatched = 4
+  };
+
+  struct Entry
+  {
+    vtkTypeInt64 FileSize;
+    vtkTypeInt64 ModifiedTime;
+    vtkTypeInt64 PixelDataOffset;
+    unsigned int Flags;
+    bool Valid;
+    bool Seen;
+    std::string Attributes;
+  };
+
+  HeaderCache(vtkDICOMMetaData *query);
+
+  // Read the cache file.  Entries are discarded if the query has changed.
+  bool Read(const char *fname);
+
+  // Write the cache file.  Entries for files that are gone are discarded.
+  bool Write(const char *fname);
+
+  // Get the entry for a file, return true if the entry is up-to-date.
+  bool Find(const std::string& path, Entry **entry);
+
+  // Save the attributes that are needed for sorting.
+  static void Store(Entry *entry, unsigned int flags, vtkTypeInt64 offset,
+                    vtkDICOMMetaData *meta, const DC::EnumType *tags);
+
+  // Restore the saved attributes.
+  static void Restore(const Entry *entry, vtkDICOMMetaData *meta);
+
+private:
+  // Encode the query, recursing into sequences.
+  static void AppendQuery(std::string *sig, vtkDICOMDataElementIterator iter,
+                          vtkDICOMDataElementIterator iterEnd);
+
+  // Encoding and decoding of integers.
+  static void AppendInt(std::string *s, vtkTypeUInt64 v, int n);
+  static vtkTypeUInt64 DecodeInt(const char **cpp, const char *ep, int n);
+  static void AppendString(std::string *s, const std::string& v);
+  static bool DecodeString(const char **cpp, const char *ep, std::string *v);
+
+  std::map<std::string, Entry> Entries;
+  std::string Signature;
+};
+
+const char vtkDICOMDirectoryCacheMagic[] = "vtkDICOMDirectoryCache";
+const unsigned int vtkDICOMDirectoryCacheVersion = 2;
+
+vtkDICOMDirectory::HeaderCache::HeaderCache(vtkDICOMMetaData *query)
+{
+  AppendQuery(&this->Signature, query->Begin(), query->End());
+}
+
+void vtkDICOMDirectory::HeaderCache::AppendInt(
+  std::string *s, vtkTypeUInt64 v, int n)
+{
+  for (int i = 0; i < n; i++)
+    {
+    s->push_back(static_cast<char>(v & 0xFF));
+    v >>= 8;
+    }
+}
+
+vtkTypeUInt64 vtkDICOMDirectory::HeaderCache::DecodeInt(
+  const char **cpp, const char *ep, int n)
+{
+  const unsigned char *cp = reinterpret_cast<const unsigned char *>(*cpp);
+  vtkTypeUInt64 v = 0;
+  if (ep - *cpp >= n)
+    {
+    for (int i = n; i > 0; i--)
+      {
+      v = (v << 8) | cp[i-1];
+      }
+    }
+  *cpp += n;
+  return v;
+}
+
+void vtkDICOMDirectory::HeaderCache::AppendString(
+  std::string *s, const std::string& v)
+{
+  AppendInt(s, v.length(), 4);
+  s->append(v);
+}
+
+bool vtkDICOMDirectory::HeaderCache::DecodeString(
+  const char **cpp, const char *ep, std::string *v)
+{
+  size_t l = static_cast<size_t>(DecodeInt(cpp, ep, 4));
+  if (*cpp > ep || static_cast<size_t>(ep - *cpp) < l)
+    {
+    return false;
+    }
+  v->assign(*cpp, l);
+  *cpp += l;
+  return true;
+}
+
+void vtkDICOMDirectory::HeaderCache::AppendQuery(
+  std::string *sig, vtkDICOMDataElementIterator iter,
+  vtkDICOMDataElementIterator iterEnd)
+{
+  for (; iter != iterEnd; ++iter)
+    {
+    const vtkDICOMValue& v = iter->GetValue();
+    vtkDICOMTag tag = iter->GetTag();
+    AppendInt(sig, tag.GetGroup(), 2);
+    AppendInt(sig, tag.GetElement(), 2);
+    sig->append(v.GetVR().GetText(), 2);
+    if (v.GetVR() == vtkDICOMVR::SQ)
+      {
+      unsigned int n = v.GetNumberOfValues();
+      const vtkDICOMItem *items = v.GetSequenceData();
+      AppendInt(sig, n, 4);
+      for (unsigned int i = 0; i < n; i++)
+        {
+        AppendQuery(sig, items[i].Begin(), items[i].End());
+        AppendInt(sig, 0xFFFE, 2);
+        AppendInt(sig, 0xE00D, 2);
+        }
+      }
+    else if (v.GetCharData())
+      {
+      AppendString(sig, std::string(v.GetCharData(), v.GetVL()));
+      }
+    else
+      {
+      AppendString(sig, v.AsString());
+      }
+    }
+}
+
+bool vtkDICOMDirectory::HeaderCache::Read(const char *fname)
+{
+  vtkDICOMFile infile(fname, vtkDICOMFile::In);
+  if (infile.GetError())
+    {
+    return false;
+    }
+
+  vtkDICOMFile::Size size = infile.GetSize();
+  std::string buffer;
+  buffer.resize(static_cast<size_t>(size));
+  if (size == 0 || infile.Read(reinterpret_cast<unsigned char *>(
+        &buffer[0]), buffer.size()) != buffer.size())
+    {
+    return false;
+    }
+  infile.Close();
+
+  const char *cp = buffer.data();
+  const char *ep = cp + buffer.size();
+  std::string magic;
+  std::string signature;
+  if (!DecodeString(&cp, ep, &magic) ||
+      magic != vtkDICOMDirectoryCacheMagic ||
+      DecodeInt(&cp, ep, 4) != vtkDICOMDirectoryCacheVersion)
+    {
+    return false;
+    }
+  if (!DecodeString(&cp, ep, &signature) || signature != this->Signature)
+    {
+    // the QueryMatched flags are useless if the query has changed
+    return true;
+    }
+
+  vtkTypeUInt64 n = DecodeInt(&cp, ep, 8);
+  for (vtkTypeUInt64 i = 0; i < n && cp < ep; i++)
+    {
+    std::string path;
+    Entry e;
+    bool good = DecodeString(&cp, ep, &path);
+    e.FileSize = static_cast<vtkTypeInt64>(DecodeInt(&cp, ep, 8));
+    e.ModifiedTime = static_cast<vtkTypeInt64>(DecodeInt(&cp, ep, 8));
+    e.PixelDataOffset = static_cast<vtkTypeInt64>(DecodeInt(&cp, ep, 8));
+    e.Flags = static_cast<unsigned int>(DecodeInt(&cp, ep, 4));
+    good &= DecodeString(&cp, ep, &e.Attributes);
+    if (!good || cp > ep)
+      {
+      break;
+      }
+    e.Valid = true;
+    e.Seen = false;
+    this->Entries[path] = e;
+    }
+
+  return true;
+}
+
+bool vtkDICOMDirectory::HeaderCache::Write(const char *fname)
+{
+  std::string buffer;
+  AppendString(&buffer, vtkDICOMDirectoryCacheMagic);
+  AppendInt(&buffer, vtkDICOMDirectoryCacheVersion, 4);
+  AppendString(&buffer, this->Signature);
+
+  std::string entries;
+  vtkTypeUInt64 n = 0;
+  std::map<std::string, Entry>::iterator iter;
+  for (iter = this->Entries.begin(); iter != this->Entries.end(); ++iter)
+    {
+    const Entry& e = iter->second;
+    if (e.Valid &&
+        (e.Seen || vtksys::SystemTools::FileExists(iter->first.c_str())))
+      {
+      AppendString(&entries, iter->first);
+      AppendInt(&entries, e.FileSize, 8);
+      AppendInt(&entries, e.ModifiedTime, 8);
+      AppendInt(&entries, e.PixelDataOffset, 8);
+      AppendInt(&entries, e.Flags, 4);
+      AppendString(&entries, e.Attributes);
+      n++;
+      }
+    }
+  AppendInt(&buffer, n, 8);
+  buffer.append(entries);
+
+  // write to a temporary file in the same directory, and then rename
+  // it, so that a failed write or a concurrent scan never sees a partly
+  // written cache (the UID makes the temporary name unique)
+  std::string tempName = fname;
+  tempName += ".";
+  tempName += vtkDICOMUtilities::GenerateUID(DC::SOPInstanceUID);
+  tempName += ".tmp";
+  vtkDICOMFile outfile(tempName.c_str(), vtkDICOMFile::Out);
+  if (outfile.GetError())
+    {
+    return false;
+    }
+  size_t l = outfile.Write(
+    reinterpret_cast<const unsigned char *>(buffer.data()), buffer.size());
+  outfile.Close();
+  if (l != buffer.size() ||
+      vtkDICOMFile::Rename(tempName.c_str(), fname) != 0)
+    {
+    vtkDICOMFile::Remove(tempName.c_str());
+    return false;
+    }
+  return true;
+}
+
+bool vtkDICOMDirectory::HeaderCache::Find(
+  const std::string& path, Entry **entry)
+{
+  // use the full precision of the modification time, so that a file
+  // rewritten within the same second is seen as changed
+  vtkDICOMFile::Size size = 0;
+  long long time = 0;
+  vtkDICOMFile::Stat(path.c_str(), &size, &time);
+  vtkTypeInt64 fileSize = static_cast<vtkTypeInt64>(size);
+  vtkTypeInt64 mtime = static_cast<vtkTypeInt64>(time);
+
+  std::map<std::string, Entry>::iterator iter = this->Entries.find(path);
+  if (iter == this->Entries.end())
+    {
+    iter = this->Entries.insert(std::make_pair(path, Entry())).first;
+    iter->second.Valid = false;
+    }
+
+  Entry *e = &iter->second;
+  e->Seen = true;
+  *entry = e;
+
+  if (e->Valid && e->FileSize == fileSize && e->ModifiedTime == mtime)
+    {
+    return true;
+    }
+
+  e->FileSize = fileSize;
+  e->ModifiedTime = mtime;
+  e->Valid = false;
+  return false;
+}
+
+void vtkDICOMDirectory::HeaderCache::Store(
+  Entry *e, unsigned int flags, vtkTypeInt64 offset,
+  vtkDICOMMetaData *meta, const DC::EnumType *tags)
+{
+  e->Flags = flags;
+  e->PixelDataOffset = offset;
+  e->Attributes.clear();
+  e->Valid = true;
+
+  for (; meta && *tags != DC::ItemDelimitationItem; tags++)
+    {
+    // only text values are needed for sorting
+    const vtkDICOMValue& v = meta->GetAttributeValue(*tags);
+    const char *cp = v.GetCharData();
+    if (cp)
+      {
+      vtkDICOMTag tag = *tags;
+      AppendInt(&e->Attributes, tag.GetGroup(), 2);
+      AppendInt(&e->Attributes, tag.GetElement(), 2);
+      e->Attributes.append(v.GetVR().GetText(), 2);
+      e->Attributes.push_back(static_cast<char>(v.GetCharacterSet().GetKey()));
+      AppendString(&e->Attributes, std::string(cp, v.GetVL()));
+      }
+    }
+}
+
+void vtkDICOMDirectory::HeaderCache::Restore(
+  const Entry *e, vtkDICOMMetaData *meta)
+{
+  const char *cp = e->Attributes.data();
+  const char *ep = cp + e->Attributes.size();
+  vtkDICOMValue::Pool *pool = meta->GetValuePool();
+  while (ep - cp >= 11)
+    {
+    unsigned short g = static_cast<unsigned short>(DecodeInt(&cp, ep, 2));
+    unsigned short n = static_cast<unsigned short>(DecodeInt(&cp, ep, 2));
+    vtkDICOMVR vr(cp);
+    vtkDICOMCharacterSet cs(static_cast<unsigned char>(cp[2]));
+    cp += 3;
+    std::string text;
+    if (!DecodeString(&cp, ep, &text))
+      {
+      break;
+      }
+
+    // create the value exactly as the parser would
+    vtkDICOMValue v;
+    size_t vl = text.length();
+    char *ptr = v.AllocateCharData(vr, cs, vl, pool);
+    if (vl > 0)
+      {
+      memcpy(ptr, text.data(), vl);
+      }
+    if (vl == 0 || ptr[vl-1] != '\0') { ptr[vl] = '\0'; }
+    v.ComputeNumberOfValuesForCharData();
+    meta->SetAttributeValue(vtkDICOMTag(g, n), v);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Parse files with a pool of threads, where each thread has its own
+// parser.  The files are parsed one block at a time.
+
+class vtkDICOMDirectory::FileScan
+{
+public:
+  struct Result
+  {
+    vtkDICOMMetaData *MetaData;
+    bool IsDICOM;
+    bool PixelDataFound;
+    bool QueryMatched;
+    bool Cached;
+    vtkTypeInt64 FileOffset;
+    unsigned long ErrorCode;
+    std::vector<std::string> Errors;
+    HeaderCache::Entry *CacheEntry;
+  };
+
+  FileScan(vtkStringArray *input, vtkDICOMMetaData *query, int bufferSize,
+           int numThreads, int blockSize);
+  ~FileScan();
+
+  // Report errors to this object as soon as they occur, rather than
+  // holding them, which is only done if there is just one thread.
+  void SetErrorRelay(vtkDICOMDirectory *relay) { this->Relay = relay; }
+
+  // Use a cache, and specify which attributes to store in the cache.
+  void SetCache(HeaderCache *cache, const DC::EnumType *tags) {
+    this->Cache = cache; this->CacheTags = tags; }
+
+  // Defer the reading of values that are larger than the given size.
+  void SetDeferredValueThreshold(unsigned int size);
+
+  // Stop parsing each file as soon as it fails to match the query.
+  void SetStopOnQueryFailure(bool stop);
+
+  // Parse the files from "first" up to (but not including) "last".
+  void Execute(vtkIdType first, vtkIdType last);
+
+  // Get the result for a file after Execute() has been called.
+  Result *GetResult(vtkIdType j) { return &this->Results[j - this->First]; }
+
+  // Store the errors from the parsers.
+  void HandleError(vtkObject *o, unsigned long e, void *data);
+
+private:
+  // Parse files until none are left.
+  void ThreadExecute(int threadId);
+
+  // Get the next file to parse, or -1 if there are none.
+  vtkIdType NextFile();
+
+  // The function that is called by vtkMultiThreader.
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+
+  vtkStringArray *Input;
+  HeaderCache *Cache;
+  const DC::EnumType *CacheTags;
+  std::vector<Result> Results;
+  std::vector<vtkDICOMParser *> Parsers;
+  std::vector<Result *> Current;
+  vtkDICOMDirectory *Relay;
+  vtkMultiThreader *Threader;
+  vtkMutexLock *Lock;
+  vtkIdType First;
+  vtkIdType Last;
+  vtkIdType Next;
+
+  FileScan(const FileScan&);
+  void operator=(const FileScan&);
+};
+
+vtkDICOMDirectory::FileScan::FileScan(
+  vtkStringArray *input, vtkDICOMMetaData *query, int bufferSize,
+  int numThreads, int blockSize)
+  : Input(input), Cache(0), CacheTags(0),
+    Results(blockSize), Parsers(numThreads),
+    Current(numThreads), Relay(0), Threader(0), First(0), Last(0), Next(0)
+{
+  // create all the VTK objects before the threads start
+  for (int i = 0; i < blockSize; i++)
+    {
+    // the headers are discarded after each block, so use a pool
+    this->Results[i].MetaData = vtkDICOMMetaData::New();
+    this->Results[i].MetaData->SetUseValuePool(true);
+    }
+  for (int j = 0; j < numThreads; j++)
+    {
+    vtkDICOMParser *parser = vtkDICOMParser::New();
+    parser->AddObserver(
+      vtkCommand::ErrorEvent, this, &FileScan::HandleError);
+    if (bufferSize > 0)
+      {
+      parser->SetBufferSize(bufferSize);
+      }
+    parser->SetQuery(query);
+    // skip files that are not DICOM without opening them twice
+    parser->CheckFileHeaderOn();
+    this->Parsers[j] = parser;
+    this->Current[j] = 0;
+    }
+  if (numThreads > 1)
+    {
+    this->Threader = vtkMultiThreader::New();
+    this->Threader->SetNumberOfThreads(numThreads);
+    }
+  this->Lock = vtkMutexLock::New();
+}
+
+vtkDICOMDirectory::FileScan::~FileScan()
+{
+  for (size_t i = 0; i < this->Results.size(); i++)
+    {
+    this->Results[i].MetaData->Delete();
+    }
+  for (size_t j = 0; j < this->Parsers.size(); j++)
+    {
+    this->Parsers[j]->Delete();
+    }
+  if (this->Threader)
+    {
+    this->Threader->Delete();
+    }
+  this->Lock->Delete();
+}
+
+void vtkDICOMDirectory::FileScan::SetDeferredValueThreshold(unsigned int size)
+{
+  for (size_t j = 0; j < this->Parsers.size(); j++)
+    {
+    this->Parsers[j]->SetDeferredValueThreshold(size);
+    }
+}
+
+void vtkDICOMDirectory::FileScan::HandleError(
+  vtkObject *o, unsigned long e, void *data)
+{
+  // errors are held, they will be reported after the threads finish,
+  // unless they are being relayed directly
+  for (size_t j = 0; j < this->Parsers.size(); j++)
+    {
+    if (this->Parsers[j] == o && this->Current[j])
+      {
+      this->Current[j]->Errors.push_back(
+        data ? static_cast<char *>(data) : "An unknown error ocurred!");
+      if (this->Relay)
+        {
+        this->Relay->RelayError(o, e, data);
+        }
+      }
+    }
+}
+
+void vtkDICOMDirectory::FileScan::SetStopOnQueryFailure(bool stop)
+{
+  for (size_t j = 0; j < this->Parsers.size(); j++)
+    {
+    this->Parsers[j]->SetStopOnQueryFailure(stop);
+    }
+}
+
+vtkIdType vtkDICOMDirectory::FileScan::NextFile()
+{
+  this->Lock->Lock();
+  vtkIdType j = this->Next;
+  if (j >= this->Last)
+    {
+    j = -1;
+    }
+  else
+    {
+    this->Next++;
+    }
+  this->Lock->Unlock();
+  return j;
+}
+
+void vtkDICOMDirectory::FileScan::ThreadExecute(int threadId)
+{
+  vtkDICOMParser *parser = this->Parsers[threadId];
+  vtkIdType j;
+  while ((j = this->NextFile()) >= 0)
+    {
+    Result *result = this->GetResult(j);
+    const std::string& fileName = this->Input->GetValue(j);
+    if (result->Cached)
+      {
+      continue;
+      }
+
+    // The parser checks whether the file looks like DICOM before
+    // parsing it, so that the file is only opened once.
+    this->Current[threadId] = result;
+    parser->SetMetaData(result->MetaData);
+    parser->SetFileName(fileName.c_str());
+    parser->Update();
+    parser->SetMetaData(0);
+    this->Current[threadId] = 0;
+
+    // Skip anything that does not look like a DICOM file.
+    result->IsDICOM = parser->GetFileIsDICOM();
+    if (!result->IsDICOM)
+      {
+      continue;
+      }
+
+    result->PixelDataFound = parser->GetPixelDataFound();
+    result->QueryMatched = parser->GetQueryMatched();
+    result->FileOffset = parser->GetFileOffset();
+    result->ErrorCode = parser->GetErrorCode();
+    }
+}
+
+VTK_THREAD_RETURN_TYPE vtkDICOMDirectory::FileScan::ThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  FileScan *scan = static_cast<FileScan *>(info->UserData);
+
+  scan->ThreadExecute(info->ThreadID);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+void vtkDICOMDirectory::FileScan::Execute(vtkIdType first, vtkIdType last)
+{
+  this->First = first;
+  this->Last = last;
+  this->Next = first;
+
+  for (vtkIdType j = first; j < last; j++)
+    {
+    Result *result = this->GetResult(j);
+    result->MetaData->Initialize();
+    result->IsDICOM = false;
+    result->PixelDataFound = false;
+    result->QueryMatched = false;
+    result->Cached = false;
+    result->FileOffset = 0;
+    result->ErrorCode = 0;
+    result->Errors.clear();
+    result->CacheEntry = 0;
+
+    // Use the cached information if the file has not changed
+    if (this->Cache &&
+        this->Cache->Find(this->Input->GetValue(j), &result->CacheEntry))
+      {
+      HeaderCache::Entry *e = result->CacheEntry;
+      result->Cached = true;
+      result->IsDICOM = ((e->Flags & HeaderCache::IsDICOM) != 0);
+      result->PixelDataFound = ((e->Flags & HeaderCache::PixelDataFound) != 0);
+      result->QueryMatched = ((e->Flags & HeaderCache::QueryMatched) != 0);
+      result->FileOffset = e->PixelDataOffset;
+      HeaderCache::Restore(e, result->MetaData);
+      }
+    }
+
+  if (this->Threader)
+    {
+    this->Threader->SetSingleMethod(FileScan::ThreadFunction, this);
+    this->Threader->SingleMethodExecute();
+    }
+  else
+    {
+    this->ThreadExecute(0);
+    }
+
+  // Add the newly parsed files to the cache, unless there were errors
+  for (vtkIdType k = first; k < last && this->Cache; k++)
+    {
+    Result *result = this->GetResult(k);
+    if (!result->Cached && result->Errors.empty())
+      {
+      unsigned int flags = 0;
+      flags |= (result->IsDICOM ? HeaderCache::IsDICOM : 0);
+      flags |= (result->PixelDataFound ? HeaderCache::PixelDataFound : 0);
+      flags |= (result->QueryMatched ? HeaderCache::QueryMatched : 0);
+      HeaderCache::Store(result->CacheEntry, flags, result->FileOffset,
+                         result->MetaData, this->CacheTags);
+      }
+    }
+}
+
 //----------------------------------------------------------------------------
 vtkDICOMDirectory::vtkDICOMDirectory()
 {
   this->DirectoryName = 0;
   this->InputFileNames = 0;
   this->FilePattern = 0;
+  this->CacheFileName = 0;
   this->Series = new SeriesVector;
   this->Studies = new StudyVector;
   this->Patients = new PatientVector;
@@ -135,7 +1007,10 @@ vtkDICOMDirectory::vtkDICOMDirectory()
   this->InternalFileName = 0;
   this->RequirePixelData = 1;
   this->FollowSymlinks = 1;
+  this->RetainSeriesMetaData = 0;
   this->ScanDepth = 1;
+  this->NumberOfThreads = 1;
+  this->DeferredValueThreshold = 0;
   this->Query = 0;
 }
 
@@ -149,6 +1024,7 @@ vtkDICOMDirectory::~vtkDICOMDirectory()
 
   delete [] this->DirectoryName;
   delete [] this->FilePattern;
+  delete [] this->CacheFileName;
   delete [] this->InternalFileName;
 
   delete this->Series;
@@ -173,6 +1049,14 @@ void vtkDICOMDirectory::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "ScanDepth: " << this->ScanDepth << "\n";
 
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+
+  os << indent << "DeferredValueThreshold: "
+     << this->DeferredValueThreshold << "\n";
+
+  os << indent << "CacheFileName: "
+     << (this->CacheFileName ? this->CacheFileName : "(NULL)") << "\n";
+
   os << indent << "FindLevel: "
      << (this->FindLevel == vtkDICOMDirectory::IMAGE ?
          "IMAGE\n" : "SERIES\n");
@@ -183,6 +1067,9 @@ void vtkDICOMDirectory::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "FollowSymlinks: "
      << (this->FollowSymlinks ? "On\n" : "Off\n");
 
+  os << indent << "RetainSeriesMetaData: "
+     << (this->RetainSeriesMetaData ? "On\n" : "Off\n");
+
   os << indent << "NumberOfSeries: " << this->GetNumberOfSeries() << "\n";
   os << indent << "NumberOfStudies: " << this->GetNumberOfStudies() << "\n";
   os << indent << "NumberOfPatients: " << this->GetNumberOfPatients() << "\n";
@@ -233,6 +1120,27 @@ void vtkDICOMDirectory::SetFilePattern(const char *name)
   this->Modified();
 }
 
+//----------------------------------------------------------------------------
+void vtkDICOMDirectory::SetCacheFileName(const char *name)
+{
+  if (name == this->CacheFileName ||
+      (name && this->CacheFileName &&
+       strcmp(name, this->CacheFileName) == 0))
+    {
+    return;
+    }
+
+  delete [] this->CacheFileName;
+  this->CacheFileName = 0;
+  if (name)
+    {
+    char *cp = new char[strlen(name) + 1];
+    strcpy(cp, name);
+    this->CacheFileName = cp;
+    }
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkDICOMDirectory::SetInputFileNames(vtkStringArray *sa)
 {
@@ -350,6 +1258,12 @@ vtkStringArray *vtkDICOMDirectory::GetFileNamesForSeries(int i)
   return (*this->Series)[i].Files;
 }
 
+//----------------------------------------------------------------------------
+vtkDICOMMetaData *vtkDICOMDirectory::GetMetaDataForSeries(int i)
+{
+  return (*this->Series)[i].MetaData;
+}
+
 //----------------------------------------------------------------------------
 void vtkDICOMDirectory::AddSeriesFileNames(
   int patient, int study, vtkStringArray *files,
@@ -435,7 +1349,8 @@ void vtkDICOMDirectory::FillSeriesRecord(
   const DC::EnumType *tag = tags;
   while (*tag != DC::ItemDelimitationItem)
     {
-    item->SetAttributeValue(*tag, meta->GetAttributeValue(*tag));
+    item->SetAttributeValue(
+      *tag, meta->GetAttributeValue(*tag).GetUnpooledCopy());
     tag++;
     }
 }
@@ -460,7 +1375,8 @@ void vtkDICOMDirectory::FillStudyRecord(
   const DC::EnumType *tag = tags;
   while (*tag != DC::ItemDelimitationItem)
     {
-    item->SetAttributeValue(*tag, meta->GetAttributeValue(*tag));
+    item->SetAttributeValue(
+      *tag, meta->GetAttributeValue(*tag).GetUnpooledCopy());
     tag++;
     }
 }
@@ -481,7 +1397,8 @@ void vtkDICOMDirectory::FillPatientRecord(
   const DC::EnumType *tag = tags;
   while (*tag != DC::ItemDelimitationItem)
     {
-    item->SetAttributeValue(*tag, meta->GetAttributeValue(*tag));
+    item->SetAttributeValue(
+      *tag, meta->GetAttributeValue(*tag).GetUnpooledCopy());
     tag++;
     }
 }
@@ -489,17 +1406,9 @@ void vtkDICOMDirectory::FillPatientRecord(
 //----------------------------------------------------------------------------
 void vtkDICOMDirectory::SortFiles(vtkStringArray *input)
 {
-  vtkSmartPointer<vtkDICOMMetaData> meta =
-    vtkSmartPointer<vtkDICOMMetaData>::New();
   vtkSmartPointer<vtkDICOMMetaData> query =
     vtkSmartPointer<vtkDICOMMetaData>::New();
-  vtkSmartPointer<vtkDICOMParser> parser =
-    vtkSmartPointer<vtkDICOMParser>::New();
-
-  parser->AddObserver(
-    vtkCommand::ErrorEvent, this, &vtkDICOMDirectory::RelayError);
-
-  parser->SetMetaData(meta);
+  int bufferSize = 0;
 
   // these are the attributes that must be part of the query
   static const DC::EnumType requiredElements[] = {
@@ -551,173 +1460,204 @@ void vtkDICOMDirectory::SortFiles(vtkStringArray *input)
       ++iter;
       }
     // use a buffer size equal to one disk block
-    parser->SetBufferSize(4096);
+    bufferSize = 4096;
+    }
+
+  vtkIdType numberOfStrings = input->GetNumberOfValues();
+
+  // If multithreaded, the files will be parsed in blocks
+  vtkIdType blockSize = 1;
+  int numThreads = this->NumberOfThreads;
+  numThreads = (numThreads < VTK_MAX_THREADS ? numThreads : VTK_MAX_THREADS);
+  if (numThreads > 1)
+    {
+    blockSize = 64*numThreads;
+    blockSize = (blockSize < numberOfStrings ? blockSize : numberOfStrings);
+    numThreads = static_cast<int>(
+      numThreads < blockSize ? numThreads : blockSize);
+    }
+  blockSize = (blockSize > 0 ? blockSize : 1);
+  FileScan scan(input, query, bufferSize,
+                numThreads, static_cast<int>(blockSize));
+  scan.SetDeferredValueThreshold(this->DeferredValueThreshold);
+  if (numThreads == 1)
+    {
+    scan.SetErrorRelay(this);
     }
 
-  parser->SetQuery(query);
+  // Use the cache from the previous scan
+  HeaderCache *headerCache = 0;
+  if (this->CacheFileName && this->CacheFileName[0] != '\0')
+    {
+    headerCache = new HeaderCache(query);
+    headerCache->Read(this->CacheFileName);
+    scan.SetCache(headerCache, requiredElements);
+    }
+  else if (this->Query && this->FindLevel == vtkDICOMDirectory::IMAGE)
+    {
+    // files that fail to match are discarded at the IMAGE level, so the
+    // parser can stop reading them early (but not if a cache is used,
+    // because the cache might later be used at the SERIES level)
+    scan.SetStopOnQueryFailure(true);
+    }
 
   SeriesInfoList sortedFiles;
   SeriesInfoList::iterator li;
+  SeriesInfoCache cache;
 
-  vtkIdType numberOfStrings = input->GetNumberOfValues();
-  for (vtkIdType j = 0; j < numberOfStrings; j++)
+  for (vtkIdType j0 = 0; j0 < numberOfStrings; j0 += blockSize)
     {
-    const std::string& fileName = input->GetValue(j);
+    vtkIdType j1 = j0 + blockSize;
+    j1 = (j1 < numberOfStrings ? j1 : numberOfStrings);
+    scan.Execute(j0, j1);
 
-    // Skip anything that does not look like a DICOM file.
-    if (!vtkDICOMUtilities::IsDICOMFile(fileName.c_str()))
+    for (vtkIdType j = j0; j < j1; j++)
       {
-      continue;
-      }
+      const std::string& fileName = input->GetValue(j);
+      FileScan::Result *result = scan.GetResult(j);
 
-    // Read the file metadata
-    meta->Initialize();
-    this->SetInternalFileName(fileName.c_str());
-    parser->SetFileName(fileName.c_str());
-    parser->Update();
-    if (!parser->GetPixelDataFound())
-      {
-      if (!this->ErrorCode)
+      // Skip anything that does not look like a DICOM file.
+      if (!result->IsDICOM)
         {
-        this->ErrorCode = parser->GetErrorCode();
+        continue;
         }
-      if (this->ErrorCode || this->RequirePixelData)
+
+      // Report the errors in the same order as for a single thread
+      this->SetInternalFileName(fileName.c_str());
+      for (size_t k = 0; k < result->Errors.size() && numThreads > 1; k++)
         {
-        continue;
+        this->SetErrorCode(result->ErrorCode);
+        vtkErrorMacro(<< result->Errors[k]);
         }
-      }
 
-    // Check for abort and update progress at 1% intervals
-    if (!this->AbortExecute)
-      {
-      double progress = (j + 1.0)/numberOfStrings;
-      if (progress == 1.0 || progress > this->GetProgress() + 0.01)
+      vtkDICOMMetaData *fileMeta = result->MetaData;
+      if (!result->PixelDataFound)
         {
-        progress = static_cast<int>(progress*100.0)/100.0;
-        this->UpdateProgress(progress);
+        if (!this->ErrorCode)
+          {
+          this->ErrorCode = result->ErrorCode;
+          }
+        if (this->ErrorCode || this->RequirePixelData)
+          {
+          continue;
+          }
         }
-      }
-    if (this->AbortExecute)
-      {
-      return;
-      }
 
-    // Check if the file matches the query
-    bool queryMatched = (!this->Query || parser->GetQueryMatched());
-    if (!queryMatched && this->FindLevel == vtkDICOMDirectory::IMAGE)
-      {
-      continue;
-      }
+      // Check for abort and update progress at 1% intervals
+      if (!this->AbortExecute)
+        {
+        double progress = (j + 1.0)/numberOfStrings;
+        if (progress == 1.0 || progress > this->GetProgress() + 0.01)
+          {
+          progress = static_cast<int>(progress*100.0)/100.0;
+          this->UpdateProgress(progress);
+          }
+        }
+      if (this->AbortExecute)
+        {
+        delete headerCache;
+        return;
+        }
 
-    // Insert the file into the sorted list
-    FileInfo fileInfo;
-    fileInfo.InstanceNumber =
-      meta->GetAttributeValue(DC::InstanceNumber).AsUnsignedInt();
-    fileInfo.FileName = fileName.c_str(); // stored in input StringArray
-
-    const vtkDICOMValue& patientNameValue =
-      meta->GetAttributeValue(DC::PatientName);
-    const vtkDICOMValue& patientIDValue =
-      meta->GetAttributeValue(DC::PatientID);
-    const vtkDICOMValue& studyDateValue =
-      meta->GetAttributeValue(DC::StudyDate);
-    const vtkDICOMValue& studyTimeValue =
-      meta->GetAttributeValue(DC::StudyTime);
-    const vtkDICOMValue& studyUIDValue =
-      meta->GetAttributeValue(DC::StudyInstanceUID);
-    const vtkDICOMValue& seriesUIDValue =
-      meta->GetAttributeValue(DC::SeriesInstanceUID);
-    unsigned int seriesNumber =
-      meta->GetAttributeValue(DC::SeriesNumber).AsUnsignedInt();
-
-    const char *patientName = patientNameValue.GetCharData();
-    const char *patientID = patientIDValue.GetCharData();
-    const char *studyDate = studyDateValue.GetCharData();
-    const char *studyTime = studyTimeValue.GetCharData();
-    const char *studyUID = studyUIDValue.GetCharData();
-    const char *seriesUID = seriesUIDValue.GetCharData();
-
-    patientName = (patientName ? patientName : "");
-    patientID = (patientID ? patientID : "");
-
-    bool foundSeries = false;
-    for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
-      {
-      // Compare patient, then study, then series.
-      const char *patientName2 = li->PatientName.GetCharData();
-      patientName2 = (patientName2 ? patientName2 : "");
-      const char *patientID2 = li->PatientID.GetCharData();
-      patientID2 = (patientID2 ? patientID2 : "");
-      int c = strcmp(patientID2, patientID);
-      if (c != 0 || patientID[0] == '\0')
+      // Check if the file matches the query
+      bool queryMatched = (!this->Query || result->QueryMatched);
+      if (!queryMatched && this->FindLevel == vtkDICOMDirectory::IMAGE)
         {
-        // Use ID to identify patient, but use name to sort.
-        int c2 = strcmp(patientName2, patientName);
-        c = (c2 == 0 ? c : c2);
+        continue;
+        }
+
+      // Insert the file into the sorted list
+      FileInfo fileInfo;
+      fileInfo.InstanceNumber =
+        fileMeta->GetAttributeValue(DC::InstanceNumber).AsUnsignedInt();
+      fileInfo.FileName = fileName.c_str(); // stored in input StringArray
+
+      SeriesInfo key;
+      key.PatientName = fileMeta->GetAttributeValue(DC::PatientName);
+      key.PatientID = fileMeta->GetAttributeValue(DC::PatientID);
+      key.StudyDate = fileMeta->GetAttributeValue(DC::StudyDate);
+      key.StudyTime = fileMeta->GetAttributeValue(DC::StudyTime);
+      key.StudyUID = fileMeta->GetAttributeValue(DC::StudyInstanceUID);
+      key.SeriesUID = fileMeta->GetAttributeValue(DC::SeriesInstanceUID);
+      key.SeriesNumber =
+        fileMeta->GetAttributeValue(DC::SeriesNumber).AsUnsignedInt();
+
+      // Find the series that the file belongs to, or else walk the list
+      // to find the series or the position at which to insert a new one
+      bool foundSeries = false;
+      li = cache.Find(&sortedFiles, key);
+      if (li != sortedFiles.end())
+        {
+        foundSeries = true;
         }
-      if (c == 0)
+      else
         {
-        c = vtkDICOMUtilities::CompareUIDs(
-          studyUID, li->StudyUID.GetCharData());
-        if (c != 0 || studyUID == 0)
+        for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
           {
-          // Use UID to identify study, but use date to sort.
-          int c2 = 0;
-          const char *studyDate2 = li->StudyDate.GetCharData();
-          if (studyDate && studyDate2)
+          int c = CompareSeries(*li, key);
+          if (c == 0 && key.SeriesUID.GetCharData() != 0)
             {
-            c2 = strcmp(studyDate2, studyDate);
-            if (c2 == 0)
-              {
-              const char *studyTime2 = li->StudyTime.GetCharData();
-              if (studyTime2 && studyTime)
-                {
-                c2 = strcmp(studyTime, studyTime2);
-                }
-              }
+            foundSeries = true;
+            break;
             }
-          c = (c2 == 0 ? c : c2);
-          }
-        if (c == 0)
-          {
-          c = vtkDICOMUtilities::CompareUIDs(
-            seriesUID, li->SeriesUID.GetCharData());
-          if (c != 0 || seriesUID == 0)
+          else if (c >= 0)
             {
-            // Use UID to identify series, but use series number to sort.
-            int c2 = li->SeriesNumber - seriesNumber;
-            c = (c2 == 0 ? c : c2);
+            break;
             }
           }
         }
-      if (c == 0 && seriesUID != 0)
+
+      if (foundSeries)
         {
         li->Files.push_back(fileInfo);
         li->QueryMatched |= queryMatched;
-        foundSeries = true;
-        break;
+        // keep the meta data for the file that will be sorted first
+        if (this->RetainSeriesMetaData &&
+            fileInfo.InstanceNumber < li->MetaDataInstance)
+          {
+          li->MetaData = vtkSmartPointer<vtkDICOMMetaData>::New();
+          li->MetaData->CopyAttributes(fileMeta);
+          li->MetaDataInstance = fileInfo.InstanceNumber;
+          li->MetaDataCached = result->Cached;
+          }
         }
-      else if (c >= 0)
+      else
         {
-        break;
+        // copy the values out of the file's value pool before keeping them
+        li = sortedFiles.insert(li, SeriesInfo());
+        li->PatientName = key.PatientName.GetUnpooledCopy();
+        li->PatientID = key.PatientID.GetUnpooledCopy();
+        li->StudyDate = key.StudyDate.GetUnpooledCopy();
+        li->StudyUID = key.StudyUID.GetUnpooledCopy();
+        li->SeriesUID = key.SeriesUID.GetUnpooledCopy();
+        li->SeriesNumber = key.SeriesNumber;
+        li->Files.push_back(fileInfo);
+        li->QueryMatched = queryMatched;
+        this->FillPatientRecord(&li->PatientRecord, fileMeta);
+        this->FillStudyRecord(&li->StudyRecord, fileMeta);
+        this->FillSeriesRecord(&li->SeriesRecord, fileMeta);
+        li->MetaDataInstance = fileInfo.InstanceNumber;
+        li->MetaDataCached = result->Cached;
+        if (this->RetainSeriesMetaData)
+          {
+          li->MetaData = vtkSmartPointer<vtkDICOMMetaData>::New();
+          li->MetaData->CopyAttributes(fileMeta);
+          }
+        cache.Inserted(li);
         }
+      cache.Added(li, key);
       }
+    }
 
-    if (!foundSeries)
+  // Save the cache for the next scan
+  if (headerCache)
+    {
+    if (!headerCache->Write(this->CacheFileName))
       {
-      li = sortedFiles.insert(li, SeriesInfo());
-      li->PatientName = patientNameValue;
-      li->PatientID = patientIDValue;
-      li->StudyDate = studyDateValue;
-      li->StudyUID = studyUIDValue;
-      li->SeriesUID = seriesUIDValue;
-      li->SeriesNumber = seriesNumber;
-      li->Files.push_back(fileInfo);
-      li->QueryMatched = queryMatched;
-      this->FillPatientRecord(&li->PatientRecord, meta);
-      this->FillStudyRecord(&li->StudyRecord, meta);
-      this->FillSeriesRecord(&li->SeriesRecord, meta);
+      vtkWarningMacro("Unable to write cache file "
+                      << this->CacheFileName);
       }
+    delete headerCache;
     }
 
   // Sort each series by InstanceNumber
@@ -760,6 +1700,21 @@ void vtkDICOMDirectory::SortFiles(vtkStringArray *input)
     this->AddSeriesFileNames(
       patientCount-1, studyCount-1, sa,
       v.PatientRecord, v.StudyRecord, v.SeriesRecord);
+
+    // The cache only holds the attributes needed for sorting, so if
+    // the first file came from the cache, its header must be read.
+    if (v.MetaData && v.MetaDataCached)
+      {
+      vtkSmartPointer<vtkDICOMParser> parser =
+        vtkSmartPointer<vtkDICOMParser>::New();
+      v.MetaData = vtkSmartPointer<vtkDICOMMetaData>::New();
+      parser->SetMetaData(v.MetaData);
+      parser->SetQuery(query);
+      parser->SetDeferredValueThreshold(this->DeferredValueThreshold);
+      parser->SetFileName(v.Files[0].FileName);
+      parser->Update();
+      }
+    this->Series->back().MetaData = v.MetaData;
     }
 }
 
@@ -137,6 +137,17 @@ public:
   //! Get the file names for a specific series.
   vtkStringArray *GetFileNamesForSeries(int i);
 
+  //! Get the meta data for the first file of a specific series.
+  /*!
+   *  This will be NULL unless RetainSeriesMetaData was On when Update()
+   *  was called.  The meta data is for the first file in the list that
+   *  is returned by GetFileNamesForSeries(), and it contains all of the
+   *  attributes in the header of that file, so the attributes can be
+   *  used without parsing the file again.  It is also NULL for series
+   *  that were found by reading a DICOMDIR file.
+   */
+  vtkDICOMMetaData *GetMetaDataForSeries(int i);
+
   //! Get the file set ID.  This will be NULL unless a DICOMDIR was found.
   const char *GetFileSetID() { return this->FileSetID; }
 
@@ -157,6 +168,59 @@ public:
   vtkBooleanMacro(FollowSymlinks, int);
   int GetFollowSymlinks() { return this->FollowSymlinks; }
 
+  //! If On, keep the meta data that was read for each series.
+  /*!
+   *  This is Off by default.  If it is On, then the meta data for the
+   *  first file of each series is kept after the files are sorted, and
+   *  can be retrieved with GetMetaDataForSeries().  This is useful for
+   *  programs that need more attributes than are provided by the series,
+   *  study, and patient records, since it saves them from having to
+   *  parse each series again.
+   */
+  vtkSetMacro(RetainSeriesMetaData, int);
+  vtkBooleanMacro(RetainSeriesMetaData, int);
+  int GetRetainSeriesMetaData() { return this->RetainSeriesMetaData; }
+
+  //! Set the number of threads to use when reading the files.
+  /*!
+   *  The default is 1.  If more than one thread is used, the files are
+   *  parsed concurrently, each thread with its own parser, and the
+   *  results are then sorted in the order that the files were given.
+   *  The patient, study, and series ordering is the same regardless of
+   *  the number of threads.  Subclasses that override FillSeriesRecord(),
+   *  FillStudyRecord(), or FillPatientRecord() do not need to be thread
+   *  safe, since those methods are always called from the main thread.
+   */
+  vtkSetClampMacro(NumberOfThreads, int, 1, VTK_INT_MAX);
+  int GetNumberOfThreads() { return this->NumberOfThreads; }
+
+  //! Defer the reading of large values in the meta data (default: 0).
+  /*!
+   *  If this is set to a nonzero number of bytes, then any OB, OW, OF,
+   *  OD, or UN value larger than this is not read while the files are
+   *  scanned, and is instead read from the file when it is first used.
+   *  This is only useful if RetainSeriesMetaData is On, or if the query
+   *  does not need these values.  See
+   *  vtkDICOMParser::SetDeferredValueThreshold() for details.
+   */
+  vtkSetMacro(DeferredValueThreshold, unsigned int);
+  unsigned int GetDeferredValueThreshold() {
+    return this->DeferredValueThreshold; }
+
+  //! Set a file for caching the file information between scans.
+  /*!
+   *  If a cache file is set, then the attributes that are needed for
+   *  sorting the files are saved to this file after every scan, along
+   *  with the size and modification time of each file.  On subsequent
+   *  scans, only the files that are new or that have changed since the
+   *  previous scan will be parsed.  The cache is not used if the query
+   *  has changed since the previous scan.  Note that only the attributes
+   *  used by the default FillSeriesRecord(), FillStudyRecord(), and
+   *  FillPatientRecord() methods are stored in the cache.
+   */
+  void SetCacheFileName(const char *name);
+  const char *GetCacheFileName() { return this->CacheFileName; }
+
 protected:
   vtkDICOMDirectory();
   ~vtkDICOMDirectory();
@@ -164,9 +228,13 @@ protected:
   const char *DirectoryName;
   vtkStringArray *InputFileNames;
   const char *FilePattern;
+  const char *CacheFileName;
   int RequirePixelData;
   int FollowSymlinks;
+  int RetainSeriesMetaData;
   int ScanDepth;
+  int NumberOfThreads;
+  unsigned int DeferredValueThreshold;
 
   vtkTimeStamp UpdateTime;
   char *InternalFileName;
@@ -234,6 +302,9 @@ private:
   struct FileInfo;
   struct SeriesInfo;
   class SeriesInfoList;
+  class SeriesInfoCache;
+  class HeaderCache;
+  class FileScan;
   class VisitedVector;
 
   vtkDICOMItem *Query;
@@ -246,6 +317,13 @@ private:
 
   //! Compare FileInfo entries by instance number
   static bool CompareInstance(const FileInfo &fi1, const FileInfo &fi2);
+
+  //! Compare the series for a file with a series in the sorted list.
+  /*!
+   *  A return value of zero means that the file belongs to the series,
+   *  a positive value means that it should be inserted before it.
+   */
+  static int CompareSeries(const SeriesInfo &si, const SeriesInfo &fi);
 };
 
 #endif
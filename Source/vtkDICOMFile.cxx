@@ -13,16 +13,21 @@
 =========================================================================*/
 
 #include "vtkDICOMFile.h"
+#include "vtkDICOMReferenceCount.h"
 
 #if defined(VTK_DICOM_POSIX_IO)
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdio.h>
 #include <errno.h>
 #elif defined(VTK_DICOM_WIN32_IO)
 #include <windows.h>
 #else
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifdef _WIN32
 #include <io.h>
 #include <direct.h>
@@ -34,13 +39,27 @@
 #include <errno.h>
 #endif
 
+namespace {
+
+// Counters for the number of files opened and the number of reads,
+// these are incremented atomically since files are read by many threads
+vtkDICOMReferenceCount vtkDICOMFileNumberOfOpens;
+vtkDICOMReferenceCount vtkDICOMFileNumberOfReads;
+
+} // end anonymous namespace
+
 //----------------------------------------------------------------------------
 vtkDICOMFile::vtkDICOMFile(const char *filename, Mode mode)
 {
+  ++vtkDICOMFileNumberOfOpens;
+
 #if defined(VTK_DICOM_POSIX_IO)
   this->Handle = -1;
   this->Error = 0;
   this->Eof = false;
+  this->MapHandle = 0;
+  this->MapAddress = 0;
+  this->MapSize = 0;
 
   if (mode == In)
     {
@@ -84,6 +103,9 @@ vtkDICOMFile::vtkDICOMFile(const char *filename, Mode mode)
   this->Handle = INVALID_HANDLE_VALUE;
   this->Error = 0;
   this->Eof = false;
+  this->MapHandle = 0;
+  this->MapAddress = 0;
+  this->MapSize = 0;
 
   WCHAR *wideFilename = 0;
   int n = MultiByteToWideChar(
@@ -147,6 +169,9 @@ vtkDICOMFile::vtkDICOMFile(const char *filename, Mode mode)
   this->Handle = 0;
   this->Error = 0;
   this->Eof = false;
+  this->MapHandle = 0;
+  this->MapAddress = 0;
+  this->MapSize = 0;
 
   if (mode == In)
     {
@@ -173,6 +198,12 @@ vtkDICOMFile::~vtkDICOMFile()
 void vtkDICOMFile::Close()
 {
 #if defined(VTK_DICOM_POSIX_IO)
+  if (this->MapAddress)
+    {
+    munmap(this->MapAddress, static_cast<size_t>(this->MapSize));
+    this->MapAddress = 0;
+    this->MapSize = 0;
+    }
   if (this->Handle)
     {
     if (close(this->Handle) == 0)
@@ -186,6 +217,17 @@ void vtkDICOMFile::Close()
     this->Handle = 0;
     }
 #elif defined(VTK_DICOM_WIN32_IO)
+  if (this->MapAddress)
+    {
+    UnmapViewOfFile(this->MapAddress);
+    this->MapAddress = 0;
+    this->MapSize = 0;
+    }
+  if (this->MapHandle)
+    {
+    CloseHandle(this->MapHandle);
+    this->MapHandle = 0;
+    }
   CloseHandle(this->Handle);
   this->Handle = INVALID_HANDLE_VALUE;
 #else
@@ -200,6 +242,8 @@ void vtkDICOMFile::Close()
 //----------------------------------------------------------------------------
 size_t vtkDICOMFile::Read(unsigned char *data, size_t len)
 {
+  ++vtkDICOMFileNumberOfReads;
+
 #if defined(VTK_DICOM_POSIX_IO)
   ssize_t n;
   while ((n = read(this->Handle, data, len)) == -1)
@@ -378,6 +422,72 @@ vtkDICOMFile::Size vtkDICOMFile::GetSize()
 #endif
 }
 
+//----------------------------------------------------------------------------
+const unsigned char *vtkDICOMFile::Map()
+{
+  if (this->MapAddress)
+    {
+    return static_cast<const unsigned char *>(this->MapAddress);
+    }
+
+#if defined(VTK_DICOM_POSIX_IO) || defined(VTK_DICOM_WIN32_IO)
+  // save the error state, a failed map should not cause an error
+  int error = this->Error;
+  Size size = this->GetSize();
+  this->Error = error;
+
+  // empty files cannot be mapped, and neither can huge files
+  // on systems with a 32-bit address space
+  if (size == 0 || size == static_cast<Size>(-1) ||
+      size != static_cast<size_t>(size))
+    {
+    return 0;
+    }
+
+#if defined(VTK_DICOM_POSIX_IO)
+  void *address = mmap(0, static_cast<size_t>(size), PROT_READ, MAP_SHARED,
+                       this->Handle, 0);
+  if (address == MAP_FAILED)
+    {
+    return 0;
+    }
+#else
+  HANDLE mapHandle = CreateFileMappingW(
+    this->Handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapHandle == NULL)
+    {
+    return 0;
+    }
+  void *address = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+  if (address == NULL)
+    {
+    CloseHandle(mapHandle);
+    return 0;
+    }
+  this->MapHandle = mapHandle;
+#endif
+
+  this->MapAddress = address;
+  this->MapSize = size;
+  return static_cast<const unsigned char *>(address);
+#else
+  // memory mapping requires native file handles
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkDICOMFile::GetNumberOfOpens()
+{
+  return vtkDICOMFileNumberOfOpens.GetValue();
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkDICOMFile::GetNumberOfReads()
+{
+  return vtkDICOMFileNumberOfReads.GetValue();
+}
+
 //----------------------------------------------------------------------------
 int vtkDICOMFile::Remove(const char *filename)
 {
@@ -440,3 +550,166 @@ int vtkDICOMFile::Remove(const char *filename)
   return errorCode;
 #endif
 }
+
+//----------------------------------------------------------------------------
+int vtkDICOMFile::Rename(const char *oldname, const char *newname)
+{
+#if defined(VTK_DICOM_WIN32_IO)
+  int errorCode = 0;
+  WCHAR *wideOldname = 0;
+  WCHAR *wideNewname = 0;
+  int n = MultiByteToWideChar(
+    CP_UTF8, MB_ERR_INVALID_CHARS, oldname, -1, NULL, 0);
+  int m = MultiByteToWideChar(
+    CP_UTF8, MB_ERR_INVALID_CHARS, newname, -1, NULL, 0);
+  if (n > 0 && m > 0)
+    {
+    wideOldname = new WCHAR[n];
+    n = MultiByteToWideChar(
+      CP_UTF8, MB_ERR_INVALID_CHARS, oldname, -1, wideOldname, n);
+    wideNewname = new WCHAR[m];
+    m = MultiByteToWideChar(
+      CP_UTF8, MB_ERR_INVALID_CHARS, newname, -1, wideNewname, m);
+    if (!MoveFileExW(wideOldname, wideNewname,
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+      {
+      DWORD lastError = GetLastError();
+      if (lastError == ERROR_ACCESS_DENIED ||
+          lastError == ERROR_SHARING_VIOLATION)
+        {
+        errorCode = AccessDenied;
+        }
+      else if (lastError == ERROR_FILE_NOT_FOUND)
+        {
+        errorCode = FileNotFound;
+        }
+      else if (lastError == ERROR_PATH_NOT_FOUND)
+        {
+        errorCode = DirectoryNotFound;
+        }
+      else
+        {
+        errorCode = Bad;
+        }
+      }
+    delete [] wideOldname;
+    delete [] wideNewname;
+    }
+  else
+    {
+    errorCode = Bad;
+    }
+  return errorCode;
+#else
+  int errorCode = 0;
+  if (rename(oldname, newname) != 0)
+    {
+    int e = errno;
+    if (e == EACCES || e == EPERM)
+      {
+      errorCode = AccessDenied;
+      }
+    else if (e == ENOENT)
+      {
+      errorCode = FileNotFound;
+      }
+    else if (e == ENOTDIR)
+      {
+      errorCode = DirectoryNotFound;
+      }
+    else
+      {
+      errorCode = Bad;
+      }
+    }
+  return errorCode;
+#endif
+}
+
+//----------------------------------------------------------------------------
+int vtkDICOMFile::Stat(const char *filename, Size *size, long long *mtime)
+{
+#if defined(VTK_DICOM_WIN32_IO)
+  int errorCode = 0;
+  WCHAR *wideFilename = 0;
+  int n = MultiByteToWideChar(
+    CP_UTF8, MB_ERR_INVALID_CHARS, filename, -1, NULL, 0);
+  if (n > 0)
+    {
+    wideFilename = new WCHAR[n];
+    n = MultiByteToWideChar(
+      CP_UTF8, MB_ERR_INVALID_CHARS, filename, -1, wideFilename, n);
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (GetFileAttributesExW(wideFilename, GetFileExInfoStandard, &attr))
+      {
+      *size = attr.nFileSizeLow |
+        (static_cast<Size>(attr.nFileSizeHigh) << 32);
+      *mtime = static_cast<long long>(attr.ftLastWriteTime.dwLowDateTime |
+        (static_cast<Size>(attr.ftLastWriteTime.dwHighDateTime) << 32));
+      }
+    else
+      {
+      DWORD lastError = GetLastError();
+      if (lastError == ERROR_ACCESS_DENIED)
+        {
+        errorCode = AccessDenied;
+        }
+      else if (lastError == ERROR_FILE_NOT_FOUND)
+        {
+        errorCode = FileNotFound;
+        }
+      else if (lastError == ERROR_PATH_NOT_FOUND)
+        {
+        errorCode = DirectoryNotFound;
+        }
+      else
+        {
+        errorCode = Bad;
+        }
+      }
+    delete [] wideFilename;
+    }
+  else
+    {
+    errorCode = Bad;
+    }
+  return errorCode;
+#else
+  int errorCode = 0;
+  struct stat fs;
+  if (stat(filename, &fs) == 0)
+    {
+    *size = fs.st_size;
+    long long t = fs.st_mtime;
+    long long nsec = 0;
+#if defined(__APPLE__)
+    nsec = fs.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+    // st_mtime is a macro if the nanoseconds are available in st_mtim
+    nsec = fs.st_mtim.tv_nsec;
+#endif
+    *mtime = t*1000000000 + nsec;
+    }
+  else
+    {
+    int e = errno;
+    if (e == EACCES)
+      {
+      errorCode = AccessDenied;
+      }
+    else if (e == ENOENT)
+      {
+      errorCode = FileNotFound;
+      }
+    else if (e == ENOTDIR)
+      {
+      errorCode = DirectoryNotFound;
+      }
+    else
+      {
+      errorCode = Bad;
+      }
+    }
+  return errorCode;
+#endif
+}
@@ -89,6 +89,21 @@ public:
   //! Check the size of the file, returns ULLONG_MAX on error.
   Size GetSize();
 
+  //! Map the whole file into memory for reading.
+  /*!
+   *  A pointer to the first byte of the file is returned, or NULL if
+   *  the file cannot be mapped (for example, if the file is empty, if
+   *  it is too large for the address space, or if memory mapping is not
+   *  supported on this platform).  If NULL is returned, then Read() can
+   *  still be used.  The mapping remains valid until the file is closed.
+   *  The file position is not used or changed by this method, and the
+   *  file must not be truncated by another process while it is mapped.
+   */
+  const unsigned char *Map();
+
+  //! Get the size of the memory map, or zero if the file is not mapped.
+  Size GetMapSize() { return this->MapSize; }
+
   //! Check for the end-of-file indicator.
   bool EndOfFile() { return this->Eof; }
 
@@ -103,6 +118,40 @@ public:
    */
   static int Remove(const char *filename);
 
+  //! Rename a file, replacing any existing file (static method).
+  /*!
+   *  The new name must be on the same file system as the old name, and
+   *  if a file with the new name exists, it is replaced atomically.
+   *  The return value is zero if successful, otherwise an error code
+   *  is returned.
+   */
+  static int Rename(const char *oldname, const char *newname);
+
+  //! Get the size and modification time of a file (static method).
+  /*!
+   *  The modification time is meant only for checking whether a file
+   *  has changed.  It has as much precision as the file system provides:
+   *  nanoseconds since the epoch on most POSIX systems, or the FILETIME
+   *  (100 nanosecond intervals since 1601) on Windows.  The return value
+   *  is zero if successful, otherwise an error code is returned.
+   */
+  static int Stat(const char *filename, Size *size, long long *mtime);
+
+  //! Get the number of times that a file has been opened (static method).
+  /*!
+   *  This counts the files that have been opened (or that failed to
+   *  open) by all vtkDICOMFile objects since the program started.
+   *  It is meant for diagnostics, for example to check how many times
+   *  the files are opened while a directory is scanned.
+   */
+  static unsigned long GetNumberOfOpens();
+
+  //! Get the number of times that Read() has been called (static method).
+  /*!
+   *  Like GetNumberOfOpens(), this is meant for diagnostics.
+   */
+  static unsigned long GetNumberOfReads();
+
 private:
 #ifdef VTK_DICOM_POSIX_IO
   int Handle;
@@ -111,6 +160,9 @@ private:
 #endif
   int Error;
   bool Eof;
+  void *MapHandle;
+  void *MapAddress;
+  Size MapSize;
 };
 
 #endif /* vtkDICOMFile_h */
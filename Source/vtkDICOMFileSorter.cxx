@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <map>
 #include <algorithm>
 #include <vtksys/SystemTools.hxx>
 #include <vtksys/Glob.hxx>
@@ -68,6 +69,31 @@ class vtkDICOMFileSorter::FileInfoVectorList
 {
 };
 
+//----------------------------------------------------------------------------
+// Maps for grouping the files by study and series, so that each file can
+// be placed without comparing its UIDs to those of every series.
+
+struct vtkDICOMFileSorter::UIDLess
+{
+  bool operator()(const vtkDICOMValue& u1, const vtkDICOMValue& u2) const {
+    return (vtkDICOMUtilities::CompareUIDs(
+              u1.GetCharData(), u2.GetCharData()) < 0); }
+};
+
+struct vtkDICOMFileSorter::StudyInfo
+{
+  // the series in the order that they were found
+  std::vector<FileInfoVectorList::iterator> Series;
+  // the series that have a SeriesInstanceUID, indexed by UID
+  std::map<vtkDICOMValue, FileInfoVectorList::iterator, UIDLess> SeriesMap;
+};
+
+class vtkDICOMFileSorter::StudyInfoMap
+  : public std::map<vtkDICOMValue, vtkDICOMFileSorter::StudyInfo,
+                    vtkDICOMFileSorter::UIDLess>
+{
+};
+
 //----------------------------------------------------------------------------
 vtkDICOMFileSorter::vtkDICOMFileSorter()
 {
@@ -230,8 +256,9 @@ void vtkDICOMFileSorter::SortFiles(vtkStringArray *input)
   parser->SetMetaData(meta);
   parser->SetGroups(groups);
 
-  FileInfoVectorList sortedFiles;
+  FileInfoVectorList seriesFiles;
   FileInfoVectorList::iterator li;
+  StudyInfoMap studies;
 
   vtkIdType numberOfStrings = input->GetNumberOfValues();
   for (vtkIdType j = 0; j < numberOfStrings; j++)
@@ -270,66 +297,67 @@ void vtkDICOMFileSorter::SortFiles(vtkStringArray *input)
     fileInfo.InstanceNumber =
       meta->GetAttributeValue(DC::InstanceNumber).AsUnsignedInt();
 
-    const char *studyUID = fileInfo.StudyUID.GetCharData();
-    const char *seriesUID = fileInfo.SeriesUID.GetCharData();
-
-    bool foundSeries = false;
-    for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
+    // Find the series, or add a new series to the study.  Files with
+    // no SeriesInstanceUID are each placed in a series of their own.
+    StudyInfo& study = studies[fileInfo.StudyUID];
+    li = seriesFiles.end();
+    if (fileInfo.SeriesUID.GetCharData() != 0)
       {
-      // compare studyId first, then seriesId
-      int c1 = vtkDICOMUtilities::CompareUIDs(
-        studyUID, (*li)[0].StudyUID.GetCharData());
-      int c2 = 0;
-      if (c1 == 0)
-        {
-        c2 = vtkDICOMUtilities::CompareUIDs(
-          seriesUID, (*li)[0].SeriesUID.GetCharData());
-        }
-      if (c1 == 0 && c2 == 0 && seriesUID != 0)
+      std::map<vtkDICOMValue, FileInfoVectorList::iterator, UIDLess>::iterator
+        si = study.SeriesMap.find(fileInfo.SeriesUID);
+      if (si != study.SeriesMap.end())
         {
-        (*li).push_back(fileInfo);
-        foundSeries = true;
-        break;
-        }
-      else if (c1 >= 0 || (c1 == 0 && c2 >= 0))
-        {
-        break;
+        li = si->second;
         }
       }
 
-    if (!foundSeries)
+    if (li == seriesFiles.end())
       {
-      std::vector<FileInfo> newSeries;
-      newSeries.push_back(fileInfo);
-      sortedFiles.insert(li, newSeries);
+      li = seriesFiles.insert(seriesFiles.end(), std::vector<FileInfo>());
+      study.Series.push_back(li);
+      if (fileInfo.SeriesUID.GetCharData() != 0)
+        {
+        study.SeriesMap[fileInfo.SeriesUID] = li;
+        }
       }
+
+    li->push_back(fileInfo);
     }
 
-  // Sort each series by InstanceNumber
+  // The studies are output in descending order of StudyInstanceUID,
+  // and within each study, the series that was found last comes first.
   int studyCount = 0;
 
   vtkDICOMValue lastStudyUID;
-  for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
+  StudyInfoMap::reverse_iterator sti;
+  for (sti = studies.rbegin(); sti != studies.rend(); ++sti)
     {
-    std::vector<FileInfo> &v = *li;
-    std::stable_sort(v.begin(), v.end(), CompareInstance);
-
-    // Is this a new study?
-    if (studyCount == 0 || v[0].StudyUID != lastStudyUID)
+    std::vector<FileInfoVectorList::iterator>::reverse_iterator si;
+    for (si = sti->second.Series.rbegin();
+         si != sti->second.Series.rend();
+         ++si)
       {
-      lastStudyUID = v[0].StudyUID;
-      studyCount++;
-      }
+      // Sort each series by InstanceNumber
+      std::vector<FileInfo> &v = **si;
+      std::stable_sort(v.begin(), v.end(), CompareInstance);
 
-    vtkSmartPointer<vtkStringArray> sa =
-      vtkSmartPointer<vtkStringArray>::New();
-    vtkIdType n = static_cast<vtkIdType>(v.size());
-    sa->SetNumberOfValues(n);
-    for (vtkIdType i = 0; i < n; i++)
-      {
-      sa->SetValue(i, v[i].FileName);
+      // Is this a new study?
+      if (studyCount == 0 || v[0].StudyUID != lastStudyUID)
+        {
+        lastStudyUID = v[0].StudyUID;
+        studyCount++;
+        }
+
+      vtkSmartPointer<vtkStringArray> sa =
+        vtkSmartPointer<vtkStringArray>::New();
+      vtkIdType n = static_cast<vtkIdType>(v.size());
+      sa->SetNumberOfValues(n);
+      for (vtkIdType i = 0; i < n; i++)
+        {
+        sa->SetValue(i, v[i].FileName);
+        }
+      this->AddSeriesFileNames(studyCount - 1, sa);
       }
-    this->AddSeriesFileNames(studyCount - 1, sa);
     }
 }
 
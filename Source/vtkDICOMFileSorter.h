@@ -139,6 +139,9 @@ private:
   class StringArrayVector;
   struct FileInfo;
   class FileInfoVectorList;
+  struct StudyInfo;
+  class StudyInfoMap;
+  struct UIDLess;
 
   StringArrayVector *Series;
   vtkIntArray *Studies;
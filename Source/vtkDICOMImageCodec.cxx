@@ -15,6 +15,11 @@
 #include "vtkDICOMMetaData.h"
 #include "vtkDICOMUtilities.h"
 
+#include "vtkMultiThreader.h"
+
+#include <vector>
+
+#include <string.h>
 #include <stddef.h>
 
 //----------------------------------------------------------------------------
@@ -86,6 +91,77 @@ std::string vtkDICOMImageCodec::GetTransferSyntaxUID() const
   return result;
 }
 
+//----------------------------------------------------------------------------
+namespace {
+
+// Unpack one PackBits segment into the output, where "size" is the number
+// of bytes in the segment and "inc" is the spacing of the output bytes.
+// The return value is the number of bytes written, which will be less
+// than the size if the segment ended early.  Using a constant "inc"
+// allows the compiler to unroll the loops.
+template<int N>
+size_t UnpackBitsSegment(
+  const unsigned char *cp, const unsigned char *ep,
+  unsigned char *dp, size_t size, unsigned int inc)
+{
+  inc = (N == 0 ? inc : N);
+  size_t remaining = size;
+
+  // the indicator byte must be followed by at least one byte
+  while (remaining != 0 && ep - cp > 1)
+    {
+    int c = static_cast<signed char>(*cp++);
+    if (c >= 0)
+      {
+      // do a literal run, limited by the input and the output
+      size_t n = static_cast<size_t>(c) + 1;
+      size_t avail = ep - cp;
+      n = (n < avail ? n : avail);
+      const unsigned char *sp = cp;
+      cp += n;
+      n = (n < remaining ? n : remaining);
+      remaining -= n;
+      if (N == 1)
+        {
+        memcpy(dp, sp, n);
+        dp += n;
+        }
+      else
+        {
+        do { *dp = *sp++; dp += inc; } while (--n);
+        }
+      }
+    else if (c > -128)
+      {
+      // do a replication run, limited by the output
+      size_t n = static_cast<size_t>(1 - c);
+      n = (n < remaining ? n : remaining);
+      remaining -= n;
+      unsigned char v = *cp++;
+      if (N == 1)
+        {
+        memset(dp, v, n);
+        dp += n;
+        }
+      else
+        {
+        do { *dp = v; dp += inc; } while (--n);
+        }
+      }
+    }
+
+  // clear the remainder of the output
+  for (size_t k = 0; k < remaining; k++)
+    {
+    *dp = 0;
+    dp += inc;
+    }
+
+  return size - remaining;
+}
+
+} // end anonymous namespace
+
 //----------------------------------------------------------------------------
 int vtkDICOMImageCodec::DecodeRLE(
   const ImageFormat& image,
@@ -96,8 +172,18 @@ int vtkDICOMImageCodec::DecodeRLE(
   unsigned char *outPtr = dest;
   int errorCode = NoError;
 
+  // the header holds the number of segments and 15 segment offsets
+  if (sourceSize < 64)
+    {
+    return MissingData;
+    }
+
   // get the number of segments and the segment size
   unsigned int n = vtkDICOMUtilities::UnpackUnsignedInt(inPtr);
+  if (n == 0 || n > 15)
+    {
+    return BadPixelFormat;
+    }
   size_t segmentSize = destSize/n;
 
   // get the samples per pixel (spp) and bytes per sample (bps)
@@ -133,90 +219,362 @@ int vtkDICOMImageCodec::DecodeRLE(
     // get the offset into the input buffer for this segment
     unsigned int offset =
       vtkDICOMUtilities::UnpackUnsignedInt(inPtr + (i+1)*4);
-    if (offset >= sourceSize)
+    // decompress the segment, use a constant increment if possible,
+    // and if the offset is past the end, the output will be cleared
+    const unsigned char *ep = inPtr + sourceSize;
+    const unsigned char *cp = (offset < sourceSize ? inPtr + offset : ep);
+    unsigned char *dp = outPtr + outOffset;
+    size_t m = 0;
+    switch (outInc)
+      {
+      case 1:
+        m = UnpackBitsSegment<1>(cp, ep, dp, segmentSize, outInc);
+        break;
+      case 2:
+        m = UnpackBitsSegment<2>(cp, ep, dp, segmentSize, outInc);
+        break;
+      case 3:
+        m = UnpackBitsSegment<3>(cp, ep, dp, segmentSize, outInc);
+        break;
+      case 4:
+        m = UnpackBitsSegment<4>(cp, ep, dp, segmentSize, outInc);
+        break;
+      default:
+        m = UnpackBitsSegment<0>(cp, ep, dp, segmentSize, outInc);
+        break;
+      }
+    if (m < segmentSize)
+      {
+      // short read, the remainder of dest was cleared
+      errorCode = MissingData;
+      }
+    }
+
+  return errorCode;
+}
+
+//----------------------------------------------------------------------------
+namespace {
+
+// Count how many times the first byte repeats, up to maxcount.  The
+// bytes are compared eight at a time against the replicated value.
+size_t PackBitsRepeatCount(const unsigned char *sp, size_t maxcount)
+{
+  unsigned char v = sp[0];
+  vtkTypeUInt64 pattern = v;
+  pattern |= (pattern << 8);
+  pattern |= (pattern << 16);
+  pattern |= (pattern << 32);
+
+  size_t k = 1;
+  while (k + 8 <= maxcount)
+    {
+    vtkTypeUInt64 w;
+    memcpy(&w, sp + k, 8);
+    if (w != pattern)
       {
       break;
       }
-    // loop over the segment and decompress it
-    const signed char *cp =
-      reinterpret_cast<const signed char *>(inPtr + offset);
-    signed char *dp = reinterpret_cast<signed char *>(outPtr + outOffset);
-    size_t remaining = segmentSize;
-    while (remaining > 0 && offset < sourceSize)
+    k += 8;
+    }
+  while (k < maxcount && sp[k] == v)
+    {
+    k++;
+    }
+
+  return k;
+}
+
+// Find the first position q >= 2 where sp[q-2], sp[q-1], sp[q] are all
+// the same, or return maxcount if there are none.  Eight positions are
+// checked at a time, by looking for a zero byte in the differences.
+size_t PackBitsLiteralCount(const unsigned char *sp, size_t maxcount)
+{
+  vtkTypeUInt64 ones = 0x01010101u;
+  ones |= (ones << 32);
+  vtkTypeUInt64 highs = (ones << 7);
+
+  size_t q = 2;
+  while (q + 8 <= maxcount)
+    {
+    vtkTypeUInt64 a, b, c;
+    memcpy(&a, sp + q, 8);
+    memcpy(&b, sp + q - 1, 8);
+    memcpy(&c, sp + q - 2, 8);
+    vtkTypeUInt64 x = ((a ^ b) | (b ^ c));
+    if (((x - ones) & ~x & highs) != 0)
       {
-      if (++offset == sourceSize)
-        {
-        break;
-        }
-      // check the indicator byte (use short to avoid overflow)
-      short c = *cp++;
-      if (c >= 0)
+      break;
+      }
+    q += 8;
+    }
+  while (q < maxcount && (sp[q] != sp[q-1] || sp[q-1] != sp[q-2]))
+    {
+    q++;
+    }
+
+  return q;
+}
+
+// Pack one row of a byte plane, where the row is contiguous in memory.
+// The destination must have room for 2*rowlen bytes.  The runs are
+// identical to those produced by the original strided encoder: literal
+// runs stop at a triplicate, and repeats at the end of a literal run
+// are moved into the following run.  Returns the number of bytes written.
+size_t PackBitsRow(
+  const unsigned char *cp, size_t rowlen, unsigned char *dp)
+{
+  unsigned char *dstart = dp;
+  size_t p = 0;
+
+  while (p != rowlen)
+    {
+    size_t remainder = rowlen - p;
+    size_t maxcount = (remainder < 128 ? remainder : 128);
+    const unsigned char *sp = cp + p;
+
+    size_t k = PackBitsRepeatCount(sp, maxcount);
+    if (k > 1)
+      {
+      // negative count for repeating
+      *dp++ = static_cast<unsigned char>(1 - static_cast<int>(k));
+      *dp++ = sp[0];
+      p += k;
+      }
+    else if (maxcount > 1)
+      {
+      // count non-repeated bytes until a triplicate found
+      size_t q = PackBitsLiteralCount(sp, maxcount);
+      size_t count = q;
+
+      // remove repeats at the end that can join with next run
+      unsigned char prev = sp[q-1];
+      if (remainder > q && sp[q] == prev)
         {
-        // do a literal run
-        c = c + 1;
-        if (sourceSize - offset < static_cast<size_t>(c))
-          {
-          // safety check: limit to the number available input bytes
-          c = static_cast<short>(sourceSize - offset);
-          }
-        offset += c;
-        if (static_cast<size_t>(c) > remaining)
-          {
-          // safety check: limit to the size of the output dest
-          c = remaining;
-          }
-        remaining -= c;
-        do
-          {
-          *dp = *cp++;
-          dp += outInc;
-          }
-        while (--c);
+        size_t reps = 1 + (prev == sp[q-2]);
+        reps = (reps < count - 1 ? reps : count - 1);
+        count -= reps;
         }
-      else if (c > -128)
+
+      // positive count for literal
+      *dp++ = static_cast<unsigned char>(count - 1);
+      memcpy(dp, sp, count);
+      dp += count;
+      p += count;
+      }
+    else
+      {
+      // a single byte at the end of the row
+      *dp++ = 0;
+      *dp++ = sp[0];
+      p += 1;
+      }
+    }
+
+  return dp - dstart;
+}
+
+// Encode one RLE segment (one byte plane of a frame).  The input bytes
+// are "inc" bytes apart, and each row is gathered into a contiguous
+// buffer before it is packed.  The result is padded to an even length,
+// and must be freed with "delete []".
+void PackBitsSegment(
+  const unsigned char *cp, unsigned int inc, size_t rowlen, size_t numrows,
+  unsigned char **destP, size_t *destSizeP)
+{
+  size_t reserve = numrows*rowlen/4 + 2*rowlen + 2;
+  unsigned char *dest = new unsigned char[reserve];
+  unsigned char *row = (inc == 1 ? 0 : new unsigned char[rowlen]);
+  size_t size = 0;
+
+  for (size_t j = 0; j < numrows; j++)
+    {
+    const unsigned char *rp = cp;
+    if (row)
+      {
+      for (size_t k = 0; k < rowlen; k++)
         {
-        // do a replication run
-        c = 1 - c;
-        offset += 1;
-        if (static_cast<size_t>(c) > remaining)
-          {
-          // safety check: limit to the size of the output dest
-          c = remaining;
-          }
-        remaining -= c;
-        do
-          {
-          *dp = *cp;
-          dp += outInc;
-          }
-        while (--c);
-        cp++;
+        row[k] = *cp;
+        cp += inc;
         }
+      rp = row;
       }
-    if (remaining > 0)
+    else
+      {
+      cp += rowlen;
+      }
+
+    // make sure there is room for the worst case, plus a pad byte
+    if (size + 2*rowlen + 1 > reserve)
       {
-      // short read, clear remainder of dest
-      errorCode = MissingData;
       do
         {
-        *dp = 0;
-        dp += outInc;
+        reserve *= 2;
         }
-      while (--remaining);
+      while (size + 2*rowlen + 1 > reserve);
+      unsigned char *newdest = new unsigned char[reserve];
+      memcpy(newdest, dest, size);
+      delete [] dest;
+      dest = newdest;
       }
+
+    size += PackBitsRow(rp, rowlen, dest + size);
     }
 
-  return errorCode;
+  // add a pad byte to the segment if needed
+  if ((size & 1) != 0)
+    {
+    dest[size++] = 0;
+    }
+
+  delete [] row;
+  *destP = dest;
+  *destSizeP = size;
+}
+
+// A helper class for encoding the segments of several frames at once.
+class RLEEncodeFrames
+{
+public:
+  RLEEncodeFrames(const unsigned char *source, size_t frameSize,
+                  unsigned int numFrames, unsigned int numSegments)
+    : Source(source), FrameSize(frameSize), NumberOfFrames(numFrames),
+      NumberOfSegments(numSegments), Increment(1), RowLength(0),
+      NumberOfRows(0), Segments(numFrames*numSegments, 0),
+      SegmentSizes(numFrames*numSegments, 0) {}
+
+  ~RLEEncodeFrames() {
+    for (size_t i = 0; i < this->Segments.size(); i++) {
+      delete [] this->Segments[i]; } }
+
+  // Set the input layout of the byte planes.
+  void SetLayout(const size_t offsets[15], unsigned int inc,
+                 size_t rowlen, size_t numrows) {
+    for (unsigned int i = 0; i < this->NumberOfSegments; i++) {
+      this->Offsets[i] = offsets[i]; }
+    this->Increment = inc;
+    this->RowLength = rowlen;
+    this->NumberOfRows = numrows; }
+
+  // Encode all of the segments with the given number of threads.
+  void Execute(int numThreads);
+
+  // Assemble the header and segments for one frame.
+  void AssembleFrame(unsigned int f, unsigned char **destP, size_t *destSizeP);
+
+private:
+  // Encode every segment whose index modulo numThreads is threadId.
+  void ExecuteThread(int threadId, int numThreads);
+
+  // The function that is called by vtkMultiThreader.
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+
+  const unsigned char *Source;
+  size_t FrameSize;
+  unsigned int NumberOfFrames;
+  unsigned int NumberOfSegments;
+  unsigned int Increment;
+  size_t RowLength;
+  size_t NumberOfRows;
+  size_t Offsets[15];
+  std::vector<unsigned char *> Segments;
+  std::vector<size_t> SegmentSizes;
+};
+
+void RLEEncodeFrames::ExecuteThread(int threadId, int numThreads)
+{
+  size_t m = this->Segments.size();
+  for (size_t i = threadId; i < m; i += numThreads)
+    {
+    size_t f = i / this->NumberOfSegments;
+    size_t s = i % this->NumberOfSegments;
+    PackBitsSegment(this->Source + f*this->FrameSize + this->Offsets[s],
+      this->Increment, this->RowLength, this->NumberOfRows,
+      &this->Segments[i], &this->SegmentSizes[i]);
+    }
+}
+
+VTK_THREAD_RETURN_TYPE RLEEncodeFrames::ThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  RLEEncodeFrames *frames =
+    static_cast<RLEEncodeFrames *>(info->UserData);
+
+  frames->ExecuteThread(info->ThreadID, info->NumberOfThreads);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+void RLEEncodeFrames::Execute(int numThreads)
+{
+  // never use more threads than there are segments
+  if (static_cast<size_t>(numThreads) > this->Segments.size())
+    {
+    numThreads = static_cast<int>(this->Segments.size());
+    }
+  if (numThreads > VTK_MAX_THREADS)
+    {
+    numThreads = VTK_MAX_THREADS;
+    }
+
+  if (numThreads > 1)
+    {
+    vtkMultiThreader *threader = vtkMultiThreader::New();
+    threader->SetNumberOfThreads(numThreads);
+    threader->SetSingleMethod(RLEEncodeFrames::ThreadFunction, this);
+    threader->SingleMethodExecute();
+    threader->Delete();
+    }
+  else
+    {
+    this->ExecuteThread(0, 1);
+    }
+}
+
+void RLEEncodeFrames::AssembleFrame(
+  unsigned int f, unsigned char **destP, size_t *destSizeP)
+{
+  unsigned int n = this->NumberOfSegments;
+  unsigned char **segments = &this->Segments[f*n];
+  size_t *sizes = &this->SegmentSizes[f*n];
+
+  size_t destSize = 64;
+  for (unsigned int i = 0; i < n; i++)
+    {
+    destSize += sizes[i];
+    }
+  unsigned char *dest = new unsigned char[destSize];
+
+  // write the table, followed by the segments
+  vtkDICOMUtilities::PackUnsignedInt(n, dest);
+  size_t offset = 64;
+  for (unsigned int i = 0; i < 15; i++)
+    {
+    unsigned int o = 0;
+    if (i < n)
+      {
+      o = static_cast<unsigned int>(offset);
+      memcpy(dest + offset, segments[i], sizes[i]);
+      offset += sizes[i];
+      delete [] segments[i];
+      segments[i] = 0;
+      }
+    vtkDICOMUtilities::PackUnsignedInt(o, dest + 4*(i + 1));
+    }
+
+  *destP = dest;
+  *destSizeP = destSize;
 }
 
+} // end anonymous namespace
+
 //----------------------------------------------------------------------------
 int vtkDICOMImageCodec::EncodeRLE(
-  const ImageFormat& image,
+  const ImageFormat& image, unsigned int numFrames,
   const unsigned char *source, size_t sourceSize,
-  unsigned char **destP, size_t *destSizeP)
+  unsigned char **destP, size_t *destSizeP, int numThreads)
 {
-  int errorCode = NoError;
-
   // get the samples per pixel (spp) and bytes per sample (bps)
   unsigned int spp = image.SamplesPerPixel;
   spp = (spp == 0 ? 1 : spp);
@@ -227,8 +585,11 @@ int vtkDICOMImageCodec::EncodeRLE(
   unsigned int n = spp*bps;
   if (n == 0 || n > 15)
     {
-    *destP = 0;
-    *destSizeP = 0;
+    for (unsigned int f = 0; f < numFrames; f++)
+      {
+      destP[f] = 0;
+      destSizeP[f] = 0;
+      }
     return BadPixelFormat;
     }
 
@@ -241,147 +602,664 @@ int vtkDICOMImageCodec::EncodeRLE(
   size_t segInc = (image.PlanarConfiguration ? segmentSize : 1);
   segInc *= bps;
 
-  // allocate the destination buffer
-  size_t destReserve = 4000;
-  unsigned char *dest = new unsigned char[destReserve];
-
-  // write the table
-  vtkDICOMUtilities::PackUnsignedInt(n, dest);
-  for (unsigned int i = 0; i < 15; i++)
-    {
-    vtkDICOMUtilities::PackUnsignedInt(0, dest + 4*(i + 1));
-    }
-
-  // the offset to the first segment
-  unsigned int offset = 64;
-  unsigned short rowlen = image.Columns;
-  size_t numrows = sourceSize/(n*rowlen);
+  // the rows are encoded separately
+  size_t rowlen = image.Columns;
+  size_t numrows = (rowlen == 0 ? 0 : sourceSize/(n*rowlen));
 
   // this will set endiancheck.s to 1 on little endian architectures
   union { char c[2]; short s; } endiancheck;
   endiancheck.c[0] = 1;
   endiancheck.c[1] = 0;
 
-  // loop over all RLE segments
-  // write the segments
+  // compute the offset into the input buffer for each segment
+  size_t offsets[15];
   for (unsigned int i = 0; i < n; i++)
     {
-    // write the offset into the table
-    vtkDICOMUtilities::PackUnsignedInt(offset, dest + 4*(i + 1));
     // sample position in pixel
     unsigned int s = i / bps;
     // byte position in sample
     unsigned int b = i % bps;
-    // compute the offset into the input buffer for this segment
-    size_t inOffset = s*segInc + b; // big-endian
+    offsets[i] = s*segInc + b; // big-endian
     if (endiancheck.s == 1) // little-endian
       {
-      inOffset = s*segInc + (bps - b - 1);
+      offsets[i] = s*segInc + (bps - b - 1);
       }
-    const signed char *cp =
-      reinterpret_cast<const signed char *>(source + inOffset);
-    signed char *dp = reinterpret_cast<signed char *>(dest + offset);
+    }
+
+  // encode all of the segments of all of the frames
+  RLEEncodeFrames frames(source, sourceSize, numFrames, n);
+  frames.SetLayout(offsets, inInc, rowlen, numrows);
+  frames.Execute(numThreads);
+
+  for (unsigned int f = 0; f < numFrames; f++)
+    {
+    frames.AssembleFrame(f, &destP[f], &destSizeP[f]);
+    }
+
+  return NoError;
+}
+
+//----------------------------------------------------------------------------
+namespace {
 
-    for (size_t j = 0; j < numrows; j++)
+// A Huffman table for the differences in a lossless JPEG scan.
+struct JPEGHuffmanTable
+{
+  // for codes of up to 8 bits: (length << 8) + symbol, or zero
+  unsigned short Lookup[256];
+  // the largest code of each length, or -1 if there are none
+  int MaxCode[17];
+  // the offset from a code of each length to its index in Values
+  int ValueOffset[17];
+  unsigned char Values[256];
+  bool Defined;
+
+  JPEGHuffmanTable() : Defined(false) {}
+
+  // Build the table from the DHT counts and symbols, return false
+  // if the table is not valid.
+  bool Build(const unsigned char counts[16], const unsigned char *values,
+             int numValues);
+};
+
+bool JPEGHuffmanTable::Build(
+  const unsigned char counts[16], const unsigned char *values, int numValues)
+{
+  this->Defined = false;
+  memset(this->Lookup, 0, sizeof(this->Lookup));
+  memcpy(this->Values, values, numValues);
+
+  int code = 0;
+  int k = 0;
+  for (int l = 1; l <= 16; l++)
+    {
+    int m = counts[l-1];
+    // codes of length l must fit within l bits
+    if (code + m > (1 << l) || k + m > numValues)
+      {
+      return false;
+      }
+    this->ValueOffset[l] = k - code;
+    this->MaxCode[l] = (m == 0 ? -1 : code + m - 1);
+    for (int i = 0; i < m; i++)
       {
-      const signed char *ep = cp + rowlen*inInc;
-      while (cp != ep)
+      if (l <= 8)
         {
-        short maxcount = 128;
-        ptrdiff_t remainder = (ep - cp)/inInc;
-        maxcount = (remainder < maxcount ? remainder : maxcount);
-        short counter = maxcount;
-        const signed char *sp = cp;
-
-        // count repeated characters
-        signed char prev = *cp;
-        do
+        // all 8-bit prefixes that begin with this code
+        int shift = 8 - l;
+        for (int j = 0; j < (1 << shift); j++)
           {
-          cp += inInc;
+          this->Lookup[(code << shift) + j] =
+            static_cast<unsigned short>((l << 8) + values[k]);
           }
-        while (--counter != 0 && *cp == prev);
+        }
+      code++;
+      k++;
+      }
+    code <<= 1;
+    }
+  this->Defined = true;
 
-        if (maxcount - counter > 1)
-          {
-          // negative count for repeating
-          counter = -(maxcount - counter - 1);
-          }
-        else if (counter > 0)
-          {
-          // count non-repeated bytes until a triplicate found
-          signed char pprev;
-          do
-            {
-            pprev = prev;
-            prev = *cp;
-            cp += inInc;
-            }
-          while (--counter != 0 && (*cp != prev || prev != pprev));
-
-          // positive count for literal
-          counter = maxcount - counter - 1;
-
-          // remove repeats at the end that can join with next run
-          if (remainder > counter + 1 && *cp == prev)
-            {
-            short reps = 1 + (prev == pprev);
-            reps = (reps < counter ? reps : counter);
-            counter -= reps;
-            cp -= reps*inInc;
-            }
-
-          // increment for the next offset into the destination
-          offset += counter;
-          }
+  return true;
+}
+
+// Read the bits from the entropy-coded segment of a JPEG scan.
+class JPEGBitReader
+{
+public:
+  JPEGBitReader(const unsigned char *cp, const unsigned char *ep)
+    : Ptr(cp), End(ep), Bits(0), Count(0), Padding(0), Marker(false),
+      Corrupt(false) {}
+
+  // Get the next n bits (at most 16) without consuming them.
+  unsigned int Peek(int n) {
+    if (this->Count < n) { this->Fill(); }
+    return static_cast<unsigned int>(this->Bits >> (64 - n)); }
+
+  // Consume n bits.
+  void Skip(int n) {
+    this->Bits <<= n;
+    this->Count -= n; }
+
+  // Decode one Huffman-coded symbol, or return -1 if the code is invalid.
+  int DecodeSymbol(const JPEGHuffmanTable *table);
 
-        // at least two bytes are always written to destination
-        offset += 2;
+  // Decode a difference value with the given table.
+  int DecodeDifference(const JPEGHuffmanTable *table);
 
-        // check whether destination buffer is large enough
-        if (offset > destReserve)
+  // Discard the remaining bits and skip the next restart marker.
+  void Restart();
+
+  // Get the position of the marker that ended the entropy-coded data.
+  const unsigned char *GetPosition() { return this->Ptr; }
+
+  // Check whether the data ended early, or had invalid codes.
+  bool GetCorrupt() {
+    return (this->Corrupt || this->Count < this->Padding); }
+
+private:
+  // Fill the bit buffer, removing stuffed zero bytes.
+  void Fill();
+
+  const unsigned char *Ptr;
+  const unsigned char *End;
+  vtkTypeUInt64 Bits;
+  int Count;
+  int Padding;
+  bool Marker;
+  bool Corrupt;
+};
+
+void JPEGBitReader::Fill()
+{
+  while (this->Count <= 56)
+    {
+    unsigned int c = 0;
+    if (this->Marker || this->Ptr == this->End)
+      {
+      // at a marker, or at the end of the data, the remainder of the
+      // scan is padded with zeros, and the padding bits are counted
+      this->Padding += 8;
+      }
+    else if (*this->Ptr != 0xFF)
+      {
+      c = *this->Ptr++;
+      }
+    else if (this->End - this->Ptr > 1 && this->Ptr[1] == 0)
+      {
+      c = 0xFF;
+      this->Ptr += 2;
+      }
+    else
+      {
+      this->Marker = true;
+      }
+    this->Bits |= static_cast<vtkTypeUInt64>(c) << (56 - this->Count);
+    this->Count += 8;
+    }
+}
+
+int JPEGBitReader::DecodeSymbol(const JPEGHuffmanTable *table)
+{
+  unsigned int e = table->Lookup[this->Peek(8)];
+  if (e != 0)
+    {
+    this->Skip(e >> 8);
+    return (e & 0xFF);
+    }
+
+  unsigned int code = this->Peek(16);
+  int l = 9;
+  while (l <= 16 && static_cast<int>(code >> (16 - l)) > table->MaxCode[l])
+    {
+    l++;
+    }
+  if (l > 16)
+    {
+    this->Corrupt = true;
+    return -1;
+    }
+  this->Skip(l);
+  return table->Values[table->ValueOffset[l] + (code >> (16 - l))];
+}
+
+int JPEGBitReader::DecodeDifference(const JPEGHuffmanTable *table)
+{
+  int t = this->DecodeSymbol(table);
+  if (t <= 0)
+    {
+    // zero difference, or an invalid code
+    return 0;
+    }
+  else if (t > 16)
+    {
+    // difference categories only go up to 16
+    this->Corrupt = true;
+    return 0;
+    }
+  else if (t == 16)
+    {
+    // this category has no additional bits
+    return 32768;
+    }
+
+  int v = static_cast<int>(this->Peek(t));
+  this->Skip(t);
+  if (v < (1 << (t - 1)))
+    {
+    v -= (1 << t) - 1;
+    }
+  return v;
+}
+
+void JPEGBitReader::Restart()
+{
+  // the marker is normally found while filling the bit buffer
+  while (!this->Marker && this->Ptr != this->End)
+    {
+    this->Fill();
+    this->Bits = 0;
+    this->Count = 0;
+    }
+  if (!this->Marker)
+    {
+    this->Corrupt = true;
+    }
+  if (this->End - this->Ptr > 1 &&
+      this->Ptr[1] >= 0xD0 && this->Ptr[1] <= 0xD7)
+    {
+    this->Ptr += 2;
+    }
+  this->Bits = 0;
+  this->Count = 0;
+  this->Padding = 0;
+  this->Marker = false;
+}
+
+// The information needed to decode one lossless JPEG frame.
+struct JPEGLosslessFrame
+{
+  unsigned int Precision;
+  unsigned int Rows;
+  unsigned int Columns;
+  unsigned int NumberOfComponents;
+  unsigned char ComponentIds[4];
+  unsigned int RestartInterval;
+  JPEGHuffmanTable Tables[4];
+
+  // the output layout for each sample
+  unsigned char *Dest;
+  size_t ComponentIncrement;
+  size_t PixelIncrement;
+  size_t RowIncrement;
+  unsigned int BytesPerSample;
+};
+
+// Decode one scan, where cp points just after the SOS header and ep is
+// the end of the data.  The ids are the components in the scan, and the
+// position at which the scan ended is returned in "endP".
+int JPEGLosslessScan(
+  JPEGLosslessFrame *frame, unsigned int numComponents,
+  const unsigned int *components, const JPEGHuffmanTable **tables,
+  int predictor, int pointTransform,
+  const unsigned char *cp, const unsigned char *ep,
+  const unsigned char **endP)
+{
+  int errorCode = vtkDICOMImageCodec::NoError;
+  unsigned int columns = frame->Columns;
+  unsigned int rows = frame->Rows;
+  int initial = 1 << (frame->Precision - pointTransform - 1);
+
+  // keep the previous row and the current row for each component
+  std::vector<unsigned short> rowBuffer(2*numComponents*columns);
+  unsigned short *prevRows[4];
+  unsigned short *currRows[4];
+  for (unsigned int c = 0; c < numComponents; c++)
+    {
+    prevRows[c] = &rowBuffer[2*c*columns];
+    currRows[c] = &rowBuffer[(2*c + 1)*columns];
+    }
+
+  JPEGBitReader reader(cp, ep);
+  unsigned int restartInterval = frame->RestartInterval;
+  unsigned int mcuCount = 0;
+  // the row and column at which the current restart interval began
+  unsigned int restartRow = 0;
+  unsigned int restartColumn = 0;
+
+  for (unsigned int y = 0; y < rows; y++)
+    {
+    for (unsigned int x = 0; x < columns; x++)
+      {
+      if (restartInterval != 0 && mcuCount == restartInterval)
+        {
+        reader.Restart();
+        mcuCount = 0;
+        restartRow = y;
+        restartColumn = x;
+        }
+      mcuCount++;
+
+      // the first row of the scan (or of a restart interval) uses the
+      // sample to the left, and the first column uses the sample above
+      int mode = predictor;
+      if (y == restartRow)
+        {
+        mode = (x == restartColumn ? -1 : 1);
+        }
+      else if (x == 0)
+        {
+        mode = 2;
+        }
+
+      for (unsigned int c = 0; c < numComponents; c++)
+        {
+        const unsigned short *prev = prevRows[c];
+        const unsigned short *curr = currRows[c];
+        int px;
+        switch (mode)
           {
-          destReserve *= 2;
-          unsigned char *newdest = new unsigned char[destReserve];
-          size_t size = dp-reinterpret_cast<signed char *>(dest);
-          memcpy(newdest, dest, size);
-          delete [] dest;
-          dest = newdest;
-          dp = reinterpret_cast<signed char *>(dest + size);
+          case 1:
+            px = curr[x-1];
+            break;
+          case 2:
+            px = prev[x];
+            break;
+          case 3:
+            px = prev[x-1];
+            break;
+          case 4:
+            px = curr[x-1] + prev[x] - prev[x-1];
+            break;
+          case 5:
+            px = curr[x-1] + ((prev[x] - prev[x-1]) >> 1);
+            break;
+          case 6:
+            px = prev[x] + ((curr[x-1] - prev[x-1]) >> 1);
+            break;
+          case 7:
+            px = (curr[x-1] + prev[x]) >> 1;
+            break;
+          default:
+            px = initial;
+            break;
           }
+        int d = reader.DecodeDifference(tables[c]);
+        currRows[c][x] = static_cast<unsigned short>(px + d);
+        }
+      }
 
-        // write the results
-        *dp++ = counter;
-        do
+    // write the row to the output
+    for (unsigned int c = 0; c < numComponents; c++)
+      {
+      unsigned short *curr = currRows[c];
+      unsigned char *dp = frame->Dest +
+        y*frame->RowIncrement + components[c]*frame->ComponentIncrement;
+      size_t inc = frame->PixelIncrement;
+      if (frame->BytesPerSample == 1)
+        {
+        for (unsigned int x = 0; x < columns; x++)
+          {
+          *dp = static_cast<unsigned char>(curr[x] << pointTransform);
+          dp += inc;
+          }
+        }
+      else
+        {
+        for (unsigned int x = 0; x < columns; x++)
           {
-          *dp++ = *sp;
-          sp += inInc;
+          *reinterpret_cast<unsigned short *>(dp) =
+            static_cast<unsigned short>(curr[x] << pointTransform);
+          dp += inc;
           }
-        while (--counter >= 0);
         }
+      // the current row becomes the previous row
+      currRows[c] = prevRows[c];
+      prevRows[c] = curr;
       }
 
-    // add a pad byte to the segment if needed
-    if ((offset & 1) != 0)
+    // stop decoding if the stream is malformed
+    if (reader.GetCorrupt())
       {
-      offset++;
-      *dp = 0;
+      break;
       }
     }
 
-  *destP = dest;
-  *destSizeP = offset;
+  if (reader.GetCorrupt())
+    {
+    errorCode = vtkDICOMImageCodec::MissingData;
+    }
+
+  // find the marker that follows the scan
+  cp = reader.GetPosition();
+  while (ep - cp > 1 &&
+         (cp[0] != 0xFF || cp[1] == 0 || cp[1] == 0xFF ||
+          (cp[1] >= 0xD0 && cp[1] <= 0xD7)))
+    {
+    cp++;
+    }
+  *endP = cp;
 
-#if 0
-  // check code, to make sure it unpacks into an identical stream
-  unsigned char *check = new unsigned char[sourceSize];
-  DecodeRLE(image, dest, offset, check, sourceSize);
+  return errorCode;
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkDICOMImageCodec::DecodeJPEGLossless(
+  const ImageFormat& image,
+  const unsigned char *source, size_t sourceSize,
+  unsigned char *dest, size_t destSize)
+{
+  const unsigned char *cp = source;
+  const unsigned char *ep = source + sourceSize;
+  int errorCode = NoError;
 
-  for (size_t k = 0; k < sourceSize; k++)
+  // the image must begin with SOI
+  if (sourceSize < 4 || cp[0] != 0xFF || cp[1] != 0xD8)
     {
-    assert(source[k] == check[k]);
+    return MissingData;
+    }
+  cp += 2;
+
+  JPEGLosslessFrame frame;
+  frame.Precision = 0;
+  frame.Rows = 0;
+  frame.Columns = 0;
+  frame.NumberOfComponents = 0;
+  frame.RestartInterval = 0;
+  frame.Dest = dest;
+  frame.BytesPerSample = (image.BitsAllocated <= 8 ? 1 : 2);
+
+  // clear the output, in case some components are missing
+  memset(dest, 0, destSize);
+  // a bit for each component that has been decoded
+  unsigned int decodedComponents = 0;
+
+  while (ep - cp >= 4)
+    {
+    // skip fill bytes before the marker
+    if (cp[0] != 0xFF)
+      {
+      errorCode = BadPixelFormat;
+      break;
+      }
+    while (ep - cp > 2 && cp[1] == 0xFF)
+      {
+      cp++;
+      }
+    unsigned char marker = cp[1];
+    cp += 2;
+    if (marker == 0xD9)
+      {
+      // EOI
+      break;
+      }
+    else if (marker >= 0xD0 && marker <= 0xD7)
+      {
+      // stray RST markers have no length
+      continue;
+      }
+
+    // all other markers are followed by a length
+    if (ep - cp < 2)
+      {
+      errorCode = MissingData;
+      break;
+      }
+    size_t l = (cp[0] << 8) + cp[1];
+    if (l < 2 || l > static_cast<size_t>(ep - cp))
+      {
+      errorCode = MissingData;
+      break;
+      }
+    const unsigned char *sp = cp + 2;
+    cp += l;
+    l -= 2;
+
+    if (marker == 0xC3)
+      {
+      // SOF3, the frame header for lossless Huffman coding
+      if (l < 6)
+        {
+        errorCode = BadPixelFormat;
+        break;
+        }
+      frame.Precision = sp[0];
+      frame.Rows = (sp[1] << 8) + sp[2];
+      frame.Columns = (sp[3] << 8) + sp[4];
+      frame.NumberOfComponents = sp[5];
+      unsigned int spp = image.SamplesPerPixel;
+      spp = (spp == 0 ? 1 : spp);
+      if (frame.Rows == 0)
+        {
+        // the number of rows could be given with a DNL marker
+        frame.Rows = image.Rows;
+        }
+      if (frame.Precision < 2 || frame.Precision > 16 ||
+          frame.Precision > 8*frame.BytesPerSample ||
+          frame.Rows != image.Rows || frame.Columns != image.Columns ||
+          frame.NumberOfComponents != spp || spp > 4 ||
+          l < 6 + 3*spp)
+        {
+        errorCode = BadPixelFormat;
+        break;
+        }
+      for (unsigned int c = 0; c < spp; c++)
+        {
+        frame.ComponentIds[c] = sp[6 + 3*c];
+        // only one sample per pixel per component is supported
+        if (sp[7 + 3*c] != 0x11)
+          {
+          errorCode = BadPixelFormat;
+          }
+        }
+      // compute the layout of the output
+      size_t bps = frame.BytesPerSample;
+      size_t n = static_cast<size_t>(frame.Rows)*frame.Columns;
+      if (n*spp*bps > destSize)
+        {
+        errorCode = BadPixelFormat;
+        }
+      if (image.PlanarConfiguration)
+        {
+        frame.ComponentIncrement = n*bps;
+        frame.PixelIncrement = bps;
+        }
+      else
+        {
+        frame.ComponentIncrement = bps;
+        frame.PixelIncrement = spp*bps;
+        }
+      frame.RowIncrement = frame.Columns*frame.PixelIncrement;
+      if (errorCode != NoError)
+        {
+        break;
+        }
+      }
+    else if ((marker >= 0xC0 && marker <= 0xCF) &&
+             marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+      {
+      // any other SOF is a lossy or arithmetic-coded frame
+      errorCode = BadPixelFormat;
+      break;
+      }
+    else if (marker == 0xC4)
+      {
+      // DHT, one or more Huffman tables
+      while (l >= 17)
+        {
+        int tc = (sp[0] >> 4);
+        int th = (sp[0] & 0x0F);
+        const unsigned char *counts = sp + 1;
+        size_t m = 0;
+        for (int i = 0; i < 16; i++)
+          {
+          m += counts[i];
+          }
+        if (tc != 0 || th > 3 || m > 256 || 17 + m > l ||
+            !frame.Tables[th].Build(counts, sp + 17, static_cast<int>(m)))
+          {
+          errorCode = BadPixelFormat;
+          break;
+          }
+        sp += 17 + m;
+        l -= 17 + m;
+        }
+      if (errorCode != NoError)
+        {
+        break;
+        }
+      }
+    else if (marker == 0xDD)
+      {
+      // DRI, the restart interval
+      if (l >= 2)
+        {
+        frame.RestartInterval = (sp[0] << 8) + sp[1];
+        }
+      }
+    else if (marker == 0xDA)
+      {
+      // SOS, the scan header
+      unsigned int ns = (l > 0 ? sp[0] : 0);
+      if (frame.NumberOfComponents == 0 || frame.Precision < 2 ||
+          ns == 0 || ns > frame.NumberOfComponents || l < 4 + 2*ns)
+        {
+        errorCode = BadPixelFormat;
+        break;
+        }
+      unsigned int components[4];
+      const JPEGHuffmanTable *tables[4];
+      for (unsigned int j = 0; j < ns; j++)
+        {
+        unsigned int c = 0;
+        while (c < frame.NumberOfComponents &&
+               frame.ComponentIds[c] != sp[1 + 2*j])
+          {
+          c++;
+          }
+        // the DC table selector must refer to a table that was defined
+        int td = (sp[2 + 2*j] >> 4);
+        if (c == frame.NumberOfComponents || td > 3 ||
+            !frame.Tables[td].Defined)
+          {
+          errorCode = BadPixelFormat;
+          break;
+          }
+        components[j] = c;
+        tables[j] = &frame.Tables[td];
+        }
+      int predictor = sp[1 + 2*ns];
+      int pointTransform = (sp[3 + 2*ns] & 0x0F);
+      if (predictor < 1 || predictor > 7 ||
+          pointTransform >= static_cast<int>(frame.Precision))
+        {
+        errorCode = BadPixelFormat;
+        }
+      if (errorCode != NoError)
+        {
+        break;
+        }
+      // the entropy-coded data follows the scan header
+      int scanError = JPEGLosslessScan(
+        &frame, ns, components, tables, predictor, pointTransform,
+        cp, ep, &cp);
+      errorCode = (errorCode == NoError ? scanError : errorCode);
+      for (unsigned int j = 0; j < ns; j++)
+        {
+        decodedComponents |= (1u << components[j]);
+        }
+      }
+    }
+
+  // every component of the frame must have been in a scan
+  if (errorCode == NoError &&
+      (frame.NumberOfComponents == 0 ||
+       decodedComponents != (1u << frame.NumberOfComponents) - 1))
+    {
+    errorCode = MissingData;
     }
-  delete [] check;
-#endif
 
   return errorCode;
 }
@@ -397,6 +1275,10 @@ int vtkDICOMImageCodec::Decode(
     {
     code = DecodeRLE(image, source, sourceSize, dest, destSize);
     }
+  else if (this->Key == JPEGLossless || this->Key == JPEGPrediction)
+    {
+    code = DecodeJPEGLossless(image, source, sourceSize, dest, destSize);
+    }
 
   return code;
 }
@@ -408,14 +1290,71 @@ int vtkDICOMImageCodec::Encode(
   unsigned char **dest, size_t *destSize) const
 {
   int code = MissingCodec;
+  *dest = 0;
+  *destSize = 0;
+  if (this->Key == RLE)
+    {
+    code = EncodeRLE(image, 1, source, sourceSize, dest, destSize, 1);
+    }
+
+  return code;
+}
+
+//----------------------------------------------------------------------------
+int vtkDICOMImageCodec::EncodeFrames(
+  const ImageFormat& image, int numFrames,
+  const unsigned char *source, size_t frameSize,
+  unsigned char **dests, size_t *destSizes, int numThreads) const
+{
+  int code = NoError;
+  if (numFrames <= 0)
+    {
+    return code;
+    }
+
   if (this->Key == RLE)
     {
-    code = EncodeRLE(image, source, sourceSize, dest, destSize);
+    code = EncodeRLE(image, static_cast<unsigned int>(numFrames),
+                     source, frameSize, dests, destSizes, numThreads);
+    }
+  else
+    {
+    for (int i = 0; i < numFrames; i++)
+      {
+      dests[i] = 0;
+      destSizes[i] = 0;
+      int c = this->Encode(image, source + i*frameSize, frameSize,
+                           &dests[i], &destSizes[i]);
+      code = (code == NoError ? c : code);
+      }
     }
 
   return code;
 }
 
+//----------------------------------------------------------------------------
+size_t vtkDICOMImageCodec::GetMaximumEncodedSize(
+  const ImageFormat& image, size_t sourceSize) const
+{
+  size_t maxSize = 0;
+  if (this->Key == RLE)
+    {
+    unsigned int spp = image.SamplesPerPixel;
+    spp = (spp == 0 ? 1 : spp);
+    unsigned int bps = (image.BitsAllocated + 7)/8;
+    bps = (bps == 0 ? 1 : bps);
+    size_t n = spp*bps;
+    size_t rowlen = image.Columns;
+    size_t numrows = (rowlen == 0 ? 0 : sourceSize/(n*rowlen));
+    // each row of each segment is packed separately, where every literal
+    // run of up to 128 bytes adds one byte, and each segment is padded
+    // to an even length, and the header is 64 bytes
+    maxSize = 64 + sourceSize + n*(numrows*(rowlen/128 + 2) + 1);
+    }
+
+  return maxSize;
+}
+
 //----------------------------------------------------------------------------
 ostream& operator<<(ostream& o, const vtkDICOMImageCodec& a)
 {
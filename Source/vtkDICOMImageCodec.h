@@ -106,6 +106,7 @@ public:
    *  The length of the source buffer must be provided.  The destination
    *  must be large enough to accept the entire decompressed frame.  On
    *  error, the error code is returned, and on success, zero is returned.
+   *  The RLE and the JPEG lossless (process 14) codecs are supported.
    */
   int Decode(const ImageFormat& image,
              const unsigned char *source, size_t sourceSize,
@@ -120,6 +121,34 @@ public:
              const unsigned char *source, size_t sourceSize,
              unsigned char **dest, size_t *destSize) const;
 
+  //! Encode several frames, using the given number of threads.
+  /*!
+   *  The frames must be contiguous in the source buffer, and each frame
+   *  must be frameSize bytes long.  The dests and destSizes arrays must
+   *  have room for numFrames entries, and the caller must free each of
+   *  the returned buffers.  For RLE, the segments (byte planes) of all
+   *  of the frames are encoded concurrently, and the results are the
+   *  same as if Encode() had been called for each frame.  Note that
+   *  vtkDICOMCompiler passes just one frame at a time, so it can use
+   *  at most one thread per segment (e.g. three for 8-bit RGB).  If any
+   *  frame fails, then the first error code is returned, and the dests
+   *  for the frames that failed are set to NULL.
+   */
+  int EncodeFrames(const ImageFormat& image, int numFrames,
+                   const unsigned char *source, size_t frameSize,
+                   unsigned char **dests, size_t *destSizes,
+                   int numThreads) const;
+
+  //! Get the largest size that Encode() could produce for one frame.
+  /*!
+   *  This is an upper bound on the size of an encoded frame, given the
+   *  size of the source frame.  It can be used to check ahead of time
+   *  whether the frames will fit within a given space.  If there is no
+   *  encoder for this codec, then zero is returned.
+   */
+  size_t GetMaximumEncodedSize(
+    const ImageFormat& image, size_t sourceSize) const;
+
   bool operator==(vtkDICOMImageCodec b) const { return (this->Key == b.Key); }
   bool operator!=(vtkDICOMImageCodec b) const { return (this->Key != b.Key); }
   bool operator<=(vtkDICOMImageCodec a) const { return (this->Key <= a.Key); }
@@ -136,10 +165,15 @@ private:
     const unsigned char *source, size_t sourceSize,
     unsigned char *dest, size_t destSize);
 
-  static int EncodeRLE(
+  static int DecodeJPEGLossless(
     const ImageFormat& image,
     const unsigned char *source, size_t sourceSize,
-    unsigned char **dest, size_t *destSize);
+    unsigned char *dest, size_t destSize);
+
+  static int EncodeRLE(
+    const ImageFormat& image, unsigned int numFrames,
+    const unsigned char *source, size_t sourceSize,
+    unsigned char **dest, size_t *destSize, int numThreads);
 
   //! Unpack one little-endian int.
   static unsigned int UnpackUnsignedInt(const void *source) {
@@ -59,46 +59,6 @@ vtkDICOMItem::vtkDICOMItem(
   this->L->VRForXS = vrForXS;
 }
 
-//----------------------------------------------------------------------------
-vtkDICOMDataElement *vtkDICOMItem::NewDataElement(vtkDICOMDataElement **iter)
-{
-  int n = this->L->NumberOfDataElements;
-
-  // if no data elements yet, then allocate four
-  if (this->L->DataElements == 0)
-    {
-    this->L->DataElements = new vtkDICOMDataElement[4];
-    }
-  // if n is a power of two, double allocated space
-  else if (n >= 4 && (n & (n-1)) == 0)
-    {
-    // but first check if a free element exists
-    do { --n; } while (n > 0 && this->L->DataElements[n].Next != 0);
-
-    if (this->L->DataElements[n].Next != 0)
-      {
-      // make a new, larger list
-      n = this->L->NumberOfDataElements;
-      vtkDICOMDataElement *oldptr = this->L->DataElements;
-      this->L->DataElements = new vtkDICOMDataElement[2*n];
-      vtkDICOMItem::CopyDataElements(
-        this->L->Head.Next, &this->L->Tail, this->L);
-      if (iter)
-        {
-        // fix the address of the provided node, since it was re-alloced
-        vtkDICOMDataElement *tptr = *iter;
-        vtkDICOMDataElement *nptr = &this->L->Tail;
-        do { tptr = tptr->Next; nptr = nptr->Prev; }
-        while (tptr != &this->L->Tail);
-        *iter = nptr;
-        }
-      delete [] oldptr;
-      }
-    }
-
-  return &this->L->DataElements[n];
-}
-
 //----------------------------------------------------------------------------
 void vtkDICOMItem::FreeList()
 {
@@ -112,6 +72,8 @@ void vtkDICOMItem::CopyList(const List *o, List *t)
 {
   t->ByteOffset = o->ByteOffset;
   t->Delimited = o->Delimited;
+  t->CharacterSet = o->CharacterSet;
+  t->VRForXS = o->VRForXS;
 
   int n = o->NumberOfDataElements;
   if (n > 0)
@@ -128,7 +90,13 @@ void vtkDICOMItem::CopyList(const List *o, List *t)
     // allocate a minimum of 4 elements
     if (m < 4) { m = 4; }
     t->DataElements = new vtkDICOMDataElement[m];
+    t->Capacity = m;
     vtkDICOMItem::CopyDataElements(o->Head.Next, &o->Tail, t);
+    t->NumberOfDataElements = n;
+    }
+  else
+    {
+    vtkDICOMItem::LinkDataElements(t, 0);
     }
 }
 
@@ -155,6 +123,24 @@ void vtkDICOMItem::CopyDataElements(
   t->Tail.Prev->Next = &t->Tail;
 }
 
+//----------------------------------------------------------------------------
+vtkDICOMItem vtkDICOMItem::GetUnpooledCopy() const
+{
+  vtkDICOMItem item;
+  if (this->L)
+    {
+    item.L = new List;
+    vtkDICOMItem::CopyList(this->L, item.L);
+    vtkDICOMDataElement *e = item.L->Head.Next;
+    while (e != &item.L->Tail)
+      {
+      e->Value = e->Value.GetUnpooledCopy();
+      e = e->Next;
+      }
+    }
+  return item;
+}
+
 //----------------------------------------------------------------------------
 vtkDICOMDataElement *vtkDICOMItem::FindDataElementOrInsert(vtkDICOMTag tag)
 {
@@ -174,29 +160,139 @@ vtkDICOMDataElement *vtkDICOMItem::FindDataElementOrInsert(vtkDICOMTag tag)
     this->L = t;
     }
 
-  // find the insert location in the linked list
-  vtkDICOMDataElement *tptr = &this->L->Tail;
-  do
+  // the parser adds elements in order, so check the end first
+  int n = this->L->NumberOfDataElements;
+  vtkDICOMDataElement *e = this->L->DataElements;
+  int i = n;
+  if (n > 0 && !(e[n-1].Tag < tag))
     {
-    tptr = tptr->Prev;
+    i = vtkDICOMItem::LowerBound(this->L, tag);
+    if (e[i].Tag == tag)
+      {
+      return &e[i];
+      }
     }
-  while (tag < tptr->GetTag());
 
-  if (tag != tptr->GetTag())
+  return this->InsertDataElement(i, tag);
+}
+
+//----------------------------------------------------------------------------
+int vtkDICOMItem::LowerBound(const List *l, vtkDICOMTag tag)
+{
+  // binary search for the first element that is not less than tag
+  const vtkDICOMDataElement *e = l->DataElements;
+  int lo = 0;
+  int hi = l->NumberOfDataElements;
+  while (lo < hi)
     {
-    // create a new data element
-    vtkDICOMDataElement *e = this->NewDataElement(&tptr);
-    e->Tag = tag;
-    e->Prev = tptr;
-    e->Next = tptr->Next;
-    e->Prev->Next = e;
-    e->Next->Prev = e;
-
-    tptr = e;
-    this->L->NumberOfDataElements++;
+    int mid = (lo + hi) >> 1;
+    if (e[mid].Tag < tag)
+      {
+      lo = mid + 1;
+      }
+    else
+      {
+      hi = mid;
+      }
     }
+  return lo;
+}
 
-  return tptr;
+//----------------------------------------------------------------------------
+void vtkDICOMItem::LinkDataElements(List *l, int first)
+{
+  // set the links for all elements from "first" to the end
+  vtkDICOMDataElement *e = l->DataElements;
+  int n = l->NumberOfDataElements;
+  if (n == 0)
+    {
+    l->Head.Next = &l->Tail;
+    l->Tail.Prev = &l->Head;
+    return;
+    }
+
+  for (int i = first; i < n; i++)
+    {
+    e[i].Prev = (i > 0 ? &e[i-1] : &l->Head);
+    e[i].Next = (i < n-1 ? &e[i+1] : &l->Tail);
+    }
+  if (first > 0 && first <= n)
+    {
+    e[first-1].Next = (first < n ? &e[first] : &l->Tail);
+    }
+
+  l->Head.Next = &e[0];
+  l->Tail.Prev = &e[n-1];
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMDataElement *vtkDICOMItem::InsertDataElement(int i, vtkDICOMTag tag)
+{
+  List *l = this->L;
+  int n = l->NumberOfDataElements;
+  vtkDICOMDataElement *e = l->DataElements;
+  int first = i;
+
+  if (n == l->Capacity)
+    {
+    // double the allocated space, with a minimum of four elements
+    int m = (n < 4 ? 4 : 2*n);
+    vtkDICOMDataElement *oldptr = e;
+    e = new vtkDICOMDataElement[m];
+    for (int j = 0; j < i; j++)
+      {
+      e[j].Tag = oldptr[j].Tag;
+      e[j].Value = oldptr[j].Value;
+      }
+    for (int j = i; j < n; j++)
+      {
+      e[j+1].Tag = oldptr[j].Tag;
+      e[j+1].Value = oldptr[j].Value;
+      }
+    delete [] oldptr;
+    l->DataElements = e;
+    l->Capacity = m;
+    first = 0;
+    }
+  else
+    {
+    // shift the following elements to make room
+    for (int j = n; j > i; j--)
+      {
+      e[j].Tag = e[j-1].Tag;
+      e[j].Value = e[j-1].Value;
+      }
+    e[i].Value.Clear();
+    }
+
+  e[i].Tag = tag;
+  l->NumberOfDataElements = n + 1;
+  vtkDICOMItem::LinkDataElements(l, first);
+
+  return &e[i];
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMItem::RemoveDataElement(vtkDICOMDataElement *e)
+{
+  List *l = this->L;
+  vtkDICOMDataElement *d = l->DataElements;
+  int n = l->NumberOfDataElements - 1;
+  int i = static_cast<int>(e - d);
+
+  // shift the following elements to fill the gap
+  for (int j = i; j < n; j++)
+    {
+    d[j].Tag = d[j+1].Tag;
+    d[j].Value = d[j+1].Value;
+    }
+  d[n].Tag = vtkDICOMTag();
+  d[n].Value.Clear();
+  d[n].Next = 0;
+  d[n].Prev = 0;
+
+  l->NumberOfDataElements = n;
+  vtkDICOMItem::LinkDataElements(l, i);
 }
 
 //----------------------------------------------------------------------------
@@ -268,11 +364,7 @@ vtkDICOMItem *vtkDICOMItem::FindItemOrInsert(
     else if (!tptr->Value.IsValid())
       {
       // we just inserted a non-SQ value, remove it
-      tptr->Prev->Next = tptr->Next;
-      tptr->Next->Prev = tptr->Prev;
-      tptr->Next = 0;
-      tptr->Prev = 0;
-      this->L->NumberOfDataElements--;
+      this->RemoveDataElement(tptr);
       }
     }
   else
@@ -288,18 +380,18 @@ vtkDICOMItem *vtkDICOMItem::FindItemOrInsert(
 void vtkDICOMItem::SetAttributeValue(
   vtkDICOMTag tag, const vtkDICOMValue& v)
 {
+  // copy first, because "v" might refer to a value within this item,
+  // and inserting a data element will shift the values in memory
+  vtkDICOMValue value = v;
+
   vtkDICOMDataElement *tptr = this->FindDataElementOrInsert(tag);
 
-  tptr->Value = v;
+  tptr->Value = value;
 
-  if (!v.IsValid())
+  if (!value.IsValid())
     {
     // setting a value to the invalid value causes deletion
-    tptr->Prev->Next = tptr->Next;
-    tptr->Next->Prev = tptr->Prev;
-    tptr->Next = 0;
-    tptr->Prev = 0;
-    this->L->NumberOfDataElements--;
+    this->RemoveDataElement(tptr);
     }
 }
 
@@ -307,12 +399,15 @@ void vtkDICOMItem::SetAttributeValue(
 void vtkDICOMItem::SetAttributeValue(
   const vtkDICOMTagPath& tagpath, const vtkDICOMValue& v)
 {
+  // copy first, since creating the path might move "v" in memory
+  vtkDICOMValue value = v;
+
   vtkDICOMTag tag;
   vtkDICOMItem *item = this->FindItemOrInsert(tagpath, &tag);
   // if item is NULL, the path was invalid
   if (item)
     {
-    item->SetAttributeValue(tag, v);
+    item->SetAttributeValue(tag, value);
     }
 }
 
@@ -380,15 +475,11 @@ const vtkDICOMValue &vtkDICOMItem::GetAttributeValue(
 {
   if (this->L)
     {
-    vtkDICOMDataElement *e = this->L->Head.Next;
-    vtkDICOMDataElement *tail = &this->L->Tail;
-    while (e != tail)
+    int i = vtkDICOMItem::LowerBound(this->L, tag);
+    if (i < this->L->NumberOfDataElements &&
+        this->L->DataElements[i].Tag == tag)
       {
-      if (e->Tag == tag)
-        {
-        return e->Value;
-        }
-      e = e->Next;
+      return this->L->DataElements[i].Value;
       }
     }
   return vtkDICOMItem::InvalidValue;
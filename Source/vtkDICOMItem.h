@@ -35,12 +35,18 @@ class VTK_DICOM_EXPORT vtkDICOMItem
 private:
 
   //! A reference counted list container class.
+  /*!
+   *  The data elements are stored in a contiguous array that is sorted
+   *  by tag, so that they can be found with a binary search.  They are
+   *  also linked together (from Head to Tail) for iteration.
+   */
   struct List
   {
     vtkDICOMDataElement Head;
     vtkDICOMDataElement Tail;
     vtkDICOMReferenceCount ReferenceCount;
     int NumberOfDataElements;
+    int Capacity;
     vtkDICOMDataElement *DataElements;
     unsigned int ByteOffset;
     bool Delimited;
@@ -48,7 +54,7 @@ private:
     vtkDICOMVR VRForXS;
 
     List() : Head(), Tail(), ReferenceCount(1),
-             NumberOfDataElements(0), DataElements(0),
+             NumberOfDataElements(0), Capacity(0), DataElements(0),
              ByteOffset(0), Delimited(false),
              CharacterSet(vtkDICOMCharacterSet::ISO_IR_6),
              VRForXS(vtkDICOMVR::US) {}
@@ -119,6 +125,13 @@ public:
   void SetAttributeValue(const vtkDICOMTagPath& tag, const std::string& v);
 
   //! Get a data element from this item.
+  /*!
+   *  The returned reference is only valid until the item is modified.
+   *  Data elements are stored in a sorted array, so adding or removing
+   *  an element will move the other values in memory.  It is safe to
+   *  pass the reference to SetAttributeValue(), which makes a copy of
+   *  the value before modifying the item.
+   */
   const vtkDICOMValue &GetAttributeValue(vtkDICOMTag tag) const;
   const vtkDICOMValue &GetAttributeValue(const vtkDICOMTagPath &tag) const;
 
@@ -143,6 +156,12 @@ public:
   vtkDICOMDataElementIterator End() const {
     return (this->L ? &this->L->Tail : 0); }
 
+  //! Get a copy of the item whose values do not use a memory pool.
+  /*!
+   *  See vtkDICOMValue::GetUnpooledCopy() for more information.
+   */
+  vtkDICOMItem GetUnpooledCopy() const;
+
   //! Resolve a private tag, or return (ffff,ffff) if not resolved.
   /*!
    *  Private data elements are mobile, which means that different data
@@ -192,7 +211,10 @@ public:
 
 private:
   void FreeList();
-  vtkDICOMDataElement *NewDataElement(vtkDICOMDataElement **iter);
+  static int LowerBound(const List *l, vtkDICOMTag tag);
+  static void LinkDataElements(List *l, int first);
+  vtkDICOMDataElement *InsertDataElement(int i, vtkDICOMTag tag);
+  void RemoveDataElement(vtkDICOMDataElement *e);
   static void CopyList(const List *o, List *t);
   static void CopyDataElements(
     const vtkDICOMDataElement *begin, const vtkDICOMDataElement *end,
@@ -208,7 +230,7 @@ private:
   //! An invalid value, for when one is needed.
   static const vtkDICOMValue InvalidValue;
 
-  //! A linked list to hold the elements.
+  //! A sorted, linked array to hold the elements.
   List *L;
 };
 
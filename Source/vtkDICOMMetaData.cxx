@@ -22,33 +22,259 @@
 #include <vtkIntArray.h>
 
 #include <assert.h>
+#include <string.h>
 #include <vector>
 #include <utility>
 
 vtkStandardNewMacro(vtkDICOMMetaData);
 
-// The hash table size, must be a power of two
-#define METADATA_HASH_SIZE 512
+// The initial storage size, must be a power of two
+#define METADATA_INITIAL_SIZE 64
+
+namespace {
+
+// Hash a tag for the element table.  The low bits are used as the slot,
+// so the group and element must be mixed well: with ComputeHash(), the
+// tags of neighbouring groups fall into the same run of slots.
+inline unsigned int vtkDICOMMetaDataHash(vtkDICOMTag tag)
+{
+  unsigned int h = ((static_cast<unsigned int>(tag.GetGroup()) << 16) |
+                    tag.GetElement())*0x9E3779B1u;
+  return (h ^ (h >> 16));
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+// An index of the values in the functional group sequences, to allow
+// per-frame lookups without searching through all of the items.
+class vtkDICOMFunctionalGroupIndex
+{
+public:
+  // The frame number used for the SharedFunctionalGroupsSequence.
+  enum { SharedFrame = -1 };
+
+  // For each tag, the public value and the first private value.
+  struct Entry
+  {
+    unsigned int Key;
+    int Instance;
+    int Frame;
+    const vtkDICOMValue *Public;
+    const vtkDICOMValue *Private;
+  };
+
+  vtkDICOMFunctionalGroupIndex() : Table(0), Mask(0), Count(0) {}
+  ~vtkDICOMFunctionalGroupIndex() { delete [] this->Table; }
+
+  // Build the index for all instances in the meta data.
+  void Build(vtkDICOMMetaData *meta);
+
+  // Find the entry for a frame, or return null.
+  const Entry *Find(int idx, int frame, vtkDICOMTag tag) const;
+
+private:
+  static unsigned int Hash(unsigned int key, int idx, int frame) {
+    unsigned int h = key*0x9E3779B1u;
+    h ^= static_cast<unsigned int>(frame)*0x85EBCA6Bu;
+    h ^= static_cast<unsigned int>(idx)*0xC2B2AE35u;
+    return (h ^ (h >> 15)); }
+
+  static unsigned int MakeKey(vtkDICOMTag tag) {
+    return ((static_cast<unsigned int>(tag.GetGroup()) << 16) |
+            tag.GetElement()); }
+
+  void AddItem(int idx, int frame, const vtkDICOMItem& item);
+  Entry *FindOrInsert(int idx, int frame, vtkDICOMTag tag);
+  void Expand();
+
+  Entry *Table;
+  unsigned int Mask;
+  unsigned int Count;
+};
+
+//----------------------------------------------------------------------------
+void vtkDICOMFunctionalGroupIndex::Build(vtkDICOMMetaData *meta)
+{
+  int n = meta->GetNumberOfInstances();
+  for (int idx = 0; idx < n; idx++)
+    {
+    const vtkDICOMValue& shared =
+      meta->GetAttributeValue(idx, DC::SharedFunctionalGroupsSequence);
+    const vtkDICOMItem *items = shared.GetSequenceData();
+    if (items && shared.GetNumberOfValues() > 0)
+      {
+      this->AddItem(idx, SharedFrame, items[0]);
+      }
+
+    const vtkDICOMValue& perFrame =
+      meta->GetAttributeValue(idx, DC::PerFrameFunctionalGroupsSequence);
+    items = perFrame.GetSequenceData();
+    unsigned int m = (items ? perFrame.GetNumberOfValues() : 0);
+    for (unsigned int f = 0; f < m; f++)
+      {
+      this->AddItem(idx, static_cast<int>(f), items[f]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMFunctionalGroupIndex::AddItem(
+  int idx, int frame, const vtkDICOMItem& item)
+{
+  vtkDICOMDataElementIterator iter;
+  vtkDICOMDataElementIterator iterEnd = item.End();
+
+  // attributes in the item itself have the highest priority
+  for (iter = item.Begin(); iter != iterEnd; ++iter)
+    {
+    if (iter->GetValue().IsValid() && iter->GetTag().GetGroup() != 0)
+      {
+      Entry *e = this->FindOrInsert(idx, frame, iter->GetTag());
+      e->Public = &iter->GetValue();
+      }
+    }
+
+  // next are the attributes in the sequences within the item, where
+  // the first public value is used, or else the first private value
+  for (iter = item.Begin(); iter != iterEnd; ++iter)
+    {
+    const vtkDICOMValue &u = iter->GetValue();
+    const vtkDICOMItem *nested = u.GetSequenceData();
+    if (nested == 0 || u.GetNumberOfValues() != 1)
+      {
+      continue;
+      }
+    bool isPrivate = ((iter->GetTag().GetGroup() & 1) != 0);
+    vtkDICOMDataElementIterator jter = nested->Begin();
+    vtkDICOMDataElementIterator jterEnd = nested->End();
+    for (; jter != jterEnd; ++jter)
+      {
+      if (jter->GetValue().IsValid() && jter->GetTag().GetGroup() != 0)
+        {
+        Entry *e = this->FindOrInsert(idx, frame, jter->GetTag());
+        const vtkDICOMValue **vpp = (isPrivate ? &e->Private : &e->Public);
+        if (*vpp == 0)
+          {
+          *vpp = &jter->GetValue();
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMFunctionalGroupIndex::Entry *
+vtkDICOMFunctionalGroupIndex::FindOrInsert(
+  int idx, int frame, vtkDICOMTag tag)
+{
+  // keep the table at most half full
+  if (2*(this->Count + 1) > this->Mask + 1)
+    {
+    this->Expand();
+    }
+
+  unsigned int key = vtkDICOMFunctionalGroupIndex::MakeKey(tag);
+  unsigned int i = (vtkDICOMFunctionalGroupIndex::Hash(key, idx, frame) &
+                    this->Mask);
+  Entry *e;
+  while ((e = &this->Table[i])->Key != 0)
+    {
+    if (e->Key == key && e->Frame == frame && e->Instance == idx)
+      {
+      return e;
+      }
+    i = ((i + 1) & this->Mask);
+    }
+
+  e->Key = key;
+  e->Instance = idx;
+  e->Frame = frame;
+  this->Count++;
+  return e;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMFunctionalGroupIndex::Expand()
+{
+  unsigned int oldSize = (this->Table ? this->Mask + 1 : 0);
+  unsigned int newSize = (oldSize ? 2*oldSize : 256);
+  Entry *oldTable = this->Table;
+
+  // a key of zero marks an empty slot (group zero is never indexed)
+  this->Table = new Entry[newSize];
+  this->Mask = newSize - 1;
+  for (unsigned int i = 0; i < newSize; i++)
+    {
+    Entry *e = &this->Table[i];
+    e->Key = 0;
+    e->Instance = 0;
+    e->Frame = 0;
+    e->Public = 0;
+    e->Private = 0;
+    }
+
+  for (unsigned int j = 0; j < oldSize; j++)
+    {
+    const Entry *o = &oldTable[j];
+    if (o->Key != 0)
+      {
+      unsigned int i = (vtkDICOMFunctionalGroupIndex::Hash(
+        o->Key, o->Instance, o->Frame) & this->Mask);
+      while (this->Table[i].Key != 0)
+        {
+        i = ((i + 1) & this->Mask);
+        }
+      this->Table[i] = *o;
+      }
+    }
+
+  delete [] oldTable;
+}
+
+//----------------------------------------------------------------------------
+const vtkDICOMFunctionalGroupIndex::Entry *
+vtkDICOMFunctionalGroupIndex::Find(int idx, int frame, vtkDICOMTag tag) const
+{
+  if (this->Count == 0)
+    {
+    return 0;
+    }
+
+  unsigned int key = vtkDICOMFunctionalGroupIndex::MakeKey(tag);
+  unsigned int i = (vtkDICOMFunctionalGroupIndex::Hash(key, idx, frame) &
+                    this->Mask);
+  const Entry *e;
+  while ((e = &this->Table[i])->Key != 0)
+    {
+    if (e->Key == key && e->Frame == frame && e->Instance == idx)
+      {
+      return e;
+      }
+    i = ((i + 1) & this->Mask);
+    }
+
+  return 0;
+}
 
 //----------------------------------------------------------------------------
 // Constructor
 vtkDICOMMetaData::vtkDICOMMetaData()
 {
   this->NumberOfInstances = 1;
-  this->NumberOfDataElements = 0;
-  this->Table = NULL;
-  this->Head.Prev = NULL;
-  this->Head.Next = &this->Tail;
-  this->Tail.Prev = &this->Head;
-  this->Tail.Next = NULL;
+  this->Storage = new ElementStorage;
   this->FileIndexArray = NULL;
   this->FrameIndexArray = NULL;
+  this->UseValuePool = false;
+  this->ValuePool = NULL;
+  this->FunctionalGroupIndex = NULL;
 }
 
 // Destructor
 vtkDICOMMetaData::~vtkDICOMMetaData()
 {
-  this->Clear();
+  this->DiscardFunctionalGroupIndex();
+  vtkDICOMMetaData::FreeStorage(this->Storage);
   if (this->FileIndexArray)
     {
     this->FileIndexArray->Delete();
@@ -57,26 +283,110 @@ vtkDICOMMetaData::~vtkDICOMMetaData()
     {
     this->FrameIndexArray->Delete();
     }
+  if (this->ValuePool)
+    {
+    this->ValuePool->Release();
+    }
 }
 
 //----------------------------------------------------------------------------
 void vtkDICOMMetaData::Clear()
 {
-  vtkDICOMDataElement **htable = this->Table;
+  this->DiscardFunctionalGroupIndex();
+  if (this->Storage->ReferenceCount == 1)
+    {
+    delete [] this->Storage->Elements;
+    delete [] this->Storage->Table;
+    this->Storage->NumberOfDataElements = 0;
+    this->Storage->Elements = NULL;
+    this->Storage->Capacity = 0;
+    this->Storage->Table = NULL;
+    this->Storage->Head.Next = &this->Storage->Tail;
+    this->Storage->Tail.Prev = &this->Storage->Head;
+    }
+  else
+    {
+    // the storage is shared, so leave it to the other owners
+    vtkDICOMMetaData::FreeStorage(this->Storage);
+    this->Storage = new ElementStorage;
+    }
 
-  if (htable)
+  // the pool memory can be reused if none of its values were kept
+  if (this->ValuePool)
     {
-    for (unsigned int i = 0; i < METADATA_HASH_SIZE; i++)
+    this->ValuePool = this->ValuePool->Recycle();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMMetaData::FreeStorage(ElementStorage *s)
+{
+  if (--s->ReferenceCount == 0)
+    {
+    delete [] s->Elements;
+    delete [] s->Table;
+    delete s;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Make a copy of the storage, unless this object is the sole owner.
+void vtkDICOMMetaData::UnshareStorage()
+{
+  ElementStorage *o = this->Storage;
+  if (o->ReferenceCount == 1)
+    {
+    return;
+    }
+
+  ElementStorage *t = new ElementStorage;
+  unsigned int n = static_cast<unsigned int>(o->NumberOfDataElements);
+  unsigned int c = o->Capacity;
+  if (c != 0)
+    {
+    // the copy has the same layout, so the hash table can be copied
+    t->Elements = new vtkDICOMDataElement[c];
+    t->Table = new unsigned int[2*c];
+    t->Capacity = c;
+    t->NumberOfDataElements = o->NumberOfDataElements;
+    memcpy(t->Table, o->Table, 2*c*sizeof(unsigned int));
+
+    // copy the elements and translate the links into the new storage
+    const vtkDICOMDataElement *optr = o->Elements;
+    vtkDICOMDataElement *tptr = t->Elements;
+    for (unsigned int j = 0; j < n; j++)
+      {
+      tptr[j].Tag = optr[j].Tag;
+      tptr[j].Value = optr[j].Value;
+      const vtkDICOMDataElement *next = optr[j].Next;
+      const vtkDICOMDataElement *prev = optr[j].Prev;
+      tptr[j].Next = (next == &o->Tail ? &t->Tail : tptr + (next - optr));
+      tptr[j].Prev = (prev == &o->Head ? &t->Head : tptr + (prev - optr));
+
+      // per-instance values are modified in place, so they must be copied
+      const vtkDICOMValue *vptr = optr[j].Value.GetMultiplexData();
+      if (vptr)
+        {
+        unsigned int m = optr[j].Value.GetNumberOfValues();
+        vtkDICOMValue *nvptr = tptr[j].Value.AllocateMultiplexData(
+          optr[j].Value.GetVR(), m);
+        for (unsigned int i = 0; i < m; i++)
+          {
+          nvptr[i] = vptr[i];
+          }
+        }
+      }
+    if (n > 0)
       {
-      delete [] htable[i];
+      const vtkDICOMDataElement *first = o->Head.Next;
+      const vtkDICOMDataElement *last = o->Tail.Prev;
+      t->Head.Next = tptr + (first - optr);
+      t->Tail.Prev = tptr + (last - optr);
       }
-    delete [] htable;
     }
 
-  this->NumberOfDataElements = 0;
-  this->Table = NULL;
-  this->Head.Next = &this->Tail;
-  this->Tail.Prev = &this->Head;
+  vtkDICOMMetaData::FreeStorage(o);
+  this->Storage = t;
 }
 
 //----------------------------------------------------------------------------
@@ -99,7 +409,7 @@ void vtkDICOMMetaData::Initialize()
 //----------------------------------------------------------------------------
 void vtkDICOMMetaData::SetNumberOfInstances(int n)
 {
-  if (this->Table != NULL)
+  if (this->Storage->Table != NULL)
     {
     vtkErrorMacro("SetNumberOfInstances: Cannot set NumberOfInstances after "
                   "attributes have been added");
@@ -110,6 +420,32 @@ void vtkDICOMMetaData::SetNumberOfInstances(int n)
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkDICOMMetaData::SetUseValuePool(bool b)
+{
+  if (b != this->UseValuePool)
+    {
+    this->UseValuePool = b;
+    if (!b && this->ValuePool)
+      {
+      // values that are still in use will keep the pool alive
+      this->ValuePool->Release();
+      this->ValuePool = NULL;
+      }
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMValue::Pool *vtkDICOMMetaData::GetValuePool()
+{
+  if (this->UseValuePool && this->ValuePool == NULL)
+    {
+    this->ValuePool = vtkDICOMValue::Pool::New();
+    }
+  return this->ValuePool;
+}
+
 //----------------------------------------------------------------------------
 void vtkDICOMMetaData::SetFileIndexArray(vtkIntArray *a)
 {
@@ -150,35 +486,72 @@ void vtkDICOMMetaData::SetFrameIndexArray(vtkIntArray *a)
 // Erase an element from the hash table
 void vtkDICOMMetaData::RemoveAttribute(vtkDICOMTag tag)
 {
-  unsigned int m = METADATA_HASH_SIZE - 1;
-  unsigned int i = (tag.ComputeHash() & m);
-  vtkDICOMDataElement **htable = this->Table;
-  vtkDICOMDataElement *hptr;
+  if (this->FindDataElement(tag) == NULL)
+    {
+    return;
+    }
+
+  this->DiscardFunctionalGroupIndex();
+  this->UnshareStorage();
+
+  unsigned int *htable = this->Storage->Table;
 
-  if (htable && (hptr = htable[i]) != NULL)
+  unsigned int m = 2*this->Storage->Capacity - 1;
+  unsigned int i = (vtkDICOMMetaDataHash(tag) & m);
+  unsigned int k;
+  while ((k = htable[i]) != 0)
     {
-    while (hptr->Next != 0)
+    vtkDICOMDataElement *hptr = &this->Storage->Elements[k-1];
+    if (hptr->Tag == tag)
       {
-      if (hptr->Tag == tag)
+      // remove from the linked list
+      hptr->Next->Prev = hptr->Prev;
+      hptr->Prev->Next = hptr->Next;
+
+      // remove from the hash table, and shift back any entries that
+      // were displaced from their home slot by the removed entry
+      htable[i] = 0;
+      unsigned int j = i;
+      for (;;)
         {
-        // remove from the linked list
-        hptr->Next->Prev = hptr->Prev;
-        hptr->Prev->Next = hptr->Next;
-        // remove from the hash table
-        hptr[0] = hptr[1];
-        while (hptr->Next != 0)
+        j = ((j + 1) & m);
+        unsigned int l = htable[j];
+        if (l == 0)
           {
-          // adjust links as necessary
-          hptr->Prev->Next = hptr;
-          hptr->Next->Prev = hptr;
-          hptr++;
-          hptr[0] = hptr[1];
+          break;
           }
-        this->NumberOfDataElements--;
-        break;
+        unsigned int h =
+          (vtkDICOMMetaDataHash(this->Storage->Elements[l-1].Tag) & m);
+        if (((i - h) & m) < ((j - h) & m))
+          {
+          htable[i] = l;
+          htable[j] = 0;
+          i = j;
+          }
+        }
+
+      // move the last element into the gap to keep the storage packed
+      unsigned int n =
+        static_cast<unsigned int>(this->Storage->NumberOfDataElements);
+      if (k != n)
+        {
+        vtkDICOMDataElement *lptr = &this->Storage->Elements[n-1];
+        *hptr = *lptr;
+        hptr->Next->Prev = hptr;
+        hptr->Prev->Next = hptr;
+        j = (vtkDICOMMetaDataHash(lptr->Tag) & m);
+        while (htable[j] != n)
+          {
+          j = ((j + 1) & m);
+          }
+        htable[j] = k;
+        hptr = lptr;
         }
-      hptr++;
+      *hptr = vtkDICOMDataElement();
+      this->Storage->NumberOfDataElements--;
+      break;
       }
+    i = ((i + 1) & m);
     }
 }
 
@@ -187,20 +560,20 @@ void vtkDICOMMetaData::RemoveAttribute(vtkDICOMTag tag)
 vtkDICOMDataElement *vtkDICOMMetaData::FindDataElement(
   vtkDICOMTag tag)
 {
-  unsigned int m = METADATA_HASH_SIZE - 1;
-  unsigned int i = (tag.ComputeHash() & m);
-  vtkDICOMDataElement **htable = this->Table;
-  vtkDICOMDataElement *hptr;
-
-  if (htable && (hptr = htable[i]) != NULL)
+  unsigned int *htable = this->Storage->Table;
+  if (htable != NULL)
     {
-    while (hptr->Next != 0)
+    unsigned int m = 2*this->Storage->Capacity - 1;
+    unsigned int i = (vtkDICOMMetaDataHash(tag) & m);
+    unsigned int k;
+    while ((k = htable[i]) != 0)
       {
+      vtkDICOMDataElement *hptr = &this->Storage->Elements[k-1];
       if (hptr->Tag == tag)
         {
         return hptr;
         }
-      hptr++;
+      i = ((i + 1) & m);
       }
     }
 
@@ -269,7 +642,7 @@ const vtkDICOMValue *vtkDICOMMetaData::FindAttributeValue(
 const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(vtkDICOMTag tag)
 {
   const vtkDICOMValue *vptr = this->FindAttributeValue(0, tag);
-  return (vptr ? *vptr : this->Tail.Value);
+  return (vptr ? *vptr : this->Storage->Tail.Value);
 }
 
 //----------------------------------------------------------------------------
@@ -277,7 +650,7 @@ const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   int idx, vtkDICOMTag tag)
 {
   const vtkDICOMValue *vptr = this->FindAttributeValue(idx, tag);
-  return (vptr ? *vptr : this->Tail.Value);
+  return (vptr ? *vptr : this->Storage->Tail.Value);
 }
 
 //----------------------------------------------------------------------------
@@ -285,7 +658,7 @@ const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   const vtkDICOMTagPath &tagpath)
 {
   const vtkDICOMValue *vptr = this->FindAttributeValue(0, tagpath);
-  return (vptr ? *vptr : this->Tail.Value);
+  return (vptr ? *vptr : this->Storage->Tail.Value);
 }
 
 //----------------------------------------------------------------------------
@@ -293,13 +666,18 @@ const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   int idx, const vtkDICOMTagPath &tagpath)
 {
   const vtkDICOMValue *vptr = this->FindAttributeValue(idx, tagpath);
-  return (vptr ? *vptr : this->Tail.Value);
+  return (vptr ? *vptr : this->Storage->Tail.Value);
 }
 
 //----------------------------------------------------------------------------
 const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   int idx, int frame, const vtkDICOMTagPath &tagpath)
 {
+  if (!tagpath.HasTail())
+    {
+    return this->GetAttributeValue(idx, frame, tagpath.GetHead());
+    }
+
   // if either of these is present in an enhanced DICOM file, then they
   // will be searched before the root is searched
   const DC::EnumType fgs[2] = {
@@ -366,14 +744,80 @@ const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   // try private value (see above) if attribute wasn't found
   vptr = (vptr ? vptr : privateValue);
 
-  return (vptr ? *vptr : this->Tail.Value);
+  return (vptr ? *vptr : this->Storage->Tail.Value);
 }
 
 //----------------------------------------------------------------------------
 const vtkDICOMValue &vtkDICOMMetaData::GetAttributeValue(
   int idx, int frame, vtkDICOMTag tag)
 {
-  return this->GetAttributeValue(idx, frame, vtkDICOMTagPath(tag));
+  // use the index to search PerFrame and then Shared functional groups,
+  // in the same order as for the tag path (see above)
+  const vtkDICOMFunctionalGroupIndex *index = this->GetFunctionalGroupIndex();
+  const vtkDICOMFunctionalGroupIndex::Entry *e;
+  const vtkDICOMValue *privateValue = 0;
+
+  if (frame >= 0 && (e = index->Find(idx, frame, tag)) != 0)
+    {
+    if (e->Public)
+      {
+      return *e->Public;
+      }
+    privateValue = e->Private;
+    }
+
+  e = index->Find(idx, vtkDICOMFunctionalGroupIndex::SharedFrame, tag);
+  if (e != 0)
+    {
+    if (e->Public)
+      {
+      return *e->Public;
+      }
+    privateValue = (privateValue ? privateValue : e->Private);
+    }
+
+  // search root last of all
+  const vtkDICOMValue *vptr = this->FindAttributeValue(idx, tag);
+
+  // try private value if attribute wasn't found
+  vptr = (vptr ? vptr : privateValue);
+
+  return (vptr ? *vptr : this->Storage->Tail.Value);
+}
+
+//----------------------------------------------------------------------------
+const vtkDICOMFunctionalGroupIndex *vtkDICOMMetaData::GetFunctionalGroupIndex()
+{
+  vtkDICOMFunctionalGroupIndex *index =
+    vtkDICOMAtomicPointer::Load(&this->FunctionalGroupIndex);
+
+  if (index == 0)
+    {
+    // several threads might build the index at the same time, in which
+    // case only the first one to finish is kept
+    index = new vtkDICOMFunctionalGroupIndex;
+    index->Build(this);
+    vtkDICOMFunctionalGroupIndex *other =
+      vtkDICOMAtomicPointer::CompareAndSwap(&this->FunctionalGroupIndex,
+        static_cast<vtkDICOMFunctionalGroupIndex *>(0), index);
+    if (other != 0)
+      {
+      delete index;
+      index = other;
+      }
+    }
+
+  return index;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMMetaData::DiscardFunctionalGroupIndex()
+{
+  if (this->FunctionalGroupIndex)
+    {
+    delete this->FunctionalGroupIndex;
+    this->FunctionalGroupIndex = NULL;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -430,81 +874,113 @@ int vtkDICOMMetaData::GetFrameIndex(int sliceIdx, int compIdx, int numComp)
   return this->FrameIndexArray->GetValue(sliceIdx*n + compIdx*n/numComp);
 }
 
+//----------------------------------------------------------------------------
+// Reallocate the elements with twice the capacity.
+void vtkDICOMMetaData::ExpandStorage()
+{
+  unsigned int n =
+    static_cast<unsigned int>(this->Storage->NumberOfDataElements);
+  unsigned int c = 2*this->Storage->Capacity;
+  if (c == 0)
+    {
+    c = METADATA_INITIAL_SIZE;
+    }
+
+  vtkDICOMDataElement *oldptr = this->Storage->Elements;
+  vtkDICOMDataElement *hptr = new vtkDICOMDataElement[c];
+  this->Storage->Elements = hptr;
+  this->Storage->Capacity = c;
+  // copy the old elements
+  for (unsigned int j = 0; j < n; j++)
+    {
+    *hptr = oldptr[j];
+    // link the new element into the list
+    hptr->Next->Prev = hptr;
+    hptr->Prev->Next = hptr;
+    hptr++;
+    }
+  delete [] oldptr;
+
+  // the hash table has twice as many slots as there are elements
+  unsigned int m = 2*c - 1;
+  unsigned int *htable = new unsigned int[2*c];
+  delete [] this->Storage->Table;
+  this->Storage->Table = htable;
+  for (unsigned int i = 0; i <= m; i++)
+    {
+    htable[i] = 0;
+    }
+  for (unsigned int k = 1; k <= n; k++)
+    {
+    unsigned int i =
+      (vtkDICOMMetaDataHash(this->Storage->Elements[k-1].Tag) & m);
+    while (htable[i] != 0)
+      {
+      i = ((i + 1) & m);
+      }
+    htable[i] = k;
+    }
+}
+
 //----------------------------------------------------------------------------
 // Return a reference to the element within the hash table, which can
 // be used to insert a new value.
 vtkDICOMDataElement *vtkDICOMMetaData::FindDataElementOrInsert(
   vtkDICOMTag tag)
 {
-  unsigned int m = METADATA_HASH_SIZE - 1;
-  unsigned int i = (tag.ComputeHash() & m);
-  vtkDICOMDataElement **htable = this->Table;
-  vtkDICOMDataElement *hptr;
+  // the caller will modify the element, so the index is out of date
+  this->DiscardFunctionalGroupIndex();
+  this->UnshareStorage();
 
-  if (htable == NULL)
+  vtkDICOMDataElement *hptr = this->FindDataElement(tag);
+  if (hptr != NULL)
     {
-    // allocate the hash table
-    m = METADATA_HASH_SIZE;
-    htable = new vtkDICOMDataElement *[METADATA_HASH_SIZE];
-    this->Table = htable;
-    do { *htable++ = NULL; } while (--m);
-    htable = this->Table;
+    return hptr;
     }
 
-  hptr = htable[i];
+  unsigned int n =
+    static_cast<unsigned int>(this->Storage->NumberOfDataElements);
+  if (n == this->Storage->Capacity)
+    {
+    this->ExpandStorage();
+    }
 
-  if (hptr == NULL)
+  // find an empty slot in the hash table
+  unsigned int *htable = this->Storage->Table;
+  unsigned int m = 2*this->Storage->Capacity - 1;
+  unsigned int i = (vtkDICOMMetaDataHash(tag) & m);
+  while (htable[i] != 0)
     {
-    hptr = new vtkDICOMDataElement[4];
-    htable[i] = hptr;
+    i = ((i + 1) & m);
     }
-  else if (hptr->Next != 0)
+  htable[i] = n + 1;
+  hptr = &this->Storage->Elements[n];
+  hptr->Tag = tag;
+
+  // insert into the linked list, usually at the tail
+  vtkDICOMDataElement *tptr = this->Storage->Tail.Prev;
+  if (n > 0 && tag < tptr->GetTag())
     {
-    // see if item is already there
-    unsigned int n = 0;
-    do
+    // start from the element that was added last (or that was moved
+    // to the end of the storage), since elements that are inserted one
+    // after another are usually close together in the list
+    tptr = &this->Storage->Elements[n-1];
+    while (tptr->Next != &this->Storage->Tail &&
+           tptr->Next->GetTag() < tag)
       {
-      if (hptr->Tag == tag)
-        {
-        return hptr;
-        }
-      n++;
-      hptr++;
+      tptr = tptr->Next;
       }
-    while (hptr->Next != 0);
-
-    // if n+1 is a power of two, double allocated space
-    if (n > 2 && (n & (n+1)) == 0)
+    while (tag < tptr->GetTag())
       {
-      vtkDICOMDataElement *oldptr = htable[i];
-      hptr = new vtkDICOMDataElement[2*(n+1)];
-      htable[i] = hptr;
-      // copy the old list
-      for (unsigned int j = 0; j < n; j++)
-        {
-        *hptr = oldptr[j];
-        // link the new element into the list
-        hptr->Next->Prev = hptr;
-        hptr->Prev->Next = hptr;
-        hptr++;
-        }
-      delete [] oldptr;
+      tptr = tptr->Prev;
       }
     }
 
-  // insert into the linked list
-  vtkDICOMDataElement *tptr = &this->Tail;
-  do
-    {
-    tptr = tptr->Prev;
-    }
-  while (tag < tptr->GetTag());
-
   hptr->Prev = tptr;
   hptr->Next = tptr->Next;
   hptr->Prev->Next = hptr;
   hptr->Next->Prev = hptr;
-  this->NumberOfDataElements++;
+  this->Storage->NumberOfDataElements++;
 
   return hptr;
 }
@@ -921,11 +1397,13 @@ void vtkDICOMMetaData::CopyAttributes(vtkDICOMMetaData *o)
 
   if (o != 0 && o != this)
     {
-    vtkDICOMDataElement **otable = o->Table;
-    if (otable != 0)
+    // values from the source's pool would keep the whole pool alive
+    bool unpool = (o->ValuePool != 0);
+
+    if (o->Storage->Table != 0)
       {
-      const vtkDICOMDataElement *iter = o->Head.Next;
-      const vtkDICOMDataElement *iterEnd = &o->Tail;
+      const vtkDICOMDataElement *iter = o->Storage->Head.Next;
+      const vtkDICOMDataElement *iterEnd = &o->Storage->Tail;
       while (iter != iterEnd)
         {
         // if this is a per-instance element, then make a copy of it
@@ -934,7 +1412,7 @@ void vtkDICOMMetaData::CopyAttributes(vtkDICOMMetaData *o)
           {
           vtkDICOMDataElement *e = this->FindDataElementOrInsert(iter->Tag);
           e->Tag = iter->Tag;
-          e->Value = iter->Value;
+          e->Value = (unpool ? iter->Value.GetUnpooledCopy() : iter->Value);
           }
         else if (this->NumberOfInstances == o->NumberOfInstances)
           {
@@ -944,7 +1422,7 @@ void vtkDICOMMetaData::CopyAttributes(vtkDICOMMetaData *o)
             iter->Value.GetVR(), this->NumberOfInstances);
           for (int i = 0; i < this->NumberOfInstances; i++)
             {
-            nvptr[i] = vptr[i];
+            nvptr[i] = (unpool ? vptr[i].GetUnpooledCopy() : vptr[i]);
             }
           }
         iter = iter->Next;
@@ -962,8 +1440,11 @@ void vtkDICOMMetaData::ShallowCopy(vtkDataObject *source)
     this->Initialize();
     if (o != 0)
       {
+      // share the storage, it will be copied before it is modified
       this->NumberOfInstances = o->NumberOfInstances;
-      this->CopyAttributes(o);
+      vtkDICOMMetaData::FreeStorage(this->Storage);
+      this->Storage = o->Storage;
+      ++this->Storage->ReferenceCount;
       this->SetFileIndexArray(o->FileIndexArray);
       this->SetFrameIndexArray(o->FrameIndexArray);
       }
@@ -1167,7 +1648,9 @@ void vtkDICOMMetaData::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "NumberOfInstances: "
      << this->NumberOfInstances << "\n";
   os << indent << "NumberOfDataElements: "
-     << this->NumberOfDataElements << "\n";
+     << this->Storage->NumberOfDataElements << "\n";
   os << indent << "FileIndexArray: " << this->FileIndexArray << "\n";
   os << indent << "FrameIndexArray: " << this->FrameIndexArray << "\n";
+  os << indent << "UseValuePool: "
+     << (this->UseValuePool ? "On\n" : "Off\n");
 }
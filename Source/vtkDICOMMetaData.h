@@ -23,12 +23,16 @@
 
 class vtkIntArray;
 class vtkDICOMTagPath;
+class vtkDICOMFunctionalGroupIndex;
 
 //! A container class for DICOM metadata.
 /*!
- *  The vtkDICOMMetaData object stores DICOM metadata in a hash table
- *  for efficient access.  One vtkDICOMMetaData object can store the
- *  metadata for a series of DICOM images.
+ *  The vtkDICOMMetaData object stores DICOM metadata in a contiguous
+ *  array, indexed by a hash table for efficient access.  One
+ *  vtkDICOMMetaData object can store the metadata for a series of
+ *  DICOM images.  The storage is reference counted, so that a
+ *  ShallowCopy() can share it, and it is copied the first time
+ *  that either of the objects that share it is modified.
  */
 class VTK_DICOM_EXPORT vtkDICOMMetaData : public vtkDataObject
 {
@@ -61,15 +65,15 @@ public:
 
   //! Get the number of data elements that are present.
   int GetNumberOfDataElements() {
-    return this->NumberOfDataElements; }
+    return this->Storage->NumberOfDataElements; }
 
   //! Get an iterator for the list of data elements.
   vtkDICOMDataElementIterator Begin() {
-    return this->Head.Next; }
+    return this->Storage->Head.Next; }
 
   //! Get an end iterator for the list of data elements.
   vtkDICOMDataElementIterator End() {
-    return &this->Tail; }
+    return &this->Storage->Tail; }
 
   //! Get the iterator for a specific data element.
   /*!
@@ -77,7 +81,7 @@ public:
    */
   vtkDICOMDataElementIterator Find(vtkDICOMTag tag) {
     vtkDICOMDataElement *e = this->FindDataElement(tag);
-    return (e != 0 ? e : &this->Tail); }
+    return (e != 0 ? e : &this->Storage->Tail); }
 
   //! Check whether an attribute is present in the metadata.
   bool HasAttribute(vtkDICOMTag tag);
@@ -117,6 +121,9 @@ public:
    *  SharedFunctionalGroupsSequence, and finally in the root.
    *  It can be used on either multi-frame or single-frame files.
    *  The frame index is counted from zero to NumberOfFrames-1.
+   *  The first call builds an index of the functional groups, so
+   *  that further lookups do not have to search the items.  The index
+   *  is discarded whenever an attribute is added or removed.
    */
   const vtkDICOMValue &GetAttributeValue(int idx, int frame, vtkDICOMTag tag);
   const vtkDICOMValue &GetAttributeValue(
@@ -235,11 +242,38 @@ public:
    *  If the source has the same NumberOfInstances as this, then the
    *  attributes are copied on an instance-by-instance basis.  Otherwise,
    *  attributes are only copied from the source if they have the same
-   *  value for all instances.
+   *  value for all instances.  If the source allocated its values from
+   *  a pool (see SetUseValuePool()), then the values are copied out of
+   *  the pool, so that this object will not keep the pool alive.
    */
   void CopyAttributes(vtkDICOMMetaData *source);
 
+  //! Allocate the values from a memory pool while parsing.
+  /*!
+   *  If this is on, then the parser will allocate the values that it
+   *  reads into this object from a memory pool that is owned by this
+   *  object, instead of allocating each value separately.  The pool is
+   *  freed all at once when this object is cleared, which is much faster
+   *  when many headers are read and then discarded.  Values that are
+   *  kept after this object is cleared remain valid, but each of them
+   *  keeps the memory for the whole pool alive.  The default is off.
+   */
+  void SetUseValuePool(bool b);
+  bool GetUseValuePool() { return this->UseValuePool; }
+
+  //! Get the pool that values should be allocated from.
+  /*!
+   *  This is used by the parser, and returns null if UseValuePool is off.
+   */
+  vtkDICOMValue::Pool *GetValuePool();
+
   //! DataObject interface function.
+  /*!
+   *  A ShallowCopy() shares the attributes with the source, rather than
+   *  copying them, so it takes the same time regardless of the number of
+   *  attributes and instances.  The attributes are copied the first time
+   *  that either the source or the copy is modified.
+   */
   void ShallowCopy(vtkDataObject *source);
   void DeepCopy(vtkDataObject *source);
 
@@ -253,6 +287,12 @@ protected:
   //! Find a tag, value pair or insert a pair if not found.
   vtkDICOMDataElement *FindDataElementOrInsert(vtkDICOMTag tag);
 
+  //! Double the storage for data elements, and rebuild the hash table.
+  void ExpandStorage();
+
+  //! Copy the storage if it is shared, so that it can be modified.
+  void UnshareStorage();
+
   //! Find or create the sequence at the head of the tagpath.
   int FindItemsOrInsert(
     int idx, bool useidx, const vtkDICOMTagPath& tagpath,
@@ -268,21 +308,44 @@ protected:
   const vtkDICOMValue *FindAttributeValue(
     int idx, const vtkDICOMTagPath& tagpath);
 
-private:
-  //! The number of DICOM files.
-  int NumberOfInstances;
+  //! Get the index for per-frame lookups, build it if necessary.
+  const vtkDICOMFunctionalGroupIndex *GetFunctionalGroupIndex();
 
-  //! The lookup table for the metadata.
-  vtkDICOMDataElement **Table;
+  //! Discard the index for per-frame lookups.
+  void DiscardFunctionalGroupIndex();
 
-  //! Links to the first data element.
-  vtkDICOMDataElement Head;
+private:
+  //! A reference counted container for the data elements.
+  /*!
+   *  The data elements are stored in a contiguous array that is indexed
+   *  by a hash table, and they are linked together (from Head to Tail)
+   *  in order of increasing tag.
+   */
+  struct ElementStorage
+  {
+    vtkDICOMDataElement Head;
+    vtkDICOMDataElement Tail;
+    vtkDICOMReferenceCount ReferenceCount;
+    int NumberOfDataElements;
+    unsigned int Capacity;
+    vtkDICOMDataElement *Elements;
+    unsigned int *Table;
+
+    ElementStorage() : Head(), Tail(), ReferenceCount(1),
+                       NumberOfDataElements(0), Capacity(0),
+                       Elements(0), Table(0) {
+      this->Head.Next = &this->Tail;
+      this->Tail.Prev = &this->Head; }
+  };
+
+  //! Release a reference to the storage, and free it if unused.
+  static void FreeStorage(ElementStorage *s);
 
-  //! Links to the last data element.
-  vtkDICOMDataElement Tail;
+  //! The number of DICOM files.
+  int NumberOfInstances;
 
-  //! The number of data elements.
-  int NumberOfDataElements;
+  //! The storage for the data elements, which is never NULL.
+  ElementStorage *Storage;
 
   //! An array to map slices and components to files.
   vtkIntArray *FileIndexArray;
@@ -290,6 +353,15 @@ private:
   //! An array to map slices and components to frames.
   vtkIntArray *FrameIndexArray;
 
+  //! Whether to allocate values from the pool.
+  bool UseValuePool;
+
+  //! The pool, created when it is first needed.
+  vtkDICOMValue::Pool *ValuePool;
+
+  //! The index for per-frame lookups, created when it is first needed.
+  vtkDICOMFunctionalGroupIndex *FunctionalGroupIndex;
+
   vtkDICOMMetaData(const vtkDICOMMetaData&);  // Not implemented.
   void operator=(const vtkDICOMMetaData&);  // Not implemented.
 };
@@ -12,11 +12,14 @@
 
 =========================================================================*/
 #include "vtkDICOMParser.h"
+#include "vtkDICOMParserVisitor.h"
+#include "vtkDICOMValueMatcher.h"
 #include "vtkDICOMDictionary.h"
 #include "vtkDICOMFile.h"
 #include "vtkDICOMMetaData.h"
 #include "vtkDICOMSequence.h"
 #include "vtkDICOMItem.h"
+#include "vtkDICOMUtilities.h"
 
 #include <vtkObjectFactory.h>
 #include <vtkUnsignedShortArray.h>
@@ -27,11 +30,11 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <algorithm>
 
 vtkStandardNewMacro(vtkDICOMParser);
 vtkCxxSetObjectMacro(vtkDICOMParser, MetaData, vtkDICOMMetaData);
-vtkCxxSetObjectMacro(vtkDICOMParser, Query, vtkDICOMMetaData);
 vtkCxxSetObjectMacro(vtkDICOMParser, Groups, vtkUnsignedShortArray);
 
 /*----------------------------------------------------------------------------
@@ -50,15 +53,44 @@ The vtkDICOMParser utilizes the DefaultDecoder, LittleEndianDecoder,
 or the BigEndianDecoder depending on the transfer syntax.
 ----------------------------------------------------------------------------*/
 
+//----------------------------------------------------------------------------
+// The query values, after they have been prepared for matching.  These
+// are kept by the parser so that each query value is prepared just once,
+// rather than once for every file that is parsed.
+class vtkDICOMParser::MatcherMap :
+  public std::map<const vtkDICOMValue *, vtkDICOMValueMatcher>
+{
+};
+
+//----------------------------------------------------------------------------
 class vtkDICOMParserInternalFriendship
 {
 public:
+  static const vtkDICOMValueMatcher& GetQueryMatcher(
+    vtkDICOMParser *parser, const vtkDICOMValue& query)
+  {
+    // the query value is stored in the matcher, so if the query has been
+    // changed since the matcher was made, the values will differ
+    vtkDICOMValueMatcher& matcher = (*parser->Matchers)[&query];
+    if (matcher.GetQuery() != query)
+      {
+      matcher.SetQuery(query);
+      }
+    return matcher;
+  }
+
   static bool FillBuffer(vtkDICOMParser *parser,
     const unsigned char* &cp, const unsigned char* &ep)
   {
     return parser->FillBuffer(cp, ep);
   }
 
+  static bool SkipBuffer(vtkDICOMParser *parser,
+    const unsigned char* &cp, const unsigned char* &ep, vtkTypeInt64 n)
+  {
+    return parser->SkipBuffer(cp, ep, n);
+  }
+
   static vtkTypeInt64 GetBytesRemaining(vtkDICOMParser *parser,
     const unsigned char *cp, const unsigned char *ep)
   {
@@ -319,6 +351,14 @@ public:
     const unsigned char* &cp, const unsigned char* &ep,
     unsigned int l, vtkDICOMTag delimiter) = 0;
 
+  // Report l bytes of data, or until delimiter tag found, to the
+  // visitor.  The delimiter is used the same as for ReadElements.
+  // The return value is false if the visitor stopped the parse, or
+  // if an error occurred.
+  virtual bool VisitElements(
+    const unsigned char* &cp, const unsigned char* &ep,
+    unsigned int l, vtkDICOMTag delimiter) = 0;
+
   // Peek ahead to see what the next element is.
   virtual vtkDICOMTag Peek(
     const unsigned char* &cp, const unsigned char* &ep) = 0;
@@ -376,11 +416,25 @@ public:
   // Finish the query (check for unused keys that must match).
   bool FinishQuery();
 
+  // Returns true if the element must be stored even when a visitor is
+  // used, because it is needed to decode the elements that follow.
+  static bool IsContextTag(vtkDICOMTag tag);
+
+  // Give "n" bytes of data to the visitor, or skip them if the visitor
+  // returns Skip.  Returns false if the visitor returns Stop, or if the
+  // end of the file is reached.
+  bool VisitData(
+    const unsigned char* &cp, const unsigned char* &ep, size_t n);
+
 protected:
   // Constructor that initializes all of the members.
   DecoderBase(vtkDICOMParser *parser, vtkDICOMMetaData *data, int idx) :
     Parser(parser), BaseContext(data,idx), Item(0), MetaData(data),
+    ValuePool(data ? data->GetValuePool() : 0),
     Index(idx), ImplicitVR(false),
+    DeferredValueThreshold(parser->GetDeferredValueThreshold()),
+    Visitor(parser->GetVisitor()),
+    StopOnQueryFailure(parser->GetStopOnQueryFailure()),
     HasQuery(false), QueryMatched(false),
     LastVL(0) { this->Context = &this->BaseContext; }
 
@@ -396,10 +450,18 @@ protected:
   vtkDICOMItem *Item;
   // the metadata object to read the data into
   vtkDICOMMetaData *MetaData;
+  // the pool to allocate the values from (null to use the heap)
+  vtkDICOMValue::Pool *ValuePool;
   // the instance index to use with the meta data
   int Index;
   // if this is set, then VRs are implicit
   bool ImplicitVR;
+  // larger values than this are read from the file only when needed
+  unsigned int DeferredValueThreshold;
+  // the visitor to report the elements to, instead of storing them
+  vtkDICOMParserVisitor *Visitor;
+  // stop reading as soon as the query fails to match
+  bool StopOnQueryFailure;
   // the query to apply while reading the data
   bool HasQuery;
   bool QueryMatched;
@@ -478,6 +540,34 @@ public:
     const unsigned char* &cp, const unsigned char* &ep,
     unsigned int l, vtkDICOMTag delimiter, size_t &bytesRead);
 
+  // Report l bytes of data, or until delimiter tag found, to the
+  // visitor.  The delimiter is used the same as for ReadElements.
+  bool VisitElements(
+    const unsigned char* &cp, const unsigned char* &ep,
+    unsigned int l, vtkDICOMTag delimiter)
+  {
+    size_t bytesRead;
+    return VisitElements(cp, ep, l, delimiter, bytesRead);
+  }
+
+  // A VisitElements that returns the number of bytes read.
+  bool VisitElements(
+    const unsigned char* &cp, const unsigned char* &ep,
+    unsigned int l, vtkDICOMTag delimiter, size_t &bytesRead);
+
+  // Report the items of a sequence, or the fragments of encapsulated
+  // data, to the visitor.  The number of bytes read is returned in l.
+  bool VisitItems(
+    const unsigned char* &cp, const unsigned char* &ep,
+    vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl, size_t &l);
+
+  // Report a value that is not a sequence to the visitor.  If the value
+  // is needed for decoding, then also store it.
+  bool VisitValue(
+    const unsigned char* &cp, const unsigned char* &ep,
+    vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl,
+    vtkDICOMParserVisitor::Action action);
+
   // A SkipElements that copies skipped bytes into value "v".
   // This method is used when parsing encapsulated data, it simply
   // reads the encapsulated data into the value as raw bytes.
@@ -857,7 +947,8 @@ bool DecoderBase::QueryMatches(const vtkDICOMValue& v)
         ((tag.GetGroup() & 1) == 0 || tag.GetElement() > 0x00ff))
       {
       // if above conditions don't apply, check if the query key matches
-      matched = v.Matches(this->Query->GetValue());
+      matched = vtkDICOMParserInternalFriendship::GetQueryMatcher(
+        this->Parser, this->Query->GetValue()).Matches(v);
       }
     }
   else
@@ -891,6 +982,47 @@ bool DecoderBase::FinishQuery()
   return this->QueryMatched;
 }
 
+//----------------------------------------------------------------------------
+bool DecoderBase::IsContextTag(vtkDICOMTag tag)
+{
+  unsigned short g = tag.GetGroup();
+  unsigned short e = tag.GetElement();
+
+  return (g == 0x0002 || // the meta header, for the TransferSyntaxUID
+          ((g & 1) != 0 && e >= 0x0010 && e < 0x0100) || // private creator
+          tag == DC::SpecificCharacterSet ||
+          tag == DC::PixelRepresentation ||
+          tag == DC::BitsAllocated ||
+          tag == DC::WaveformBitsAllocated);
+}
+
+//----------------------------------------------------------------------------
+bool DecoderBase::VisitData(
+  const unsigned char* &cp, const unsigned char* &ep, size_t n)
+{
+  vtkDICOMParserVisitor::Action action = vtkDICOMParserVisitor::Continue;
+
+  // give the data to the visitor one buffer-full at a time
+  while (n != 0 && action == vtkDICOMParserVisitor::Continue)
+    {
+    if (!this->CheckBuffer(cp, ep, 1)) { return false; }
+    size_t m = ep - cp;
+    if (m > n) { m = n; }
+    action = this->Visitor->ElementData(cp, m);
+    cp += m;
+    n -= m;
+    }
+
+  if (action == vtkDICOMParserVisitor::Skip)
+    {
+    // skip the rest of the data without reading it
+    return vtkDICOMParserInternalFriendship::SkipBuffer(
+      this->Parser, cp, ep, n);
+    }
+
+  return (action != vtkDICOMParserVisitor::Stop);
+}
+
 //----------------------------------------------------------------------------
 template<>
 inline unsigned short Decoder<LE>::GetInt16(const unsigned char *ip)
@@ -1185,6 +1317,26 @@ size_t Decoder<E>::ReadElementValue(
       }
     }
 
+  // for large binary values, record the file offset instead of reading
+  if (vl > this->DeferredValueThreshold && this->DeferredValueThreshold &&
+      vl != HxFFFFFFFF &&
+      (vr == vtkDICOMVR::OB || vr == vtkDICOMVR::OW ||
+       vr == vtkDICOMVR::OF || vr == vtkDICOMVR::OD ||
+       vr == vtkDICOMVR::UN))
+    {
+    vtkTypeInt64 offset =
+      vtkDICOMParserInternalFriendship::GetBytesProcessed(
+        this->Parser, cp, ep);
+    if (!vtkDICOMParserInternalFriendship::SkipBuffer(
+          this->Parser, cp, ep, vl))
+      {
+      return 0;
+      }
+    v.AllocateDeferredData(
+      vr, vl, this->Parser->GetFileName(), offset, (E == BE));
+    return vl;
+    }
+
   switch (vr.GetType())
     {
     case VTK_CHAR:
@@ -1193,11 +1345,12 @@ size_t Decoder<E>::ReadElementValue(
       if (vr.HasSpecificCharacterSet() &&
           this->LastTag > DC::SpecificCharacterSet)
         {
-        ptr = v.AllocateCharData(vr, this->Context->GetCharacterSet(), vl);
+        ptr = v.AllocateCharData(
+          vr, this->Context->GetCharacterSet(), vl, this->ValuePool);
         }
       else
         {
-        ptr = v.AllocateCharData(vr, vl);
+        ptr = v.AllocateCharData(vr, vl, this->ValuePool);
         }
       l = this->ReadData(cp, ep, ptr, vl);
       // AllocateCharData makes room for terminal null
@@ -1207,56 +1360,58 @@ size_t Decoder<E>::ReadElementValue(
       break;
     case VTK_UNSIGNED_CHAR:
       {
-      unsigned char *ptr = v.AllocateUnsignedCharData(vr, vl);
+      unsigned char *ptr = v.AllocateUnsignedCharData(
+        vr, vl, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, vl);
       }
       break;
     case VTK_SHORT:
       {
       unsigned int n = vl/sizeof(short);
-      short *ptr = v.AllocateShortData(vr, n);
+      short *ptr = v.AllocateShortData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_UNSIGNED_SHORT:
       {
       unsigned int n = vl/sizeof(unsigned short);
-      unsigned short *ptr = v.AllocateUnsignedShortData(vr, n);
+      unsigned short *ptr = v.AllocateUnsignedShortData(
+        vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_INT:
       {
       unsigned int n = vl/sizeof(int);
-      int *ptr = v.AllocateIntData(vr, n);
+      int *ptr = v.AllocateIntData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_UNSIGNED_INT:
       {
       unsigned int n = vl/sizeof(unsigned int);
-      unsigned int *ptr = v.AllocateUnsignedIntData(vr, n);
+      unsigned int *ptr = v.AllocateUnsignedIntData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_FLOAT:
       {
       unsigned int n = vl/sizeof(float);
-      float *ptr = v.AllocateFloatData(vr, n);
+      float *ptr = v.AllocateFloatData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_DOUBLE:
       {
       unsigned int n = vl/sizeof(double);
-      double *ptr = v.AllocateDoubleData(vr, n);
+      double *ptr = v.AllocateDoubleData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
     case VTK_DICOM_TAG:
       {
       unsigned int n = vl/sizeof(vtkDICOMTag);
-      vtkDICOMTag *ptr = v.AllocateTagData(vr, n);
+      vtkDICOMTag *ptr = v.AllocateTagData(vr, n, this->ValuePool);
       l = this->ReadData(cp, ep, ptr, n);
       }
       break;
@@ -1397,6 +1552,11 @@ bool Decoder<E>::ReadElements(
 
   while (tl < static_cast<size_t>(l) || l == HxFFFFFFFF)
     {
+    // stop if the data set has already failed to match the query (but
+    // not within a sequence item, since only one item has to match)
+    if (this->StopOnQueryFailure && this->HasQuery &&
+        !this->QueryMatched && this->Item == 0) { break; }
+
     // read the tag
     if (!this->CheckBuffer(cp, ep, 8)) { break; }
     unsigned short g = Decoder<E>::GetInt16(cp);
@@ -1537,6 +1697,276 @@ bool Decoder<E>::ReadElements(
   return true;
 }
 
+//----------------------------------------------------------------------------
+template<int E>
+bool Decoder<E>::VisitElements(
+  const unsigned char* &cp, const unsigned char* &ep,
+  unsigned int l, vtkDICOMTag delimiter, size_t &bytesRead)
+{
+  size_t tl = 0;
+
+  // does delimiter specify a single group to read?
+  unsigned short group = delimiter.GetGroup();
+  bool readGroup = (delimiter.GetElement() == 0x0000);
+
+  while (tl < static_cast<size_t>(l) || l == HxFFFFFFFF)
+    {
+    // read the tag
+    if (!this->CheckBuffer(cp, ep, 8)) { break; }
+    unsigned short g = Decoder<E>::GetInt16(cp);
+    unsigned short e = Decoder<E>::GetInt16(cp + 2);
+    vtkDICOMTag tag(g,e);
+
+    // break if element is not in the chosen group
+    if (readGroup && group != g) { break; }
+
+    // read the VR and VL
+    cp += 4;
+    vtkDICOMVR vr;
+    unsigned int vl;
+    size_t hl = this->ReadElementHead(cp, ep, tag, vr, vl);
+    tl += 4 + hl;
+
+    // return false if could not read element
+    if (hl == 0) { return false; }
+
+    // save this as the most recent tag
+    this->LastTag = tag;
+    this->LastVR = vr;
+    this->LastVL = vl;
+
+    // break if delimiter found
+    if (!readGroup && tag == delimiter) { break; }
+
+    // if it was explicitly labeled 'UN' then check dictionary, the
+    // value itself is implicit little endian
+    bool implicitLE = false;
+    if (vr == vtkDICOMVR::UN && !this->ImplicitVR)
+      {
+      implicitLE = true;
+      vr = this->Context->FindDictVR(tag);
+      }
+
+    vtkDICOMParserVisitor::Action action =
+      this->Visitor->StartElement(tag, vr, vl, (E == BE && !implicitLE));
+    if (action == vtkDICOMParserVisitor::Stop) { return false; }
+
+    bool r = true;
+    size_t rl = vl;
+    if (vl == HxFFFFFFFF || vr == vtkDICOMVR::SQ)
+      {
+      if (action == vtkDICOMParserVisitor::Skip)
+        {
+        size_t offset = this->GetByteOffset(cp, ep);
+        if (vl != HxFFFFFFFF)
+          {
+          r = vtkDICOMParserInternalFriendship::SkipBuffer(
+            this->Parser, cp, ep, vl);
+          }
+        else if (implicitLE || vr == vtkDICOMVR::UN)
+          {
+          // the value is an implicit LE sequence
+          r = this->ImplicitLE->SkipElements(
+            cp, ep, vl, vtkDICOMTag(HxFFFE, HxE0DD), NULL);
+          }
+        else
+          {
+          // the value is either a sequence or is encapsulated data
+          r = this->SkipElements(
+            cp, ep, vl, vtkDICOMTag(HxFFFE, HxE0DD), NULL);
+          }
+        rl = this->GetByteOffset(cp, ep) - offset;
+        }
+      else if (implicitLE || vr == vtkDICOMVR::UN)
+        {
+        r = this->ImplicitLE->VisitItems(cp, ep, tag, vr, vl, rl);
+        }
+      else
+        {
+        r = this->VisitItems(cp, ep, tag, vr, vl, rl);
+        }
+      }
+    else if (implicitLE)
+      {
+      r = this->ImplicitLE->VisitValue(cp, ep, tag, vr, vl, action);
+      }
+    else
+      {
+      r = this->VisitValue(cp, ep, tag, vr, vl, action);
+      }
+
+    if (!r) { return false; }
+    tl += rl;
+
+    if (this->Visitor->EndElement(tag) == vtkDICOMParserVisitor::Stop)
+      {
+      return false;
+      }
+    }
+
+  bytesRead += tl;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template<int E>
+bool Decoder<E>::VisitItems(
+  const unsigned char* &cp, const unsigned char* &ep,
+  vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl, size_t &l)
+{
+  // only UN, OB, and SQ can have unknown length
+  if (vl == HxFFFFFFFF && vr != vtkDICOMVR::SQ &&
+      vr != vtkDICOMVR::UN && vr != vtkDICOMVR::OB)
+    {
+    vtkDICOMParserInternalFriendship::ParseError(this->Parser, cp, ep,
+      "Illegal item length FFFFFFFF encountered.");
+    return false;
+    }
+
+  // encapsulated data has fragments instead of items
+  bool fragments = (vr == vtkDICOMVR::OB);
+  vtkDICOMTag endtag(HxFFFE, HxE00D);
+
+  l = 0;
+  while (l < static_cast<size_t>(vl) || vl == HxFFFFFFFF)
+    {
+    if (!this->CheckBuffer(cp, ep, 8)) { return false; }
+    unsigned short g = Decoder<E>::GetInt16(cp);
+    unsigned short e = Decoder<E>::GetInt16(cp + 2);
+    unsigned int il = Decoder<E>::GetInt32(cp + 4);
+    cp += 8;
+    l += 8;
+
+    if (g == HxFFFE && e == HxE000)
+      {
+      vtkDICOMParserVisitor::Action action = this->Visitor->StartItem(il);
+      if (action == vtkDICOMParserVisitor::Stop) { return false; }
+
+      bool r = true;
+      if (action == vtkDICOMParserVisitor::Skip)
+        {
+        size_t offset = this->GetByteOffset(cp, ep);
+        if (il == HxFFFFFFFF)
+          {
+          r = this->SkipElements(cp, ep, il, endtag, NULL);
+          }
+        else
+          {
+          r = vtkDICOMParserInternalFriendship::SkipBuffer(
+            this->Parser, cp, ep, il);
+          }
+        l += this->GetByteOffset(cp, ep) - offset;
+        }
+      else if (fragments)
+        {
+        r = (il != HxFFFFFFFF && this->VisitData(cp, ep, il));
+        l += il;
+        }
+      else
+        {
+        // the item is kept only for the values that are needed to
+        // decode the rest of the item (see IsContextTag)
+        unsigned int offset = this->GetByteOffset(cp, ep) - 8;
+        vtkDICOMItem item(this->Context->GetCharacterSet(),
+                          this->Context->GetVRForXS(),
+                          (il == HxFFFFFFFF), offset);
+        DecoderContext context(&item);
+        this->PushContext(&context, tag);
+        r = this->VisitElements(cp, ep, il, endtag, l);
+        this->PopContext();
+        }
+
+      if (!r ||
+          this->Visitor->EndItem() == vtkDICOMParserVisitor::Stop)
+        {
+        return false;
+        }
+      }
+    else if (g == HxFFFE && e == HxE0DD)
+      {
+      // sequence delimiter found
+      break;
+      }
+    else
+      {
+      // non-item tag found, skip to end if vl is known
+      if (vl != HxFFFFFFFF)
+        {
+        l += this->SkipData(cp, ep, static_cast<size_t>(vl) - l);
+        }
+      break;
+      }
+    }
+
+  // reset the tag and VR as we step out of the sequence
+  this->LastTag = tag;
+  this->LastVR = vr;
+  this->LastVL = vl;
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template<int E>
+bool Decoder<E>::VisitValue(
+  const unsigned char* &cp, const unsigned char* &ep,
+  vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl,
+  vtkDICOMParserVisitor::Action action)
+{
+  if (static_cast<size_t>(ep - cp) < static_cast<size_t>(vl))
+    {
+    // value is larger than what remains in buffer,
+    // make sure there are enough bytes left in file
+    vtkTypeInt64 bytesRemaining =
+      vtkDICOMParserInternalFriendship::GetBytesRemaining(
+          this->Parser, cp, ep);
+    if (static_cast<vtkTypeInt64>(vl) > bytesRemaining)
+      {
+      vtkDICOMParserInternalFriendship::ParseError(this->Parser, cp, ep,
+        "Item length exceeds the bytes remaining in file.");
+      return false;
+      }
+    }
+
+  if (vl <= 256 && DecoderBase::IsContextTag(tag) &&
+      this->CheckBuffer(cp, ep, vl))
+    {
+    // give the bytes to the visitor, then decode and store the value
+    if (action == vtkDICOMParserVisitor::Continue &&
+        this->Visitor->ElementData(cp, vl) == vtkDICOMParserVisitor::Stop)
+      {
+      return false;
+      }
+    vtkDICOMValue v;
+    if (this->ReadElementValue(cp, ep, vr, vl, v) != vl)
+      {
+      return false;
+      }
+    if (this->Item)
+      {
+      this->Item->SetAttributeValue(tag, v);
+      }
+    else if (this->Index < 0)
+      {
+      this->MetaData->SetAttributeValue(tag, v);
+      }
+    else
+      {
+      this->MetaData->SetAttributeValue(this->Index, tag, v);
+      }
+    return true;
+    }
+
+  if (action == vtkDICOMParserVisitor::Skip)
+    {
+    return vtkDICOMParserInternalFriendship::SkipBuffer(
+      this->Parser, cp, ep, vl);
+    }
+
+  return this->VisitData(cp, ep, vl);
+}
+
 //----------------------------------------------------------------------------
 template<int E>
 bool Decoder<E>::SkipElements(
@@ -1706,6 +2136,8 @@ vtkDICOMParser::vtkDICOMParser()
   this->Query = NULL;
   this->QueryItem = NULL;
   this->Groups = NULL;
+  this->Visitor = NULL;
+  this->Matchers = new MatcherMap;
   this->InputFile = NULL;
   this->BytesRead = 0;
   this->FileOffset = 0;
@@ -1715,6 +2147,11 @@ vtkDICOMParser::vtkDICOMParser()
   this->ChunkSize = 0;
   this->Index = -1;
   this->PixelDataVL = 0;
+  this->DeferredValueThreshold = 0;
+  this->MemoryMapping = false;
+  this->CheckFileHeader = false;
+  this->StopOnQueryFailure = false;
+  this->FileIsDICOM = false;
   this->PixelDataFound = false;
   this->QueryMatched = false;
   this->ErrorCode = 0;
@@ -1725,6 +2162,7 @@ vtkDICOMParser::~vtkDICOMParser()
 {
   delete [] this->FileName;
   delete this->QueryItem;
+  delete this->Matchers;
 
   if (this->MetaData)
     {
@@ -1740,6 +2178,25 @@ vtkDICOMParser::~vtkDICOMParser()
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkDICOMParser::SetQuery(vtkDICOMMetaData *query)
+{
+  if (this->Query != query)
+    {
+    if (this->Query)
+      {
+      this->Query->UnRegister(this);
+      }
+    this->Query = query;
+    if (this->Query)
+      {
+      this->Query->Register(this);
+      }
+    this->Matchers->clear();
+    this->Modified();
+    }
+}
+
 //----------------------------------------------------------------------------
 void vtkDICOMParser::SetQueryItem(const vtkDICOMItem& query)
 {
@@ -1750,6 +2207,7 @@ void vtkDICOMParser::SetQueryItem(const vtkDICOMItem& query)
     }
   delete this->QueryItem;
   this->QueryItem = 0;
+  this->Matchers->clear();
   if (query.GetNumberOfDataElements() > 0)
     {
     this->QueryItem = new vtkDICOMItem(query);
@@ -1797,6 +2255,7 @@ bool vtkDICOMParser::ReadFile(vtkDICOMMetaData *data, int idx)
   this->QueryMatched = (this->Query != 0 || this->QueryItem != 0);
   this->FileOffset = 0;
   this->FileSize = 0;
+  this->FileIsDICOM = false;
 
   // Check that the file name has been set.
   if (!this->FileName)
@@ -1811,6 +2270,11 @@ bool vtkDICOMParser::ReadFile(vtkDICOMMetaData *data, int idx)
   if (infile.GetError())
     {
     this->SetErrorCode(vtkErrorCode::CannotOpenFileError);
+    if (this->CheckFileHeader)
+      {
+      // treat the same as a file that isn't DICOM
+      return false;
+      }
     const char *errText = "Can't open the file ";
     if (infile.GetError() == vtkDICOMFile::AccessDenied)
       {
@@ -1826,14 +2290,46 @@ bool vtkDICOMParser::ReadFile(vtkDICOMMetaData *data, int idx)
 
   this->InputFile = &infile;
   this->FileSize = infile.GetSize();
-  this->Buffer = new unsigned char [this->BufferSize + 8];
-  this->BytesRead = 0;
-  // guard against anyone changing BufferSize while reading
-  this->ChunkSize = this->BufferSize;
 
   const unsigned char *cp = NULL;
   const unsigned char *ep = NULL;
-  this->FillBuffer(cp, ep);
+  if (this->MemoryMapping)
+    {
+    cp = infile.Map();
+    }
+
+  if (cp)
+    {
+    // decode directly from the memory map, no buffer is needed
+    this->BytesRead = infile.GetMapSize();
+    ep = cp + infile.GetMapSize();
+    }
+  else
+    {
+    this->Buffer = new unsigned char [this->BufferSize + 8];
+    this->BytesRead = 0;
+    // guard against anyone changing BufferSize while reading
+    this->ChunkSize = this->BufferSize;
+    this->FillBuffer(cp, ep);
+    // in case of a short read, make sure enough is read for the check
+    size_t n = ep - cp;
+    while (n < 256 && this->FillBuffer(cp, ep) &&
+           static_cast<size_t>(ep - cp) > n)
+      {
+      n = ep - cp;
+      }
+    }
+
+  // Use the data that has been read to check if this is a DICOM file
+  this->FileIsDICOM = vtkDICOMUtilities::IsDICOMFileHeader(cp, ep - cp);
+  if (this->CheckFileHeader && !this->FileIsDICOM)
+    {
+    delete [] this->Buffer;
+    this->Buffer = NULL;
+    infile.Close();
+    this->InputFile = NULL;
+    return false;
+    }
 
   if (ep - cp >= 132 &&
       cp[128] == 'D' && cp[129] == 'I' && cp[130] == 'C' && cp[131] == 'M')
@@ -1848,10 +2344,13 @@ bool vtkDICOMParser::ReadFile(vtkDICOMMetaData *data, int idx)
     cp += 4;
     }
 
-  this->ReadMetaHeader(cp, ep, data, idx);
-  this->ReadMetaData(cp, ep, data, idx);
+  if (this->ReadMetaHeader(cp, ep, data, idx))
+    {
+    this->ReadMetaData(cp, ep, data, idx);
+    }
 
   delete [] this->Buffer;
+  this->Buffer = NULL;
   infile.Close();
   this->InputFile = NULL;
 
@@ -1871,12 +2370,28 @@ bool vtkDICOMParser::ReadMetaHeader(
     }
 
   LittleEndianDecoder decoder(this, meta, idx);
+  bool stopped = false;
+
+  // make sure the first data element is available, because a mapped
+  // file has no slack after its end (unlike the buffer)
+  if (ep - cp < 12)
+    {
+    this->FillBuffer(cp, ep);
+    }
+  size_t n = ep - cp;
 
   // get the meta information group length
-  unsigned short g = Decoder<LE>::GetInt16(cp);
-  unsigned short e = Decoder<LE>::GetInt16(cp + 2);
-  vtkDICOMVR vr = vtkDICOMVR(cp + 4);
-  unsigned int vl = Decoder<LE>::GetInt16(cp + 6);
+  unsigned short g = 0;
+  unsigned short e = 0;
+  vtkDICOMVR vr;
+  unsigned int vl = 0;
+  if (n >= 8)
+    {
+    g = Decoder<LE>::GetInt16(cp);
+    e = Decoder<LE>::GetInt16(cp + 2);
+    vr = vtkDICOMVR(cp + 4);
+    vl = Decoder<LE>::GetInt16(cp + 6);
+    }
 
   // verify that this is the right tag
   if (g == 0x0002)
@@ -1885,13 +2400,20 @@ bool vtkDICOMParser::ReadMetaHeader(
     decoder.SetImplicitVR(!vr.IsValid());
 
     unsigned int l = HxFFFFFFFF;
-    if (e == 0x0000 && vl == 4)
+    if (e == 0x0000 && vl == 4 && n >= 12)
       {
       // get length from tag 0x0002,0x0000
       l = Decoder<LE>::GetInt32(cp + 8) + 12;
       }
 
-    decoder.ReadElements(cp, ep, l, vtkDICOMTag(g,0));
+    if (this->Visitor)
+      {
+      stopped = !decoder.VisitElements(cp, ep, l, vtkDICOMTag(g,0));
+      }
+    else
+      {
+      decoder.ReadElements(cp, ep, l, vtkDICOMTag(g,0));
+      }
 
     int i = (idx == -1 ? 0 : idx);
     this->TransferSyntax =
@@ -1909,7 +2431,7 @@ bool vtkDICOMParser::ReadMetaHeader(
     meta->Delete();
     }
 
-  return true;
+  return !stopped;
 }
 
 //----------------------------------------------------------------------------
@@ -1917,11 +2439,6 @@ bool vtkDICOMParser::ReadMetaData(
   const unsigned char* &cp, const unsigned char* &ep,
   vtkDICOMMetaData *meta, int idx)
 {
-  // the decoders to choose from
-  LittleEndianDecoder decoderLE(this, meta, idx);
-  BigEndianDecoder decoderBE(this, meta, idx);
-  DecoderBase *decoder = &decoderLE;
-
   // make sure there is at least one data element
   if (ep - cp < 8)
     {
@@ -1932,6 +2449,19 @@ bool vtkDICOMParser::ReadMetaData(
       }
     }
 
+  // the visitor needs somewhere to keep the values used for decoding
+  vtkDICOMMetaData *tempMeta = 0;
+  if (this->Visitor && meta == 0)
+    {
+    tempMeta = vtkDICOMMetaData::New();
+    meta = tempMeta;
+    }
+
+  // the decoders to choose from
+  LittleEndianDecoder decoderLE(this, meta, idx);
+  BigEndianDecoder decoderBE(this, meta, idx);
+  DecoderBase *decoder = &decoderLE;
+
   std::string &tsyntax = this->TransferSyntax;
   if (tsyntax == "") // try to guess the syntax
     {
@@ -1958,13 +2488,13 @@ bool vtkDICOMParser::ReadMetaData(
   vtkDICOMDataElementIterator iter;
   vtkDICOMDataElementIterator iterEnd;
   bool hasQuery = false;
-  if (this->Query)
+  if (this->Query && !this->Visitor)
     {
     hasQuery = true;
     iter = this->Query->Begin();
     iterEnd = this->Query->End();
     }
-  else if (this->QueryItem)
+  else if (this->QueryItem && !this->Visitor)
     {
     hasQuery = true;
     iter = this->QueryItem->Begin();
@@ -2000,7 +2530,8 @@ bool vtkDICOMParser::ReadMetaData(
         {
         if (metaIter->GetTag() == iter->GetTag())
           {
-          matched &= metaIter->GetValue(this->Index).Matches(iter->GetValue());
+          matched &= vtkDICOMParserInternalFriendship::GetQueryMatcher(
+            this, iter->GetValue()).Matches(metaIter->GetValue(this->Index));
           ++iter;
           ++metaIter;
           }
@@ -2039,7 +2570,7 @@ bool vtkDICOMParser::ReadMetaData(
       ++iter;
       }
     }
-  else if (this->Groups)
+  else if (this->Groups && !this->Visitor)
     {
     vtkIdType n = this->Groups->GetNumberOfTuples();
     for (vtkIdType i = 0; i < n; i++)
@@ -2057,7 +2588,8 @@ bool vtkDICOMParser::ReadMetaData(
   bool foundPixelData = false;
   bool readFailure = false;
   bool queryFailure = (hasQuery && !this->QueryMatched);
-  bool bailOnQueryFailure = (meta && meta->GetNumberOfInstances() == 1);
+  bool bailOnQueryFailure = (this->StopOnQueryFailure ||
+    (meta && meta->GetNumberOfInstances() == 1));
   while (!foundPixelData && !readFailure &&
          (!queryFailure || !bailOnQueryFailure))
     {
@@ -2097,7 +2629,11 @@ bool vtkDICOMParser::ReadMetaData(
         }
       }
 
-    if (found && meta)
+    if (this->Visitor)
+      {
+      readFailure = !decoder->VisitElements(cp, ep, l, delimiter);
+      }
+    else if (found && meta)
       {
       readFailure = !decoder->ReadElements(cp, ep, l, delimiter);
       queryFailure = (hasQuery && !decoder->GetQueryMatched());
@@ -2133,6 +2669,20 @@ bool vtkDICOMParser::ReadMetaData(
       {
       meta->SetAttributeValue(lastTag, v);
       }
+
+    // the visitor sees the PixelData element, but not its value
+    if (this->Visitor &&
+        this->Visitor->StartElement(lastTag, decoder->GetLastVR(),
+          this->PixelDataVL, (decoder == &decoderBE)) !=
+          vtkDICOMParserVisitor::Stop)
+      {
+      this->Visitor->EndElement(lastTag);
+      }
+    }
+
+  if (tempMeta)
+    {
+    tempMeta->Delete();
     }
 
   return true;
@@ -2142,6 +2692,12 @@ bool vtkDICOMParser::ReadMetaData(
 bool vtkDICOMParser::FillBuffer(
   const unsigned char* &ucp, const unsigned char* &ep)
 {
+  if (this->Buffer == NULL)
+    {
+    // the file is memory mapped, so all of it is already available
+    return false;
+    }
+
   unsigned char *dp = this->Buffer;
   size_t n = ep - ucp;
   const unsigned char *cp = ucp;
@@ -2183,6 +2739,31 @@ bool vtkDICOMParser::FillBuffer(
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkDICOMParser::SkipBuffer(
+  const unsigned char* &cp, const unsigned char* &ep, vtkTypeInt64 n)
+{
+  vtkTypeInt64 m = ep - cp;
+  if (n <= m)
+    {
+    cp += n;
+    return true;
+    }
+
+  // skip what is left in the buffer, then move the file position
+  cp = ep;
+  n -= m;
+  if (this->Buffer == NULL ||
+      this->FileSize - this->BytesRead < n ||
+      !this->InputFile->SetPosition(this->BytesRead + n))
+    {
+    return false;
+    }
+  this->BytesRead += n;
+
+  return true;
+}
+
 //----------------------------------------------------------------------------
 vtkTypeInt64 vtkDICOMParser::GetBytesRemaining(
   const unsigned char *cp, const unsigned char *ep)
@@ -2225,9 +2806,20 @@ void vtkDICOMParser::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "MetaData: " << this->MetaData << "\n";
   os << indent << "Index: " << this->Index << "\n";
   os << indent << "BufferSize: " << this->BufferSize << "\n";
+  os << indent << "DeferredValueThreshold: "
+     << this->DeferredValueThreshold << "\n";
+  os << indent << "MemoryMapping: "
+     << (this->MemoryMapping ? "On\n" : "Off\n");
+  os << indent << "CheckFileHeader: "
+     << (this->CheckFileHeader ? "On\n" : "Off\n");
+  os << indent << "StopOnQueryFailure: "
+     << (this->StopOnQueryFailure ? "On\n" : "Off\n");
+  os << indent << "FileIsDICOM: "
+     << (this->FileIsDICOM ? "True\n" : "False\n");
   os << indent << "Query: " << this->Query << "\n";
   os << indent << "QueryItem: " << this->QueryItem << "\n";
   os << indent << "QueryMatched: "
      << (this->QueryMatched ? "True\n" : "False\n");
   os << indent << "Groups: " << this->Groups << "\n";
+  os << indent << "Visitor: " << this->Visitor << "\n";
 }
@@ -22,6 +22,7 @@
 class vtkDICOMFile;
 class vtkDICOMItem;
 class vtkDICOMMetaData;
+class vtkDICOMParserVisitor;
 class vtkUnsignedShortArray;
 class vtkDICOMParserInternalFriendship;
 
@@ -61,7 +62,9 @@ public:
   /*!
    *  This can be used to scan a file for data that matches a given
    *  query.  For more information on how matching is done, see the
-   *  vtkDICOMValue::Matches() method.
+   *  vtkDICOMValue::Matches() method.  Each query value is prepared
+   *  for matching with a vtkDICOMValueMatcher the first time that it
+   *  is used, and is then reused for every file that is parsed.
    */
   void SetQuery(vtkDICOMMetaData *query);
   vtkDICOMMetaData *GetQuery() { return this->Query; }
@@ -75,6 +78,20 @@ public:
    */
   void SetQueryItem(const vtkDICOMItem& query);
 
+  //! Stop reading a file as soon as it fails to match the query.
+  /*!
+   *  Ordinarily, a file that fails to match the query is still parsed
+   *  up to the PixelData (unless it is being read into a MetaData object
+   *  that holds just one instance), and GetQueryMatched() is set at the
+   *  end.  If this option is on, the parser stops at the first query key
+   *  that fails to match, so the MetaData will be incomplete, and the
+   *  PixelData will not be found.  This is useful when most of the files
+   *  that are scanned will not match the query.  Default: Off.
+   */
+  vtkSetMacro(StopOnQueryFailure, bool);
+  vtkGetMacro(StopOnQueryFailure, bool);
+  vtkBooleanMacro(StopOnQueryFailure, bool);
+
   //! Set specific metadata groups to read (obsolete).
   /*!
    *  This method is obsolete, the SetQuery() method should be used instead.
@@ -94,7 +111,10 @@ public:
   //! Get the byte offset to the end of the metadata.
   /*!
    *  After the metadata has been read, the file offset
-   *  will be set to the position of the pixel data.
+   *  will be set to the position of the pixel data.  If the parser
+   *  stopped early because of StopOnQueryFailure, then the offset is
+   *  the position at which it stopped, and the number of bytes that
+   *  were not parsed is GetFileSize() minus GetFileOffset().
    */
   vtkTypeInt64 GetFileOffset() { return this->FileOffset; }
 
@@ -109,6 +129,68 @@ public:
   void SetBufferSize(int size);
   int GetBufferSize() { return this->BufferSize; }
 
+  //! Use memory mapping to read the file (default: Off).
+  /*!
+   *  If this is on, the whole file is mapped into memory and the data
+   *  elements are decoded directly from the mapped memory, instead of
+   *  being read into the buffer one chunk at a time.  If the file cannot
+   *  be mapped, then the buffer is used instead.
+   */
+  vtkSetMacro(MemoryMapping, bool);
+  vtkGetMacro(MemoryMapping, bool);
+  vtkBooleanMacro(MemoryMapping, bool);
+
+  //! Check that the file is DICOM before parsing it (default: Off).
+  /*!
+   *  If this is on, then the first data that is read from the file is
+   *  checked with vtkDICOMUtilities::IsDICOMFileHeader() before the
+   *  file is parsed.  If the file does not look like DICOM, or if it
+   *  cannot be opened, then it is closed without reporting an error.
+   *  This allows each file to be opened only once when a directory is
+   *  scanned, instead of being opened once by IsDICOMFile() and then
+   *  again by the parser.
+   */
+  vtkSetMacro(CheckFileHeader, bool);
+  vtkGetMacro(CheckFileHeader, bool);
+  vtkBooleanMacro(CheckFileHeader, bool);
+
+  //! Defer the reading of values larger than this size (default: 0).
+  /*!
+   *  If this is set to a nonzero number of bytes, then any OB, OW, OF,
+   *  OD, or UN value that is larger than this is not read while the
+   *  file is parsed.  Instead, its location within the file is recorded,
+   *  and its data is read the first time that it is accessed through the
+   *  vtkDICOMValue interface.  This reduces the time and memory needed
+   *  to read headers that hold large private blobs or overlays.  The
+   *  file must not be modified or removed while the values are in use,
+   *  since a value that cannot be read will have no data (see
+   *  vtkDICOMValue::AllocateDeferredData() for details).
+   */
+  vtkSetMacro(DeferredValueThreshold, unsigned int);
+  vtkGetMacro(DeferredValueThreshold, unsigned int);
+
+  //! Set a visitor to receive the data elements as they are parsed.
+  /*!
+   *  If a visitor is set, then each data element is reported to the
+   *  visitor as it is decoded, instead of being stored in the MetaData.
+   *  Only the elements that are needed to decode the rest of the file
+   *  (the meta header, the SpecificCharacterSet, the private creators,
+   *  and the elements that determine the VR of other elements) are
+   *  stored in the MetaData, if a MetaData object has been set.  The
+   *  Query and the Groups are ignored while a visitor is set.  The
+   *  visitor is not reference counted, so it must not be deleted while
+   *  it is set.  See vtkDICOMParserVisitor for more information.
+   */
+  void SetVisitor(vtkDICOMParserVisitor *visitor) {
+    this->Visitor = visitor; }
+  vtkDICOMParserVisitor *GetVisitor() { return this->Visitor; }
+
+  //! This is true if the file looked like a DICOM file.
+  /*!
+   *  This is set by Update(), whether or not CheckFileHeader is on.
+   */
+  bool GetFileIsDICOM() { return this->FileIsDICOM; }
+
   //! Read the metadata from the file.
   virtual void Update();
 
@@ -128,11 +210,25 @@ protected:
    *  region to the beginning of the buffer, and will then
    *  fill the remainder of the buffer with new data from
    *  the file.  The values of cp and ep will be set to the
-   *  beginning and end of the buffer.
+   *  beginning and end of the buffer.  If the file is memory
+   *  mapped, then cp and ep already span the whole file, so
+   *  this method returns false.
    */
   virtual bool FillBuffer(
     const unsigned char* &cp, const unsigned char* &ep);
 
+  //! Internal method for skipping over data.
+  /*!
+   *  This is an internal method that skips "n" bytes, starting at cp.
+   *  The bytes that are left in the buffer are skipped first, and then
+   *  the file position is moved past the rest without reading them.
+   *  On return, cp and ep will mark the region of the buffer that has
+   *  not been parsed yet, which might be empty.  The return value is
+   *  false if the file ended before "n" bytes could be skipped.
+   */
+  virtual bool SkipBuffer(
+    const unsigned char* &cp, const unsigned char* &ep, vtkTypeInt64 n);
+
   //! Get the bytes remaining in the file.
   virtual vtkTypeInt64 GetBytesRemaining(
     const unsigned char *cp, const unsigned char *ep);
@@ -167,6 +263,7 @@ protected:
   vtkDICOMMetaData *Query;
   vtkDICOMItem *QueryItem;
   vtkUnsignedShortArray *Groups;
+  vtkDICOMParserVisitor *Visitor;
   vtkDICOMFile *InputFile;
   vtkTypeInt64 BytesRead;
   vtkTypeInt64 FileOffset;
@@ -176,10 +273,19 @@ protected:
   int ChunkSize;
   int Index;
   unsigned int PixelDataVL;
+  unsigned int DeferredValueThreshold;
+  bool MemoryMapping;
+  bool CheckFileHeader;
+  bool StopOnQueryFailure;
+  bool FileIsDICOM;
   bool PixelDataFound;
   bool QueryMatched;
   unsigned long ErrorCode;
 
+  // the query values, prepared for matching
+  class MatcherMap;
+  MatcherMap *Matchers;
+
   // used to share FillBuffer with internal classes
   friend class vtkDICOMParserInternalFriendship;
 
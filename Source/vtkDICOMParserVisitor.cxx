@@ -0,0 +1,53 @@
+/*=========================================================================
+
+  Program: DICOM for VTK
+
+  Copyright (c) 2012-2015 David Gobbi
+  All rights reserved.
+  See Copyright.txt or http://dgobbi.github.io/bsd3.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "vtkDICOMParserVisitor.h"
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::~vtkDICOMParserVisitor()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::Action vtkDICOMParserVisitor::StartElement(
+  vtkDICOMTag, vtkDICOMVR, unsigned int, bool)
+{
+  return Continue;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::Action vtkDICOMParserVisitor::ElementData(
+  const unsigned char *, size_t)
+{
+  return Continue;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::Action vtkDICOMParserVisitor::EndElement(
+  vtkDICOMTag)
+{
+  return Continue;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::Action vtkDICOMParserVisitor::StartItem(
+  unsigned int)
+{
+  return Continue;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMParserVisitor::Action vtkDICOMParserVisitor::EndItem()
+{
+  return Continue;
+}
@@ -0,0 +1,95 @@
+/*=========================================================================
+
+  Program: DICOM for VTK
+
+  Copyright (c) 2012-2015 David Gobbi
+  All rights reserved.
+  See Copyright.txt or http://dgobbi.github.io/bsd3.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef vtkDICOMParserVisitor_h
+#define vtkDICOMParserVisitor_h
+
+#include <vtkSystemIncludes.h>
+#include "vtkDICOMModule.h"
+#include "vtkDICOMTag.h"
+#include "vtkDICOMVR.h"
+
+//! A callback interface for streaming through a DICOM file.
+/*!
+ *  If a visitor is given to vtkDICOMParser with SetVisitor(), then the
+ *  parser reports each data element to the visitor as it is decoded,
+ *  instead of storing it in a vtkDICOMMetaData object.  This allows a
+ *  file to be scanned without allocating memory for its values.  Each
+ *  data element is reported with StartElement(), followed by its value
+ *  (in one or more calls to ElementData() or, for a sequence, through
+ *  the items), followed by EndElement().  The items of a sequence and
+ *  the fragments of encapsulated data are reported with StartItem()
+ *  and EndItem().  Every method returns an Action, where Skip causes
+ *  the rest of the current element or item to be skipped without being
+ *  reported, and Stop causes the parser to stop reading the file.
+ */
+class VTK_DICOM_EXPORT vtkDICOMParserVisitor
+{
+public:
+  //! The actions that a visitor can return to the parser.
+  enum Action
+  {
+    Continue, //!< Continue on to the next part of the data.
+    Skip,     //!< Skip the rest of the current element or item.
+    Stop      //!< Stop parsing the file.
+  };
+
+  //! Construct a visitor.
+  vtkDICOMParserVisitor() {}
+
+  //! Destructor.
+  virtual ~vtkDICOMParserVisitor();
+
+  //! Called when the header of a data element has been decoded.
+  /*!
+   *  The VR will be the VR from the file, unless the VR in the file was
+   *  implicit or UN, in which case it will be the VR from the dictionary.
+   *  The VL will be 0xffffffff for a delimited sequence or for delimited
+   *  encapsulated data.  If bigEndian is true, then the bytes that are
+   *  given to ElementData() are big endian, rather than little endian.
+   */
+  virtual Action StartElement(
+    vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl, bool bigEndian);
+
+  //! Called with the bytes of the value, exactly as they are in the file.
+  /*!
+   *  A value might be given in several chunks, which will be no larger
+   *  than the parser's buffer.  The pointer is only valid until the
+   *  function returns.  This is not called for sequences.
+   */
+  virtual Action ElementData(const unsigned char *data, size_t n);
+
+  //! Called after the value of the data element has been read or skipped.
+  /*!
+   *  For the PixelData, this is called immediately after StartElement(),
+   *  because the parser stops before it reads the pixel data.
+   */
+  virtual Action EndElement(vtkDICOMTag tag);
+
+  //! Called at the start of a sequence item or an encapsulated fragment.
+  /*!
+   *  The VL will be 0xffffffff if the item is delimited.  The data
+   *  elements in an item are reported with StartElement(), but the
+   *  data in a fragment is reported with ElementData().
+   */
+  virtual Action StartItem(unsigned int vl);
+
+  //! Called at the end of a sequence item or an encapsulated fragment.
+  virtual Action EndItem();
+
+private:
+  vtkDICOMParserVisitor(const vtkDICOMParserVisitor&);  // Not implemented.
+  void operator=(const vtkDICOMParserVisitor&);  // Not implemented.
+};
+
+#endif /* vtkDICOMParserVisitor_h */
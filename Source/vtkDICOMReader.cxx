@@ -43,6 +43,8 @@
 #include "vtkSmartPointer.h"
 #include "vtkVersion.h"
 #include "vtkTypeTraits.h"
+#include "vtkMultiThreader.h"
+#include "vtkMutexLock.h"
 
 #if defined(DICOM_USE_DCMTK)
 #ifndef _WIN32
@@ -65,6 +67,8 @@
 #include "vtksys/ios/sstream"
 
 #include <algorithm>
+#include <string>
+#include <vector>
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
@@ -96,6 +100,10 @@ vtkDICOMReader::vtkDICOMReader()
   this->TimeDimension = 0;
   this->TimeSpacing = 1.0;
   this->DesiredStackID[0] = '\0';
+  this->NumberOfThreads = 1;
+  this->MemoryMapping = 0;
+  this->DeferredValueThreshold = 0;
+  this->Worker = 0;
 
   this->DataScalarType = VTK_SHORT;
   this->NumberOfScalarComponents = 1;
@@ -235,6 +243,12 @@ void vtkDICOMReader::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "MemoryRowOrder: "
      << this->GetMemoryRowOrderAsString() << "\n";
+
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "MemoryMapping: "
+     << (this->MemoryMapping ? "On\n" : "Off\n");
+  os << indent << "DeferredValueThreshold: "
+     << this->DeferredValueThreshold << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -354,6 +368,589 @@ struct vtkDICOMReaderFileInfo
   vtkDICOMReaderFileInfo(int i, int n) : FileIndex(i), FramesInFile(n) {}
 };
 
+// a simple struct to hold an error until it can be reported
+struct vtkDICOMReaderFileError
+{
+  unsigned long ErrorCode;
+  std::string Text;
+
+  vtkDICOMReaderFileError() : ErrorCode(0) {}
+};
+
+} // end anonymous namespace
+
+// Report an error for a file, instead of calling vtkErrorMacro directly.
+#define vtkDICOMReaderFileErrorMacro(fileIdx, code, x) \
+  { \
+  vtksys_ios::ostringstream vtkmsg; \
+  vtkmsg << x; \
+  this->FileReadError(fileIdx, code, vtkmsg.str().c_str()); \
+  }
+
+//----------------------------------------------------------------------------
+// The worker reads a list of files into the output, and can be run
+// by several threads at once.  Each file is read by exactly one thread,
+// and the output slices for different files never overlap, so the only
+// state that is shared between the threads is the file counter.
+class vtkDICOMReaderWorker
+{
+public:
+  vtkDICOMReaderWorker(vtkDICOMReader *reader,
+                       std::vector<vtkDICOMReaderFileInfo> *files);
+  ~vtkDICOMReaderWorker();
+
+  // Read files until none are left, or until aborted.
+  void Execute(int threadId);
+
+  // Read one file and copy its frames into the output.
+  void ReadFile(size_t idx, unsigned char **fileBufferPtr,
+                int *bufferFramesPtr, unsigned char *rowBuffer);
+
+  // Hold an error until all the threads have finished.
+  void DeferError(int fileIdx, unsigned long code, const char *text);
+
+  // Report the held errors, in the same order as the files.
+  void ReportErrors();
+
+  // The function that is called by vtkMultiThreader.
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+
+  vtkDICOMReader *Reader;
+  std::vector<vtkDICOMReaderFileInfo> *Files;
+  std::vector<std::string> FileNames;
+  std::vector<vtkDICOMReaderFileError> Errors;
+  bool Deferred;
+
+  unsigned char *DataPtr;
+  int Extent[6];
+  int NumberOfPlanes;
+  vtkIdType PixelSize;
+  vtkIdType SliceSize;
+  vtkIdType FilePixelSize;
+  vtkIdType FileRowSize;
+  vtkIdType FilePlaneSize;
+  vtkIdType FileFrameSize;
+  bool FlipImage;
+  bool PlanarToPacked;
+
+  vtkMutexLock *Lock;
+  size_t NextFile;
+  size_t FilesDone;
+
+private:
+  vtkDICOMReaderWorker(const vtkDICOMReaderWorker&);  // Not implemented.
+  void operator=(const vtkDICOMReaderWorker&);  // Not implemented.
+};
+
+//----------------------------------------------------------------------------
+vtkDICOMReaderWorker::vtkDICOMReaderWorker(
+  vtkDICOMReader *reader, std::vector<vtkDICOMReaderFileInfo> *files)
+  : Reader(reader), Files(files), Deferred(false), DataPtr(0),
+    NumberOfPlanes(1), PixelSize(0), SliceSize(0), FilePixelSize(0),
+    FileRowSize(0), FilePlaneSize(0), FileFrameSize(0),
+    FlipImage(false), PlanarToPacked(false), NextFile(0), FilesDone(0)
+{
+  for (int i = 0; i < 6; i++)
+    {
+    this->Extent[i] = 0;
+    }
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMReaderWorker::~vtkDICOMReaderWorker()
+{
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkDICOMReaderWorker::ThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkDICOMReaderWorker *worker =
+    static_cast<vtkDICOMReaderWorker *>(info->UserData);
+
+  worker->Execute(info->ThreadID);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMReaderWorker::Execute(int threadId)
+{
+  // each thread has its own buffers
+  unsigned char *rowBuffer = 0;
+  if (this->FlipImage)
+    {
+    rowBuffer = new unsigned char[this->FileRowSize];
+    }
+  unsigned char *fileBuffer = 0;
+  int bufferFrames = 0;
+
+  size_t n = this->Files->size();
+  for (;;)
+    {
+    if (this->Reader->AbortExecute) { break; }
+
+    // get the next file that has not been read by any thread
+    this->Lock->Lock();
+    size_t idx = this->NextFile++;
+    size_t done = this->FilesDone;
+    this->Lock->Unlock();
+
+    if (idx >= n) { break; }
+
+    // only the thread that called RequestData can report progress
+    if (threadId == 0)
+      {
+      this->Reader->UpdateProgress(static_cast<double>(done)/
+                                   static_cast<double>(n));
+      }
+
+    this->ReadFile(idx, &fileBuffer, &bufferFrames, rowBuffer);
+
+    this->Lock->Lock();
+    this->FilesDone++;
+    this->Lock->Unlock();
+    }
+
+  delete [] rowBuffer;
+  delete [] fileBuffer;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMReaderWorker::ReadFile(
+  size_t idx, unsigned char **fileBufferPtr, int *bufferFramesPtr,
+  unsigned char *rowBuffer)
+{
+  vtkDICOMReader *reader = this->Reader;
+  const int *extent = this->Extent;
+  vtkIdType pixelSize = this->PixelSize;
+  vtkIdType sliceSize = this->SliceSize;
+  vtkIdType filePixelSize = this->FilePixelSize;
+  vtkIdType fileRowSize = this->FileRowSize;
+  vtkIdType filePlaneSize = this->FilePlaneSize;
+  vtkIdType fileFrameSize = this->FileFrameSize;
+  int numPlanes = this->NumberOfPlanes;
+
+  // get the index for this file
+  const vtkDICOMReaderFileInfo& fileInfo = (*this->Files)[idx];
+  int fileIdx = fileInfo.FileIndex;
+  int framesInFile = fileInfo.FramesInFile;
+  const std::vector<vtkDICOMReaderFrameInfo>& frames = fileInfo.Frames;
+  int numFrames = static_cast<int>(frames.size());
+
+  // we need a file buffer if input frames don't match output slices
+  bool needBuffer = (this->PlanarToPacked || numFrames != framesInFile);
+  for (int sIdx = 0; sIdx < numFrames && !needBuffer; sIdx++)
+    {
+    needBuffer = (sIdx != frames[sIdx].FrameIndex);
+    }
+
+  unsigned char *bufferPtr = 0;
+
+  if (needBuffer)
+    {
+    if (framesInFile > *bufferFramesPtr)
+      {
+      // allocate a buffer for planar-to-packed conversion
+      delete [] *fileBufferPtr;
+      *fileBufferPtr = new unsigned char[fileFrameSize*framesInFile];
+      *bufferFramesPtr = framesInFile;
+      }
+    bufferPtr = *fileBufferPtr;
+    }
+  else
+    {
+    // read directly into the output
+    int sliceIdx = frames[0].SliceIndex;
+    int componentIdx = frames[0].ComponentIndex;
+    bufferPtr = (this->DataPtr +
+                 (sliceIdx - extent[4])*sliceSize +
+                 componentIdx*filePixelSize*numPlanes);
+    }
+
+  reader->ReadOneFile(this->FileNames[idx].c_str(), fileIdx,
+                      bufferPtr, framesInFile*fileFrameSize);
+
+  // iterate through all frames contained in the file
+  for (int sIdx = 0; sIdx < numFrames; sIdx++)
+    {
+    int frameIdx = frames[sIdx].FrameIndex;
+    int sliceIdx = frames[sIdx].SliceIndex;
+    int componentIdx = frames[sIdx].ComponentIndex;
+    // go to the correct position in the input
+    unsigned char *framePtr = bufferPtr + frameIdx*fileFrameSize;
+    // go to the correct position in the output
+    unsigned char *slicePtr =
+      (this->DataPtr + (sliceIdx - extent[4])*sliceSize +
+       componentIdx*filePixelSize*numPlanes);
+
+    // rescale if Rescale was different for different files
+    if (reader->NeedsRescale &&
+        reader->MetaData->GetAttributeValue(
+          fileIdx, DC::PixelData).IsValid())
+      {
+      reader->RescaleBuffer(fileIdx, frameIdx, bufferPtr, sliceSize);
+      }
+
+    // iterate through all color planes in the slice
+    unsigned char *planePtr = framePtr;
+    for (int pIdx = 0; pIdx < numPlanes; pIdx++)
+      {
+      // flip the data if necessary
+      if (this->FlipImage)
+        {
+        int numRows = extent[3] - extent[2] + 1;
+        int halfRows = numRows/2;
+        for (int yIdx = 0; yIdx < halfRows; yIdx++)
+          {
+          unsigned char *row1 = planePtr + yIdx*fileRowSize;
+          unsigned char *row2 = planePtr + (numRows-yIdx-1)*fileRowSize;
+          memcpy(rowBuffer, row1, fileRowSize);
+          memcpy(row1, row2, fileRowSize);
+          memcpy(row2, rowBuffer, fileRowSize);
+          }
+        }
+
+      // convert planes into vector components
+      if (this->PlanarToPacked)
+        {
+        const unsigned char *tmpInPtr = planePtr;
+        unsigned char *tmpOutPtr = slicePtr;
+        int m = sliceSize/pixelSize;
+        for (int i = 0; i < m; i++)
+          {
+          vtkIdType n = filePixelSize;
+          do { *tmpOutPtr++ = *tmpInPtr++; } while (--n);
+          tmpOutPtr += pixelSize - filePixelSize;
+          }
+        slicePtr += filePixelSize;
+        }
+      else if (slicePtr != planePtr)
+        {
+        memcpy(slicePtr, planePtr, filePlaneSize);
+        }
+
+      planePtr += filePlaneSize;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMReaderWorker::DeferError(
+  int fileIdx, unsigned long code, const char *text)
+{
+  // each file is read by only one thread, so no lock is needed,
+  // and only the first error for each file is kept
+  if (fileIdx >= 0 && fileIdx < static_cast<int>(this->Errors.size()) &&
+      this->Errors[fileIdx].Text.empty())
+    {
+    this->Errors[fileIdx].ErrorCode = code;
+    this->Errors[fileIdx].Text = text;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMReaderWorker::ReportErrors()
+{
+  // must only be called after all the threads have finished
+  this->Deferred = false;
+  for (size_t idx = 0; idx < this->Files->size(); idx++)
+    {
+    int fileIdx = (*this->Files)[idx].FileIndex;
+    if (fileIdx >= 0 && fileIdx < static_cast<int>(this->Errors.size()) &&
+        !this->Errors[fileIdx].Text.empty())
+      {
+      const vtkDICOMReaderFileError& error = this->Errors[fileIdx];
+      this->Reader->FileReadError(
+        fileIdx, error.ErrorCode, error.Text.c_str());
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMReader::FileReadError(
+  int fileIdx, unsigned long errorCode, const char *text)
+{
+  if (this->Worker && this->Worker->Deferred)
+    {
+    this->Worker->DeferError(fileIdx, errorCode, text);
+    }
+  else
+    {
+    if (errorCode != vtkErrorCode::NoError)
+      {
+      this->SetErrorCode(errorCode);
+      }
+    vtkErrorMacro(<< text);
+    }
+}
+
+//----------------------------------------------------------------------------
+namespace {
+
+// the meta data that was read from one file by a worker thread
+struct vtkDICOMReaderHeaderInfo
+{
+  std::string FileName;
+  vtkDICOMMetaData *MetaData;
+  vtkTypeInt64 OffsetAndSize[2];
+  unsigned long ErrorCode;
+  std::vector<std::string> Errors;
+
+  vtkDICOMReaderHeaderInfo() : MetaData(0), ErrorCode(0) {
+    this->OffsetAndSize[0] = 0;
+    this->OffsetAndSize[1] = 0; }
+};
+
+class vtkDICOMReaderHeaderScan;
+
+// each thread has its own parser
+class vtkDICOMReaderHeaderThread
+{
+public:
+  vtkDICOMReaderHeaderThread(
+    vtkDICOMReaderHeaderScan *scan, bool mmap, unsigned int deferSize);
+  ~vtkDICOMReaderHeaderThread();
+
+  // Parse files until none are left.
+  void Execute();
+
+  // Store the errors from the parser.
+  void HandleError(vtkObject *o, unsigned long e, void *data);
+
+private:
+  vtkDICOMReaderHeaderScan *Scan;
+  vtkDICOMParser *Parser;
+  vtkDICOMReaderHeaderInfo *Current;
+
+  vtkDICOMReaderHeaderThread(const vtkDICOMReaderHeaderThread&);
+  void operator=(const vtkDICOMReaderHeaderThread&);
+};
+
+// read the headers of many files with a pool of threads
+class vtkDICOMReaderHeaderScan
+{
+public:
+  vtkDICOMReaderHeaderScan(int numFiles);
+  ~vtkDICOMReaderHeaderScan();
+
+  // Read all the files with the specified number of threads.
+  void Execute(int numThreads, bool mmap, unsigned int deferSize);
+
+  // Get the next file to read, or return -1 if there are none.
+  int NextFile();
+
+  // Indicate that an error occurred while reading a file.
+  void StopAtFile(int idx);
+
+  // The function that is called by vtkMultiThreader.
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+
+  std::vector<vtkDICOMReaderHeaderInfo> Headers;
+  std::vector<vtkDICOMReaderHeaderThread *> Threads;
+  vtkMutexLock *Lock;
+  int NextIndex;
+  int LastIndex;
+
+private:
+  vtkDICOMReaderHeaderScan(const vtkDICOMReaderHeaderScan&);
+  void operator=(const vtkDICOMReaderHeaderScan&);
+};
+
+//----------------------------------------------------------------------------
+vtkDICOMReaderHeaderThread::vtkDICOMReaderHeaderThread(
+  vtkDICOMReaderHeaderScan *scan, bool mmap, unsigned int deferSize)
+  : Scan(scan), Current(0)
+{
+  this->Parser = vtkDICOMParser::New();
+  this->Parser->SetMemoryMapping(mmap);
+  this->Parser->SetDeferredValueThreshold(deferSize);
+  this->Parser->AddObserver(
+    vtkCommand::ErrorEvent, this, &vtkDICOMReaderHeaderThread::HandleError);
+}
+
+vtkDICOMReaderHeaderThread::~vtkDICOMReaderHeaderThread()
+{
+  this->Parser->Delete();
+}
+
+void vtkDICOMReaderHeaderThread::HandleError(
+  vtkObject *, unsigned long, void *data)
+{
+  // errors are held, they will be reported after the threads finish
+  if (this->Current)
+    {
+    this->Current->Errors.push_back(
+      data ? static_cast<char *>(data) : "An unknown error ocurred!");
+    }
+}
+
+void vtkDICOMReaderHeaderThread::Execute()
+{
+  int idx;
+  while ((idx = this->Scan->NextFile()) >= 0)
+    {
+    vtkDICOMReaderHeaderInfo *header = &this->Scan->Headers[idx];
+    this->Current = header;
+    this->Parser->SetMetaData(header->MetaData);
+    this->Parser->SetFileName(header->FileName.c_str());
+    this->Parser->Update();
+    this->Parser->SetMetaData(0);
+    this->Current = 0;
+
+    header->ErrorCode = this->Parser->GetErrorCode();
+    header->OffsetAndSize[0] = this->Parser->GetFileOffset();
+    header->OffsetAndSize[1] = this->Parser->GetFileSize();
+
+    if (header->ErrorCode)
+      {
+      // the parser error code is sticky, so this thread must stop
+      this->Scan->StopAtFile(idx);
+      break;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMReaderHeaderScan::vtkDICOMReaderHeaderScan(int numFiles)
+  : Headers(numFiles), NextIndex(0), LastIndex(numFiles - 1)
+{
+  this->Lock = vtkMutexLock::New();
+}
+
+vtkDICOMReaderHeaderScan::~vtkDICOMReaderHeaderScan()
+{
+  for (size_t i = 0; i < this->Threads.size(); i++)
+    {
+    delete this->Threads[i];
+    }
+  for (size_t j = 0; j < this->Headers.size(); j++)
+    {
+    if (this->Headers[j].MetaData)
+      {
+      this->Headers[j].MetaData->Delete();
+      }
+    }
+  this->Lock->Delete();
+}
+
+int vtkDICOMReaderHeaderScan::NextFile()
+{
+  this->Lock->Lock();
+  int idx = this->NextIndex;
+  if (idx > this->LastIndex)
+    {
+    idx = -1;
+    }
+  else
+    {
+    this->NextIndex++;
+    }
+  this->Lock->Unlock();
+  return idx;
+}
+
+void vtkDICOMReaderHeaderScan::StopAtFile(int idx)
+{
+  // files after the first bad file will not be needed
+  this->Lock->Lock();
+  if (idx < this->LastIndex)
+    {
+    this->LastIndex = idx;
+    }
+  this->Lock->Unlock();
+}
+
+VTK_THREAD_RETURN_TYPE vtkDICOMReaderHeaderScan::ThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkDICOMReaderHeaderScan *scan =
+    static_cast<vtkDICOMReaderHeaderScan *>(info->UserData);
+
+  scan->Threads[info->ThreadID]->Execute();
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+void vtkDICOMReaderHeaderScan::Execute(
+  int numThreads, bool mmap, unsigned int deferSize)
+{
+  // create all the VTK objects before the threads start
+  for (size_t j = 0; j < this->Headers.size(); j++)
+    {
+    this->Headers[j].MetaData = vtkDICOMMetaData::New();
+    }
+  for (int i = 0; i < numThreads; i++)
+    {
+    this->Threads.push_back(
+      new vtkDICOMReaderHeaderThread(this, mmap, deferSize));
+    }
+
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(numThreads);
+  threader->SetSingleMethod(vtkDICOMReaderHeaderScan::ThreadFunction, this);
+  threader->SingleMethodExecute();
+  threader->Delete();
+}
+
+//----------------------------------------------------------------------------
+// Merge the meta data from one file into the meta data for the series.
+// This does exactly what vtkDICOMParser::Update() does when it writes
+// to the series meta data directly: attributes that are present for
+// other instances but missing from this one are set to null values.
+void vtkDICOMReaderMergeMetaData(
+  vtkDICOMMetaData *meta, int idx, vtkDICOMMetaData *source)
+{
+  vtkDICOMDataElementIterator iter = source->Begin();
+  vtkDICOMDataElementIterator iterEnd = source->End();
+
+  if (meta->GetNumberOfDataElements() == 0 ||
+      meta->GetNumberOfInstances() <= 1)
+    {
+    for (; iter != iterEnd; ++iter)
+      {
+      meta->SetAttributeValue(iter->GetTag(), iter->GetValue());
+      }
+    return;
+    }
+
+  vtkDICOMTag lastWrittenTag;
+  bool inMetaHeader = true;
+  for (; iter != iterEnd; ++iter)
+    {
+    vtkDICOMTag tag = iter->GetTag();
+    meta->SetAttributeValue(idx, tag, iter->GetValue());
+
+    // the parser uses a new decoder after the meta header
+    if (inMetaHeader && tag.GetGroup() > 0x0002)
+      {
+      inMetaHeader = false;
+      lastWrittenTag = vtkDICOMTag();
+      }
+
+    // find the elements between this one and the last one written
+    std::vector<vtkDICOMTag> missing;
+    vtkDICOMDataElementIterator miter = meta->Find(tag);
+    --miter;
+    while (miter->GetTag() != lastWrittenTag &&
+           miter->GetTag().GetGroup() != 0x0002)
+      {
+      missing.push_back(miter->GetTag());
+      --miter;
+      }
+    for (size_t i = missing.size(); i > 0; i--)
+      {
+      meta->SetAttributeValue(idx, missing[i-1], vtkDICOMValue());
+      }
+
+    lastWrittenTag = tag;
+    }
+}
+
 } // end anonymous namespace
 
 //----------------------------------------------------------------------------
@@ -588,6 +1185,8 @@ int vtkDICOMReader::RequestInformation(
   // Parser reads just the meta data, not the pixel data.
   this->Parser = vtkDICOMParser::New();
   this->Parser->SetMetaData(this->MetaData);
+  this->Parser->SetMemoryMapping(this->MemoryMapping != 0);
+  this->Parser->SetDeferredValueThreshold(this->DeferredValueThreshold);
   this->Parser->AddObserver(
     vtkCommand::ErrorEvent, this, &vtkDICOMReader::RelayError);
 
@@ -596,23 +1195,77 @@ int vtkDICOMReader::RequestInformation(
   this->FileOffsetArray->SetNumberOfComponents(2);
   this->FileOffsetArray->SetNumberOfTuples(numFiles);
 
-  for (int idx = 0; idx < numFiles; idx++)
+  // never use more threads than there are files
+  int numThreads = this->NumberOfThreads;
+  if (numThreads > numFiles)
     {
-    this->ComputeInternalFileName(this->DataExtent[4] + idx);
-    this->Parser->SetFileName(this->InternalFileName);
-    this->Parser->SetIndex(idx);
-    this->Parser->Update();
+    numThreads = numFiles;
+    }
+  if (numThreads > VTK_MAX_THREADS)
+    {
+    numThreads = VTK_MAX_THREADS;
+    }
 
-    if (this->Parser->GetErrorCode())
+  if (numThreads > 1)
+    {
+    // parse the files concurrently, each into its own meta data object
+    vtkDICOMReaderHeaderScan scan(numFiles);
+    for (int idx = 0; idx < numFiles; idx++)
       {
-      break;
+      this->ComputeInternalFileName(this->DataExtent[4] + idx);
+      if (this->InternalFileName)
+        {
+        scan.Headers[idx].FileName = this->InternalFileName;
+        }
       }
+    scan.Execute(numThreads, (this->MemoryMapping != 0),
+                 this->DeferredValueThreshold);
 
-    // save the offset to the pixel data
-    vtkTypeInt64 offset[2];
-    offset[0] = this->Parser->GetFileOffset();
-    offset[1] = this->Parser->GetFileSize();
-    this->FileOffsetArray->SetTupleValue(idx, offset);
+    // merge the meta data in file order, exactly as if the files
+    // had been read one at a time by this->Parser
+    for (int idx = 0; idx <= scan.LastIndex; idx++)
+      {
+      vtkDICOMReaderHeaderInfo& header = scan.Headers[idx];
+      vtkDICOMReaderMergeMetaData(this->MetaData, idx, header.MetaData);
+      header.MetaData->Delete();
+      header.MetaData = 0;
+
+      if (header.ErrorCode)
+        {
+        for (size_t i = 0; i < header.Errors.size(); i++)
+          {
+          this->SetErrorCode(header.ErrorCode);
+          vtkErrorMacro(<< header.Errors[i].c_str());
+          }
+        this->SetErrorCode(header.ErrorCode);
+        break;
+        }
+
+      // save the offset to the pixel data
+      this->FileOffsetArray->SetTupleValue(idx, header.OffsetAndSize);
+      }
+    this->MetaData->Modified();
+    }
+  else
+    {
+    for (int idx = 0; idx < numFiles; idx++)
+      {
+      this->ComputeInternalFileName(this->DataExtent[4] + idx);
+      this->Parser->SetFileName(this->InternalFileName);
+      this->Parser->SetIndex(idx);
+      this->Parser->Update();
+
+      if (this->Parser->GetErrorCode())
+        {
+        break;
+        }
+
+      // save the offset to the pixel data
+      vtkTypeInt64 offset[2];
+      offset[0] = this->Parser->GetFileOffset();
+      offset[1] = this->Parser->GetFileSize();
+      this->FileOffsetArray->SetTupleValue(idx, offset);
+      }
     }
 
   // Files are read in the order provided, but they might have
@@ -1161,6 +1814,163 @@ void vtkDICOMReader::UnpackBits(
     }
 }
 
+//----------------------------------------------------------------------------
+namespace {
+
+// Read data from a file, or from the file's memory map if mapPtr is set.
+// If the map holds all of the requested data, then dataPtr is set to point
+// into the map and nothing is copied, otherwise the data is read (or copied
+// from the map) into the supplied buffer and dataPtr is set to the buffer.
+size_t vtkDICOMReaderReadData(
+  vtkDICOMFile *infile, const unsigned char *mapPtr, size_t mapSize,
+  unsigned char *buffer, size_t size, const unsigned char **dataPtr)
+{
+  if (mapPtr)
+    {
+    if (size <= mapSize)
+      {
+      *dataPtr = mapPtr;
+      return size;
+      }
+    memcpy(buffer, mapPtr, mapSize);
+    *dataPtr = buffer;
+    return mapSize;
+    }
+
+  *dataPtr = buffer;
+  return infile->Read(buffer, size);
+}
+
+// Decode the frames of a compressed image.  For RLE, each frame is held
+// in exactly one fragment, but a JPEG frame can be split across several
+// fragments.  The frames are independent of each other, so they can be
+// decoded by several threads at once.
+class vtkDICOMReaderCompressedFrames
+{
+public:
+  vtkDICOMReaderCompressedFrames(
+    vtkDICOMMetaData *meta, const std::string& ts,
+    unsigned char *buffer, vtkIdType frameSize)
+    : Codec(ts), Image(meta), Buffer(buffer), FrameSize(frameSize) {}
+
+  // Add a fragment, either as the start of a new frame or as the
+  // continuation of the previous frame.
+  void AddFragment(const unsigned char *data, size_t size, bool newFrame) {
+    if (newFrame || this->Frames.empty()) {
+      this->Frames.push_back(this->Fragments.size()); }
+    this->Fragments.push_back(data);
+    this->FragmentSizes.push_back(size); }
+
+  // Get the number of frames.
+  size_t GetNumberOfFrames() { return this->Frames.size(); }
+
+  // Decode all of the frames with the given number of threads.
+  void Execute(int numThreads);
+
+  // Get the error code for the first frame that failed to decode.
+  int GetErrorCode();
+
+private:
+  // Decode every frame whose index modulo numThreads is threadId.
+  void ExecuteThread(int threadId, int numThreads);
+
+  // The function that is called by vtkMultiThreader.
+  static VTK_THREAD_RETURN_TYPE ThreadFunction(void *arg);
+
+  vtkDICOMImageCodec Codec;
+  vtkDICOMImageCodec::ImageFormat Image;
+  std::vector<size_t> Frames;
+  std::vector<const unsigned char *> Fragments;
+  std::vector<size_t> FragmentSizes;
+  std::vector<int> ErrorCodes;
+  unsigned char *Buffer;
+  vtkIdType FrameSize;
+};
+
+void vtkDICOMReaderCompressedFrames::ExecuteThread(
+  int threadId, int numThreads)
+{
+  size_t n = this->Frames.size();
+  std::vector<unsigned char> joined;
+  for (size_t i = threadId; i < n; i += numThreads)
+    {
+    size_t first = this->Frames[i];
+    size_t last = (i + 1 < n ? this->Frames[i+1] : this->Fragments.size());
+    const unsigned char *data = this->Fragments[first];
+    size_t size = this->FragmentSizes[first];
+    if (last - first > 1)
+      {
+      // the codec needs the fragments of the frame to be contiguous
+      joined.clear();
+      for (size_t j = first; j < last; j++)
+        {
+        joined.insert(joined.end(), this->Fragments[j],
+                      this->Fragments[j] + this->FragmentSizes[j]);
+        }
+      data = &joined[0];
+      size = joined.size();
+      }
+    this->ErrorCodes[i] = this->Codec.Decode(this->Image, data, size,
+      this->Buffer + i*this->FrameSize, this->FrameSize);
+    }
+}
+
+VTK_THREAD_RETURN_TYPE vtkDICOMReaderCompressedFrames::ThreadFunction(
+  void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkDICOMReaderCompressedFrames *frames =
+    static_cast<vtkDICOMReaderCompressedFrames *>(info->UserData);
+
+  frames->ExecuteThread(info->ThreadID, info->NumberOfThreads);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+void vtkDICOMReaderCompressedFrames::Execute(int numThreads)
+{
+  this->ErrorCodes.assign(this->Frames.size(), vtkDICOMImageCodec::NoError);
+
+  // never use more threads than there are frames
+  if (static_cast<size_t>(numThreads) > this->Frames.size())
+    {
+    numThreads = static_cast<int>(this->Frames.size());
+    }
+  if (numThreads > VTK_MAX_THREADS)
+    {
+    numThreads = VTK_MAX_THREADS;
+    }
+
+  if (numThreads > 1)
+    {
+    vtkMultiThreader *threader = vtkMultiThreader::New();
+    threader->SetNumberOfThreads(numThreads);
+    threader->SetSingleMethod(
+      vtkDICOMReaderCompressedFrames::ThreadFunction, this);
+    threader->SingleMethodExecute();
+    threader->Delete();
+    }
+  else
+    {
+    this->ExecuteThread(0, 1);
+    }
+}
+
+int vtkDICOMReaderCompressedFrames::GetErrorCode()
+{
+  for (size_t i = 0; i < this->ErrorCodes.size(); i++)
+    {
+    if (this->ErrorCodes[i] != vtkDICOMImageCodec::NoError)
+      {
+      return this->ErrorCodes[i];
+      }
+    }
+  return vtkDICOMImageCodec::NoError;
+}
+
+} // end anonymous namespace
+
 //----------------------------------------------------------------------------
 bool vtkDICOMReader::ReadFileNative(
   const char *filename, int fileIdx,
@@ -1176,15 +1986,35 @@ bool vtkDICOMReader::ReadFileNative(
 
   if (infile.GetError())
     {
-    this->SetErrorCode(vtkErrorCode::CannotOpenFileError);
-    vtkErrorMacro("ReadFile: Can't read the file " << filename);
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::CannotOpenFileError,
+      "ReadFile: Can't read the file " << filename);
     return false;
     }
 
-  if (!infile.SetPosition(offset))
+  // if the file can be mapped, the data will be taken from the map
+  const unsigned char *mapPtr = 0;
+  size_t mapSize = 0;
+  if (this->MemoryMapping)
+    {
+    mapPtr = infile.Map();
+    if (mapPtr && offset >= 0 &&
+        static_cast<vtkDICOMFile::Size>(offset) <= infile.GetMapSize())
+      {
+      mapPtr += offset;
+      mapSize = static_cast<size_t>(infile.GetMapSize() - offset);
+      }
+    else
+      {
+      mapPtr = 0;
+      }
+    }
+
+  if (mapPtr == 0 && !infile.SetPosition(offset))
     {
-    this->SetErrorCode(vtkErrorCode::PrematureEndOfFileError);
-    vtkErrorMacro("DICOM file is truncated, some data is missing.");
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::PrematureEndOfFileError,
+      "DICOM file is truncated, some data is missing.");
     infile.Close();
     return false;
     }
@@ -1203,10 +2033,11 @@ bool vtkDICOMReader::ReadFileNative(
 
   size_t readSize = bufferSize;
   size_t resultSize = 0;
-  if (transferSyntax == "1.2.840.10008.1.2.5")
+  if (transferSyntax == "1.2.840.10008.1.2.5"    ||  // RLE compressed
+      transferSyntax == "1.2.840.10008.1.2.4.57" ||  // JPEG lossless
+      transferSyntax == "1.2.840.10008.1.2.4.70")    // JPEG lossless SV1
     {
-    vtkDICOMImageCodec codec(transferSyntax);
-
+    bool isRLE = (transferSyntax == "1.2.840.10008.1.2.5");
     unsigned int numFrames = this->MetaData->GetAttributeValue(
       fileIdx, DC::NumberOfFrames).AsUnsignedInt();
     numFrames = (numFrames == 0 ? 1 : numFrames);
@@ -1218,14 +2049,20 @@ bool vtkDICOMReader::ReadFileNative(
       {
       readSize = 8;
       }
-    unsigned char *rleBuffer = new unsigned char[readSize];
-    unsigned char *filePtr = rleBuffer;
-    resultSize = infile.Read(filePtr, readSize);
+    unsigned char *compressedBuffer = 0;
+    if (readSize > mapSize)
+      {
+      compressedBuffer = new unsigned char[readSize];
+      }
+    const unsigned char *filePtr = 0;
+    resultSize = vtkDICOMReaderReadData(
+      &infile, mapPtr, mapSize, compressedBuffer, readSize, &filePtr);
     size_t bytesRemaining = resultSize;
-    vtkIdType bufferPos = 0;
     vtkIdType frameSize = bufferSize/numFrames;
+    vtkDICOMReaderCompressedFrames frames(
+      this->MetaData, transferSyntax, buffer, frameSize);
     bool isOffsetTable = true;
-    while (bytesRemaining >= 8 && bufferPos < bufferSize)
+    while (bytesRemaining >= 8)
       {
       // get the item header
       unsigned int tagkey = vtkDICOMUtilities::UnpackUnsignedInt(filePtr);
@@ -1243,19 +2080,49 @@ bool vtkDICOMReader::ReadFileNative(
         readSize += length - bytesRemaining;
         length = bytesRemaining;
         }
-      // first item is the offset table
+      // first item is the offset table, the rest are frames, where
+      // each JPEG frame begins with a fragment that starts with SOI
       if (!isOffsetTable)
         {
-        // unpack an RLE fragment
-        codec.Decode(this->MetaData,
-          filePtr, length, buffer + bufferPos, frameSize);
-        bufferPos += frameSize;
+        bool newFrame = (isRLE ||
+          (length >= 2 && filePtr[0] == 0xFF && filePtr[1] == 0xD8));
+        if (newFrame && frames.GetNumberOfFrames() == numFrames)
+          {
+          break;
+          }
+        frames.AddFragment(filePtr, length, newFrame);
         }
       filePtr += length;
       bytesRemaining -= length;
       isOffsetTable = false;
       }
-    delete [] rleBuffer;
+    // decode the frames with several threads, unless the files are
+    // already being read by several threads
+    int numThreads = this->NumberOfThreads;
+    if (this->Worker && this->Worker->Deferred)
+      {
+      numThreads = 1;
+      }
+    frames.Execute(numThreads);
+    delete [] compressedBuffer;
+
+    // if the codec does not support this image, then try DCMTK or GDCM
+    int codecError = frames.GetErrorCode();
+    if (codecError == vtkDICOMImageCodec::BadPixelFormat ||
+        codecError == vtkDICOMImageCodec::MissingCodec)
+      {
+      infile.Close();
+      return this->ReadFileDelegated(filename, fileIdx, buffer, bufferSize);
+      }
+    else if (codecError != vtkDICOMImageCodec::NoError)
+      {
+      // the compressed data is truncated or corrupt
+      vtkDICOMReaderFileErrorMacro(fileIdx,
+        vtkErrorCode::FileFormatError,
+        "Error in DICOM file, cannot decode the compressed pixel data.");
+      infile.Close();
+      return false;
+      }
     }
   else if (bitsAllocated == 12)
     {
@@ -1263,8 +2130,10 @@ bool vtkDICOMReader::ReadFileNative(
     // the result will have to be swapped if machine is BE (the
     // swapping is done at the end of this function)
     readSize = bufferSize/2 + (bufferSize+3)/4;
-    unsigned char *filePtr = buffer + (bufferSize - readSize);
-    resultSize = infile.Read(filePtr, readSize);
+    const unsigned char *filePtr = 0;
+    resultSize = vtkDICOMReaderReadData(
+      &infile, mapPtr, mapSize, buffer + (bufferSize - readSize), readSize,
+      &filePtr);
 
     vtkDICOMReader::UnpackBits(filePtr, buffer, bufferSize, bitsAllocated);
     }
@@ -1273,28 +2142,38 @@ bool vtkDICOMReader::ReadFileNative(
     // unpack 1 bit into 8 bits, source assumed to be either OB
     // or little endian OW, never big endian OW
     readSize = (bufferSize + 7)/8;
-    unsigned char *filePtr = buffer + (bufferSize - readSize);
-    resultSize = infile.Read(filePtr, readSize);
+    const unsigned char *filePtr = 0;
+    resultSize = vtkDICOMReaderReadData(
+      &infile, mapPtr, mapSize, buffer + (bufferSize - readSize), readSize,
+      &filePtr);
 
     vtkDICOMReader::UnpackBits(filePtr, buffer, bufferSize, bitsAllocated);
     }
   else
     {
-    resultSize = infile.Read(buffer, readSize);
+    const unsigned char *filePtr = 0;
+    resultSize = vtkDICOMReaderReadData(
+      &infile, mapPtr, mapSize, buffer, readSize, &filePtr);
+    if (filePtr != buffer)
+      {
+      memcpy(buffer, filePtr, resultSize);
+      }
     }
 
   bool success = true;
   if (infile.EndOfFile() || resultSize != readSize)
     {
-    this->SetErrorCode(vtkErrorCode::PrematureEndOfFileError);
-    vtkErrorMacro("DICOM file is truncated, " <<
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::PrematureEndOfFileError,
+      "DICOM file is truncated, " <<
       (readSize - resultSize) << " bytes are missing.");
     success = false;
     }
   else if (infile.GetError())
     {
-    this->SetErrorCode(vtkErrorCode::FileFormatError);
-    vtkErrorMacro("Error in DICOM file, cannot read.");
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::FileFormatError,
+      "Error in DICOM file, cannot read.");
     success = false;
     }
   else if (fileBigEndian != memoryBigEndian)
@@ -1321,8 +2200,9 @@ bool vtkDICOMReader::ReadFileDelegated(
 
   if (!status.good())
     {
-    vtkErrorMacro("DCMTK error: " << status.text());
-    this->SetErrorCode(vtkErrorCode::FileFormatError);
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::FileFormatError,
+      "DCMTK error: " << status.text());
     delete fileformat;
     return false;
     }
@@ -1350,9 +2230,10 @@ bool vtkDICOMReader::ReadFileDelegated(
     }
   else
     {
-    vtkErrorMacro(<< filename << ": The uncompressed image size is "
-                  << imageSize << " bytes, expected "
-                  << bufferSize << " bytes.");
+    vtkDICOMReaderFileErrorMacro(fileIdx, vtkErrorCode::NoError,
+      filename << ": The uncompressed image size is "
+      << imageSize << " bytes, expected "
+      << bufferSize << " bytes.");
     delete fileformat;
     return false;
     }
@@ -1362,24 +2243,24 @@ bool vtkDICOMReader::ReadFileDelegated(
 
 #elif defined(DICOM_USE_GDCM)
 
-  (void)fileIdx;
-
   gdcm::ImageReader reader;
   reader.SetFileName(filename);
   if(!reader.Read())
     {
-    vtkErrorMacro("The GDCM ImageReader could not read the image.");
-    this->SetErrorCode(vtkErrorCode::FileFormatError);
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::FileFormatError,
+      "The GDCM ImageReader could not read the image.");
     return false;
     }
 
   gdcm::Image &image = reader.GetImage();
   if (static_cast<vtkIdType>(image.GetBufferLength()) < bufferSize)
     {
-    vtkErrorMacro(<< filename << ": The uncompressed image size is "
-                  << image.GetBufferLength() << " bytes, expected "
-                  << bufferSize << " bytes.");
-    this->SetErrorCode(vtkErrorCode::FileFormatError);
+    vtkDICOMReaderFileErrorMacro(fileIdx,
+      vtkErrorCode::FileFormatError,
+      filename << ": The uncompressed image size is "
+      << image.GetBufferLength() << " bytes, expected "
+      << bufferSize << " bytes.");
     return false;
     }
 
@@ -1389,12 +2270,12 @@ bool vtkDICOMReader::ReadFileDelegated(
 #else /* no DCMTK or GDCM, so no file decompression */
 
   (void)filename;
-  (void)fileIdx;
   (void)buffer;
   (void)bufferSize;
 
-  this->SetErrorCode(vtkErrorCode::FileFormatError);
-  vtkErrorMacro("DICOM file is compressed, cannot read.");
+  vtkDICOMReaderFileErrorMacro(fileIdx,
+    vtkErrorCode::FileFormatError,
+    "DICOM file is compressed, cannot read.");
   return false;
 
 #endif
@@ -1408,12 +2289,14 @@ bool vtkDICOMReader::ReadOneFile(
   std::string transferSyntax = this->MetaData->GetAttributeValue(
     fileIdx, DC::TransferSyntaxUID).AsString();
 
-  if (transferSyntax == "1.2.840.10008.1.2"   ||  // Implicit LE
-      transferSyntax == "1.2.840.10008.1.20"  ||  // Papyrus Implicit LE
-      transferSyntax == "1.2.840.10008.1.2.1" ||  // Explicit LE
-      transferSyntax == "1.2.840.10008.1.2.2" ||  // Explicit BE
-      transferSyntax == "1.2.840.10008.1.2.5" ||  // RLE compressed
-      transferSyntax == "1.2.840.113619.5.2"  ||  // GE LE with BE data
+  if (transferSyntax == "1.2.840.10008.1.2"      ||  // Implicit LE
+      transferSyntax == "1.2.840.10008.1.20"     ||  // Papyrus Implicit LE
+      transferSyntax == "1.2.840.10008.1.2.1"    ||  // Explicit LE
+      transferSyntax == "1.2.840.10008.1.2.2"    ||  // Explicit BE
+      transferSyntax == "1.2.840.10008.1.2.5"    ||  // RLE compressed
+      transferSyntax == "1.2.840.10008.1.2.4.57" ||  // JPEG lossless
+      transferSyntax == "1.2.840.10008.1.2.4.70" ||  // JPEG lossless SV1
+      transferSyntax == "1.2.840.113619.5.2"     ||  // GE LE with BE data
       transferSyntax == "")
     {
     return this->ReadFileNative(filename, fileIdx, buffer, bufferSize);
@@ -1520,129 +2403,67 @@ int vtkDICOMReader::RequestData(
 
   this->InvokeEvent(vtkCommand::StartEvent);
 
-  bool flipImage = (this->MemoryRowOrder == vtkDICOMReader::BottomUp);
-  bool planarToPacked = (filePixelSize != pixelSize);
-  unsigned char *rowBuffer = 0;
-  if (flipImage)
-    {
-    rowBuffer = new unsigned char[fileRowSize];
-    }
-  unsigned char *fileBuffer = 0;
-  int framesInPreviousFile = -1;
-
-  // loop through all files in the update extent
+  // set up the worker that will read the files
+  vtkDICOMReaderWorker worker(this, &files);
+  worker.DataPtr = dataPtr;
+  for (int i = 0; i < 6; i++)
+    {
+    worker.Extent[i] = extent[i];
+    }
+  worker.NumberOfPlanes = numPlanes;
+  worker.PixelSize = pixelSize;
+  worker.SliceSize = sliceSize;
+  worker.FilePixelSize = filePixelSize;
+  worker.FileRowSize = fileRowSize;
+  worker.FilePlaneSize = filePlaneSize;
+  worker.FileFrameSize = fileFrameSize;
+  worker.FlipImage = (this->MemoryRowOrder == vtkDICOMReader::BottomUp);
+  worker.PlanarToPacked = (filePixelSize != pixelSize);
+
+  // compute the filenames now, since this is not thread safe
+  worker.FileNames.resize(files.size());
   for (size_t idx = 0; idx < files.size(); idx++)
     {
-    if (this->AbortExecute) { break; }
-
-    this->UpdateProgress(static_cast<double>(idx)/
-                         static_cast<double>(files.size()));
-
-    // get the index for this file
-    int fileIdx = files[idx].FileIndex;
-    int framesInFile = files[idx].FramesInFile;
-    std::vector<vtkDICOMReaderFrameInfo>& frames = files[idx].Frames;
-    int numFrames = static_cast<int>(frames.size());
-
-    // we need a file buffer if input frames don't match output slices
-    bool needBuffer = (planarToPacked || numFrames != framesInFile);
-    for (int sIdx = 0; sIdx < numFrames && !needBuffer; sIdx++)
+    this->ComputeInternalFileName(files[idx].FileIndex);
+    if (this->InternalFileName)
       {
-      needBuffer = (sIdx != frames[sIdx].FrameIndex);
-      }
-
-    unsigned char *bufferPtr = 0;
-
-    if (needBuffer)
-      {
-      if (numFrames != framesInPreviousFile)
-        {
-        // allocate a buffer for planar-to-packed conversion
-        delete [] fileBuffer;
-        fileBuffer = new unsigned char[fileFrameSize*framesInFile];
-        framesInPreviousFile = numFrames;
-        }
-      bufferPtr = fileBuffer;
-      }
-    else
-      {
-      // read directly into the output
-      int sliceIdx = frames[0].SliceIndex;
-      int componentIdx = frames[0].ComponentIndex;
-      bufferPtr = (dataPtr +
-                   (sliceIdx - extent[4])*sliceSize +
-                   componentIdx*filePixelSize*numPlanes);
+      worker.FileNames[idx] = this->InternalFileName;
       }
+    }
 
-    this->ComputeInternalFileName(fileIdx);
-    this->ReadOneFile(this->InternalFileName, fileIdx,
-                      bufferPtr, framesInFile*fileFrameSize);
+  // never use more threads than there are files
+  int numThreads = this->NumberOfThreads;
+  if (static_cast<size_t>(numThreads) > files.size())
+    {
+    numThreads = static_cast<int>(files.size());
+    }
+  if (numThreads > VTK_MAX_THREADS)
+    {
+    numThreads = VTK_MAX_THREADS;
+    }
 
-    // iterate through all frames contained in the file
-    for (int sIdx = 0; sIdx < numFrames; sIdx++)
-      {
-      int frameIdx = frames[sIdx].FrameIndex;
-      int sliceIdx = frames[sIdx].SliceIndex;
-      int componentIdx = frames[sIdx].ComponentIndex;
-      // go to the correct position in the input
-      unsigned char *framePtr = bufferPtr + frameIdx*fileFrameSize;
-      // go to the correct position in the output
-      unsigned char *slicePtr =
-        (dataPtr + (sliceIdx - extent[4])*sliceSize +
-         componentIdx*filePixelSize*numPlanes);
-
-      // rescale if Rescale was different for different files
-      if (this->NeedsRescale &&
-          this->MetaData->GetAttributeValue(fileIdx, DC::PixelData).IsValid())
-        {
-        this->RescaleBuffer(fileIdx, frameIdx, bufferPtr, sliceSize);
-        }
+  this->Worker = &worker;
 
-      // iterate through all color planes in the slice
-      unsigned char *planePtr = framePtr;
-      for (int pIdx = 0; pIdx < numPlanes; pIdx++)
-        {
-        // flip the data if necessary
-        if (flipImage)
-          {
-          int numRows = extent[3] - extent[2] + 1;
-          int halfRows = numRows/2;
-          for (int yIdx = 0; yIdx < halfRows; yIdx++)
-            {
-            unsigned char *row1 = planePtr + yIdx*fileRowSize;
-            unsigned char *row2 = planePtr + (numRows-yIdx-1)*fileRowSize;
-            memcpy(rowBuffer, row1, fileRowSize);
-            memcpy(row1, row2, fileRowSize);
-            memcpy(row2, rowBuffer, fileRowSize);
-            }
-          }
+  if (numThreads > 1)
+    {
+    // errors will be held until all the threads are finished
+    worker.Deferred = true;
+    worker.Errors.resize(this->MetaData->GetNumberOfInstances());
 
-        // convert planes into vector components
-        if (planarToPacked)
-          {
-          const unsigned char *tmpInPtr = planePtr;
-          unsigned char *tmpOutPtr = slicePtr;
-          int m = sliceSize/pixelSize;
-          for (int i = 0; i < m; i++)
-            {
-            vtkIdType n = filePixelSize;
-            do { *tmpOutPtr++ = *tmpInPtr++; } while (--n);
-            tmpOutPtr += pixelSize - filePixelSize;
-            }
-          slicePtr += filePixelSize;
-          }
-        else if (slicePtr != planePtr)
-          {
-          memcpy(slicePtr, planePtr, filePlaneSize);
-          }
+    vtkMultiThreader *threader = vtkMultiThreader::New();
+    threader->SetNumberOfThreads(numThreads);
+    threader->SetSingleMethod(vtkDICOMReaderWorker::ThreadFunction, &worker);
+    threader->SingleMethodExecute();
+    threader->Delete();
 
-        planePtr += filePlaneSize;
-        }
-      }
+    worker.ReportErrors();
+    }
+  else
+    {
+    worker.Execute(0);
     }
 
-  delete [] rowBuffer;
-  delete [] fileBuffer;
+  this->Worker = 0;
 
   this->UpdateProgress(1.0);
   this->InvokeEvent(vtkCommand::EndEvent);
@@ -30,6 +30,7 @@ class vtkMedicalImageProperties;
 class vtkDICOMMetaData;
 class vtkDICOMParser;
 class vtkDICOMSliceSorter;
+class vtkDICOMReaderWorker;
 
 //----------------------------------------------------------------------------
 class VTK_DICOM_EXPORT vtkDICOMReader : public vtkImageReader2
@@ -185,6 +186,43 @@ public:
   int GetMemoryRowOrder() { return this->MemoryRowOrder; }
   const char *GetMemoryRowOrderAsString();
 
+  // Description:
+  // Set the number of threads to use when reading the files (default: 1).
+  // If more than one thread is used, then the files are distributed
+  // amongst the threads.  When the meta data is read, each thread has
+  // its own parser, and the meta data is merged in file order after all
+  // of the threads are finished.  When the pixel data is read, each
+  // thread reads its files directly into the output.  If there is only
+  // one file, then the frames of an RLE or JPEG lossless file are decoded
+  // by several threads instead.  Errors are held until all of the threads
+  // are finished, and are then reported in the same order as for a
+  // single thread.
+  // Subclasses that override ReadFileNative() or ReadFileDelegated()
+  // must use FileReadError() instead of vtkErrorMacro() to report errors.
+  vtkSetClampMacro(NumberOfThreads, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfThreads, int);
+
+  // Description:
+  // Use memory mapping to read the files (default: Off).
+  // If this is on, then each file is mapped into memory, the meta data
+  // is decoded directly from the mapped memory, and uncompressed, RLE,
+  // or JPEG lossless pixel data is unpacked directly from the mapped
+  // memory without first being read into an intermediate buffer.  Files
+  // that cannot be mapped are read in the usual manner.  This is most
+  // useful for large files, especially multi-frame files.
+  vtkSetMacro(MemoryMapping, int);
+  vtkGetMacro(MemoryMapping, int);
+  vtkBooleanMacro(MemoryMapping, int);
+
+  // Description:
+  // Defer the reading of large values in the meta data (default: 0).
+  // If this is set to a nonzero number of bytes, then any OB, OW, OF,
+  // OD, or UN value larger than this is not read with the rest of the
+  // header, and is instead read from the file when it is first used.
+  // See vtkDICOMParser::SetDeferredValueThreshold() for details.
+  vtkSetMacro(DeferredValueThreshold, unsigned int);
+  vtkGetMacro(DeferredValueThreshold, unsigned int);
+
 protected:
   vtkDICOMReader();
   ~vtkDICOMReader();
@@ -224,6 +262,13 @@ protected:
     const char *filename, int idx,
     unsigned char *buffer, vtkIdType bufferSize);
 
+  // Description:
+  // Report an error that occurred while reading the specified file.
+  // If the files are being read by multiple threads, then the error
+  // is held until all of the threads are finished.  If the errorCode
+  // is vtkErrorCode::NoError, then the ErrorCode will not be changed.
+  void FileReadError(int fileIdx, unsigned long errorCode, const char *text);
+
   // Description:
   // Rescale the data in the buffer.
   virtual void RescaleBuffer(
@@ -326,6 +371,25 @@ protected:
   // The stack to load.
   char DesiredStackID[20];
 
+  // Description:
+  // The number of threads to use for reading the files.
+  int NumberOfThreads;
+
+  // Description:
+  // Whether to use memory mapping when reading the files.
+  int MemoryMapping;
+
+  // Description:
+  // The size above which values are not read until they are used.
+  unsigned int DeferredValueThreshold;
+
+  // Description:
+  // The object that is reading the files, during RequestData only.
+  vtkDICOMReaderWorker *Worker;
+
+  // used to share the file reading methods with the worker threads
+  friend class vtkDICOMReaderWorker;
+
 private:
   vtkDICOMReader(const vtkDICOMReader&);  // Not implemented.
   void operator=(const vtkDICOMReader&);  // Not implemented.
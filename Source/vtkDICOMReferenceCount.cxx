@@ -15,6 +15,12 @@
 
 #include <vtkWindows.h>
 
+#if !defined(_WIN32) && \
+    !defined(__ATOMIC_ACQUIRE) && !defined(VTK_HAVE_SYNC_BUILTINS)
+#include <vtkMutexLock.h>
+#define VTK_DICOM_ATOMIC_USE_LOCK
+#endif
+
 #if defined(_WIN32)
 unsigned int vtkDICOMReferenceCount::operator--()
 {
@@ -30,3 +36,67 @@ unsigned int vtkDICOMReferenceCount::operator++()
     InterlockedIncrement(reinterpret_cast<LONG *>(&this->Counter)));
 }
 #endif
+
+#if defined(_WIN32)
+void *vtkDICOMAtomicPointer::LoadPointer(void *const *ptr)
+{
+  // the barrier keeps later reads from moving ahead of this one
+  void *value = *static_cast<void *const volatile *>(ptr);
+  MemoryBarrier();
+  return value;
+}
+
+void vtkDICOMAtomicPointer::StorePointer(void **ptr, void *value)
+{
+  InterlockedExchangePointer(reinterpret_cast<PVOID volatile *>(ptr), value);
+}
+
+void *vtkDICOMAtomicPointer::CompareAndSwapPointer(
+  void **ptr, void *expected, void *value)
+{
+  return InterlockedCompareExchangePointer(
+    reinterpret_cast<PVOID volatile *>(ptr), value, expected);
+}
+#endif
+
+#if defined(VTK_DICOM_ATOMIC_USE_LOCK)
+// Without atomic operations, all pointer operations share one lock.
+// It is constructed on first use, which happens during the static
+// initialization of the dictionaries, before any threads are started.
+static vtkSimpleMutexLock *vtkDICOMAtomicPointerLock()
+{
+  static vtkSimpleMutexLock *lock = new vtkSimpleMutexLock;
+  return lock;
+}
+
+void *vtkDICOMAtomicPointer::LoadPointer(void *const *ptr)
+{
+  vtkSimpleMutexLock *lock = vtkDICOMAtomicPointerLock();
+  lock->Lock();
+  void *value = *ptr;
+  lock->Unlock();
+  return value;
+}
+
+void vtkDICOMAtomicPointer::StorePointer(void **ptr, void *value)
+{
+  vtkSimpleMutexLock *lock = vtkDICOMAtomicPointerLock();
+  lock->Lock();
+  *ptr = value;
+  lock->Unlock();
+}
+
+void *vtkDICOMAtomicPointer::CompareAndSwapPointer(
+  void **ptr, void *expected, void *value)
+{
+  vtkSimpleMutexLock *lock = vtkDICOMAtomicPointerLock();
+  lock->Lock();
+  void *previous = *ptr;
+  if (previous == expected)
+    {
+    *ptr = value;
+    }
+  lock->Unlock();
+  return previous;
+}
+#endif
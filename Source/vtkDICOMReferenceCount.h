@@ -32,6 +32,9 @@ public:
   unsigned int operator--();
   unsigned int operator++();
 
+  unsigned int GetValue() const {
+    return this->Counter; }
+
   bool operator==(unsigned int x) const {
     return this->Counter == x; }
   bool operator!=(unsigned int x) const {
@@ -63,4 +66,79 @@ inline unsigned int vtkDICOMReferenceCount::operator++()
 }
 #endif
 
+//! Atomic operations for pointers that are shared between threads.
+/*!
+ *  These are used to publish objects that are built while other threads
+ *  might be reading them:  a reader that loads the pointer will either
+ *  see the old value, or the new value and the fully constructed object
+ *  that it points to.  The typed methods are convenience wrappers for
+ *  the LoadPointer(), StorePointer(), and CompareAndSwapPointer() methods.
+ */
+class VTK_DICOM_EXPORT vtkDICOMAtomicPointer
+{
+public:
+  //! Read a pointer, with acquire semantics.
+  static void *LoadPointer(void *const *ptr);
+
+  //! Write a pointer, with release semantics.
+  static void StorePointer(void **ptr, void *value);
+
+  //! Write "value" if the pointer is equal to "expected".
+  /*!
+   *  The pointer's previous value is returned, so the write succeeded
+   *  if the return value is equal to "expected".
+   */
+  static void *CompareAndSwapPointer(void **ptr, void *expected, void *value);
+
+  template<class T>
+  static T *Load(T *const *ptr) {
+    return static_cast<T *>(
+      LoadPointer(reinterpret_cast<void *const *>(ptr))); }
+
+  template<class T>
+  static void Store(T **ptr, T *value) {
+    StorePointer(reinterpret_cast<void **>(ptr), value); }
+
+  template<class T>
+  static T *CompareAndSwap(T **ptr, T *expected, T *value) {
+    return static_cast<T *>(CompareAndSwapPointer(
+      reinterpret_cast<void **>(ptr), expected, value)); }
+};
+
+#if !defined(_WIN32) && \
+    (defined(__ATOMIC_ACQUIRE) || defined(VTK_HAVE_SYNC_BUILTINS))
+inline void *vtkDICOMAtomicPointer::LoadPointer(void *const *ptr)
+{
+#if defined(__ATOMIC_ACQUIRE)
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else
+  void *value = *static_cast<void *const volatile *>(ptr);
+  __sync_synchronize();
+  return value;
+#endif
+}
+
+inline void vtkDICOMAtomicPointer::StorePointer(void **ptr, void *value)
+{
+#if defined(__ATOMIC_RELEASE)
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#else
+  __sync_synchronize();
+  *static_cast<void *volatile *>(ptr) = value;
+#endif
+}
+
+inline void *vtkDICOMAtomicPointer::CompareAndSwapPointer(
+  void **ptr, void *expected, void *value)
+{
+#if defined(VTK_HAVE_SYNC_BUILTINS)
+  return __sync_val_compare_and_swap(ptr, expected, value);
+#else
+  __atomic_compare_exchange_n(
+    ptr, &expected, value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  return expected;
+#endif
+}
+#endif
+
 #endif /* vtkDICOMReferenceCount_h */
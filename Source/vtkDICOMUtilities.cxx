@@ -13,19 +13,23 @@
 =========================================================================*/
 
 #include <vtkStringArray.h>
+#include <vtkMutexLock.h>
 #include "vtkDICOMUtilities.h"
 #include "vtkDICOMFile.h"
 
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
-// needed for gettimeofday
+// needed for gettimeofday and getpid
 #ifndef _WIN32
 #include <time.h>
 #include <sys/time.h>
+#include <unistd.h>
 #endif
 
 // needed for random number generation and time
@@ -36,24 +40,50 @@
 
 namespace {
 
-// divide a hex string by 10, return remainder
-int vtkDivideHexStringBy10(char *value)
+// divide a multi-word integer (most significant word first) by one
+// billion, and return the remainder
+unsigned int vtkDivideWordsByBillion(unsigned int *x, int n)
 {
-  char *cp = value;
+  const unsigned int billion = 1000000000u;
+  unsigned long long r = 0;
+  for (int i = 0; i < n; i++)
+    {
+    r = (r << 32) + x[i];
+    x[i] = static_cast<unsigned int>(r / billion);
+    r %= billion;
+    }
+  return static_cast<unsigned int>(r);
+}
+
+// convert a hex string (such as a uuid) into a decimal string
+void vtkConvertHexToDecimal(const char *uuid, char *uid)
+{
+  // max characters in a uuid and uid
+  const unsigned int uuidlen = 36;
+  const unsigned int uidlen = 64;
+  const int n = (uuidlen + 7)/8;
+
+  if (uuid[0] == '0' && uuid[1] == 'x')
+    {
+    uuid += 2;
+    }
 
-  // convert hex string to binary
-  unsigned int x = 0;
-  while (*cp != '\0')
+  // convert hex string to binary, as 32-bit words
+  unsigned int x[n];
+  for (int i = 0; i < n; i++)
+    {
+    x[i] = 0;
+    }
+  for (unsigned int j = 0; j < uuidlen && uuid[j] != '\0'; j++)
     {
     // skip any hyphens
-    if (*cp == '-')
+    if (uuid[j] == '-')
       {
-      cp++;
       continue;
       }
 
     // convert hex digit to a nibble
-    unsigned int d = *cp;
+    unsigned int d = uuid[j];
     if ((d -= '0') > 9)
       {
       if ((d -= ('A' - '0' - 10)) > 15)
@@ -63,71 +93,38 @@ int vtkDivideHexStringBy10(char *value)
       }
 
     // append the nibble
-    x <<= 4;
-    x += d;
-
-    // divide by 10
-    unsigned int y = (10 << 3);
-    unsigned int z = 0;
-    int i;
-    for (i = 0; i < 4; i++)
+    for (int i = 0; i < n - 1; i++)
       {
-      z <<= 1;
-      int nx = x - y;
-      if (nx >= 0)
-        {
-        x = nx;
-        z++;
-        }
-      y >>= 1;
+      x[i] = (x[i] << 4) | (x[i+1] >> 28);
       }
-
-    // convert quotient to new hex digit
-    if ((z += '0') > '9')
-      {
-      z += ('A' - '0' - 10);
-      }
-
-    *cp++ = static_cast<char>(z);
+    x[n-1] = (x[n-1] << 4) | (d & 0x0F);
     }
 
-  // return the remainder
-  return static_cast<int>(x);
-}
-
-// convert a hex uuid string to a decimal uid string, the
-// supplied uid will be at most 1.5 times as long as the uuid
-void vtkConvertHexToDecimal(const char *uuid, char *uid)
-{
-  // max characters in a uuid and uid
-  const unsigned int uuidlen = 36;
-  const unsigned int uidlen = 64;
-
-  char x[uuidlen + 4];
   char y[uidlen + 4];
-
-  if (uuid[0] == '0' && uuid[1] == 'x')
-    {
-    uuid += 2;
-    }
-
-  strncpy(x, uuid, uuidlen);
-  x[uuidlen] = '\0';
-
   char *cp = y + uidlen;
   *cp = '\0';
 
-  char *dp = x;
+  // generate nine decimal digits at a time
+  int first = 0;
   do
     {
-    *(--cp) = vtkDivideHexStringBy10(x) + '0';
-    // remove any leading zeros
-    while (*dp == '0' || *dp == '-')
+    unsigned int r = vtkDivideWordsByBillion(x + first, n - first);
+    while (first < n && x[first] == 0)
+      {
+      first++;
+      }
+    // don't add leading zeros after the most significant digit
+    for (int k = 0; k < 9; k++)
       {
-      dp++;
+      *(--cp) = static_cast<char>('0' + r % 10);
+      r /= 10;
+      if (r == 0 && first == n)
+        {
+        break;
+        }
       }
     }
-  while (*dp != '\0');
+  while (first < n);
 
   // copy out the result
   strcpy(uid, cp);
@@ -201,8 +198,8 @@ void vtkConvertUUIDToUID(const char *uuid, char *uid)
   vtkConvertHexToDecimal(uuid, uid + 5);
 }
 
-// read from the random number generator
-void vtkGenerateRandomBytes(unsigned char *bytes, vtkIdType n)
+// read from the system's random number generator
+bool vtkReadSystemRandomBytes(unsigned char *bytes, size_t n)
 {
   int r = 0;
 #ifdef _WIN32
@@ -217,7 +214,8 @@ void vtkGenerateRandomBytes(unsigned char *bytes, vtkIdType n)
     }
   if (r != 0)
     {
-    r = CryptGenRandom(hProv, n, reinterpret_cast<BYTE *>(bytes));
+    r = CryptGenRandom(hProv, static_cast<DWORD>(n),
+                       reinterpret_cast<BYTE *>(bytes));
     CryptReleaseContext(hProv, 0);
     }
 #else
@@ -225,13 +223,91 @@ void vtkGenerateRandomBytes(unsigned char *bytes, vtkIdType n)
   if (infile.GetError() == 0)
     {
     size_t m = infile.Read(bytes, n);
-    r = (m == static_cast<size_t>(n));
+    r = (m == n);
     infile.Close();
     }
 #endif
-  if (r == 0)
+  return (r != 0);
+}
+
+// A pool of random bytes that is refilled from the system's random
+// number generator when it runs dry, so that the generator does not
+// have to be opened every time a UID is generated.
+class vtkDICOMRandomPool
+{
+public:
+  vtkDICOMRandomPool() : Position(PoolSize), ProcessId(0) {}
+  ~vtkDICOMRandomPool() { memset(this->Pool, 0, PoolSize); }
+
+  // Get n random bytes, return false if the generator failed.
+  bool Read(unsigned char *bytes, size_t n);
+
+private:
+  enum { PoolSize = 4096 };
+
+  vtkSimpleMutexLock Lock;
+  size_t Position;
+  long ProcessId;
+  unsigned char Pool[PoolSize];
+};
+
+bool vtkDICOMRandomPool::Read(unsigned char *bytes, size_t n)
+{
+  // large requests go directly to the system
+  if (n >= PoolSize/4)
+    {
+    return vtkReadSystemRandomBytes(bytes, n);
+    }
+
+#ifdef _WIN32
+  long pid = 0;
+#else
+  // a forked child must not re-use the parent's bytes
+  long pid = static_cast<long>(getpid());
+#endif
+
+  bool r = true;
+  this->Lock.Lock();
+  if (pid != this->ProcessId)
+    {
+    this->Position = PoolSize;
+    this->ProcessId = pid;
+    }
+  while (n > 0)
     {
-    memset(bytes, '\0', n);
+    if (this->Position == PoolSize)
+      {
+      if (!vtkReadSystemRandomBytes(this->Pool, PoolSize))
+        {
+        r = false;
+        break;
+        }
+      this->Position = 0;
+      }
+    size_t m = PoolSize - this->Position;
+    m = (n < m ? n : m);
+    // erase the bytes from the pool as they are used
+    unsigned char *cp = this->Pool + this->Position;
+    memcpy(bytes, cp, m);
+    memset(cp, 0, m);
+    this->Position += m;
+    bytes += m;
+    n -= m;
+    }
+  this->Lock.Unlock();
+
+  return r;
+}
+
+vtkDICOMRandomPool vtkDICOMRandomPoolInstance;
+
+// read from the random number generator
+void vtkGenerateRandomBytes(unsigned char *bytes, vtkIdType n)
+{
+  size_t m = static_cast<size_t>(n);
+  if (!vtkDICOMRandomPoolInstance.Read(bytes, m))
+    {
+    memset(bytes, '\0', m);
     vtkGenericWarningMacro(
       "vtkDICOMUtilities::GenerateUID() failed to read from "
       "the random number generator");
@@ -340,6 +416,18 @@ void vtkGeneratePrefixedUID(
     }
 }
 
+// for sorting UIDs that are stored in fixed-size buffers
+struct vtkDICOMUIDLess
+{
+  vtkDICOMUIDLess(const char (*uids)[64]) : UIDs(uids) {}
+
+  bool operator()(vtkIdType i, vtkIdType j) const {
+    return (vtkDICOMUtilities::CompareUIDs(
+              this->UIDs[i], this->UIDs[j]) < 0); }
+
+  const char (*UIDs)[64];
+};
+
 } // end anonymous namespace
 
 //----------------------------------------------------------------------------
@@ -399,9 +487,11 @@ void vtkDICOMUtilities::GenerateUIDs(vtkDICOMTag tag, vtkStringArray *uids)
   unsigned char *r = new unsigned char[n*m];
   vtkGenerateRandomBytes(r, n*m);
 
+  char (*buffer)[64] = new char[n][64];
+  std::vector<vtkIdType> order(n);
   for (vtkIdType i = 0; i < n; i++)
     {
-    char uid[64];
+    char *uid = buffer[i];
 
     if (useUUIDForUID)
       {
@@ -414,22 +504,17 @@ void vtkDICOMUtilities::GenerateUIDs(vtkDICOMTag tag, vtkStringArray *uids)
       vtkGeneratePrefixedUID(r + i*m, m, prefix, d, uid);
       }
 
-    // put uids into the array in order (simple insertion sort)
-    vtkIdType j = 0;
-    for (; j < i; j++)
-      {
-      if (vtkDICOMUtilities::CompareUIDs(uids->GetValue(j), uid) > 0)
-        {
-        break;
-        }
-      }
-    for (vtkIdType k = i; k > j; --k)
-      {
-      uids->SetValue(k, uids->GetValue(k - 1));
-      }
-    uids->SetValue(j, uid);
+    order[i] = i;
     }
 
+  // put uids into the array in order
+  std::sort(order.begin(), order.end(), vtkDICOMUIDLess(buffer));
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    uids->SetValue(i, buffer[order[i]]);
+    }
+
+  delete [] buffer;
   delete [] r;
 }
 
@@ -759,6 +844,18 @@ bool vtkDICOMUtilities::IsDICOMFile(const char *filename)
     return false;
     }
 
+  return vtkDICOMUtilities::IsDICOMFileHeader(buffer, size);
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMUtilities::IsDICOMFileHeader(
+  const unsigned char *buffer, size_t size)
+{
+  if (buffer == 0)
+    {
+    return false;
+    }
+
   const unsigned char *cp = buffer;
 
   // Look for the magic number and the first meta header tag.
@@ -39,6 +39,11 @@ public:
   static const char *GetUIDPrefix();
 
   //! Generate a UID for the provided tag.
+  /*!
+   *  The random bits are drawn from a pool that is shared by all
+   *  threads and refilled from the system's random number generator
+   *  as needed, so this method can safely be called from any thread.
+   */
   static std::string GenerateUID(vtkDICOMTag tag);
 
   //! Generate a series of UIDs, sorted from low to high.
@@ -47,7 +52,8 @@ public:
    *  the array to specify the number of UIDs that you want to be
    *  stored in it.  The stored UIDs will be sorted, low to high.
    *  Generating a batch of UIDs is more efficient than calling
-   *  GenerateUID() repeatedly.
+   *  GenerateUID() repeatedly, since all of the random bits are read
+   *  from the system's random number generator at once.
    */
   static void GenerateUIDs(vtkDICOMTag tag, vtkStringArray *uids);
 
@@ -102,6 +108,15 @@ public:
    */
   static bool IsDICOMFile(const char *filename);
 
+  //! Check if the first bytes of a file are those of a DICOM file.
+  /*!
+   *  This does the same check as IsDICOMFile(), but on data that has
+   *  already been read from the file, so that the file does not have
+   *  to be opened again.  Unless the DICM magic number is present,
+   *  at least the first 256 bytes are needed.
+   */
+  static bool IsDICOMFileHeader(const unsigned char *buffer, size_t size);
+
   //! Get the UID for this DICOM implementation.
   static const char *GetImplementationClassUID();
 
@@ -15,14 +15,18 @@
 #include "vtkDICOMItem.h"
 #include "vtkDICOMSequence.h"
 #include "vtkDICOMUtilities.h"
+#include "vtkDICOMFile.h"
 
 #include <vtkMath.h>
 #include <vtkTypeTraits.h>
+#include <vtkByteSwap.h>
+#include <vtkMutexLock.h>
 
 #include <math.h>
 #include <float.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 #include <new>
@@ -155,6 +159,164 @@ void ValueFree(void *vp)
 #define OVERFLOW_BYTE(vn) 0
 #endif
 
+//----------------------------------------------------------------------------
+// The pool allocates memory in blocks, the first block is small so that
+// pools that hold only a few values don't waste much memory.
+#define POOL_INITIAL_BLOCK_SIZE 4096
+#define POOL_MAXIMUM_BLOCK_SIZE 65536
+
+// Each block starts with a header that links it to the other blocks.
+struct vtkDICOMValue::Pool::Block
+{
+  Block *Next;
+  size_t Size;
+};
+
+namespace {
+
+// Each pooled value is preceded by a pointer to its pool, padded so
+// that the value itself has the same alignment as a double.
+union PoolPrefix
+{
+  vtkDICOMValue::Pool *Owner;
+  double Alignment;
+};
+
+// Round up to a multiple of the size of the prefix.
+inline size_t PoolAlign(size_t size)
+{
+  return (size + (sizeof(PoolPrefix) - 1)) & ~(sizeof(PoolPrefix) - 1);
+}
+
+} // end anonymous namespace
+
+vtkDICOMValue::Pool::Pool()
+  : ReferenceCount(1), Head(0), Ptr(0), End(0),
+    BlockSize(POOL_INITIAL_BLOCK_SIZE)
+{
+}
+
+vtkDICOMValue::Pool::~Pool()
+{
+  this->FreeBlocks(0);
+}
+
+vtkDICOMValue::Pool *vtkDICOMValue::Pool::New()
+{
+  return new Pool;
+}
+
+void vtkDICOMValue::Pool::Release()
+{
+  if (--this->ReferenceCount == 0)
+    {
+    delete this;
+    }
+}
+
+vtkDICOMValue::Pool *vtkDICOMValue::Pool::Recycle()
+{
+  // if no values hold a reference, nobody else can be using the pool
+  if (this->ReferenceCount == 1)
+    {
+    // keep the current block, it is the most recent and largest one
+    this->FreeBlocks(this->Head);
+    if (this->Head)
+      {
+      char *cp = reinterpret_cast<char *>(this->Head);
+      this->Ptr = cp + PoolAlign(sizeof(Block));
+      this->End = cp + this->Head->Size;
+      }
+    return this;
+    }
+
+  this->Release();
+  return 0;
+}
+
+void vtkDICOMValue::Pool::FreeBlocks(Block *keep)
+{
+  Block *block = this->Head;
+  while (block)
+    {
+    Block *next = block->Next;
+    if (block != keep)
+      {
+      ValueFree(block);
+      }
+    block = next;
+    }
+  if (keep)
+    {
+    keep->Next = 0;
+    }
+  else
+    {
+    this->Ptr = 0;
+    this->End = 0;
+    }
+  this->Head = keep;
+}
+
+void *vtkDICOMValue::Pool::Allocate(size_t size)
+{
+  size_t n = PoolAlign(sizeof(PoolPrefix) + size);
+  char *cp = this->Ptr;
+  if (n > static_cast<size_t>(this->End - cp))
+    {
+    size_t h = PoolAlign(sizeof(Block));
+    if (n > this->BlockSize/4)
+      {
+      // large values get a block of their own, which is linked in after
+      // the current block so that the current block can still be used
+      Block *block = static_cast<Block *>(ValueMalloc(h + n));
+      block->Size = h + n;
+      if (this->Head)
+        {
+        block->Next = this->Head->Next;
+        this->Head->Next = block;
+        }
+      else
+        {
+        block->Next = 0;
+        this->Head = block;
+        }
+      cp = reinterpret_cast<char *>(block) + h;
+      }
+    else
+      {
+      // start a new block, and grow the block size for next time
+      Block *block = static_cast<Block *>(ValueMalloc(this->BlockSize));
+      block->Size = this->BlockSize;
+      block->Next = this->Head;
+      this->Head = block;
+      cp = reinterpret_cast<char *>(block) + h;
+      this->End = reinterpret_cast<char *>(block) + this->BlockSize;
+      this->Ptr = cp + n;
+      if (this->BlockSize < POOL_MAXIMUM_BLOCK_SIZE)
+        {
+        this->BlockSize *= 2;
+        }
+      }
+    }
+  else
+    {
+    this->Ptr = cp + n;
+    }
+
+  // every value holds a reference to the pool
+  ++this->ReferenceCount;
+  PoolPrefix *prefix = reinterpret_cast<PoolPrefix *>(cp);
+  prefix->Owner = this;
+  return prefix + 1;
+}
+
+void vtkDICOMValue::Pool::Free(void *vp)
+{
+  PoolPrefix *prefix = static_cast<PoolPrefix *>(vp) - 1;
+  prefix->Owner->Release();
+}
+
 //----------------------------------------------------------------------------
 // Construct a numerical value.
 template<class T>
@@ -264,14 +426,16 @@ vtkDICOMValue& vtkDICOMValue::operator=(const vtkDICOMSequence& o)
 }
 
 template<class T>
-T *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn)
+T *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn, Pool *pool)
 {
   this->Clear();
   // Use C++ "placement new" to allocate a single block of memory that
   // includes both the Value struct and the array of values.
   size_t n = vn + !vn; // add one if zero
-  void *vp = ValueMalloc(sizeof(Value) + n*sizeof(T));
+  size_t size = sizeof(Value) + n*sizeof(T);
+  void *vp = (pool ? pool->Allocate(size) : ValueMalloc(size));
   ValueT<T> *v = new(vp) ValueT<T>(vr, vn);
+  v->Pooled = (pool != 0);
   // Test the assumption that Data is at an offset of sizeof(Value)
   assert(static_cast<char *>(static_cast<void *>(v->Data)) ==
          static_cast<char *>(vp) + sizeof(Value));
@@ -280,14 +444,16 @@ T *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn)
 }
 
 template<>
-unsigned char *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn)
+unsigned char *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn, Pool *pool)
 {
   this->Clear();
   // Use C++ "placement new" to allocate a single block of memory that
   // includes both the Value struct and the array of values.
   size_t n = vn + !vn; // add one if zero
-  void *vp = ValueMalloc(sizeof(Value) + n);
+  size_t size = sizeof(Value) + n;
+  void *vp = (pool ? pool->Allocate(size) : ValueMalloc(size));
   ValueT<unsigned char> *v = new(vp) ValueT<unsigned char>(vr, vn);
+  v->Pooled = (pool != 0);
   // Test the assumption that Data is at an offset of sizeof(Value)
   assert(static_cast<char *>(static_cast<void *>(v->Data)) ==
          static_cast<char *>(vp) + sizeof(Value));
@@ -296,7 +462,7 @@ unsigned char *vtkDICOMValue::Allocate(vtkDICOMVR vr, size_t vn)
 }
 
 template<>
-char *vtkDICOMValue::Allocate<char>(vtkDICOMVR vr, size_t vn)
+char *vtkDICOMValue::Allocate<char>(vtkDICOMVR vr, size_t vn, Pool *pool)
 {
   this->Clear();
   // Strings of any type other than UI will be padded with spaces to
@@ -305,23 +471,26 @@ char *vtkDICOMValue::Allocate<char>(vtkDICOMVR vr, size_t vn)
   size_t pad = (vn & static_cast<size_t>(vr != vtkDICOMVR::UI));
   // Use C++ "placement new" to allocate a single block of memory that
   // includes both the Value struct and the array of values.
-  void *vp = ValueMalloc(sizeof(Value) + vn + pad + 1);
+  size_t size = sizeof(Value) + vn + pad + 1;
+  void *vp = (pool ? pool->Allocate(size) : ValueMalloc(size));
   ValueT<char> *v = new(vp) ValueT<char>(vr, vn);
+  v->Pooled = (pool != 0);
   // Test the assumption that Data is at an offset of sizeof(Value)
   assert(v->Data == static_cast<char *>(vp) + sizeof(Value));
   this->V = v;
   return v->Data;
 }
 
-char *vtkDICOMValue::AllocateCharData(vtkDICOMVR vr, size_t vn)
+char *vtkDICOMValue::AllocateCharData(
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<char>(vr, vn);
+  return this->Allocate<char>(vr, vn, pool);
 }
 
 char *vtkDICOMValue::AllocateCharData(
-  vtkDICOMVR vr, vtkDICOMCharacterSet cs, size_t vn)
+  vtkDICOMVR vr, vtkDICOMCharacterSet cs, size_t vn, Pool *pool)
 {
-  char *data = this->Allocate<char>(vr, vn);
+  char *data = this->Allocate<char>(vr, vn, pool);
   if (vr.HasSpecificCharacterSet() && this->V)
     {
     this->V->CharacterSet = cs.GetKey();
@@ -330,47 +499,51 @@ char *vtkDICOMValue::AllocateCharData(
 }
 
 unsigned char *vtkDICOMValue::AllocateUnsignedCharData(
-  vtkDICOMVR vr, size_t vn)
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<unsigned char>(vr, vn);
+  return this->Allocate<unsigned char>(vr, vn, pool);
 }
 
-short *vtkDICOMValue::AllocateShortData(vtkDICOMVR vr, size_t vn)
+short *vtkDICOMValue::AllocateShortData(
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<short>(vr, vn);
+  return this->Allocate<short>(vr, vn, pool);
 }
 
 unsigned short *vtkDICOMValue::AllocateUnsignedShortData(
-  vtkDICOMVR vr, size_t vn)
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<unsigned short>(vr, vn);
+  return this->Allocate<unsigned short>(vr, vn, pool);
 }
 
-int *vtkDICOMValue::AllocateIntData(vtkDICOMVR vr, size_t vn)
+int *vtkDICOMValue::AllocateIntData(
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<int>(vr, vn);
+  return this->Allocate<int>(vr, vn, pool);
 }
 
 unsigned int *vtkDICOMValue::AllocateUnsignedIntData(
-  vtkDICOMVR vr, size_t vn)
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<unsigned int>(vr, vn);
+  return this->Allocate<unsigned int>(vr, vn, pool);
 }
 
-float *vtkDICOMValue::AllocateFloatData(vtkDICOMVR vr, size_t vn)
+float *vtkDICOMValue::AllocateFloatData(
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<float>(vr, vn);
+  return this->Allocate<float>(vr, vn, pool);
 }
 
-double *vtkDICOMValue::AllocateDoubleData(vtkDICOMVR vr, size_t vn)
+double *vtkDICOMValue::AllocateDoubleData(
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<double>(vr, vn);
+  return this->Allocate<double>(vr, vn, pool);
 }
 
 vtkDICOMTag *vtkDICOMValue::AllocateTagData(
-  vtkDICOMVR vr, size_t vn)
+  vtkDICOMVR vr, size_t vn, Pool *pool)
 {
-  return this->Allocate<vtkDICOMTag>(vr, vn);
+  return this->Allocate<vtkDICOMTag>(vr, vn, pool);
 }
 
 vtkDICOMItem *vtkDICOMValue::AllocateSequenceData(
@@ -448,6 +621,234 @@ unsigned char *vtkDICOMValue::ReallocateUnsignedCharData(size_t vn)
   return ptr;
 }
 
+//----------------------------------------------------------------------------
+void vtkDICOMValue::AllocateDeferredData(
+  vtkDICOMVR vr, unsigned int vl, const char *filename,
+  vtkTypeInt64 offset, bool bigEndian)
+{
+  assert(vr == vtkDICOMVR::OB || vr == vtkDICOMVR::OW ||
+         vr == vtkDICOMVR::OF || vr == vtkDICOMVR::OD ||
+         vr == vtkDICOMVR::UN);
+
+  this->Clear();
+  size_t l = strlen(filename);
+  void *vp = ValueMalloc(sizeof(DeferredValue) + l);
+  DeferredValue *v = new(vp) DeferredValue;
+
+  // the size of each value, e.g. 2 bytes for OW
+  size_t m = 1;
+  switch (vr.GetType())
+    {
+    case VTK_SHORT:
+      m = sizeof(short);
+      break;
+    case VTK_FLOAT:
+      m = sizeof(float);
+      break;
+    case VTK_DOUBLE:
+      m = sizeof(double);
+      break;
+    }
+
+  // set the VL and NumberOfValues exactly as if the data had been read
+  size_t n = vl/m;
+  v->Type = VTK_DICOM_DEFERRED;
+  v->CharacterSet = 0;
+  v->Overflow = 0;
+  v->VR = vr;
+  v->VL = static_cast<unsigned int>(m == 1 ? n + (n & 1) : n*m);
+  v->NumberOfValues = static_cast<unsigned int>(n);
+  v->Data = 0;
+  v->Lock = new vtkSimpleMutexLock;
+  v->Offset = offset;
+  v->BigEndian = bigEndian;
+  v->ReadFailed = false;
+  strcpy(v->FileName, filename);
+  this->V = v;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValue::IsDeferred() const
+{
+  bool r = false;
+  if (this->V && this->V->Type == VTK_DICOM_DEFERRED)
+    {
+    DeferredValue *d = static_cast<DeferredValue *>(this->V);
+    d->Lock->Lock();
+    r = (d->Data == 0);
+    d->Lock->Unlock();
+    }
+  return r;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMValue vtkDICOMValue::GetUnpooledCopy() const
+{
+  vtkDICOMValue v;
+  const Value *vp = this->V;
+  if (vp == 0)
+    {
+    return v;
+    }
+
+  size_t n = this->GetNumberOfValues();
+  if (vp->Pooled)
+    {
+    // only the simple types are pooled, so copy the value's memory
+    size_t m = n + (n == 0);
+    size_t l = 0;
+    switch (vp->Type)
+      {
+      case VTK_CHAR:
+        // an odd-length UI is not padded, so only VL chars are
+        // certain to be present, the terminator is added below
+        l = vp->VL;
+        break;
+      case VTK_UNSIGNED_CHAR:
+        l = m;
+        break;
+      case VTK_SHORT:
+      case VTK_UNSIGNED_SHORT:
+        l = m*sizeof(short);
+        break;
+      case VTK_INT:
+      case VTK_UNSIGNED_INT:
+        l = m*sizeof(int);
+        break;
+      case VTK_FLOAT:
+        l = m*sizeof(float);
+        break;
+      case VTK_DOUBLE:
+        l = m*sizeof(double);
+        break;
+      case VTK_DICOM_TAG:
+        l = m*sizeof(vtkDICOMTag);
+        break;
+      }
+    size_t size = sizeof(Value) + l;
+    void *dp = ValueMalloc(size + (vp->Type == VTK_CHAR));
+    memcpy(dp, vp, size);
+    if (vp->Type == VTK_CHAR)
+      {
+      static_cast<char *>(dp)[size] = '\0';
+      }
+    v.V = static_cast<Value *>(dp);
+    v.V->ReferenceCount = 1;
+    v.V->Pooled = 0;
+    }
+  else if (vp->Type == VTK_DICOM_ITEM)
+    {
+    const vtkDICOMItem *ip =
+      static_cast<const ValueT<vtkDICOMItem> *>(vp)->Data;
+    vtkDICOMItem *op = v.AllocateSequenceData(vp->VR, n);
+    for (size_t i = 0; i < n; i++)
+      {
+      op[i] = ip[i].GetUnpooledCopy();
+      }
+    v.V->VL = vp->VL;
+    }
+  else if (vp->Type == VTK_DICOM_VALUE)
+    {
+    const vtkDICOMValue *ip =
+      static_cast<const ValueT<vtkDICOMValue> *>(vp)->Data;
+    vtkDICOMValue *op = v.AllocateMultiplexData(vp->VR, n);
+    for (size_t i = 0; i < n; i++)
+      {
+      op[i] = ip[i].GetUnpooledCopy();
+      }
+    v.V->VL = vp->VL;
+    }
+  else
+    {
+    v = *this;
+    }
+
+  return v;
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMValue::Value *vtkDICOMValue::ReadDeferredData() const
+{
+  // the deferred value is never replaced by its data, since other threads
+  // might be using this same object, instead the data is kept with the
+  // deferred value (and shared with its copies) after it has been read
+  DeferredValue *d = static_cast<DeferredValue *>(this->V);
+  d->Lock->Lock();
+
+  if (d->Data == 0 && !d->ReadFailed)
+    {
+    vtkDICOMValue v;
+    size_t n = d->NumberOfValues;
+    size_t m = 1;
+    unsigned char *ptr = 0;
+    switch (d->VR.GetType())
+      {
+      case VTK_SHORT:
+        ptr = reinterpret_cast<unsigned char *>(
+          v.AllocateShortData(d->VR, n));
+        m = sizeof(short);
+        break;
+      case VTK_FLOAT:
+        ptr = reinterpret_cast<unsigned char *>(
+          v.AllocateFloatData(d->VR, n));
+        m = sizeof(float);
+        break;
+      case VTK_DOUBLE:
+        ptr = reinterpret_cast<unsigned char *>(
+          v.AllocateDoubleData(d->VR, n));
+        m = sizeof(double);
+        break;
+      default:
+        ptr = v.AllocateUnsignedCharData(d->VR, n);
+        break;
+      }
+
+    size_t l = n*m;
+    size_t r = 0;
+    vtkDICOMFile infile(d->FileName, vtkDICOMFile::In);
+    if (infile.GetError() == 0 &&
+        infile.SetPosition(static_cast<vtkDICOMFile::Size>(d->Offset)))
+      {
+      size_t k;
+      while (r < l && (k = infile.Read(ptr + r, l - r)) != 0)
+        {
+        r += k;
+        }
+      }
+    infile.Close();
+
+    if (r < l)
+      {
+      // the file was removed, truncated, or could not be read
+      d->ReadFailed = true;
+      vtkGenericWarningMacro(
+        "vtkDICOMValue: Could not read " << l << " bytes at offset "
+        << d->Offset << " in file " << d->FileName);
+      }
+    else
+      {
+#ifdef VTK_WORDS_BIGENDIAN
+      if (m > 1 && !d->BigEndian)
+#else
+      if (m > 1 && d->BigEndian)
+#endif
+        {
+        vtkByteSwap::SwapVoidRange(
+          ptr, static_cast<vtkIdType>(n), static_cast<int>(m));
+        }
+
+      // keep the data with the deferred value, for the other copies
+      d->Data = v.V;
+      v.V = 0;
+      }
+    }
+
+  Value *data = d->Data;
+  d->Lock->Unlock();
+
+  return data;
+}
+
 //----------------------------------------------------------------------------
 template<class T>
 void vtkDICOMValue::CreateValue(vtkDICOMVR vr, const T *data, size_t n)
@@ -970,8 +1371,26 @@ void vtkDICOMValue::FreeValue(Value *v)
         dp++;
         }
       }
+    else if (v->Type == VTK_DICOM_DEFERRED)
+      {
+      // release the data, if it was read
+      DeferredValue *d = static_cast<DeferredValue *>(v);
+      Value *dp = d->Data;
+      if (dp && --(dp->ReferenceCount) == 0)
+        {
+        vtkDICOMValue::FreeValue(dp);
+        }
+      delete d->Lock;
+      }
 
-    ValueFree(v);
+    if (v->Pooled)
+      {
+      Pool::Free(v);
+      }
+    else
+      {
+      ValueFree(v);
+      }
     }
 }
 //----------------------------------------------------------------------------
@@ -1082,9 +1501,10 @@ const char *vtkDICOMValue::GetCharData() const
 const unsigned char *vtkDICOMValue::GetUnsignedCharData() const
 {
   const unsigned char *ptr = 0;
-  if (this->V && this->V->Type == VTK_UNSIGNED_CHAR)
+  const Value *vp = this->LoadDeferred();
+  if (vp && vp->Type == VTK_UNSIGNED_CHAR)
     {
-    ptr = static_cast<const ValueT<unsigned char> *>(this->V)->Data;
+    ptr = static_cast<const ValueT<unsigned char> *>(vp)->Data;
     }
   return ptr;
 }
@@ -1092,17 +1512,18 @@ const unsigned char *vtkDICOMValue::GetUnsignedCharData() const
 const short *vtkDICOMValue::GetShortData() const
 {
   const short *ptr = 0;
-  if (this->V)
+  const Value *vp = this->LoadDeferred();
+  if (vp)
     {
-    if (this->V->Type == VTK_SHORT)
+    if (vp->Type == VTK_SHORT)
       {
-      ptr = static_cast<const ValueT<short> *>(this->V)->Data;
+      ptr = static_cast<const ValueT<short> *>(vp)->Data;
       }
-    else if (this->V->Type == VTK_UNSIGNED_SHORT &&
-             this->V->VR == vtkDICOMVR::OW)
+    else if (vp->Type == VTK_UNSIGNED_SHORT &&
+             vp->VR == vtkDICOMVR::OW)
       {
       ptr = reinterpret_cast<const short *>(
-        static_cast<const ValueT<unsigned short> *>(this->V)->Data);
+        static_cast<const ValueT<unsigned short> *>(vp)->Data);
       }
     }
   return ptr;
@@ -1111,17 +1532,18 @@ const short *vtkDICOMValue::GetShortData() const
 const unsigned short *vtkDICOMValue::GetUnsignedShortData() const
 {
   const unsigned short *ptr = 0;
-  if (this->V)
+  const Value *vp = this->LoadDeferred();
+  if (vp)
     {
-    if (this->V->Type == VTK_UNSIGNED_SHORT)
+    if (vp->Type == VTK_UNSIGNED_SHORT)
       {
-      ptr = static_cast<const ValueT<unsigned short> *>(this->V)->Data;
+      ptr = static_cast<const ValueT<unsigned short> *>(vp)->Data;
       }
-    else if (this->V->Type == VTK_SHORT &&
-             this->V->VR == vtkDICOMVR::OW)
+    else if (vp->Type == VTK_SHORT &&
+             vp->VR == vtkDICOMVR::OW)
       {
       ptr = reinterpret_cast<const unsigned short *>(
-        static_cast<const ValueT<short> *>(this->V)->Data);
+        static_cast<const ValueT<short> *>(vp)->Data);
       }
     }
   return ptr;
@@ -1150,9 +1572,10 @@ const unsigned int *vtkDICOMValue::GetUnsignedIntData() const
 const float *vtkDICOMValue::GetFloatData() const
 {
   const float *ptr = 0;
-  if (this->V && this->V->Type == VTK_FLOAT)
+  const Value *vp = this->LoadDeferred();
+  if (vp && vp->Type == VTK_FLOAT)
     {
-    ptr = static_cast<const ValueT<float> *>(this->V)->Data;
+    ptr = static_cast<const ValueT<float> *>(vp)->Data;
     }
   return ptr;
 }
@@ -1160,9 +1583,10 @@ const float *vtkDICOMValue::GetFloatData() const
 const double *vtkDICOMValue::GetDoubleData() const
 {
   const double *ptr = 0;
-  if (this->V && this->V->Type == VTK_DOUBLE)
+  const Value *vp = this->LoadDeferred();
+  if (vp && vp->Type == VTK_DOUBLE)
     {
-    ptr = static_cast<const ValueT<double> *>(this->V)->Data;
+    ptr = static_cast<const ValueT<double> *>(vp)->Data;
     }
   return ptr;
 }
@@ -1211,45 +1635,51 @@ vtkDICOMValue *vtkDICOMValue::GetMultiplex()
 template<class VT>
 void vtkDICOMValue::GetValuesT(VT *v, size_t c, size_t s) const
 {
-  switch (this->V->Type)
+  const Value *vp = this->LoadDeferred();
+  if (vp == 0)
+    {
+    return;
+    }
+
+  switch (vp->Type)
     {
     case VTK_CHAR:
       StringConversion(
-        static_cast<const ValueT<char> *>(this->V)->Data, this->V->VR,
+        static_cast<const ValueT<char> *>(vp)->Data, vp->VR,
         v, s, c);
       break;
     case VTK_UNSIGNED_CHAR:
       NumericalConversion(
-        static_cast<const ValueT<unsigned char> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<unsigned char> *>(vp)->Data+s, v, c);
       break;
     case VTK_SHORT:
       NumericalConversion(
-        static_cast<const ValueT<short> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<short> *>(vp)->Data+s, v, c);
       break;
     case VTK_UNSIGNED_SHORT:
       NumericalConversion(
-        static_cast<const ValueT<unsigned short> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<unsigned short> *>(vp)->Data+s, v, c);
       break;
     case VTK_INT:
       NumericalConversion(
-        static_cast<const ValueT<int> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<int> *>(vp)->Data+s, v, c);
       break;
     case VTK_UNSIGNED_INT:
       NumericalConversion(
-        static_cast<const ValueT<unsigned int> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<unsigned int> *>(vp)->Data+s, v, c);
       break;
     case VTK_FLOAT:
       NumericalConversion(
-        static_cast<const ValueT<float> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<float> *>(vp)->Data+s, v, c);
       break;
     case VTK_DOUBLE:
       NumericalConversion(
-        static_cast<const ValueT<double> *>(this->V)->Data+s, v, c);
+        static_cast<const ValueT<double> *>(vp)->Data+s, v, c);
       break;
     case VTK_DICOM_TAG:
       {
       const vtkDICOMTag *tptr =
-        static_cast<const ValueT<vtkDICOMTag> *>(this->V)->Data + s;
+        static_cast<const ValueT<vtkDICOMTag> *>(vp)->Data + s;
       for (size_t i = 0; i < c; i += 2)
         {
         v[i] = static_cast<VT>(tptr[i/2].GetGroup());
@@ -1729,49 +2159,55 @@ void vtkDICOMValue::AppendValueToString(
 
   assert(i < this->V->NumberOfValues);
 
-  switch (this->V->Type)
+  const Value *vp = this->LoadDeferred();
+  if (vp == 0)
+    {
+    return;
+    }
+
+  switch (vp->Type)
     {
     case VTK_CHAR:
-      cp = static_cast<const ValueT<char> *>(this->V)->Data;
-      dp = cp + (i == 0 ? this->V->VL : 0);
-      if (!this->V->VR.HasSingleValue())
+      cp = static_cast<const ValueT<char> *>(vp)->Data;
+      dp = cp + (i == 0 ? vp->VL : 0);
+      if (!vp->VR.HasSingleValue())
         {
         this->Substring(i, cp, dp);
         }
       break;
     case VTK_UNSIGNED_CHAR:
-      d = static_cast<const ValueT<unsigned char> *>(this->V)->Data[i];
+      d = static_cast<const ValueT<unsigned char> *>(vp)->Data[i];
       break;
     case VTK_SHORT:
-      d = static_cast<const ValueT<short> *>(this->V)->Data[i];
+      d = static_cast<const ValueT<short> *>(vp)->Data[i];
       break;
     case VTK_UNSIGNED_SHORT:
-      d = static_cast<const ValueT<unsigned short> *>(this->V)->Data[i];
+      d = static_cast<const ValueT<unsigned short> *>(vp)->Data[i];
       break;
     case VTK_INT:
-      d = static_cast<const ValueT<int> *>(this->V)->Data[i];
+      d = static_cast<const ValueT<int> *>(vp)->Data[i];
       break;
     case VTK_UNSIGNED_INT:
-      u = static_cast<const ValueT<unsigned int> *>(this->V)->Data[i];
+      u = static_cast<const ValueT<unsigned int> *>(vp)->Data[i];
       break;
     case VTK_FLOAT:
-      f = static_cast<const ValueT<float> *>(this->V)->Data[i];
+      f = static_cast<const ValueT<float> *>(vp)->Data[i];
       break;
     case VTK_DOUBLE:
-      f = static_cast<const ValueT<double> *>(this->V)->Data[i];
+      f = static_cast<const ValueT<double> *>(vp)->Data[i];
       break;
     case VTK_DICOM_TAG:
-      a = static_cast<const ValueT<vtkDICOMTag> *>(this->V)->Data[i];
+      a = static_cast<const ValueT<vtkDICOMTag> *>(vp)->Data[i];
       break;
     }
 
-  if (this->V->Type == VTK_CHAR)
+  if (vp->Type == VTK_CHAR)
     {
     while (cp != dp && dp[-1] == '\0') { --dp; }
     str.append(cp, dp);
     }
-  else if (this->V->Type == VTK_FLOAT ||
-           this->V->Type == VTK_DOUBLE)
+  else if (vp->Type == VTK_FLOAT ||
+           vp->Type == VTK_DOUBLE)
     {
     // force consistent printing of "inf", "nan" regardless of platform
     if (vtkMath::IsNan(f))
@@ -1789,12 +2225,12 @@ void vtkDICOMValue::AppendValueToString(
       // use exponential form if printing in "%f" format
       // would print an integer that is too large for the
       // float to accurately represent.
-      if ((this->V->Type == VTK_DOUBLE &&
+      if ((vp->Type == VTK_DOUBLE &&
            fabs(f) <= 9007199254740992.0) || // 2^53
-          (this->V->Type == VTK_FLOAT &&
+          (vp->Type == VTK_FLOAT &&
            fabs(f) <= 16777216.0)) // 2^24
         {
-        if (this->V->Type == VTK_DOUBLE)
+        if (vp->Type == VTK_DOUBLE)
           {
           sprintf(text, "%#.16g", f);
           }
@@ -1812,7 +2248,7 @@ void vtkDICOMValue::AppendValueToString(
         }
       else
         {
-        if (this->V->Type == VTK_DOUBLE)
+        if (vp->Type == VTK_DOUBLE)
           {
           sprintf(text, "%.15e", f);
           }
@@ -1841,11 +2277,11 @@ void vtkDICOMValue::AppendValueToString(
       str.append(text);
       }
     }
-  else if (this->V->Type == VTK_UNSIGNED_CHAR ||
-           this->V->Type == VTK_SHORT ||
-           this->V->Type == VTK_UNSIGNED_SHORT ||
-           this->V->Type == VTK_INT ||
-           this->V->Type == VTK_UNSIGNED_INT)
+  else if (vp->Type == VTK_UNSIGNED_CHAR ||
+           vp->Type == VTK_SHORT ||
+           vp->Type == VTK_UNSIGNED_SHORT ||
+           vp->Type == VTK_INT ||
+           vp->Type == VTK_UNSIGNED_INT)
     {
     // simple code to convert an integer to a string
     char text[16];
@@ -1875,7 +2311,7 @@ void vtkDICOMValue::AppendValueToString(
 
     str.append(&text[ti], &text[16]);
     }
-  else if (this->V->Type == VTK_DICOM_TAG)
+  else if (vp->Type == VTK_DICOM_TAG)
     {
     char text[12];
     int t[2];
@@ -2298,18 +2734,25 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
     return false;
     }
 
+  Value *tv = this->LoadDeferred();
+  Value *qv = value.LoadDeferred();
+  if (tv == 0 || qv == 0)
+    {
+    return false;
+    }
+
   bool match = false;
-  vtkDICOMVR vr = this->V->VR;
-  int type = this->V->Type;
+  vtkDICOMVR vr = tv->VR;
+  int type = tv->Type;
 
   // First, do comparisons for string values
   if (type == VTK_CHAR)
     {
     // Does the pattern string have wildcards?
     bool wildcard = false;
-    const char *pattern = static_cast<const ValueT<char> *>(value.V)->Data;
+    const char *pattern = static_cast<const ValueT<char> *>(qv)->Data;
     size_t pl = 0;
-    while (pattern[pl] != '\0' && pl < value.V->VL)
+    while (pattern[pl] != '\0' && pl < qv->VL)
       {
       char c = pattern[pl++];
       wildcard |= (c == '*');
@@ -2318,8 +2761,8 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
     while (pl > 0 && pattern[pl-1] == ' ') { pl--; }
 
     // Get string value and remove any trailing nulls and spaces
-    const char *cp = static_cast<const ValueT<char> *>(this->V)->Data;
-    size_t l = this->V->VL;
+    const char *cp = static_cast<const ValueT<char> *>(tv)->Data;
+    size_t l = tv->VL;
     while (l > 0 && cp[l-1] == '\0') { l--; }
     while (l > 0 && cp[l-1] == ' ') { l--; }
 
@@ -2411,16 +2854,16 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
         }
       else if (vr.HasSpecificCharacterSet())
         {
-        if (this->V->CharacterSet != vtkDICOMCharacterSet::ISO_IR_6 &&
-            this->V->CharacterSet != vtkDICOMCharacterSet::ISO_IR_192)
+        if (tv->CharacterSet != vtkDICOMCharacterSet::ISO_IR_6 &&
+            tv->CharacterSet != vtkDICOMCharacterSet::ISO_IR_192)
           {
           // Convert value to UTF8 before matching
           str = this->AsUTF8String();
           cp = str.c_str();
           l = str.length();
           }
-        if (value.V->CharacterSet != vtkDICOMCharacterSet::ISO_IR_6 &&
-            value.V->CharacterSet != vtkDICOMCharacterSet::ISO_IR_192)
+        if (qv->CharacterSet != vtkDICOMCharacterSet::ISO_IR_6 &&
+            qv->CharacterSet != vtkDICOMCharacterSet::ISO_IR_192)
           {
           // Convert pattern to UTF8 before matching
           pstr = value.AsUTF8String();
@@ -2445,7 +2888,7 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
   else if (type == VTK_DICOM_VALUE)
     {
     // Match if any of the contained values match
-    vtkDICOMValue *vp = static_cast<ValueT<vtkDICOMValue> *>(this->V)->Data;
+    vtkDICOMValue *vp = static_cast<ValueT<vtkDICOMValue> *>(tv)->Data;
     size_t vn = this->GetNumberOfValues();
     for (size_t i = 0; i < vn && !match; i++)
       {
@@ -2456,8 +2899,8 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
   else if (type == VTK_DICOM_ITEM)
     {
     // Match if any item matches
-    vtkDICOMItem *item = static_cast<ValueT<vtkDICOMItem> *>(value.V)->Data;
-    vtkDICOMItem *ip = static_cast<ValueT<vtkDICOMItem> *>(this->V)->Data;
+    vtkDICOMItem *item = static_cast<ValueT<vtkDICOMItem> *>(qv)->Data;
+    vtkDICOMItem *ip = static_cast<ValueT<vtkDICOMItem> *>(tv)->Data;
     size_t n = this->GetNumberOfValues();
     for (size_t i = 0; i < n && !match; i++)
       {
@@ -2488,42 +2931,42 @@ bool vtkDICOMValue::Matches(const vtkDICOMValue& value) const
   else if (vr == vtkDICOMVR::OB || vr == vtkDICOMVR::UN)
     {
     // OB and UN must match exactly
-    match = ValueT<unsigned char>::Compare(value.V, this->V);
+    match = ValueT<unsigned char>::Compare(qv, tv);
     }
   else if (vr == vtkDICOMVR::OW)
     {
     // OW must match exactly
-    match = ValueT<short>::Compare(value.V, this->V);
+    match = ValueT<short>::Compare(qv, tv);
     }
   else if (vr == vtkDICOMVR::OF)
     {
     // OF must match exactly
-    match = ValueT<float>::Compare(value.V, this->V);
+    match = ValueT<float>::Compare(qv, tv);
     }
   else if (vr == vtkDICOMVR::OD)
     {
     // OF must match exactly
-    match = ValueT<double>::Compare(value.V, this->V);
+    match = ValueT<double>::Compare(qv, tv);
     }
   else if (type == VTK_SHORT || type == VTK_UNSIGNED_SHORT)
     {
     // Match if any value matches
-    match = ValueT<short>::CompareEach(value.V, this->V);
+    match = ValueT<short>::CompareEach(qv, tv);
     }
   else if (type == VTK_INT || type == VTK_UNSIGNED_INT)
     {
     // Match if any value matches
-    match = ValueT<int>::CompareEach(value.V, this->V);
+    match = ValueT<int>::CompareEach(qv, tv);
     }
   else if (type == VTK_FLOAT)
     {
     // Match if any value matches
-    match = ValueT<float>::CompareEach(value.V, this->V);
+    match = ValueT<float>::CompareEach(qv, tv);
     }
   else if (type == VTK_DOUBLE)
     {
     // Match if any value matches
-    match = ValueT<double>::CompareEach(value.V, this->V);
+    match = ValueT<double>::CompareEach(qv, tv);
     }
 
   return match;
@@ -2572,6 +3015,20 @@ bool vtkDICOMValue::operator==(const vtkDICOMValue& o) const
 {
   const vtkDICOMValue::Value *a = this->V;
   const vtkDICOMValue::Value *b = o.V;
+  if (a != b && this->IsDeferred() && o.IsDeferred())
+    {
+    // compare the locations of the data, rather than reading it
+    const DeferredValue *da = static_cast<const DeferredValue *>(a);
+    const DeferredValue *db = static_cast<const DeferredValue *>(b);
+    return (da->VR == db->VR && da->VL == db->VL &&
+            da->Offset == db->Offset && da->BigEndian == db->BigEndian &&
+            strcmp(da->FileName, db->FileName) == 0);
+    }
+  else if (a != b)
+    {
+    a = this->LoadDeferred();
+    b = o.LoadDeferred();
+    }
   bool r = true;
 
   if (a != b)
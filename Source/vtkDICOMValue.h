@@ -27,6 +27,7 @@
 #define VTK_DICOM_TAG    13
 #define VTK_DICOM_ITEM   14
 #define VTK_DICOM_VALUE  15
+#define VTK_DICOM_DEFERRED 16
 
 // This adds an overflow byte for the "NumberOfValues" field, so that
 // "NumberOfValues" can effectively go as high as 2^40-1.  This means
@@ -38,6 +39,7 @@
 
 class vtkDICOMItem;
 class vtkDICOMSequence;
+class vtkSimpleMutexLock;
 
 //! A class to store attribute values for DICOM metadata.
 /*!
@@ -54,14 +56,15 @@ private:
   struct Value
   {
     vtkDICOMReferenceCount ReferenceCount;
-    unsigned char  Type;
+    unsigned char  Type : 7;
+    unsigned char  Pooled : 1;
     unsigned char  CharacterSet;
     unsigned char  Overflow;
     vtkDICOMVR     VR;
     unsigned int   VL;
     unsigned int   NumberOfValues;
 
-    Value() : ReferenceCount(1) {}
+    Value() : ReferenceCount(1), Pooled(0) {}
   };
 
   //! The value class, subclassed to support values of different types.
@@ -75,7 +78,73 @@ private:
     static bool CompareEach(const Value *a, const Value *b);
   };
 
+  //! A value whose data is still in a file, waiting to be read.
+  struct DeferredValue : Value
+  {
+    Value *Data;
+    vtkSimpleMutexLock *Lock;
+    vtkTypeInt64 Offset;
+    bool BigEndian;
+    bool ReadFailed;
+    char FileName[1];
+  };
+
 public:
+  //! A memory pool that values can be allocated from.
+  /*!
+   *  A pool is a bump allocator: the values are carved sequentially
+   *  from large blocks of memory, and the blocks are freed all at once
+   *  after the pool and all of the values allocated from it have been
+   *  released.  Values that are allocated from a pool are reference
+   *  counted just like any other values, so they can safely outlive
+   *  the owner of the pool, but any such value will keep the memory
+   *  for the whole pool alive.  Only one thread at a time can allocate
+   *  from a pool, but the values can be released from any thread.
+   */
+  class VTK_DICOM_EXPORT Pool
+  {
+  public:
+    //! Create a new pool, the caller owns the returned reference.
+    static Pool *New();
+
+    //! Release the caller's reference to the pool.
+    void Release();
+
+    //! Release the pool, or reuse it if none of its values are in use.
+    /*!
+     *  If the caller holds the only remaining reference, then the
+     *  pool is emptied and returned so that its memory can be reused.
+     *  Otherwise, the reference is released and null is returned.
+     */
+    Pool *Recycle();
+
+  private:
+    friend class vtkDICOMValue;
+
+    struct Block;
+
+    Pool();
+    ~Pool();
+
+    //! Allocate memory for one value.
+    void *Allocate(size_t size);
+
+    //! Free the memory for one value.
+    static void Free(void *vp);
+
+    //! Free all blocks except for the one that is currently in use.
+    void FreeBlocks(Block *keep);
+
+    vtkDICOMReferenceCount ReferenceCount;
+    Block *Head;
+    char *Ptr;
+    char *End;
+    size_t BlockSize;
+
+    Pool(const Pool&);  // Not implemented.
+    void operator=(const Pool&);  // Not implemented.
+  };
+
   //! Construct a new value from the data that is provided.
   /*!
    *  The data will be copied into the value, with conversion if
@@ -271,19 +340,23 @@ public:
    *  within the value object.  This method will not do any checks
    *  to ensure that the data type matches the VR.  It is meant to
    *  be an efficent way for the parser to allocate a value so that
-   *  the value's contents can be read in directly from a file.
+   *  the value's contents can be read in directly from a file.  If
+   *  a pool is provided, the memory will be allocated from the pool.
    */
-  char *AllocateCharData(vtkDICOMVR vr, size_t vn);
+  char *AllocateCharData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
   char *AllocateCharData(
-    vtkDICOMVR vr, vtkDICOMCharacterSet cs, size_t vn);
-  unsigned char *AllocateUnsignedCharData(vtkDICOMVR vr, size_t vn);
-  short *AllocateShortData(vtkDICOMVR vr, size_t vn);
-  unsigned short *AllocateUnsignedShortData(vtkDICOMVR vr, size_t vn);
-  int *AllocateIntData(vtkDICOMVR vr, size_t vn);
-  unsigned int *AllocateUnsignedIntData(vtkDICOMVR vr, size_t vn);
-  float *AllocateFloatData(vtkDICOMVR vr, size_t vn);
-  double *AllocateDoubleData(vtkDICOMVR vr, size_t vn);
-  vtkDICOMTag *AllocateTagData(vtkDICOMVR vr, size_t vn);
+    vtkDICOMVR vr, vtkDICOMCharacterSet cs, size_t vn, Pool *pool = 0);
+  unsigned char *AllocateUnsignedCharData(
+    vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  short *AllocateShortData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  unsigned short *AllocateUnsignedShortData(
+    vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  int *AllocateIntData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  unsigned int *AllocateUnsignedIntData(
+    vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  float *AllocateFloatData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  double *AllocateDoubleData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
+  vtkDICOMTag *AllocateTagData(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
   vtkDICOMItem *AllocateSequenceData(vtkDICOMVR vr, size_t vn);
   vtkDICOMValue *AllocateMultiplexData(vtkDICOMVR vr, size_t vn);
 
@@ -304,6 +377,39 @@ public:
    */
   unsigned char *ReallocateUnsignedCharData(size_t vn);
 
+  //! Allocate a value whose data will be read from a file when needed.
+  /*!
+   *  This is used by the parser to defer the reading of large values.
+   *  The VR must be OB, OW, OF, OD, or UN, and the data must be stored
+   *  at the given offset within the file.  The VR, the VL, and the number
+   *  of values are available immediately, but the data is not read until
+   *  it is first accessed, for example through GetUnsignedCharData() or
+   *  GetValues().  If "bigEndian" is set, the data is byte-swapped as it
+   *  is read.  The data is read only once, even if the value is accessed
+   *  from several threads at the same time, and it is shared by all
+   *  copies of the value.  If the file cannot be read, or if it ends
+   *  before the data does, then a warning is printed and the value has
+   *  no data: GetUnsignedCharData() and the other data methods return
+   *  null, and GetValues() leaves the output unchanged.
+   */
+  void AllocateDeferredData(
+    vtkDICOMVR vr, unsigned int vl, const char *filename,
+    vtkTypeInt64 offset, bool bigEndian);
+
+  //! Check whether the data for this value has yet to be read from file.
+  bool IsDeferred() const;
+
+  //! Get a copy of the value that does not use a memory pool.
+  /*!
+   *  A value that was allocated from a Pool keeps the memory for the
+   *  whole pool alive, so values that will be kept after the pool is
+   *  released should be copied with this method.  The values within the
+   *  items of a sequence are copied, too.  If the value was not allocated
+   *  from a pool and does not hold any items, then the returned value
+   *  simply shares the data with this value.
+   */
+  vtkDICOMValue GetUnpooledCopy() const;
+
   //! Append value "i" to the supplied UTF8 string.
   /*
    *  String values will be converted from their native encoding
@@ -365,17 +471,31 @@ public:
   vtkDICOMValue& operator=(const vtkDICOMSequence& o);
 
   //! Equality requires that all elements of the value are equal.
+  /*!
+   *  If both values are deferred and neither has been read yet, then
+   *  they are compared by their location within the file, and they are
+   *  equal only if they refer to the same data.  Otherwise, any deferred
+   *  data is read before the comparison is done.
+   */
   bool operator==(const vtkDICOMValue& o) const;
   bool operator!=(const vtkDICOMValue& o) const { return !(*this == o); }
 
 private:
   //! Allocate an array of size vn for the specified vr
   template<class T>
-  T *Allocate(vtkDICOMVR vr, size_t vn);
+  T *Allocate(vtkDICOMVR vr, size_t vn, Pool *pool = 0);
 
   //! Free the internal value.
   static void FreeValue(Value *v);
 
+  //! Get the internal value, or the data if this value is deferred.
+  Value *LoadDeferred() const {
+    return ((this->V && this->V->Type == VTK_DICOM_DEFERRED) ?
+            this->ReadDeferredData() : this->V); }
+
+  //! Read the data for a deferred value, or return null on failure.
+  Value *ReadDeferredData() const;
+
   //! Internal templated GetValues() method.
   template<class OT>
   void GetValuesT(OT *v, size_t count, size_t s) const;
@@ -441,6 +561,9 @@ private:
 
   // friend the meta data class, it requires GetMultiplex().
   friend class vtkDICOMValueFriendMetaData;
+
+  // friend the matcher class, it requires the normalization methods.
+  friend class vtkDICOMValueMatcher;
 };
 
 //! @cond
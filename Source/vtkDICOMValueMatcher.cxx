@@ -0,0 +1,446 @@
+/*=========================================================================
+
+  Program: DICOM for VTK
+
+  Copyright (c) 2012-2015 David Gobbi
+  All rights reserved.
+  See Copyright.txt or http://dgobbi.github.io/bsd3.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "vtkDICOMValueMatcher.h"
+#include "vtkDICOMUtilities.h"
+
+#include <string.h>
+
+namespace {
+
+// Check whether a character set requires conversion to utf-8.
+inline bool NeedsConversion(vtkDICOMCharacterSet cs)
+{
+  return (cs != vtkDICOMCharacterSet::ISO_IR_6 &&
+          cs != vtkDICOMCharacterSet::ISO_IR_192);
+}
+
+// Convert backslash-separated values to utf-8, the same way as
+// vtkDICOMValue::AsUTF8String() does for multi-valued VRs.
+std::string ConvertMultiToUTF8(
+  vtkDICOMCharacterSet cs, const char *cp, size_t l)
+{
+  const char *ep = cp + l;
+  std::string s;
+  while (cp != ep && *cp != '\0')
+    {
+    size_t n = cs.NextBackslash(cp, ep);
+    while (n > 0 && *cp == ' ') { cp++; n--; }
+    size_t m = n;
+    while (m > 0 && cp[m-1] == ' ') { m--; }
+    s.append(cs.ConvertToUTF8(cp, m));
+    cp += n;
+    if (cp != ep && *cp == '\\')
+      {
+      s.append(cp, 1);
+      cp++;
+      }
+    }
+  return s;
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+vtkDICOMValueMatcher::vtkDICOMValueMatcher() :
+  Type(UniversalMatch), Hyphen(false), Inclusive(false), Ordered(false),
+  N1(0), N2(0)
+{
+  this->R1[0] = '\0';
+  this->R2[0] = '\0';
+}
+
+//----------------------------------------------------------------------------
+vtkDICOMValueMatcher::vtkDICOMValueMatcher(const vtkDICOMValue& query) :
+  Type(UniversalMatch), Hyphen(false), Inclusive(false), Ordered(false),
+  N1(0), N2(0)
+{
+  this->R1[0] = '\0';
+  this->R2[0] = '\0';
+  this->SetQuery(query);
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMValueMatcher::SetQuery(const vtkDICOMValue& query)
+{
+  this->Query = query;
+  this->VR = query.GetVR();
+  this->Type = GenericMatch;
+  this->Hyphen = false;
+  this->Inclusive = false;
+  this->Ordered = false;
+  this->N1 = 0;
+  this->N2 = 0;
+  this->R1[0] = '\0';
+  this->R2[0] = '\0';
+  this->Patterns.clear();
+
+  // keys with no value match everything (universal matching)
+  if (!query.IsValid())
+    {
+    this->Type = UniversalMatch;
+    return;
+    }
+
+  // only text is prepared, everything else uses vtkDICOMValue::Matches()
+  const char *pattern = query.GetCharData();
+  if (pattern == 0)
+    {
+    return;
+    }
+  if (query.GetVL() == 0)
+    {
+    this->Type = UniversalMatch;
+    return;
+    }
+
+  // Does the pattern string have wildcards?
+  bool wildcard = false;
+  size_t pl = 0;
+  while (pattern[pl] != '\0' && pl < query.GetVL())
+    {
+    char c = pattern[pl++];
+    wildcard |= (c == '*');
+    wildcard |= (c == '?');
+    }
+  while (pl > 0 && pattern[pl-1] == ' ') { pl--; }
+
+  vtkDICOMVR vr = this->VR;
+  if (!wildcard &&
+      (vr == vtkDICOMVR::DA ||
+       vr == vtkDICOMVR::TM ||
+       vr == vtkDICOMVR::DT))
+    {
+    this->SetDateTimePattern(pattern, pl);
+    }
+  else if (vr == vtkDICOMVR::PN)
+    {
+    this->SetPersonPattern(pattern, pl);
+    }
+  else
+    {
+    std::string pstr;
+    if (vr.HasSpecificCharacterSet() &&
+        NeedsConversion(query.GetCharacterSet()))
+      {
+      // Convert pattern to UTF8 before matching
+      pstr = query.AsUTF8String();
+      pattern = pstr.c_str();
+      pl = pstr.length();
+      }
+    if (vr.HasSingleValue())
+      {
+      this->Patterns.push_back(std::string(pattern, pl));
+      this->Type = SingleMatch;
+      }
+    else
+      {
+      this->SetMultiPattern(pattern, pl);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMValueMatcher::SetDateTimePattern(const char *pattern, size_t pl)
+{
+  vtkDICOMVR vr = this->VR;
+
+  // Find the position of the hyphen
+  size_t hp = 0;
+  while (hp < pl && pattern[hp] != '-') { hp++; }
+  if (vr == vtkDICOMVR::DT && hp + 5 < pl)
+    {
+    // Check if the hyphen was part of the timezone offset
+    if (pattern[hp+5] == '-')
+      {
+      hp += 5;
+      }
+    else if (hp != 4 && pattern[hp+5] == '\0')
+      {
+      hp = 0;
+      }
+    }
+  // Get a pointer to the part of pattern after the hyphen
+  const char *dp = &pattern[hp];
+  this->Hyphen = (*dp == '-');
+  dp += this->Hyphen;
+
+  // Normalize the ends of the range
+  if (pattern[0] != '\0' && pattern[0] != '-')
+    {
+    this->N1 = vtkDICOMValue::NormalizeDateTime(pattern, this->R1, vr);
+    }
+  if (dp[0] != '\0' && dp[0] != '-')
+    {
+    this->N2 = vtkDICOMValue::NormalizeDateTime(dp, this->R2, vr);
+    }
+
+  this->Type = DateTimeMatch;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMValueMatcher::SetPersonPattern(const char *pattern, size_t pl)
+{
+  // Convert to lowercase UTF8, and then normalize each name
+  std::string pstr =
+    this->Query.GetCharacterSet().CaseFoldedUTF8(pattern, pl);
+  char normalizedPattern[256];
+  const char *pp = pstr.c_str();
+  for (;;)
+    {
+    vtkDICOMValue::NormalizePersonName(pp, normalizedPattern, true);
+    this->Patterns.push_back(normalizedPattern);
+
+    // break if no patterns remain
+    while (*pp != '\0' && *pp != '\\') { pp++; }
+    if (*pp == '\0') { break; }
+    pp++;
+    }
+
+  this->Type = PersonMatch;
+}
+
+//----------------------------------------------------------------------------
+void vtkDICOMValueMatcher::SetMultiPattern(const char *pattern, size_t pl)
+{
+  const char *pp = pattern;
+  const char *pe = pattern + pl;
+  for (;;)
+    {
+    // get pattern value start and end
+    const char *pd = pp;
+    while (pd != pe && *pd != '\\') { pd++; }
+    const char *pf = pd;
+    // strip spaces
+    while (pp != pf && *pp == ' ') { pp++; }
+    while (pf != pp && pf[-1] == ' ') { --pf; }
+    this->Patterns.push_back(std::string(pp, pf - pp));
+
+    // break if no patterns remain
+    if (pd == pe) { break; }
+    pp = pd + 1;
+    }
+
+  this->Inclusive = (this->VR == vtkDICOMVR::UI);
+  this->Ordered = (this->VR == vtkDICOMVR::IS || this->VR == vtkDICOMVR::DS);
+  this->Type = MultiMatch;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValueMatcher::Matches(const vtkDICOMValue& value) const
+{
+  if (this->Type == UniversalMatch)
+    {
+    return true;
+    }
+
+  // deferred values, sequences, etc. are not handled here
+  const char *cp = value.GetCharData();
+  if (this->Type == GenericMatch || cp == 0)
+    {
+    return value.Matches(this->Query);
+    }
+
+  return this->Matches(
+    value.GetVR(), value.GetCharacterSet(), cp, value.GetVL());
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValueMatcher::Matches(
+  vtkDICOMVR vr, vtkDICOMCharacterSet cs, const char *cp, size_t l) const
+{
+  if (this->Type == UniversalMatch)
+    {
+    return true;
+    }
+  if (this->Type == GenericMatch)
+    {
+    return vtkDICOMValue(vr, cs, cp, l).Matches(this->Query);
+    }
+  if (vr != this->VR)
+    {
+    // match is impossible if VRs differ
+    return false;
+    }
+
+  // Remove any trailing nulls and spaces
+  while (l > 0 && cp[l-1] == '\0') { l--; }
+  size_t nl = l;
+  while (l > 0 && cp[l-1] == ' ') { l--; }
+
+  bool match = false;
+  if (this->Type == DateTimeMatch)
+    {
+    match = this->MatchesDateTime(cp, l);
+    }
+  else if (this->Type == PersonMatch)
+    {
+    match = this->MatchesPerson(cs, cp, l);
+    }
+  else
+    {
+    std::string str;
+    if (vr.HasSpecificCharacterSet() && NeedsConversion(cs))
+      {
+      // Convert value to UTF8 before matching
+      if (vr.HasSingleValue())
+        {
+        str = cs.ConvertToUTF8(cp, l);
+        }
+      else
+        {
+        str = ConvertMultiToUTF8(cs, cp, nl);
+        }
+      cp = str.c_str();
+      l = str.length();
+      }
+    if (this->Type == SingleMatch)
+      {
+      const std::string& pattern = this->Patterns[0];
+      match = vtkDICOMUtilities::PatternMatches(
+        pattern.data(), pattern.length(), cp, l);
+      }
+    else
+      {
+      match = this->MatchesMulti(cp, l);
+      }
+    }
+
+  return match;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValueMatcher::MatchesDateTime(const char *cp, size_t l) const
+{
+  // Copy the value, since the normalization requires a terminated string
+  char buf[32];
+  if (l > sizeof(buf) - 1)
+    {
+    l = sizeof(buf) - 1;
+    }
+  memcpy(buf, cp, l);
+  buf[l] = '\0';
+
+  char d[22];
+  vtkDICOMValue::NormalizeDateTime(buf, d, this->VR);
+
+  // Perform lexical comparison on normalized datetime
+  bool match = false;
+  if (!this->Hyphen)
+    {
+    match = (strncmp(d, this->R1, this->N1) == 0);
+    }
+  else if (*this->R1 != '\0')
+    {
+    match = (strncmp(d, this->R1, this->N1) >= 0);
+    }
+  else if (*this->R2 != '\0')
+    {
+    match = (strncmp(this->R2, d, this->N2) >= 0);
+    }
+  else
+    {
+    match = (strncmp(this->R2, d, this->N2) >= 0 &&
+             strncmp(d, this->R1, this->N1) >= 0);
+    }
+
+  return match;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValueMatcher::MatchesPerson(
+  vtkDICOMCharacterSet cs, const char *cp, size_t l) const
+{
+  // Convert to lowercase UTF8 before matching
+  std::string str;
+  const char *ep = cp + l;
+  while (cp != ep && *cp != '\0')
+    {
+    size_t n = cs.NextBackslash(cp, ep);
+    str.append(cs.CaseFoldedUTF8(cp, n));
+    cp += n;
+    if (cp != ep && *cp == '\\')
+      {
+      str.append(cp, 1);
+      cp++;
+      }
+    }
+
+  bool match = false;
+  char normalizedName[256];
+  const char *vp = str.c_str();
+  while (!match)
+    {
+    // normalize the name, and compare with every pattern
+    vtkDICOMValue::NormalizePersonName(vp, normalizedName);
+    size_t nl = strlen(normalizedName);
+    for (size_t i = 0; i < this->Patterns.size() && !match; i++)
+      {
+      const std::string& pattern = this->Patterns[i];
+      match = vtkDICOMUtilities::PatternMatches(
+        pattern.data(), pattern.length(), normalizedName, nl);
+      }
+
+    // break if no values remain
+    while (*vp != '\0' && *vp != '\\') { vp++; }
+    if (*vp == '\0') { break; }
+    vp++;
+    }
+
+  return match;
+}
+
+//----------------------------------------------------------------------------
+bool vtkDICOMValueMatcher::MatchesMulti(const char *val, size_t l) const
+{
+  // the values end at the first null, if there is one
+  const char *ve = val;
+  const char *vt = val + l;
+  while (ve != vt && *ve != '\0') { ve++; }
+
+  bool inclusive = this->Inclusive;
+  bool match = !inclusive;
+
+  size_t np = this->Patterns.size();
+  for (size_t i = 0; i < np && (match ^ inclusive); i++)
+    {
+    const std::string& pattern = this->Patterns[i];
+
+    match = false;
+    const char *vp = val;
+    while (!match)
+      {
+      // get value start and end
+      const char *vd = vp;
+      while (vd != ve && *vd != '\\') { vd++; }
+      const char *vf = vd;
+      // strip whitespace
+      while (vp != vf && *vp == ' ') { vp++; }
+      while (vf != vp && vf[-1] == ' ') { --vf; }
+
+      match = vtkDICOMUtilities::PatternMatches(
+        pattern.data(), pattern.length(), vp, vf-vp);
+
+      // break if no values remain
+      if (vd == ve) { break; }
+      vp = vd + 1;
+      }
+    if (match && this->Ordered)
+      {
+      // set inner loop start to current position
+      val = vp;
+      }
+    }
+
+  return match;
+}
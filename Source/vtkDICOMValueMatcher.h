@@ -0,0 +1,112 @@
+/*=========================================================================
+
+  Program: DICOM for VTK
+
+  Copyright (c) 2012-2015 David Gobbi
+  All rights reserved.
+  See Copyright.txt or http://dgobbi.github.io/bsd3.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef vtkDICOMValueMatcher_h
+#define vtkDICOMValueMatcher_h
+
+#include <vtkSystemIncludes.h>
+#include "vtkDICOMModule.h"
+#include "vtkDICOMValue.h"
+
+#include <string>
+#include <vector>
+
+//! A query value that has been prepared for fast matching.
+/*!
+ *  Every call to vtkDICOMValue::Matches() has to interpret the query
+ *  value: it splits the query at the backslashes, normalizes the ends of
+ *  date and time ranges, and case-folds and normalizes person names.
+ *  This class does all of that just once, when the query is set, so that
+ *  one query value can be checked efficiently against the values from
+ *  a large number of files.  The result of matching is always the same
+ *  as the result of vtkDICOMValue::Matches().
+ */
+class VTK_DICOM_EXPORT vtkDICOMValueMatcher
+{
+public:
+  //! Construct a matcher with an empty query, which matches everything.
+  vtkDICOMValueMatcher();
+
+  //! Construct a matcher for the given query value.
+  explicit vtkDICOMValueMatcher(const vtkDICOMValue& query);
+
+  //! Set the query value that will be matched.
+  void SetQuery(const vtkDICOMValue& query);
+
+  //! Get the query value.
+  const vtkDICOMValue& GetQuery() const { return this->Query; }
+
+  //! Check if the query matches everything (universal matching).
+  bool IsUniversal() const { return (this->Type == UniversalMatch); }
+
+  //! Check if the given value matches the query.
+  /*!
+   *  This gives the same result as value.Matches(query).
+   */
+  bool Matches(const vtkDICOMValue& value) const;
+
+  //! Check if a text value, given as the bytes from the file, matches.
+  /*!
+   *  The VR must be the VR of the data element, and the character set
+   *  must be the one that was used to encode it.  This gives the same
+   *  result as creating a vtkDICOMValue from the bytes and then calling
+   *  Matches() on it, but it avoids the creation of the value.
+   */
+  bool Matches(vtkDICOMVR vr, vtkDICOMCharacterSet cs,
+               const char *text, size_t l) const;
+
+private:
+  //! The kinds of matching that are done.
+  enum MatchType
+  {
+    UniversalMatch, // the query is empty, it matches everything
+    GenericMatch,   // use vtkDICOMValue::Matches()
+    DateTimeMatch,  // a date or time, or a range of dates or times
+    PersonMatch,    // one or more person names
+    SingleMatch,    // a single string, possibly with wildcards
+    MultiMatch      // multiple backslash-separated strings
+  };
+
+  //! Prepare the pattern for a date, time, or datetime.
+  void SetDateTimePattern(const char *pattern, size_t pl);
+
+  //! Prepare the pattern for a person name.
+  void SetPersonPattern(const char *pattern, size_t pl);
+
+  //! Prepare the pattern for a multi-valued string.
+  void SetMultiPattern(const char *pattern, size_t pl);
+
+  //! Match against a date, time, or datetime.
+  bool MatchesDateTime(const char *cp, size_t l) const;
+
+  //! Match against the case-folded person names.
+  bool MatchesPerson(
+    vtkDICOMCharacterSet cs, const char *cp, size_t l) const;
+
+  //! Match against multiple backslash-separated strings.
+  bool MatchesMulti(const char *cp, size_t l) const;
+
+  vtkDICOMValue Query;
+  vtkDICOMVR VR;
+  int Type;
+  bool Hyphen;
+  bool Inclusive;
+  bool Ordered;
+  size_t N1;
+  size_t N2;
+  char R1[22];
+  char R2[22];
+  std::vector<std::string> Patterns;
+};
+
+#endif /* vtkDICOMValueMatcher_h */
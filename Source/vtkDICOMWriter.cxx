@@ -34,11 +34,13 @@
 #include "vtkCommand.h"
 #include "vtkErrorCode.h"
 #include "vtkSmartPointer.h"
+#include "vtkMultiThreader.h"
 
 #include <time.h>
 #include <math.h>
 #include <stdlib.h>
 
+#include <string>
 #include <vector>
 
 vtkStandardNewMacro(vtkDICOMWriter);
@@ -67,6 +69,8 @@ vtkDICOMWriter::vtkDICOMWriter()
   this->ImageType = new char[24];
   strcpy(this->ImageType, "DERIVED/SECONDARY/OTHER");
   this->Streaming = 0;
+  this->NumberOfThreads = 1;
+  this->StreamFragments = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -158,6 +162,9 @@ void vtkDICOMWriter::PrintSelf(ostream& os, vtkIndent indent)
      << this->GetFileSliceOrderAsString() << "\n";
   os << indent << "Streaming: "
      << (this->Streaming ? "On\n" : "Off\n");
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "StreamFragments: "
+     << (this->StreamFragments ? "On\n" : "Off\n");
 }
 
 //----------------------------------------------------------------------------
@@ -442,6 +449,228 @@ int vtkDICOMWriter::GenerateMetaData(vtkInformation *info)
   return 1;
 }
 
+//----------------------------------------------------------------------------
+namespace {
+
+// The layout of the image data, and of the frames within the files.
+struct vtkDICOMWriterLayout
+{
+  unsigned char *DataPtr;
+  int Extent[6];
+  vtkIntArray *SliceMap;
+  vtkIntArray *ComponentMap;
+  int NumberOfFrames;
+  int SamplesPerPixel;
+  int ScalarSize;
+  int NumberOfPlanes;
+  vtkIdType PixelSize;
+  vtkIdType SliceSize;
+  vtkIdType FilePixelSize;
+  vtkIdType FileRowSize;
+  vtkIdType FilePlaneSize;
+  vtkIdType FileFrameSize;
+  bool FlipImage;
+  bool PackedToPlanar;
+};
+
+// Write a range of files.  Each instance has its own compiler and its
+// own buffers, so that several ranges can be written at once by
+// different threads.
+class vtkDICOMWriterFiles
+{
+public:
+  vtkDICOMWriterFiles(vtkDICOMWriter *writer,
+                      const vtkDICOMWriterLayout *layout,
+                      const std::vector<std::string> *fileNames,
+                      int firstFileIdx);
+  ~vtkDICOMWriterFiles();
+
+  // Get the compiler, so that it can be configured.
+  vtkDICOMCompiler *GetCompiler() { return this->Compiler; }
+
+  // Set the range of files to write.
+  void SetRange(int first, int last) {
+    this->First = first;
+    this->Last = last; }
+
+  // Set whether to report progress, as a fraction of the given range.
+  void SetProgressRange(int first, int count) {
+    this->ProgressFirst = first;
+    this->ProgressCount = count; }
+
+  // Write the files.
+  void Execute();
+
+  // Get the first error that occurred, or zero if none.
+  unsigned long GetErrorCode() { return this->ErrorCode; }
+
+private:
+  // Write one file.
+  void WriteFile(int fileIdx);
+
+  vtkDICOMWriter *Writer;
+  const vtkDICOMWriterLayout *Layout;
+  const std::vector<std::string> *FileNames;
+  int FirstFileIdx;
+  int First;
+  int Last;
+  int ProgressFirst;
+  int ProgressCount;
+  vtkDICOMCompiler *Compiler;
+  unsigned char *RowBuffer;
+  unsigned char *FrameBuffer;
+  unsigned long ErrorCode;
+};
+
+vtkDICOMWriterFiles::vtkDICOMWriterFiles(
+  vtkDICOMWriter *writer, const vtkDICOMWriterLayout *layout,
+  const std::vector<std::string> *fileNames, int firstFileIdx)
+  : Writer(writer), Layout(layout), FileNames(fileNames),
+    FirstFileIdx(firstFileIdx), First(0), Last(-1),
+    ProgressFirst(0), ProgressCount(0), RowBuffer(0), FrameBuffer(0),
+    ErrorCode(0)
+{
+  this->Compiler = vtkDICOMCompiler::New();
+  if (layout->FlipImage)
+    {
+    this->RowBuffer = new unsigned char[layout->FileRowSize];
+    }
+  if (layout->FlipImage || layout->PackedToPlanar)
+    {
+    this->FrameBuffer = new unsigned char[layout->FileFrameSize];
+    }
+}
+
+vtkDICOMWriterFiles::~vtkDICOMWriterFiles()
+{
+  this->Compiler->Delete();
+  delete [] this->RowBuffer;
+  delete [] this->FrameBuffer;
+}
+
+void vtkDICOMWriterFiles::Execute()
+{
+  for (int fileIdx = this->First; fileIdx <= this->Last; fileIdx++)
+    {
+    this->WriteFile(fileIdx);
+    }
+}
+
+void vtkDICOMWriterFiles::WriteFile(int fileIdx)
+{
+  const vtkDICOMWriterLayout *layout = this->Layout;
+  vtkDICOMCompiler *compiler = this->Compiler;
+  vtkDICOMMetaData *meta = compiler->GetMetaData();
+  const int *extent = layout->Extent;
+  int numFrames = layout->NumberOfFrames;
+
+  // get the index for this file
+  compiler->SetFileName(
+    (*this->FileNames)[fileIdx - this->FirstFileIdx].c_str());
+  compiler->SetIndex(fileIdx);
+  compiler->SetSOPInstanceUID(
+    meta->GetAttributeValue(fileIdx, DC::SOPInstanceUID).GetCharData());
+  compiler->SetSeriesInstanceUID(
+    meta->GetAttributeValue(fileIdx, DC::SeriesInstanceUID).GetCharData());
+  compiler->WriteHeader();
+
+  // iterate through all frames in the file
+  for (int frameIdx = 0; frameIdx < numFrames; frameIdx++)
+    {
+    if (this->Writer->GetAbortExecute()) { break; }
+
+    if (this->ProgressCount > 0)
+      {
+      this->Writer->UpdateProgress(
+        static_cast<double>(
+          (fileIdx - this->ProgressFirst)*numFrames + frameIdx)/
+        static_cast<double>(this->ProgressCount*numFrames));
+      }
+
+    int sliceIdx = layout->SliceMap->GetComponent(fileIdx, frameIdx);
+    int componentIdx = layout->ComponentMap->GetComponent(fileIdx, frameIdx);
+
+    // pointer to the frame that will be written to the file
+    unsigned char *framePtr = this->FrameBuffer;
+
+    if (!framePtr)
+      {
+      // write the frame directly from image data
+      framePtr = (layout->DataPtr + (sliceIdx - extent[4])*layout->SliceSize);
+      }
+
+    // go to the correct position in image data
+    unsigned char *slicePtr =
+      (layout->DataPtr + (sliceIdx - extent[4])*layout->SliceSize +
+       componentIdx*layout->SamplesPerPixel*layout->ScalarSize);
+
+    // iterate through all color planes in the slice
+    unsigned char *planePtr = framePtr;
+    for (int pIdx = 0; pIdx < layout->NumberOfPlanes; pIdx++)
+      {
+      // convert scalar components to planes
+      if (layout->PackedToPlanar)
+        {
+        const unsigned char *tmpInPtr = slicePtr;
+        unsigned char *tmpOutPtr = planePtr;
+        int m = layout->SliceSize/layout->PixelSize;
+        for (int i = 0; i < m; i++)
+          {
+          vtkIdType n = layout->FilePixelSize;
+          do { *tmpOutPtr++ = *tmpInPtr++; } while (--n);
+          tmpInPtr += layout->PixelSize - layout->FilePixelSize;
+          }
+        slicePtr += layout->FilePixelSize;
+        }
+      else if (framePtr != slicePtr)
+        {
+        memcpy(framePtr, slicePtr, layout->FileFrameSize);
+        }
+
+      // flip the data if necessary
+      if (layout->FlipImage)
+        {
+        vtkIdType fileRowSize = layout->FileRowSize;
+        int numRows = extent[3] - extent[2] + 1;
+        int halfRows = numRows/2;
+        for (int yIdx = 0; yIdx < halfRows; yIdx++)
+          {
+          unsigned char *row1 = planePtr + yIdx*fileRowSize;
+          unsigned char *row2 = planePtr + (numRows-yIdx-1)*fileRowSize;
+          memcpy(this->RowBuffer, row1, fileRowSize);
+          memcpy(row1, row2, fileRowSize);
+          memcpy(row2, this->RowBuffer, fileRowSize);
+          }
+        }
+
+      planePtr += layout->FilePlaneSize;
+      }
+    // write the frame to the file
+    compiler->WriteFrame(framePtr, layout->FileFrameSize);
+    }
+  compiler->Close();
+
+  if (this->ErrorCode == 0)
+    {
+    this->ErrorCode = compiler->GetErrorCode();
+    }
+}
+
+// The function that is called by vtkMultiThreader.
+VTK_THREAD_RETURN_TYPE vtkDICOMWriterThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkDICOMWriterFiles **workers =
+    static_cast<vtkDICOMWriterFiles **>(info->UserData);
+
+  workers[info->ThreadID]->Execute();
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end anonymous namespace
+
 //----------------------------------------------------------------------------
 int vtkDICOMWriter::RequestData(
   vtkInformation* vtkNotUsed(request),
@@ -504,14 +733,7 @@ int vtkDICOMWriter::RequestData(
       }
     }
 
-  vtkSmartPointer<vtkDICOMCompiler> compiler =
-    vtkSmartPointer<vtkDICOMCompiler>::New();
-  if (this->TransferSyntaxUID)
-    {
-    compiler->SetTransferSyntaxUID(this->TransferSyntaxUID);
-    }
   vtkDICOMMetaData *meta = this->GeneratedMetaData;
-  compiler->SetMetaData(meta);
 
   // write the image
   unsigned char *dataPtr = static_cast<unsigned char *>(
@@ -537,107 +759,97 @@ int vtkDICOMWriter::RequestData(
   vtkIdType filePlaneSize = fileRowSize*(extent[3] - extent[2] + 1);
   vtkIdType fileFrameSize = filePlaneSize*numPlanes;
 
+  vtkDICOMWriterLayout layout;
+  layout.DataPtr = dataPtr;
+  for (int i = 0; i < 6; i++)
+    {
+    layout.Extent[i] = extent[i];
+    }
+  layout.SliceMap = sliceMap;
+  layout.ComponentMap = componentMap;
+  layout.NumberOfFrames = numFrames;
+  layout.SamplesPerPixel = samplesPerPixel;
+  layout.ScalarSize = scalarSize;
+  layout.NumberOfPlanes = numPlanes;
+  layout.PixelSize = pixelSize;
+  layout.SliceSize = sliceSize;
+  layout.FilePixelSize = filePixelSize;
+  layout.FileRowSize = fileRowSize;
+  layout.FilePlaneSize = filePlaneSize;
+  layout.FileFrameSize = fileFrameSize;
+  layout.FlipImage = flipImage;
+  layout.PackedToPlanar = (filePixelSize != pixelSize);
+
   this->InvokeEvent(vtkCommand::StartEvent);
   this->UpdateProgress(0.0);
 
-  bool packedToPlanar = (filePixelSize != pixelSize);
-  unsigned char *rowBuffer = 0;
-  if (flipImage)
-    {
-    rowBuffer = new unsigned char[fileRowSize];
-    }
-  unsigned char *frameBuffer = 0;
-  if (flipImage || packedToPlanar)
-    {
-    frameBuffer = new unsigned char[fileFrameSize];
-    }
-
-  // loop through all files in the update extent
+  // compute all of the file names before any files are written
+  std::vector<std::string> fileNames;
   for (int fileIdx = minFileIdx; fileIdx <= maxFileIdx; fileIdx++)
     {
-    // get the index for this file
     this->ComputeInternalFileName(fileIdx + 1);
-    compiler->SetFileName(this->InternalFileName);
-    compiler->SetIndex(fileIdx);
-    compiler->SetSOPInstanceUID(
-      meta->GetAttributeValue(fileIdx, DC::SOPInstanceUID).GetCharData());
-    compiler->SetSeriesInstanceUID(
-      meta->GetAttributeValue(fileIdx, DC::SeriesInstanceUID).GetCharData());
-    compiler->WriteHeader();
-
-    // iterate through all frames in the file
-    for (int frameIdx = 0; frameIdx < numFrames; frameIdx++)
-      {
-      if (this->AbortExecute) { break; }
-
-      this->UpdateProgress(static_cast<double>(fileIdx*numFrames + frameIdx)/
-                           static_cast<double>(numFiles*numFrames));
-
-      int sliceIdx = sliceMap->GetComponent(fileIdx, frameIdx);
-      int componentIdx = componentMap->GetComponent(fileIdx, frameIdx);
+    fileNames.push_back(this->InternalFileName);
+    }
 
-      // pointer to the frame that will be written to the file
-      unsigned char *framePtr = frameBuffer;
+  // never use more threads than there are files
+  int numThreads = this->NumberOfThreads;
+  int numFilesToWrite = maxFileIdx - minFileIdx + 1;
+  numThreads = (numThreads < numFilesToWrite ? numThreads : numFilesToWrite);
+  numThreads = (numThreads < VTK_MAX_THREADS ? numThreads : VTK_MAX_THREADS);
+  numThreads = (numThreads > 1 ? numThreads : 1);
 
-      if (!framePtr)
-        {
-        // write the frame directly from image data
-        framePtr = (dataPtr + (sliceIdx - extent[4])*sliceSize);
-        }
-
-      // go to the correct position in image data
-      unsigned char *slicePtr =
-        (dataPtr + (sliceIdx - extent[4])*sliceSize +
-         componentIdx*samplesPerPixel*scalarSize);
+  // each thread writes a contiguous range of files with its own compiler
+  std::vector<vtkDICOMWriterFiles *> workers(numThreads);
+  for (int t = 0; t < numThreads; t++)
+    {
+    vtkDICOMWriterFiles *worker =
+      new vtkDICOMWriterFiles(this, &layout, &fileNames, minFileIdx);
+    vtkDICOMCompiler *compiler = worker->GetCompiler();
+    if (this->TransferSyntaxUID)
+      {
+      compiler->SetTransferSyntaxUID(this->TransferSyntaxUID);
+      }
+    compiler->SetMetaData(meta);
+    compiler->SetStreamFragments(this->StreamFragments != 0);
+    if (numThreads == 1)
+      {
+      // if there is only one file, the compiler can use the threads
+      compiler->SetNumberOfThreads(this->NumberOfThreads);
+      }
+    int first = minFileIdx + (t*numFilesToWrite)/numThreads;
+    int last = minFileIdx + ((t + 1)*numFilesToWrite)/numThreads - 1;
+    worker->SetRange(first, last);
+    workers[t] = worker;
+    }
 
-      // iterate through all color planes in the slice
-      unsigned char *planePtr = framePtr;
-      for (int pIdx = 0; pIdx < numPlanes; pIdx++)
-        {
-        // convert scalar components to planes
-        if (packedToPlanar)
-          {
-          const unsigned char *tmpInPtr = slicePtr;
-          unsigned char *tmpOutPtr = planePtr;
-          int m = sliceSize/pixelSize;
-          for (int i = 0; i < m; i++)
-            {
-            vtkIdType n = filePixelSize;
-            do { *tmpOutPtr++ = *tmpInPtr++; } while (--n);
-            tmpInPtr += pixelSize - filePixelSize;
-            }
-          slicePtr += filePixelSize;
-          }
-        else
-          {
-          memcpy(framePtr, slicePtr, fileFrameSize);
-          }
+  if (numThreads > 1)
+    {
+    // the first thread reports the progress for its own range
+    workers[0]->SetProgressRange(
+      minFileIdx, (numFilesToWrite + numThreads - 1)/numThreads);
 
-        // flip the data if necessary
-        if (flipImage)
-          {
-          int numRows = extent[3] - extent[2] + 1;
-          int halfRows = numRows/2;
-          for (int yIdx = 0; yIdx < halfRows; yIdx++)
-            {
-            unsigned char *row1 = planePtr + yIdx*fileRowSize;
-            unsigned char *row2 = planePtr + (numRows-yIdx-1)*fileRowSize;
-            memcpy(rowBuffer, row1, fileRowSize);
-            memcpy(row1, row2, fileRowSize);
-            memcpy(row2, rowBuffer, fileRowSize);
-            }
-          }
+    vtkMultiThreader *threader = vtkMultiThreader::New();
+    threader->SetNumberOfThreads(numThreads);
+    threader->SetSingleMethod(vtkDICOMWriterThreadFunction, &workers[0]);
+    threader->SingleMethodExecute();
+    threader->Delete();
+    }
+  else
+    {
+    workers[0]->SetProgressRange(0, numFiles);
+    workers[0]->Execute();
+    }
 
-        planePtr += filePlaneSize;
-        }
-      // write the frame to the file
-      compiler->WriteFrame(framePtr, fileFrameSize);
+  // report the first error, in file order
+  for (int t = 0; t < numThreads; t++)
+    {
+    if (this->GetErrorCode() == vtkErrorCode::NoError)
+      {
+      this->SetErrorCode(workers[t]->GetErrorCode());
       }
-    compiler->Close();
+    delete workers[t];
     }
 
-  delete [] rowBuffer;
-  delete [] frameBuffer;
   this->FreeInternalFileName();
 
   this->UpdateProgress(1.0);
@@ -173,6 +173,25 @@ public:
   vtkGetMacro(Streaming, int);
   vtkBooleanMacro(Streaming, int);
 
+  // Description:
+  // Set the number of threads to use when writing the files (default: 1).
+  // If more than one thread is used, then each thread writes a contiguous
+  // range of the files with its own vtkDICOMCompiler.  The file names,
+  // UIDs, and file contents are the same as when one thread is used.
+  // If there is only one file, then the threads are used by the compiler
+  // to compress the frames instead.
+  vtkSetClampMacro(NumberOfThreads, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfThreads, int);
+
+  // Description:
+  // Write each compressed frame to the file as soon as it is encoded
+  // (default: Off).  This bounds the memory that is used when writing
+  // large, compressed, multi-frame files, but it requires that the files
+  // support seeking.  See vtkDICOMCompiler::SetStreamFragments().
+  vtkSetMacro(StreamFragments, int);
+  vtkGetMacro(StreamFragments, int);
+  vtkBooleanMacro(StreamFragments, int);
+
   // Description:
   // Write the file to disk.
   virtual void Write();
@@ -253,6 +272,14 @@ protected:
   // Whether to stream the data and write one file at a time.
   int Streaming;
 
+  // Description:
+  // The number of threads to use for writing the files.
+  int NumberOfThreads;
+
+  // Description:
+  // Whether to write compressed frames as soon as they are encoded.
+  int StreamFragments;
+
 private:
   vtkDICOMWriter(const vtkDICOMWriter&);  // Not implemented.
   void operator=(const vtkDICOMWriter&);  // Not implemented.
@@ -0,0 +1,165 @@
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark compares the pipelined mode of vtkDICOMCompiler, where
+// a background thread writes each frame while the next frame is being
+// encoded, with the serial mode, where WriteFrame() encodes the frame
+// and then waits for it to be written.  The files must be identical.
+
+namespace {
+
+// Write a multi-frame file, and return the time that it took
+double WriteFile(
+  const char *fileName, vtkDICOMMetaData *meta, const char *syntax,
+  const unsigned char *frames, int numFrames, size_t frameSize,
+  bool pipelined, int depth)
+{
+  double t0 = vtksys::SystemTools::GetTime();
+
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fileName);
+  compiler->SetMetaData(meta);
+  compiler->SetTransferSyntaxUID(syntax);
+  compiler->SetSOPInstanceUID("1.2.826.0.1.3680043.2.1143.1");
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->StreamFragmentsOn();
+  compiler->SetPipelined(pipelined);
+  compiler->SetPipelineDepth(depth);
+  compiler->WriteHeader();
+  for (int i = 0; i < numFrames; i++)
+    {
+    compiler->WriteFrame(frames + i*frameSize, frameSize);
+    }
+  compiler->Close();
+  compiler->Delete();
+
+  return vtksys::SystemTools::GetTime() - t0;
+}
+
+// Read a whole file into a string
+std::string ReadFile(const char *fileName)
+{
+  std::string contents;
+  FILE *fp = fopen(fileName, "rb");
+  if (fp)
+    {
+    char buffer[8192];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+      {
+      contents.append(buffer, n);
+      }
+    fclose(fp);
+    }
+  return contents;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of times to write each file
+  int numberOfRepeats = 10;
+  if (argc > 1)
+    {
+    numberOfRepeats = atoi(argv[1]);
+    }
+  // the maximum number of frames in the pipeline queue
+  int depth = 2;
+  if (argc > 2)
+    {
+    depth = atoi(argv[2]);
+    }
+  // the directory to write the files to
+  std::string dir = ".";
+  if (argc > 3)
+    {
+    dir = argv[3];
+    }
+
+  // a 16-bit greyscale series with smooth and noisy regions
+  int rows = 512;
+  int columns = 512;
+  int numFrames = 64;
+  size_t frameSize = static_cast<size_t>(rows)*columns*2;
+  unsigned char *frames = new unsigned char[frameSize*numFrames];
+  srand(1);
+  for (size_t i = 0; i < frameSize*numFrames; i++)
+    {
+    size_t row = i/(columns*2);
+    frames[i] = static_cast<unsigned char>(
+      (row % 64) < 32 ? (i/128) : rand());
+    }
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7.3");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::SamplesPerPixel, 1);
+  meta->SetAttributeValue(DC::PhotometricInterpretation, "MONOCHROME2");
+  meta->SetAttributeValue(DC::NumberOfFrames, numFrames);
+  meta->SetAttributeValue(DC::Rows, rows);
+  meta->SetAttributeValue(DC::Columns, columns);
+  meta->SetAttributeValue(DC::BitsAllocated, 16);
+  meta->SetAttributeValue(DC::BitsStored, 16);
+  meta->SetAttributeValue(DC::HighBit, 15);
+  meta->SetAttributeValue(DC::PixelRepresentation, 0);
+  // add an empty PixelData to be filled in by the compiler
+  unsigned short empty = 0;
+  meta->SetAttributeValue(
+    DC::PixelData, vtkDICOMValue(vtkDICOMVR::OW, &empty, empty));
+
+  std::string serialName = dir + "/BenchmarkDICOMCompiler1.dcm";
+  std::string pipelinedName = dir + "/BenchmarkDICOMCompiler2.dcm";
+  int result = 0;
+
+  // RLE compression, and big endian (which requires byte swapping)
+  static const char *syntaxes[2] = {
+    "1.2.840.10008.1.2.5", "1.2.840.10008.1.2.2" };
+
+  for (int k = 0; k < 2; k++)
+    {
+    double serialTime = 0.0;
+    double pipelinedTime = 0.0;
+    for (int n = 0; n < numberOfRepeats; n++)
+      {
+      serialTime += WriteFile(
+        serialName.c_str(), meta, syntaxes[k],
+        frames, numFrames, frameSize, false, depth);
+      pipelinedTime += WriteFile(
+        pipelinedName.c_str(), meta, syntaxes[k],
+        frames, numFrames, frameSize, true, depth);
+      }
+
+    std::string serialData = ReadFile(serialName.c_str());
+    std::string pipelinedData = ReadFile(pipelinedName.c_str());
+    if (serialData.size() == 0 || serialData != pipelinedData)
+      {
+      cout << "the pipelined file does not match the serial file\n";
+      result = 1;
+      }
+
+    double megabytes = 1e-6*numberOfRepeats*numFrames*frameSize;
+    cout << syntaxes[k] << ", frames: " << numFrames
+         << ", depth: " << depth << "\n";
+    cout << "write (MB/s):  serial " << megabytes/serialTime
+         << ", pipelined " << megabytes/pipelinedTime << "\n";
+    }
+
+  vtksys::SystemTools::RemoveFile(serialName.c_str());
+  vtksys::SystemTools::RemoveFile(pipelinedName.c_str());
+
+  meta->Delete();
+  delete [] frames;
+
+  return result;
+}
@@ -0,0 +1,191 @@
+#include "vtkDICOMDirectory.h"
+#include "vtkDICOMParser.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMUtilities.h"
+#include "vtkDICOMFile.h"
+
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark scans a set of files, some of which are DICOM and some
+// of which are not, and counts how many times the files are opened and
+// read.  The scan is done the way that vtkDICOMDirectory did it before,
+// where IsDICOMFile() opened each file before it was parsed, and the way
+// it does it now, where the parser checks the header as it reads it.
+
+namespace {
+
+// Scan the files and return the time, the number of opens, and reads
+double ScanFiles(
+  vtkStringArray *files, bool checkHeader,
+  unsigned long *opens, unsigned long *reads, int *found)
+{
+  unsigned long opens0 = vtkDICOMFile::GetNumberOfOpens();
+  unsigned long reads0 = vtkDICOMFile::GetNumberOfReads();
+  double t0 = vtksys::SystemTools::GetTime();
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetCheckFileHeader(checkHeader);
+  *found = 0;
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    const char *fileName = files->GetValue(i);
+    if (!checkHeader && !vtkDICOMUtilities::IsDICOMFile(fileName))
+      {
+      continue;
+      }
+    meta->Initialize();
+    parser->SetMetaData(meta);
+    parser->SetFileName(fileName);
+    parser->Update();
+    *found += parser->GetFileIsDICOM();
+    }
+  parser->Delete();
+  meta->Delete();
+
+  double t1 = vtksys::SystemTools::GetTime();
+  *opens = vtkDICOMFile::GetNumberOfOpens() - opens0;
+  *reads = vtkDICOMFile::GetNumberOfReads() - reads0;
+  return t1 - t0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of DICOM files, and the number of other files
+  int numberOfDICOM = 1000;
+  int numberOfOther = 100;
+  if (argc > 1)
+    {
+    numberOfDICOM = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    numberOfOther = atoi(argv[2]);
+    }
+  // the directory to write the files to
+  std::string dir = ".";
+  if (argc > 3)
+    {
+    dir = argv[3];
+    }
+
+  vtkStringArray *files = vtkStringArray::New();
+
+  // write the DICOM files
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "BENCHMARK^DIRECTORY");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  // the compiler only replaces the UIDs that are present in the meta data
+  meta->SetAttributeValue(DC::SOPInstanceUID, "1.2.826.0.1.3680043.2.1143.1");
+  meta->SetAttributeValue(DC::SeriesInstanceUID,
+                          "1.2.826.0.1.3680043.2.1143.2");
+  meta->SetAttributeValue(DC::StudyInstanceUID,
+                          "1.2.826.0.1.3680043.2.1143.3");
+  for (int i = 0; i < numberOfDICOM; i++)
+    {
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMDirectory" << i << ".dcm";
+    meta->SetAttributeValue(DC::InstanceNumber, i + 1);
+    vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+    compiler->SetFileName(name.str().c_str());
+    compiler->SetMetaData(meta);
+    compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+    compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+    compiler->WriteHeader();
+    compiler->Close();
+    compiler->Delete();
+    files->InsertNextValue(name.str());
+    }
+  meta->Delete();
+
+  // write some files that are not DICOM
+  for (int i = 0; i < numberOfOther; i++)
+    {
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMDirectory" << i << ".txt";
+    FILE *fp = fopen(name.str().c_str(), "wb");
+    if (fp)
+      {
+      for (int j = 0; j < 64; j++)
+        {
+        fputs("this is not a DICOM file\n", fp);
+        }
+      fclose(fp);
+      }
+    files->InsertNextValue(name.str());
+    }
+
+  int result = 0;
+  vtkIdType numberOfFiles = files->GetNumberOfValues();
+  unsigned long opens[3];
+  unsigned long reads[3];
+  int found[3];
+  double times[3];
+
+  times[0] = ScanFiles(files, false, &opens[0], &reads[0], &found[0]);
+  times[1] = ScanFiles(files, true, &opens[1], &reads[1], &found[1]);
+
+  // the directory scan should also open each file once
+  unsigned long opens0 = vtkDICOMFile::GetNumberOfOpens();
+  unsigned long reads0 = vtkDICOMFile::GetNumberOfReads();
+  double t0 = vtksys::SystemTools::GetTime();
+  vtkDICOMDirectory *directory = vtkDICOMDirectory::New();
+  directory->SetInputFileNames(files);
+  directory->RequirePixelDataOff();
+  directory->Update();
+  times[2] = vtksys::SystemTools::GetTime() - t0;
+  opens[2] = vtkDICOMFile::GetNumberOfOpens() - opens0;
+  reads[2] = vtkDICOMFile::GetNumberOfReads() - reads0;
+  found[2] = 0;
+  if (directory->GetNumberOfSeries() == 1)
+    {
+    found[2] = static_cast<int>(directory->GetFileNamesForSeries(0)
+                                ->GetNumberOfValues());
+    }
+  directory->Delete();
+
+  static const char *names[3] = {
+    "IsDICOMFile, then parse: ",
+    "parse, check header:     ",
+    "vtkDICOMDirectory:       " };
+
+  cout << "files: " << numberOfFiles << ", DICOM: " << numberOfDICOM << "\n";
+  for (int k = 0; k < 3; k++)
+    {
+    cout << names[k] << "opens " << opens[k] << ", reads " << reads[k]
+         << ", time (s) " << times[k] << "\n";
+    if (found[k] != numberOfDICOM)
+      {
+      cout << "found " << found[k] << " DICOM files, expected "
+           << numberOfDICOM << "\n";
+      result = 1;
+      }
+    }
+  if (opens[1] != static_cast<unsigned long>(numberOfFiles) ||
+      opens[2] != static_cast<unsigned long>(numberOfFiles))
+    {
+    cout << "each file should be opened exactly once\n";
+    result = 1;
+    }
+
+  for (vtkIdType i = 0; i < numberOfFiles; i++)
+    {
+    vtksys::SystemTools::RemoveFile(files->GetValue(i));
+    }
+  files->Delete();
+
+  return result;
+}
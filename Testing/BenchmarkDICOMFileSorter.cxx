@@ -0,0 +1,292 @@
+#include "vtkDICOMFileSorter.h"
+#include "vtkDICOMParser.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMUtilities.h"
+
+#include <vtkStringArray.h>
+#include <vtkUnsignedShortArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <list>
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark measures how the time taken by vtkDICOMFileSorter grows
+// with the number of files and series.  It also groups the same files
+// the way that vtkDICOMFileSorter did it before, where each file was
+// compared with every series that had been found so far, and checks
+// that the studies and series are the same.
+
+namespace {
+
+struct FileInfo
+{
+  std::string FileName;
+  vtkDICOMValue StudyUID;
+  vtkDICOMValue SeriesUID;
+  int InstanceNumber;
+};
+
+bool CompareInstance(const FileInfo &fi1, const FileInfo &fi2)
+{
+  return (fi1.InstanceNumber < fi2.InstanceNumber);
+}
+
+// The sorted files, as a list of series and the study for each series
+struct SortResult
+{
+  std::vector<std::vector<std::string> > Series;
+  std::vector<int> Study;
+};
+
+// Read the information that is used to sort the files
+void ReadFileInfo(
+  vtkStringArray *files, vtkIdType n, std::vector<FileInfo> *info)
+{
+  vtkUnsignedShortArray *groups = vtkUnsignedShortArray::New();
+  groups->InsertNextValue(0x0020);
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetGroups(groups);
+
+  info->resize(n);
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    FileInfo& fi = (*info)[i];
+    fi.FileName = files->GetValue(i);
+    meta->Initialize();
+    parser->SetMetaData(meta);
+    parser->SetFileName(fi.FileName.c_str());
+    parser->Update();
+    fi.StudyUID = meta->GetAttributeValue(DC::StudyInstanceUID);
+    fi.SeriesUID = meta->GetAttributeValue(DC::SeriesInstanceUID);
+    fi.InstanceNumber =
+      meta->GetAttributeValue(DC::InstanceNumber).AsUnsignedInt();
+    }
+
+  parser->Delete();
+  meta->Delete();
+  groups->Delete();
+}
+
+// Group the files by walking through all the series for every file
+void LegacyGroupFiles(const std::vector<FileInfo>& info, SortResult *r)
+{
+  std::list<std::vector<FileInfo> > sortedFiles;
+  std::list<std::vector<FileInfo> >::iterator li;
+
+  for (size_t j = 0; j < info.size(); j++)
+    {
+    const FileInfo& fileInfo = info[j];
+    const char *studyUID = fileInfo.StudyUID.GetCharData();
+    const char *seriesUID = fileInfo.SeriesUID.GetCharData();
+
+    bool foundSeries = false;
+    for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
+      {
+      // compare studyId first, then seriesId
+      int c1 = vtkDICOMUtilities::CompareUIDs(
+        studyUID, (*li)[0].StudyUID.GetCharData());
+      int c2 = 0;
+      if (c1 == 0)
+        {
+        c2 = vtkDICOMUtilities::CompareUIDs(
+          seriesUID, (*li)[0].SeriesUID.GetCharData());
+        }
+      if (c1 == 0 && c2 == 0 && seriesUID != 0)
+        {
+        (*li).push_back(fileInfo);
+        foundSeries = true;
+        break;
+        }
+      else if (c1 >= 0 || (c1 == 0 && c2 >= 0))
+        {
+        break;
+        }
+      }
+
+    if (!foundSeries)
+      {
+      std::vector<FileInfo> newSeries;
+      newSeries.push_back(fileInfo);
+      sortedFiles.insert(li, newSeries);
+      }
+    }
+
+  int studyCount = 0;
+  vtkDICOMValue lastStudyUID;
+  for (li = sortedFiles.begin(); li != sortedFiles.end(); ++li)
+    {
+    std::vector<FileInfo> &v = *li;
+    std::stable_sort(v.begin(), v.end(), CompareInstance);
+    if (studyCount == 0 || v[0].StudyUID != lastStudyUID)
+      {
+      lastStudyUID = v[0].StudyUID;
+      studyCount++;
+      }
+    r->Series.push_back(std::vector<std::string>());
+    r->Study.push_back(studyCount - 1);
+    for (size_t i = 0; i < v.size(); i++)
+      {
+      r->Series.back().push_back(v[i].FileName);
+      }
+    }
+}
+
+// Get the results from the sorter
+void GetSorterResult(vtkDICOMFileSorter *sorter, SortResult *r)
+{
+  for (int j = 0; j < sorter->GetNumberOfStudies(); j++)
+    {
+    int k0 = sorter->GetFirstSeriesForStudy(j);
+    int k1 = sorter->GetLastSeriesForStudy(j);
+    for (int k = k0; k <= k1; k++)
+      {
+      vtkStringArray *a = sorter->GetFileNamesForSeries(k);
+      r->Series.push_back(std::vector<std::string>());
+      r->Study.push_back(j);
+      for (vtkIdType i = 0; i < a->GetNumberOfValues(); i++)
+        {
+        r->Series.back().push_back(a->GetValue(i));
+        }
+      }
+    }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of files, the files per series, and the series per study
+  int numberOfFiles = 16000;
+  int filesPerSeries = 4;
+  int seriesPerStudy = 8;
+  if (argc > 1)
+    {
+    numberOfFiles = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    filesPerSeries = atoi(argv[2]);
+    }
+  if (argc > 3)
+    {
+    seriesPerStudy = atoi(argv[3]);
+    }
+  // the directory to write the files to
+  std::string dir = ".";
+  if (argc > 4)
+    {
+    dir = argv[4];
+    }
+  filesPerSeries = (filesPerSeries > 0 ? filesPerSeries : 1);
+  seriesPerStudy = (seriesPerStudy > 0 ? seriesPerStudy : 1);
+
+  vtkStringArray *files = vtkStringArray::New();
+
+  // write the files, with the files for each series written together
+  // and with the instances in reverse order, and with the series for
+  // each study spread throughout the list of files
+  int numberOfSeries = (numberOfFiles + filesPerSeries - 1)/filesPerSeries;
+  int numberOfStudies = (numberOfSeries + seriesPerStudy - 1)/seriesPerStudy;
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "BENCHMARK^FILESORTER");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    int series = i/filesPerSeries;
+    int study = series % numberOfStudies;
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMFileSorter" << i << ".dcm";
+    std::ostringstream studyUID;
+    studyUID << "1.2.826.0.1.3680043.2.1143." << study;
+    std::ostringstream seriesUID;
+    seriesUID << studyUID.str() << "." << series;
+    meta->SetAttributeValue(DC::StudyInstanceUID, studyUID.str());
+    meta->SetAttributeValue(DC::SeriesInstanceUID, seriesUID.str());
+    meta->SetAttributeValue(
+      DC::InstanceNumber, filesPerSeries - i % filesPerSeries);
+    vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+    compiler->SetFileName(name.str().c_str());
+    compiler->SetMetaData(meta);
+    compiler->WriteHeader();
+    compiler->Close();
+    compiler->Delete();
+    files->InsertNextValue(name.str());
+    }
+  meta->Delete();
+
+  int result = 0;
+  double t0, t1;
+
+  cout << "files: " << numberOfFiles << ", series: " << numberOfSeries
+       << ", studies: " << numberOfStudies << "\n";
+
+  // sort increasing numbers of files, to see how the time scales
+  vtkStringArray *subset = vtkStringArray::New();
+  for (int m = 8; m >= 1; m /= 2)
+    {
+    vtkIdType n = numberOfFiles/m;
+    subset->SetNumberOfValues(n);
+    for (vtkIdType i = 0; i < n; i++)
+      {
+      subset->SetValue(i, files->GetValue(i));
+      }
+
+    // the time to read the files, without sorting them
+    std::vector<FileInfo> info;
+    t0 = vtksys::SystemTools::GetTime();
+    ReadFileInfo(subset, n, &info);
+    t1 = vtksys::SystemTools::GetTime();
+    double readTime = t1 - t0;
+
+    // the time to group the files with the legacy method
+    SortResult legacyResult;
+    t0 = vtksys::SystemTools::GetTime();
+    LegacyGroupFiles(info, &legacyResult);
+    t1 = vtksys::SystemTools::GetTime();
+    double legacyTime = t1 - t0;
+
+    // the time to read and sort the files with vtkDICOMFileSorter
+    vtkDICOMFileSorter *sorter = vtkDICOMFileSorter::New();
+    sorter->SetInputFileNames(subset);
+    sorter->RequirePixelDataOff();
+    t0 = vtksys::SystemTools::GetTime();
+    sorter->Update();
+    t1 = vtksys::SystemTools::GetTime();
+    double sorterTime = t1 - t0;
+    SortResult sorterResult;
+    GetSorterResult(sorter, &sorterResult);
+    sorter->Delete();
+
+    cout << "files: " << n << "\n";
+    cout << "  read (s):                  " << readTime << "\n";
+    cout << "  read and sort (s):         " << sorterTime << "\n";
+    cout << "  legacy grouping only (s):  " << legacyTime << "\n";
+
+    if (sorterResult.Series != legacyResult.Series ||
+        sorterResult.Study != legacyResult.Study)
+      {
+      cout << "vtkDICOMFileSorter and the legacy method do not match\n";
+      result = 1;
+      }
+    }
+  subset->Delete();
+
+  for (vtkIdType i = 0; i < numberOfFiles; i++)
+    {
+    vtksys::SystemTools::RemoveFile(files->GetValue(i));
+    }
+  files->Delete();
+
+  return result;
+}
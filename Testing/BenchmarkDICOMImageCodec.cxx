@@ -0,0 +1,411 @@
+#include "vtkDICOMImageCodec.h"
+#include "vtkDICOMUtilities.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark compares the RLE decoder in vtkDICOMImageCodec with
+// the decoder that it used previously, which wrote each decoded byte
+// directly to its interleaved position in the output.  It also compares
+// the RLE encoder with the previous encoder, which read each byte from
+// its interleaved position, and times the multi-threaded encoder.
+
+namespace {
+
+int LegacyDecodeRLE(
+  const vtkDICOMImageCodec::ImageFormat& image,
+  const unsigned char *source, size_t sourceSize,
+  unsigned char *dest, size_t destSize)
+{
+  const unsigned char *inPtr = source;
+  unsigned char *outPtr = dest;
+  int errorCode = vtkDICOMImageCodec::NoError;
+
+  unsigned int n = vtkDICOMUtilities::UnpackUnsignedInt(inPtr);
+  size_t segmentSize = destSize/n;
+
+  unsigned int spp = image.SamplesPerPixel;
+  spp = (spp == 0 ? 1 : spp);
+  spp = (n % spp != 0 ? n : spp);
+  unsigned int bps = n/spp;
+
+  unsigned int outInc = (image.PlanarConfiguration ? bps : n);
+  size_t segInc = (image.PlanarConfiguration ? segmentSize : 1);
+  segInc *= bps;
+
+  union { char c[2]; short s; } endiancheck;
+  endiancheck.c[0] = 1;
+  endiancheck.c[1] = 0;
+
+  for (unsigned int i = 0; i < n; i++)
+    {
+    unsigned int s = i / bps;
+    unsigned int b = i % bps;
+    size_t outOffset = s*segInc + b;
+    if (endiancheck.s == 1)
+      {
+      outOffset = s*segInc + (bps - b - 1);
+      }
+    unsigned int offset =
+      vtkDICOMUtilities::UnpackUnsignedInt(inPtr + (i+1)*4);
+    if (offset >= sourceSize)
+      {
+      break;
+      }
+    const signed char *cp =
+      reinterpret_cast<const signed char *>(inPtr + offset);
+    signed char *dp = reinterpret_cast<signed char *>(outPtr + outOffset);
+    size_t remaining = segmentSize;
+    while (remaining > 0 && offset < sourceSize)
+      {
+      if (++offset == sourceSize)
+        {
+        break;
+        }
+      short c = *cp++;
+      if (c >= 0)
+        {
+        c = c + 1;
+        if (sourceSize - offset < static_cast<size_t>(c))
+          {
+          c = static_cast<short>(sourceSize - offset);
+          }
+        offset += c;
+        if (static_cast<size_t>(c) > remaining)
+          {
+          c = static_cast<short>(remaining);
+          }
+        remaining -= c;
+        do
+          {
+          *dp = *cp++;
+          dp += outInc;
+          }
+        while (--c);
+        }
+      else if (c > -128)
+        {
+        c = 1 - c;
+        offset += 1;
+        if (static_cast<size_t>(c) > remaining)
+          {
+          c = static_cast<short>(remaining);
+          }
+        remaining -= c;
+        do
+          {
+          *dp = *cp;
+          dp += outInc;
+          }
+        while (--c);
+        cp++;
+        }
+      }
+    if (remaining > 0)
+      {
+      errorCode = vtkDICOMImageCodec::MissingData;
+      do
+        {
+        *dp = 0;
+        dp += outInc;
+        }
+      while (--remaining);
+      }
+    }
+
+  return errorCode;
+}
+
+int LegacyEncodeRLE(
+  const vtkDICOMImageCodec::ImageFormat& image,
+  const unsigned char *source, size_t sourceSize,
+  unsigned char **destP, size_t *destSizeP)
+{
+  int errorCode = vtkDICOMImageCodec::NoError;
+
+  unsigned int spp = image.SamplesPerPixel;
+  spp = (spp == 0 ? 1 : spp);
+  unsigned int bps = (image.BitsAllocated + 7)/8;
+  bps = (bps == 0 ? 1 : bps);
+
+  unsigned int n = spp*bps;
+  if (n == 0 || n > 15)
+    {
+    *destP = 0;
+    *destSizeP = 0;
+    return vtkDICOMImageCodec::BadPixelFormat;
+    }
+
+  size_t segmentSize = sourceSize/n;
+
+  unsigned int inInc = (image.PlanarConfiguration ? bps : n);
+  size_t segInc = (image.PlanarConfiguration ? segmentSize : 1);
+  segInc *= bps;
+
+  size_t destReserve = 4000;
+  unsigned char *dest = new unsigned char[destReserve + 1];
+
+  vtkDICOMUtilities::PackUnsignedInt(n, dest);
+  for (unsigned int i = 0; i < 15; i++)
+    {
+    vtkDICOMUtilities::PackUnsignedInt(0, dest + 4*(i + 1));
+    }
+
+  unsigned int offset = 64;
+  unsigned short rowlen = image.Columns;
+  size_t numrows = sourceSize/(n*rowlen);
+
+  union { char c[2]; short s; } endiancheck;
+  endiancheck.c[0] = 1;
+  endiancheck.c[1] = 0;
+
+  for (unsigned int i = 0; i < n; i++)
+    {
+    vtkDICOMUtilities::PackUnsignedInt(offset, dest + 4*(i + 1));
+    unsigned int s = i / bps;
+    unsigned int b = i % bps;
+    size_t inOffset = s*segInc + b; // big-endian
+    if (endiancheck.s == 1) // little-endian
+      {
+      inOffset = s*segInc + (bps - b - 1);
+      }
+    const signed char *cp =
+      reinterpret_cast<const signed char *>(source + inOffset);
+    signed char *dp = reinterpret_cast<signed char *>(dest + offset);
+
+    for (size_t j = 0; j < numrows; j++)
+      {
+      const signed char *ep = cp + rowlen*inInc;
+      while (cp != ep)
+        {
+        short maxcount = 128;
+        ptrdiff_t remainder = (ep - cp)/inInc;
+        maxcount = (remainder < maxcount ? remainder : maxcount);
+        short counter = maxcount;
+        const signed char *sp = cp;
+
+        signed char prev = *cp;
+        do
+          {
+          cp += inInc;
+          }
+        while (--counter != 0 && *cp == prev);
+
+        if (maxcount - counter > 1)
+          {
+          counter = -(maxcount - counter - 1);
+          }
+        else if (counter > 0)
+          {
+          signed char pprev;
+          do
+            {
+            pprev = prev;
+            prev = *cp;
+            cp += inInc;
+            }
+          while (--counter != 0 && (*cp != prev || prev != pprev));
+
+          counter = maxcount - counter - 1;
+
+          if (remainder > counter + 1 && *cp == prev)
+            {
+            short reps = 1 + (prev == pprev);
+            reps = (reps < counter ? reps : counter);
+            counter -= reps;
+            cp -= reps*inInc;
+            }
+
+          offset += counter;
+          }
+
+        offset += 2;
+
+        if (offset > destReserve)
+          {
+          destReserve *= 2;
+          unsigned char *newdest = new unsigned char[destReserve + 1];
+          size_t size = dp-reinterpret_cast<signed char *>(dest);
+          memcpy(newdest, dest, size);
+          delete [] dest;
+          dest = newdest;
+          dp = reinterpret_cast<signed char *>(dest + size);
+          }
+
+        *dp++ = counter;
+        do
+          {
+          *dp++ = *sp;
+          sp += inInc;
+          }
+        while (--counter >= 0);
+        }
+      }
+
+    if ((offset & 1) != 0)
+      {
+      offset++;
+      *dp = 0;
+      }
+    }
+
+  *destP = dest;
+  *destSizeP = offset;
+
+  return errorCode;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of times to decode and encode each image
+  int numberOfRepeats = 200;
+  if (argc > 1)
+    {
+    numberOfRepeats = atoi(argv[1]);
+    }
+  // the number of threads for the multi-threaded encoder
+  int numberOfThreads = 4;
+  if (argc > 2)
+    {
+    numberOfThreads = atoi(argv[2]);
+    }
+
+  // a 16-bit greyscale image and an 8-bit RGB image, with smooth
+  // regions (for replication runs) and noisy regions (for literal runs)
+  int rows = 512;
+  int columns = 512;
+  int result = 0;
+
+  for (int k = 0; k < 2; k++)
+    {
+    vtkDICOMImageCodec::ImageFormat image;
+    image.Rows = static_cast<unsigned short>(rows);
+    image.Columns = static_cast<unsigned short>(columns);
+    image.BitsAllocated = (k == 0 ? 16 : 8);
+    image.BitsStored = image.BitsAllocated;
+    image.SamplesPerPixel = (k == 0 ? 1 : 3);
+
+    size_t size = static_cast<size_t>(rows)*columns*
+      image.SamplesPerPixel*(image.BitsAllocated/8);
+    unsigned char *source = new unsigned char[size];
+    srand(1);
+    for (size_t i = 0; i < size; i++)
+      {
+      size_t row = i/(size/rows);
+      source[i] = static_cast<unsigned char>(
+        (row % 64) < 32 ? (i/128) : rand());
+      }
+
+    vtkDICOMImageCodec codec(vtkDICOMImageCodec::RLE);
+    unsigned char *encoded = 0;
+    size_t encodedSize = 0;
+    codec.Encode(image, source, size, &encoded, &encodedSize);
+
+    unsigned char *dest = new unsigned char[size];
+    unsigned char *check = new unsigned char[size];
+    double t0, t1;
+
+    t0 = vtksys::SystemTools::GetTime();
+    for (int n = 0; n < numberOfRepeats; n++)
+      {
+      codec.Decode(image, encoded, encodedSize, dest, size);
+      }
+    t1 = vtksys::SystemTools::GetTime();
+    double codecTime = t1 - t0;
+
+    t0 = vtksys::SystemTools::GetTime();
+    for (int n = 0; n < numberOfRepeats; n++)
+      {
+      LegacyDecodeRLE(image, encoded, encodedSize, check, size);
+      }
+    t1 = vtksys::SystemTools::GetTime();
+    double legacyTime = t1 - t0;
+
+    // encode the image with one thread
+    t0 = vtksys::SystemTools::GetTime();
+    for (int n = 0; n < numberOfRepeats; n++)
+      {
+      unsigned char *tmp = 0;
+      size_t tmpSize = 0;
+      codec.Encode(image, source, size, &tmp, &tmpSize);
+      delete [] tmp;
+      }
+    t1 = vtksys::SystemTools::GetTime();
+    double codecEncodeTime = t1 - t0;
+
+    unsigned char *legacyEncoded = 0;
+    size_t legacyEncodedSize = 0;
+    t0 = vtksys::SystemTools::GetTime();
+    for (int n = 0; n < numberOfRepeats; n++)
+      {
+      delete [] legacyEncoded;
+      LegacyEncodeRLE(image, source, size,
+                      &legacyEncoded, &legacyEncodedSize);
+      }
+    t1 = vtksys::SystemTools::GetTime();
+    double legacyEncodeTime = t1 - t0;
+
+    // encode the same number of frames with several threads
+    int numberOfFrames = 16;
+    unsigned char *frames = new unsigned char[numberOfFrames*size];
+    for (int f = 0; f < numberOfFrames; f++)
+      {
+      memcpy(frames + f*size, source, size);
+      }
+    unsigned char **frameData = new unsigned char *[numberOfFrames];
+    size_t *frameSizes = new size_t[numberOfFrames];
+    bool framesMatch = true;
+    t0 = vtksys::SystemTools::GetTime();
+    for (int n = 0; n < numberOfRepeats; n += numberOfFrames)
+      {
+      codec.EncodeFrames(image, numberOfFrames, frames, size,
+                         frameData, frameSizes, numberOfThreads);
+      for (int f = 0; f < numberOfFrames; f++)
+        {
+        framesMatch &= (frameSizes[f] == encodedSize &&
+                        memcmp(frameData[f], encoded, encodedSize) == 0);
+        delete [] frameData[f];
+        }
+      }
+    t1 = vtksys::SystemTools::GetTime();
+    double threadedEncodeTime = t1 - t0;
+    delete [] frameData;
+    delete [] frameSizes;
+    delete [] frames;
+
+    cout << (k == 0 ? "16-bit grey" : "8-bit RGB") << " " << columns
+         << "x" << rows << ", compressed to " << encodedSize << " bytes\n";
+    cout << "decode (s):  vtkDICOMImageCodec " << codecTime
+         << ", legacy " << legacyTime << "\n";
+    cout << "encode (s):  vtkDICOMImageCodec " << codecEncodeTime
+         << ", legacy " << legacyEncodeTime << ", "
+         << numberOfThreads << " threads " << threadedEncodeTime << "\n";
+
+    // all of the encoders must produce identical output
+    if (legacyEncodedSize != encodedSize ||
+        memcmp(legacyEncoded, encoded, encodedSize) != 0 || !framesMatch)
+      {
+      cout << "encoded image does not match the legacy encoder!\n";
+      result = 1;
+      }
+    delete [] legacyEncoded;
+
+    // both decoders must produce the original image
+    if (memcmp(dest, source, size) != 0 || memcmp(check, source, size) != 0)
+      {
+      cout << "decoded image does not match the original!\n";
+      result = 1;
+      }
+
+    delete [] encoded;
+    delete [] source;
+    delete [] dest;
+    delete [] check;
+    }
+
+  return result;
+}
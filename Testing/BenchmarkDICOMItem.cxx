@@ -0,0 +1,347 @@
+#include "vtkDICOMItem.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMParser.h"
+#include "vtkDICOMDataElement.h"
+#include "vtkDICOMValue.h"
+#include "vtkDICOMTag.h"
+#include "vtkDICOMTagPath.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark compares vtkDICOMItem with the storage that it used
+// previously: a linked list that was searched element-by-element, which
+// was slow for the large items that are found in RT structure sets.
+// It also measures the time needed to parse a large RTSTRUCT file.
+
+namespace {
+
+struct LegacyElement
+{
+  LegacyElement() : Tag(), Value(), Next(0), Prev(0) {}
+
+  vtkDICOMTag Tag;
+  vtkDICOMValue Value;
+  LegacyElement *Next;
+  LegacyElement *Prev;
+};
+
+class LegacyItem
+{
+public:
+  LegacyItem() : Elements(0), NumberOfElements(0), Capacity(0) {
+    this->Head.Next = &this->Tail;
+    this->Tail.Prev = &this->Head; }
+  ~LegacyItem() { delete [] this->Elements; }
+
+  const vtkDICOMValue *Find(vtkDICOMTag tag) const;
+  LegacyElement *FindOrInsert(vtkDICOMTag tag);
+
+  LegacyElement *Elements;
+  int NumberOfElements;
+  int Capacity;
+  LegacyElement Head;
+  LegacyElement Tail;
+
+private:
+  LegacyItem(const LegacyItem&);
+  LegacyItem& operator=(const LegacyItem&);
+};
+
+const vtkDICOMValue *LegacyItem::Find(vtkDICOMTag tag) const
+{
+  const LegacyElement *e = this->Head.Next;
+  while (e != &this->Tail)
+    {
+    if (e->Tag == tag)
+      {
+      return &e->Value;
+      }
+    e = e->Next;
+    }
+  return 0;
+}
+
+LegacyElement *LegacyItem::FindOrInsert(vtkDICOMTag tag)
+{
+  LegacyElement *tptr = &this->Tail;
+  do
+    {
+    tptr = tptr->Prev;
+    }
+  while (tptr != &this->Head && tag < tptr->Tag);
+
+  if (tptr != &this->Head && tptr->Tag == tag)
+    {
+    return tptr;
+    }
+
+  if (this->NumberOfElements == this->Capacity)
+    {
+    // re-allocate and re-link, in list order
+    int m = (this->Capacity < 4 ? 4 : 2*this->Capacity);
+    LegacyElement *e = new LegacyElement[m];
+    LegacyElement *ptr = this->Head.Next;
+    LegacyElement *newtptr = &this->Head;
+    LegacyElement *prev = &this->Head;
+    for (int i = 0; i < this->NumberOfElements; i++)
+      {
+      e[i].Tag = ptr->Tag;
+      e[i].Value = ptr->Value;
+      e[i].Prev = prev;
+      prev->Next = &e[i];
+      prev = &e[i];
+      if (ptr == tptr)
+        {
+        newtptr = &e[i];
+        }
+      ptr = ptr->Next;
+      }
+    prev->Next = &this->Tail;
+    this->Tail.Prev = prev;
+    delete [] this->Elements;
+    this->Elements = e;
+    this->Capacity = m;
+    tptr = newtptr;
+    }
+
+  LegacyElement *e = &this->Elements[this->NumberOfElements++];
+  e->Tag = tag;
+  e->Prev = tptr;
+  e->Next = tptr->Next;
+  e->Prev->Next = e;
+  e->Next->Prev = e;
+
+  return e;
+}
+
+// Make the data elements for one item of a ContourSequence, in order,
+// followed by a block of private elements like those added by vendors
+void MakeContourElements(
+  int contour, int numberOfPrivate,
+  std::vector<vtkDICOMTag> *tags, std::vector<vtkDICOMValue> *values)
+{
+  double points[60];
+  for (int i = 0; i < 60; i++)
+    {
+    points[i] = 0.5*(contour % 200) + 0.25*i;
+    }
+
+  vtkDICOMItem imageItem;
+  imageItem.SetAttributeValue(
+    DC::ReferencedSOPClassUID, "1.2.840.10008.5.1.4.1.1.2");
+  imageItem.SetAttributeValue(
+    DC::ReferencedSOPInstanceUID, "1.2.826.0.1.3680043.2.1143.4");
+
+  tags->clear();
+  values->clear();
+  tags->push_back(DC::ContourImageSequence);
+  values->push_back(vtkDICOMValue(vtkDICOMVR::SQ, imageItem));
+  tags->push_back(DC::ContourGeometricType);
+  values->push_back(vtkDICOMValue(vtkDICOMVR::CS, "CLOSED_PLANAR"));
+  tags->push_back(DC::NumberOfContourPoints);
+  values->push_back(vtkDICOMValue(vtkDICOMVR::IS, 20));
+  tags->push_back(DC::ContourNumber);
+  values->push_back(vtkDICOMValue(vtkDICOMVR::IS, contour + 1));
+  tags->push_back(DC::ContourData);
+  values->push_back(vtkDICOMValue(vtkDICOMVR::DS, points, 60));
+
+  if (numberOfPrivate > 0)
+    {
+    tags->push_back(vtkDICOMTag(0x3007, 0x0010));
+    values->push_back(vtkDICOMValue(vtkDICOMVR::LO, "BENCHMARK"));
+    for (int i = 0; i < numberOfPrivate && i < 256; i++)
+      {
+      tags->push_back(vtkDICOMTag(0x3007, 0x1000 + i));
+      values->push_back(vtkDICOMValue(vtkDICOMVR::LO, "benchmark"));
+      }
+    }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of ROIs, the contours per ROI, the private elements per
+  // contour, and the directory to write the RTSTRUCT file to
+  int numberOfROIs = 50;
+  int numberOfContours = 100;
+  int numberOfPrivate = 40;
+  std::string dir = ".";
+  if (argc > 1)
+    {
+    numberOfROIs = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    numberOfContours = atoi(argv[2]);
+    }
+  if (argc > 3)
+    {
+    numberOfPrivate = atoi(argv[3]);
+    }
+  if (argc > 4)
+    {
+    dir = argv[4];
+    }
+
+  int numberOfItems = numberOfROIs*numberOfContours;
+  std::vector<std::vector<vtkDICOMTag> > tags(numberOfItems);
+  std::vector<std::vector<vtkDICOMValue> > values(numberOfItems);
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    MakeContourElements(i, numberOfPrivate, &tags[i], &values[i]);
+    }
+
+  // a random order for lookups, with a tag that will not be found
+  std::vector<vtkDICOMTag> lookups(tags[0]);
+  lookups.push_back(vtkDICOMTag(0x3006, 0x0049));
+  srand(1);
+  for (size_t j = lookups.size(); j > 1; j--)
+    {
+    size_t k = static_cast<size_t>(rand()) % j;
+    vtkDICOMTag t = lookups[j-1];
+    lookups[j-1] = lookups[k];
+    lookups[k] = t;
+    }
+
+  int found = 0;
+  int repeats = 10;
+  double t0, t1;
+
+  // the current storage
+  std::vector<vtkDICOMItem> items(numberOfItems);
+  t0 = vtksys::SystemTools::GetTime();
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    for (size_t j = 0; j < tags[i].size(); j++)
+      {
+      items[i].SetAttributeValue(tags[i][j], values[i][j]);
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double itemInsert = t1 - t0;
+
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < repeats; n++)
+    {
+    for (int i = 0; i < numberOfItems; i++)
+      {
+      for (size_t j = 0; j < lookups.size(); j++)
+        {
+        found += items[i].GetAttributeValue(lookups[j]).IsValid();
+        }
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double itemFind = t1 - t0;
+
+  // the legacy storage
+  std::vector<LegacyItem *> legacy(numberOfItems);
+  t0 = vtksys::SystemTools::GetTime();
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    legacy[i] = new LegacyItem;
+    for (size_t j = 0; j < tags[i].size(); j++)
+      {
+      legacy[i]->FindOrInsert(tags[i][j])->Value = values[i][j];
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double legacyInsert = t1 - t0;
+
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < repeats; n++)
+    {
+    for (int i = 0; i < numberOfItems; i++)
+      {
+      for (size_t j = 0; j < lookups.size(); j++)
+        {
+        found -= (legacy[i]->Find(lookups[j]) != 0);
+        }
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double legacyFind = t1 - t0;
+
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    delete legacy[i];
+    }
+
+  // build an RTSTRUCT from the items, write it, and then parse it
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.481.3");
+  meta->SetAttributeValue(DC::Modality, "RTSTRUCT");
+  meta->SetAttributeValue(DC::StructureSetLabel, "BENCHMARK");
+  vtkDICOMSequence roiContours;
+  for (int r = 0; r < numberOfROIs; r++)
+    {
+    vtkDICOMSequence contours;
+    for (int c = 0; c < numberOfContours; c++)
+      {
+      contours.AddItem(items[r*numberOfContours + c]);
+      }
+    vtkDICOMItem roiItem;
+    roiItem.SetAttributeValue(DC::ContourSequence, contours);
+    roiItem.SetAttributeValue(DC::ReferencedROINumber, r + 1);
+    roiContours.AddItem(roiItem);
+    }
+  meta->SetAttributeValue(DC::ROIContourSequence, roiContours);
+
+  std::string fileName = dir + "/BenchmarkDICOMItem.dcm";
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fileName.c_str());
+  compiler->SetMetaData(meta);
+  compiler->SetSOPInstanceUID("1.2.826.0.1.3680043.2.1143.1");
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->WriteHeader();
+  compiler->Close();
+  compiler->Delete();
+
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetFileName(fileName.c_str());
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < repeats; n++)
+    {
+    meta->Clear();
+    parser->SetMetaData(meta);
+    parser->Update();
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double parseTime = (t1 - t0)/repeats;
+  parser->Delete();
+
+  // check that the parsed file has all of the contours
+  vtkDICOMTagPath path(
+    DC::ROIContourSequence, numberOfROIs - 1,
+    DC::ContourSequence, numberOfContours - 1, DC::ContourNumber);
+  if (meta->GetAttributeValue(path).AsInt() != numberOfItems)
+    {
+    cout << "the parsed RTSTRUCT does not match the original\n";
+    found = -1;
+    }
+  meta->Delete();
+  vtksys::SystemTools::RemoveFile(fileName.c_str());
+
+  cout << "items: " << numberOfItems
+       << ", elements per item: " << tags[0].size() << "\n";
+  cout << "insert (s):  vtkDICOMItem " << itemInsert
+       << ", legacy " << legacyInsert << "\n";
+  cout << "find (s):    vtkDICOMItem " << itemFind
+       << ", legacy " << legacyFind << "\n";
+  cout << "parse (s):   " << parseTime << "\n";
+
+  // both should have found the same elements
+  return (found == 0 ? 0 : 1);
+}
@@ -0,0 +1,352 @@
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDataElement.h"
+#include "vtkDICOMValue.h"
+#include "vtkDICOMTag.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark compares vtkDICOMMetaData with the storage that it used
+// previously: a fixed-size hash table of separately allocated buckets,
+// with a doubly-linked list to keep the elements in order.  It also
+// measures ShallowCopy() for meta data with many instances, as is done
+// for every filter in a pipeline, against copying every attribute.
+
+namespace {
+
+struct LegacyElement
+{
+  LegacyElement() : Tag(), Value(), Next(0), Prev(0) {}
+
+  vtkDICOMTag Tag;
+  vtkDICOMValue Value;
+  LegacyElement *Next;
+  LegacyElement *Prev;
+};
+
+class LegacyMetaData
+{
+public:
+  enum { HashSize = 512 };
+
+  LegacyMetaData() : Table(0) {
+    this->Head.Next = &this->Tail;
+    this->Tail.Prev = &this->Head; }
+  ~LegacyMetaData() { this->Clear(); }
+
+  void Clear();
+  LegacyElement *Find(vtkDICOMTag tag);
+  LegacyElement *FindOrInsert(vtkDICOMTag tag);
+
+  LegacyElement **Table;
+  LegacyElement Head;
+  LegacyElement Tail;
+};
+
+void LegacyMetaData::Clear()
+{
+  if (this->Table)
+    {
+    for (unsigned int i = 0; i < HashSize; i++)
+      {
+      delete [] this->Table[i];
+      }
+    delete [] this->Table;
+    }
+  this->Table = 0;
+  this->Head.Next = &this->Tail;
+  this->Tail.Prev = &this->Head;
+}
+
+LegacyElement *LegacyMetaData::Find(vtkDICOMTag tag)
+{
+  unsigned int i = (tag.ComputeHash() & (HashSize - 1));
+  LegacyElement *hptr;
+  if (this->Table && (hptr = this->Table[i]) != 0)
+    {
+    while (hptr->Next != 0)
+      {
+      if (hptr->Tag == tag)
+        {
+        return hptr;
+        }
+      hptr++;
+      }
+    }
+  return 0;
+}
+
+LegacyElement *LegacyMetaData::FindOrInsert(vtkDICOMTag tag)
+{
+  unsigned int i = (tag.ComputeHash() & (HashSize - 1));
+  if (this->Table == 0)
+    {
+    this->Table = new LegacyElement *[HashSize];
+    for (unsigned int j = 0; j < HashSize; j++)
+      {
+      this->Table[j] = 0;
+      }
+    }
+
+  LegacyElement *hptr = this->Table[i];
+  if (hptr == 0)
+    {
+    hptr = new LegacyElement[4];
+    this->Table[i] = hptr;
+    }
+  else if (hptr->Next != 0)
+    {
+    unsigned int n = 0;
+    do
+      {
+      if (hptr->Tag == tag)
+        {
+        return hptr;
+        }
+      n++;
+      hptr++;
+      }
+    while (hptr->Next != 0);
+
+    if (n > 2 && (n & (n+1)) == 0)
+      {
+      LegacyElement *oldptr = this->Table[i];
+      hptr = new LegacyElement[2*(n+1)];
+      this->Table[i] = hptr;
+      for (unsigned int j = 0; j < n; j++)
+        {
+        *hptr = oldptr[j];
+        hptr->Next->Prev = hptr;
+        hptr->Prev->Next = hptr;
+        hptr++;
+        }
+      delete [] oldptr;
+      }
+    }
+
+  LegacyElement *tptr = &this->Tail;
+  do
+    {
+    tptr = tptr->Prev;
+    }
+  while (tag < tptr->Tag);
+
+  hptr->Tag = tag;
+  hptr->Prev = tptr;
+  hptr->Next = tptr->Next;
+  hptr->Prev->Next = hptr;
+  hptr->Next->Prev = hptr;
+
+  return hptr;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of data sets, and the number of elements in each
+  int numberOfDataSets = 200;
+  int numberOfElements = 2000;
+  if (argc > 1)
+    {
+    numberOfDataSets = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    numberOfElements = atoi(argv[2]);
+    }
+
+  // make tags from a few groups, in the order a parser would see them
+  std::vector<vtkDICOMTag> tags;
+  static const unsigned short groups[] = {
+    0x0008, 0x0010, 0x0018, 0x0020, 0x0028, 0x0029, 0x0043, 0x5200 };
+  const int numberOfGroups = sizeof(groups)/sizeof(groups[0]);
+  for (int i = 0; i < numberOfElements; i++)
+    {
+    unsigned short g = groups[(i*numberOfGroups)/numberOfElements];
+    unsigned short e = static_cast<unsigned short>(
+      0x0010 + 3*(i % (numberOfElements/numberOfGroups + 1)));
+    tags.push_back(vtkDICOMTag(g, e));
+    }
+
+  // a random order for lookups
+  std::vector<vtkDICOMTag> lookups(tags);
+  srand(1);
+  for (size_t j = lookups.size(); j > 1; j--)
+    {
+    size_t k = static_cast<size_t>(rand()) % j;
+    vtkDICOMTag t = lookups[j-1];
+    lookups[j-1] = lookups[k];
+    lookups[k] = t;
+    }
+
+  vtkDICOMValue value(vtkDICOMVR::LO, "benchmark");
+  int found = 0;
+  double t0, t1;
+
+  // the current storage
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    meta->Clear();
+    for (size_t i = 0; i < tags.size(); i++)
+      {
+      meta->SetAttributeValue(tags[i], value);
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double metaInsert = t1 - t0;
+
+  // insert in random order, so that each insertion is within the list
+  vtkDICOMMetaData *shuffled = vtkDICOMMetaData::New();
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    shuffled->Clear();
+    for (size_t i = 0; i < lookups.size(); i++)
+      {
+      shuffled->SetAttributeValue(lookups[i], value);
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double metaShuffled = t1 - t0;
+
+  // the elements must be in order, no matter the order of insertion
+  vtkDICOMTag lastTag;
+  vtkDICOMDataElementIterator iter = shuffled->Begin();
+  vtkDICOMDataElementIterator iterEnd = shuffled->End();
+  for (; iter != iterEnd; ++iter)
+    {
+    found += (lastTag < iter->GetTag() ? 0 : 1);
+    lastTag = iter->GetTag();
+    }
+  found += (shuffled->GetNumberOfDataElements() ==
+            static_cast<int>(tags.size()) ? 0 : 1);
+  shuffled->Delete();
+
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    for (size_t i = 0; i < lookups.size(); i++)
+      {
+      found += (meta->Find(lookups[i]) != meta->End());
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double metaFind = t1 - t0;
+  meta->Delete();
+
+  // the legacy storage
+  LegacyMetaData legacy;
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    legacy.Clear();
+    for (size_t i = 0; i < tags.size(); i++)
+      {
+      legacy.FindOrInsert(tags[i])->Value = value;
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double legacyInsert = t1 - t0;
+
+  LegacyMetaData legacyShuffled;
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    legacyShuffled.Clear();
+    for (size_t i = 0; i < lookups.size(); i++)
+      {
+      legacyShuffled.FindOrInsert(lookups[i])->Value = value;
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double legacyShuffledInsert = t1 - t0;
+
+  t0 = vtksys::SystemTools::GetTime();
+  for (int n = 0; n < numberOfDataSets; n++)
+    {
+    for (size_t i = 0; i < lookups.size(); i++)
+      {
+      found -= (legacy.Find(lookups[i]) != 0);
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double legacyFind = t1 - t0;
+
+  // meta data for a series, where some attributes differ per instance
+  int numberOfInstances = 3000;
+  vtkDICOMMetaData *series = vtkDICOMMetaData::New();
+  series->SetNumberOfInstances(numberOfInstances);
+  for (size_t i = 0; i < tags.size(); i++)
+    {
+    series->SetAttributeValue(tags[i], value);
+    if (i % 20 == 0)
+      {
+      for (int j = 0; j < numberOfInstances; j++)
+        {
+        series->SetAttributeValue(j, tags[i], vtkDICOMValue(
+          vtkDICOMVR::IS, j));
+        }
+      }
+    }
+
+  // pass the meta data along a chain of copies, like a pipeline
+  vtkDICOMMetaData *copies[2];
+  copies[0] = vtkDICOMMetaData::New();
+  copies[1] = vtkDICOMMetaData::New();
+  t0 = vtksys::SystemTools::GetTime();
+  copies[0]->ShallowCopy(series);
+  for (int n = 1; n < numberOfDataSets; n++)
+    {
+    copies[n % 2]->ShallowCopy(copies[(n - 1) % 2]);
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double shallowCopy = t1 - t0;
+
+  // the first modification after a shallow copy must copy the storage
+  vtkDICOMMetaData *last = copies[(numberOfDataSets - 1) % 2];
+  t0 = vtksys::SystemTools::GetTime();
+  last->SetAttributeValue(DC::SeriesDescription, "copy");
+  t1 = vtksys::SystemTools::GetTime();
+  double firstWrite = t1 - t0;
+  found += (series->HasAttribute(DC::SeriesDescription) ? 1 : 0);
+
+  // the previous method, which copied every attribute
+  t0 = vtksys::SystemTools::GetTime();
+  copies[0]->Initialize();
+  copies[0]->SetNumberOfInstances(numberOfInstances);
+  copies[0]->CopyAttributes(series);
+  for (int n = 1; n < numberOfDataSets; n++)
+    {
+    copies[n % 2]->Initialize();
+    copies[n % 2]->SetNumberOfInstances(numberOfInstances);
+    copies[n % 2]->CopyAttributes(copies[(n - 1) % 2]);
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double attributeCopy = t1 - t0;
+  copies[0]->Delete();
+  copies[1]->Delete();
+  series->Delete();
+
+  cout << "data sets: " << numberOfDataSets
+       << ", elements: " << numberOfElements << "\n";
+  cout << "insert (s):  vtkDICOMMetaData " << metaInsert
+       << ", legacy " << legacyInsert << "\n";
+  cout << "shuffled insert (s):  vtkDICOMMetaData " << metaShuffled
+       << ", legacy " << legacyShuffledInsert << "\n";
+  cout << "find (s):    vtkDICOMMetaData " << metaFind
+       << ", legacy " << legacyFind << "\n";
+  cout << "copy (s):    ShallowCopy " << shallowCopy
+       << ", then first write " << firstWrite
+       << ", CopyAttributes " << attributeCopy
+       << " (instances: " << numberOfInstances << ")\n";
+
+  // both should have found every element
+  return (found == 0 ? 0 : 1);
+}
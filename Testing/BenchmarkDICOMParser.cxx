@@ -0,0 +1,239 @@
+#include "vtkDICOMParser.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark writes files whose headers hold large binary values,
+// like the private blobs, overlays, and point data that are found in
+// many clinical files, and then parses the files with and without the
+// parser's DeferredValueThreshold.  It reports the time taken and the
+// number of value bytes that are held in memory after parsing, and it
+// checks that the deferred values match the values that were read
+// directly, for little-endian, implicit, and big-endian files.
+
+namespace {
+
+// Parse the files, and return the time and the bytes held in memory
+double ParseFiles(
+  vtkStringArray *files, unsigned int threshold,
+  std::vector<vtkDICOMMetaData *> *metas, size_t *bytes, size_t *deferred)
+{
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetDeferredValueThreshold(threshold);
+
+  double t0 = vtksys::SystemTools::GetTime();
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+    parser->SetMetaData(meta);
+    parser->SetFileName(files->GetValue(i));
+    parser->Update();
+    metas->push_back(meta);
+    }
+  double t1 = vtksys::SystemTools::GetTime();
+  parser->Delete();
+
+  *bytes = 0;
+  *deferred = 0;
+  for (size_t i = 0; i < metas->size(); i++)
+    {
+    vtkDICOMMetaData *meta = (*metas)[i];
+    vtkDICOMDataElementIterator iter;
+    for (iter = meta->Begin(); iter != meta->End(); ++iter)
+      {
+      const vtkDICOMValue& v = iter->GetValue();
+      if (v.IsDeferred())
+        {
+        (*deferred)++;
+        }
+      else
+        {
+        *bytes += v.GetVL();
+        }
+      }
+    }
+
+  return t1 - t0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of files, the size of the private blob in each file,
+  // the threshold for deferring values, and the directory to write to
+  int numberOfFiles = 200;
+  int blobSize = 1048576;
+  int threshold = 4096;
+  std::string dir = ".";
+  if (argc > 1)
+    {
+    numberOfFiles = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    blobSize = atoi(argv[2]);
+    }
+  if (argc > 3)
+    {
+    threshold = atoi(argv[3]);
+    }
+  if (argc > 4)
+    {
+    dir = argv[4];
+    }
+  blobSize += (blobSize & 1);
+
+  // the large values: a private blob, an overlay, and point coordinates
+  std::vector<unsigned char> blob(blobSize);
+  for (int i = 0; i < blobSize; i++)
+    {
+    blob[i] = static_cast<unsigned char>(i*7 + 3);
+    }
+  std::vector<unsigned short> overlay(65536);
+  for (size_t i = 0; i < overlay.size(); i++)
+    {
+    overlay[i] = static_cast<unsigned short>(i*0x0101 + 1);
+    }
+  std::vector<float> points(3*4096);
+  for (size_t i = 0; i < points.size(); i++)
+    {
+    points[i] = 0.25f*i - 100.0f;
+    }
+
+  static const char *syntaxes[3] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2",   // implicit little endian
+    "1.2.840.10008.1.2.2"  // explicit big endian
+  };
+
+  vtkStringArray *files = vtkStringArray::New();
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "BENCHMARK^PARSER");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x0010),
+    vtkDICOMValue(vtkDICOMVR::LO, "BENCHMARK"));
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x1010),
+    vtkDICOMValue(vtkDICOMVR::OB, &blob[0], blob.size()));
+  meta->SetAttributeValue(DC::OverlayRows, 256);
+  meta->SetAttributeValue(DC::OverlayColumns, 256);
+  meta->SetAttributeValue(DC::OverlayBitsAllocated, 16);
+  meta->SetAttributeValue(DC::OverlayData,
+    vtkDICOMValue(vtkDICOMVR::OW, &overlay[0], overlay.size()));
+  meta->SetAttributeValue(DC::PointCoordinatesData,
+    vtkDICOMValue(vtkDICOMVR::OF, &points[0], points.size()));
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMParser" << i << ".dcm";
+    meta->SetAttributeValue(DC::InstanceNumber, i + 1);
+    vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+    compiler->SetFileName(name.str().c_str());
+    compiler->SetMetaData(meta);
+    compiler->SetTransferSyntaxUID(syntaxes[i % 3]);
+    compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+    compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+    compiler->WriteHeader();
+    compiler->Close();
+    compiler->Delete();
+    files->InsertNextValue(name.str());
+    }
+
+  int result = 0;
+  std::vector<vtkDICOMMetaData *> direct;
+  std::vector<vtkDICOMMetaData *> deferred;
+  size_t directBytes, deferredBytes, directCount, deferredCount;
+
+  double directTime = ParseFiles(
+    files, 0, &direct, &directBytes, &directCount);
+  double deferredTime = ParseFiles(
+    files, threshold, &deferred, &deferredBytes, &deferredCount);
+
+  // read every deferred value, and check it against the direct value
+  double t0 = vtksys::SystemTools::GetTime();
+  for (size_t i = 0; i < deferred.size(); i++)
+    {
+    vtkDICOMDataElementIterator iter = deferred[i]->Begin();
+    vtkDICOMDataElementIterator jter = direct[i]->Begin();
+    for (; iter != deferred[i]->End(); ++iter, ++jter)
+      {
+      if (jter == direct[i]->End() ||
+          iter->GetTag() != jter->GetTag() ||
+          iter->GetValue() != jter->GetValue() ||
+          iter->GetValue().IsDeferred())
+        {
+        cout << "deferred value of " << iter->GetTag() << " in file "
+             << i << " does not match\n";
+        result = 1;
+        break;
+        }
+      }
+    }
+  double readTime = vtksys::SystemTools::GetTime() - t0;
+
+  // check the data itself, for each byte order
+  for (size_t i = 0; i < 3 && i < deferred.size(); i++)
+    {
+    const vtkDICOMValue& b =
+      deferred[i]->GetAttributeValue(vtkDICOMTag(0x0029, 0x1010));
+    const vtkDICOMValue& o = deferred[i]->GetAttributeValue(DC::OverlayData);
+    const vtkDICOMValue& p =
+      deferred[i]->GetAttributeValue(DC::PointCoordinatesData);
+    if (b.GetUnsignedCharData() == 0 ||
+        memcmp(b.GetUnsignedCharData(), &blob[0], blob.size()) != 0 ||
+        o.GetUnsignedShortData() == 0 ||
+        memcmp(o.GetUnsignedShortData(), &overlay[0],
+               overlay.size()*sizeof(unsigned short)) != 0 ||
+        p.GetFloatData() == 0 ||
+        memcmp(p.GetFloatData(), &points[0],
+               points.size()*sizeof(float)) != 0)
+      {
+      cout << "data read for " << syntaxes[i] << " is incorrect\n";
+      result = 1;
+      }
+    }
+
+  // the deferred values should all have been read by now
+  if (deferredCount != 3*deferred.size() || directCount != 0)
+    {
+    cout << "expected " << 3*deferred.size() << " deferred values, found "
+         << deferredCount << "\n";
+    result = 1;
+    }
+
+  cout << "files: " << numberOfFiles << ", blob: " << blobSize
+       << " bytes, threshold: " << threshold << "\n";
+  cout << "parse (s):           direct " << directTime
+       << ", deferred " << deferredTime << "\n";
+  cout << "bytes in memory:     direct " << directBytes
+       << ", deferred " << deferredBytes << "\n";
+  cout << "read deferred (s):   " << readTime << "\n";
+
+  for (size_t i = 0; i < direct.size(); i++)
+    {
+    direct[i]->Delete();
+    deferred[i]->Delete();
+    }
+  meta->Delete();
+
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    vtksys::SystemTools::RemoveFile(files->GetValue(i));
+    }
+  files->Delete();
+
+  return result;
+}
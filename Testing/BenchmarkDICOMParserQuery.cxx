@@ -0,0 +1,191 @@
+#include "vtkDICOMParser.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMItem.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark writes files with a long sequence and a private block
+// in their headers, and scans them with a query that only a few of the
+// files will match.  It compares the parser with and without the
+// StopOnQueryFailure option, and reports the time and the number of
+// bytes that were not parsed.  It also checks that the same files
+// match the query either way.
+
+namespace {
+
+struct ScanResult
+{
+  std::vector<char> Matched;
+  std::vector<vtkTypeInt64> Offset;
+  vtkTypeInt64 BytesParsed;
+  vtkTypeInt64 BytesAvoided;
+};
+
+// Scan the files with the query, return the time
+double ScanFiles(
+  vtkStringArray *files, const vtkDICOMItem& query, bool stop,
+  ScanResult *r)
+{
+  vtkIdType n = files->GetNumberOfValues();
+  r->Matched.resize(n);
+  r->Offset.resize(n);
+  r->BytesParsed = 0;
+  r->BytesAvoided = 0;
+
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetQueryItem(query);
+  parser->SetStopOnQueryFailure(stop);
+  double t0 = vtksys::SystemTools::GetTime();
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+    parser->SetMetaData(meta);
+    parser->SetFileName(files->GetValue(i));
+    parser->Update();
+    r->Matched[i] = parser->GetQueryMatched();
+    r->Offset[i] = parser->GetFileOffset();
+    r->BytesParsed += parser->GetFileOffset();
+    r->BytesAvoided += parser->GetFileSize() - parser->GetFileOffset();
+    meta->Delete();
+    }
+  double t1 = vtksys::SystemTools::GetTime();
+  parser->SetMetaData(0);
+  parser->Delete();
+
+  return t1 - t0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of files, the number of items in the sequence,
+  // and the directory to write the files to
+  int numberOfFiles = 400;
+  int numberOfItems = 200;
+  std::string dir = ".";
+  if (argc > 1)
+    {
+    numberOfFiles = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    numberOfItems = atoi(argv[2]);
+    }
+  if (argc > 3)
+    {
+    dir = argv[3];
+    }
+
+  static const char *syntaxes[3] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2",   // implicit little endian
+    "1.2.840.10008.1.2.2"  // explicit big endian
+  };
+  static const char *modalities[4] = { "CT", "MR", "US", "OT" };
+
+  // a sequence that follows the Modality in group 0x0008
+  vtkDICOMSequence seq(numberOfItems);
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143.4." << i;
+    vtkDICOMItem item;
+    item.SetAttributeValue(DC::ReferencedSOPClassUID,
+      vtkDICOMValue(vtkDICOMVR::UI, "1.2.840.10008.5.1.4.1.1.7"));
+    item.SetAttributeValue(DC::ReferencedSOPInstanceUID,
+      vtkDICOMValue(vtkDICOMVR::UI, uid.str()));
+    seq.SetItem(i, item);
+    }
+
+  vtkStringArray *files = vtkStringArray::New();
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::PatientName, "BENCHMARK^QUERY");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(DC::ReferencedImageSequence, seq);
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x0010),
+    vtkDICOMValue(vtkDICOMVR::LO, "BENCHMARK"));
+  for (unsigned short e = 0x1010; e < 0x1030; e++)
+    {
+    meta->SetAttributeValue(vtkDICOMTag(0x0029, e),
+      vtkDICOMValue(vtkDICOMVR::UL, static_cast<unsigned int>(e)));
+    }
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMParserQuery" << i << ".dcm";
+    meta->SetAttributeValue(DC::Modality, modalities[i % 4]);
+    meta->SetAttributeValue(DC::InstanceNumber, i + 1);
+    vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+    compiler->SetFileName(name.str().c_str());
+    compiler->SetMetaData(meta);
+    compiler->SetTransferSyntaxUID(syntaxes[i % 3]);
+    compiler->WriteHeader();
+    compiler->Close();
+    compiler->Delete();
+    files->InsertNextValue(name.str());
+    }
+  meta->Delete();
+
+  // the query, which also asks for the private block and the sequence
+  vtkDICOMItem query;
+  query.SetAttributeValue(DC::Modality, vtkDICOMValue(vtkDICOMVR::CS, "MR"));
+  query.SetAttributeValue(DC::ReferencedImageSequence,
+    vtkDICOMValue(vtkDICOMVR::SQ));
+  query.SetAttributeValue(vtkDICOMTag(0x0029, 0x0010),
+    vtkDICOMValue(vtkDICOMVR::LO, "BENCHMARK"));
+  query.SetAttributeValue(vtkDICOMTag(0x0029, 0x1010),
+    vtkDICOMValue(vtkDICOMVR::UL));
+
+  int result = 0;
+
+  ScanResult full;
+  ScanResult stop;
+  double fullTime = ScanFiles(files, query, false, &full);
+  double stopTime = ScanFiles(files, query, true, &stop);
+
+  // the same files must match, and be parsed to the same position
+  int matchCount = 0;
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    if (full.Matched[i] != stop.Matched[i] ||
+        full.Matched[i] != (i % 4 == 1) ||
+        (full.Matched[i] && full.Offset[i] != stop.Offset[i]))
+      {
+      cout << "query result for file " << i << " is incorrect\n";
+      result = 1;
+      break;
+      }
+    matchCount += full.Matched[i];
+    }
+
+  cout << "files: " << numberOfFiles << ", items: " << numberOfItems
+       << ", matched: " << matchCount << "\n";
+  cout << "full scan (s):   " << fullTime << ", bytes parsed "
+       << full.BytesParsed << ", bytes not parsed "
+       << full.BytesAvoided << "\n";
+  cout << "stop early (s):  " << stopTime << ", bytes parsed "
+       << stop.BytesParsed << ", bytes not parsed "
+       << stop.BytesAvoided << "\n";
+
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    vtksys::SystemTools::RemoveFile(files->GetValue(i));
+    }
+  files->Delete();
+
+  return result;
+}
@@ -0,0 +1,327 @@
+#include "vtkDICOMParser.h"
+#include "vtkDICOMParserVisitor.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMItem.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark writes files that have a long sequence and a private
+// block in their headers, and scans them with a vtkDICOMParserVisitor
+// instead of parsing them into vtkDICOMMetaData.  It checks that the
+// visitor sees the same elements, items, and value bytes as the full
+// parse, for little-endian, implicit, and big-endian files.  It also
+// times a scan that skips the sequences, and a scan that stops as soon
+// as it finds the StudyID.
+
+namespace {
+
+// A visitor that counts what it sees, and keeps the bytes of one value
+class ScanVisitor : public vtkDICOMParserVisitor
+{
+public:
+  ScanVisitor(vtkDICOMTag findTag, bool skipSequences, bool stopAtFind) :
+    FindTag(findTag), SkipSequences(skipSequences), StopAtFind(stopAtFind),
+    Depth(0), Elements(0), Items(0), Bytes(0), Collect(false) {}
+
+  Action StartElement(vtkDICOMTag tag, vtkDICOMVR vr, unsigned int, bool)
+  {
+    if (this->Depth == 0)
+      {
+      this->Elements++;
+      this->Collect = (tag == this->FindTag);
+      }
+    if (vr == vtkDICOMVR::SQ && this->SkipSequences)
+      {
+      return Skip;
+      }
+    return Continue;
+  }
+
+  Action ElementData(const unsigned char *data, size_t n)
+  {
+    this->Bytes += n;
+    if (this->Collect)
+      {
+      this->Value.append(reinterpret_cast<const char *>(data), n);
+      }
+    return Continue;
+  }
+
+  Action EndElement(vtkDICOMTag tag)
+  {
+    if (this->Depth == 0 && tag == this->FindTag)
+      {
+      this->Collect = false;
+      if (this->StopAtFind)
+        {
+        return Stop;
+        }
+      }
+    return Continue;
+  }
+
+  Action StartItem(unsigned int)
+  {
+    this->Depth++;
+    this->Items++;
+    return Continue;
+  }
+
+  Action EndItem()
+  {
+    this->Depth--;
+    return Continue;
+  }
+
+  void Reset()
+  {
+    this->Depth = 0;
+    this->Collect = false;
+    this->Value.clear();
+  }
+
+  vtkDICOMTag FindTag;
+  bool SkipSequences;
+  bool StopAtFind;
+  int Depth;
+  size_t Elements;
+  size_t Items;
+  size_t Bytes;
+  bool Collect;
+  std::string Value;
+};
+
+// Count the items and the value bytes within a data set
+void CountContents(
+  vtkDICOMDataElementIterator iter, vtkDICOMDataElementIterator iterEnd,
+  size_t *items, size_t *bytes)
+{
+  for (; iter != iterEnd; ++iter)
+    {
+    const vtkDICOMValue& v = iter->GetValue();
+    if (v.GetVR() == vtkDICOMVR::SQ)
+      {
+      const vtkDICOMItem *seq = v.GetSequenceData();
+      unsigned int n = v.GetNumberOfValues();
+      *items += n;
+      for (unsigned int i = 0; i < n; i++)
+        {
+        CountContents(seq[i].Begin(), seq[i].End(), items, bytes);
+        }
+      }
+    else
+      {
+      *bytes += v.GetVL();
+      }
+    }
+}
+
+// Parse the files into meta data, return the time
+double ParseFiles(vtkStringArray *files, size_t counts[3])
+{
+  counts[0] = 0;
+  counts[1] = 0;
+  counts[2] = 0;
+
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  double t0 = vtksys::SystemTools::GetTime();
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+    parser->SetMetaData(meta);
+    parser->SetFileName(files->GetValue(i));
+    parser->Update();
+    counts[0] += meta->GetNumberOfDataElements();
+    CountContents(meta->Begin(), meta->End(), &counts[1], &counts[2]);
+    meta->Delete();
+    }
+  double t1 = vtksys::SystemTools::GetTime();
+  parser->Delete();
+
+  return t1 - t0;
+}
+
+// Scan the files with the visitor, return the time
+double ScanFiles(
+  vtkStringArray *files, ScanVisitor *visitor, std::string *found)
+{
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetVisitor(visitor);
+  double t0 = vtksys::SystemTools::GetTime();
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    visitor->Reset();
+    parser->SetFileName(files->GetValue(i));
+    parser->Update();
+    found[i] = visitor->Value;
+    }
+  double t1 = vtksys::SystemTools::GetTime();
+  parser->Delete();
+
+  return t1 - t0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of files, the number of items in the sequence,
+  // and the directory to write the files to
+  int numberOfFiles = 300;
+  int numberOfItems = 200;
+  std::string dir = ".";
+  if (argc > 1)
+    {
+    numberOfFiles = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    numberOfItems = atoi(argv[2]);
+    }
+  if (argc > 3)
+    {
+    dir = argv[3];
+    }
+
+  static const char *syntaxes[3] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2",   // implicit little endian
+    "1.2.840.10008.1.2.2"  // explicit big endian
+  };
+
+  // a sequence with a nested sequence in each item
+  vtkDICOMSequence seq(numberOfItems);
+  for (int i = 0; i < numberOfItems; i++)
+    {
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143.4." << i;
+    vtkDICOMItem item;
+    item.SetAttributeValue(DC::ReferencedSOPClassUID,
+      vtkDICOMValue(vtkDICOMVR::UI, "1.2.840.10008.5.1.4.1.1.7"));
+    item.SetAttributeValue(DC::ReferencedSOPInstanceUID,
+      vtkDICOMValue(vtkDICOMVR::UI, uid.str()));
+    vtkDICOMItem code;
+    code.SetAttributeValue(DC::CodeValue,
+      vtkDICOMValue(vtkDICOMVR::SH, "121311"));
+    code.SetAttributeValue(DC::CodingSchemeDesignator,
+      vtkDICOMValue(vtkDICOMVR::SH, "DCM"));
+    code.SetAttributeValue(DC::CodeMeaning,
+      vtkDICOMValue(vtkDICOMVR::LO, "Localizer"));
+    vtkDICOMSequence codes(1);
+    codes.SetItem(0, code);
+    item.SetAttributeValue(DC::PurposeOfReferenceCodeSequence, codes);
+    seq.SetItem(i, item);
+    }
+
+  vtkStringArray *files = vtkStringArray::New();
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SpecificCharacterSet, "ISO_IR 100");
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "BENCHMARK^VISITOR");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(DC::ReferencedImageSequence, seq);
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x0010),
+    vtkDICOMValue(vtkDICOMVR::LO, "BENCHMARK"));
+  for (unsigned short e = 0x1010; e < 0x1030; e++)
+    {
+    meta->SetAttributeValue(vtkDICOMTag(0x0029, e),
+      vtkDICOMValue(vtkDICOMVR::UL, static_cast<unsigned int>(e)));
+    }
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    std::ostringstream name;
+    name << dir << "/BenchmarkDICOMParserVisitor" << i << ".dcm";
+    std::ostringstream studyID;
+    studyID << "STUDY" << i;
+    meta->SetAttributeValue(DC::StudyID, studyID.str());
+    meta->SetAttributeValue(DC::InstanceNumber, i + 1);
+    vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+    compiler->SetFileName(name.str().c_str());
+    compiler->SetMetaData(meta);
+    compiler->SetTransferSyntaxUID(syntaxes[i % 3]);
+    compiler->WriteHeader();
+    compiler->Close();
+    compiler->Delete();
+    files->InsertNextValue(name.str());
+    }
+  meta->Delete();
+
+  int result = 0;
+  std::string *found = new std::string[numberOfFiles];
+
+  // parse everything into meta data
+  size_t counts[3];
+  double parseTime = ParseFiles(files, counts);
+
+  // visit everything, and check that the visitor saw the same data
+  ScanVisitor fullVisitor(DC::StudyID, false, false);
+  double fullTime = ScanFiles(files, &fullVisitor, found);
+  if (fullVisitor.Elements != counts[0] ||
+      fullVisitor.Items != counts[1] ||
+      fullVisitor.Bytes != counts[2])
+    {
+    cout << "visitor saw " << fullVisitor.Elements << " elements, "
+         << fullVisitor.Items << " items, " << fullVisitor.Bytes
+         << " bytes, expected " << counts[0] << " elements, "
+         << counts[1] << " items, " << counts[2] << " bytes\n";
+    result = 1;
+    }
+
+  // visit everything but the sequences
+  ScanVisitor skipVisitor(DC::StudyID, true, false);
+  double skipTime = ScanFiles(files, &skipVisitor, found);
+  if (skipVisitor.Elements != counts[0] || skipVisitor.Items != 0)
+    {
+    cout << "visitor did not skip the sequences\n";
+    result = 1;
+    }
+
+  // stop as soon as the StudyID is found
+  ScanVisitor stopVisitor(DC::StudyID, false, true);
+  double stopTime = ScanFiles(files, &stopVisitor, found);
+  for (int i = 0; i < numberOfFiles; i++)
+    {
+    std::ostringstream studyID;
+    studyID << "STUDY" << i;
+    std::string s = found[i];
+    while (!s.empty() && s[s.length() - 1] == ' ')
+      {
+      s.resize(s.length() - 1);
+      }
+    if (s != studyID.str())
+      {
+      cout << "found \"" << s << "\" in file " << i << ", expected \""
+           << studyID.str() << "\"\n";
+      result = 1;
+      break;
+      }
+    }
+  delete [] found;
+
+  cout << "files: " << numberOfFiles << ", items: " << numberOfItems
+       << "\n";
+  cout << "parse into meta data (s):   " << parseTime << "\n";
+  cout << "visit all elements (s):     " << fullTime << "\n";
+  cout << "visit, skip sequences (s):  " << skipTime << "\n";
+  cout << "visit, stop at StudyID (s): " << stopTime << "\n";
+
+  for (vtkIdType i = 0; i < files->GetNumberOfValues(); i++)
+    {
+    vtksys::SystemTools::RemoveFile(files->GetValue(i));
+    }
+  files->Delete();
+
+  return result;
+}
@@ -0,0 +1,149 @@
+#include "vtkDICOMUtilities.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark measures the time needed to generate a large number of
+// UIDs, both one at a time with GenerateUID() and in batches with
+// GenerateUIDs().  It also measures how long it takes to read the same
+// number of random bytes by opening the system's random number generator
+// for each UID, which is what GenerateUID() did previously.
+
+namespace {
+
+// Read random bytes by opening the generator every time
+bool LegacyRandomBytes(unsigned char *bytes, size_t n)
+{
+#ifdef _WIN32
+  (void)bytes;
+  (void)n;
+  return false;
+#else
+  bool r = false;
+  FILE *fp = fopen("/dev/urandom", "rb");
+  if (fp)
+    {
+    r = (fread(bytes, 1, n, fp) == n);
+    fclose(fp);
+    }
+  return r;
+#endif
+}
+
+// Check that the UIDs are valid, and return the number of duplicates
+int CheckUIDs(std::vector<std::string> *uids)
+{
+  int duplicates = 0;
+  std::sort(uids->begin(), uids->end());
+  for (size_t i = 0; i < uids->size(); i++)
+    {
+    const std::string& uid = (*uids)[i];
+    if (uid.length() == 0 || uid.length() > 64 ||
+        (i > 0 && uid == (*uids)[i-1]))
+      {
+      duplicates++;
+      }
+    }
+  return duplicates;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of UIDs, and the number of UIDs in each batch
+  int numberOfUIDs = 1000000;
+  int batchSize = 1000;
+  if (argc > 1)
+    {
+    numberOfUIDs = atoi(argv[1]);
+    }
+  if (argc > 2)
+    {
+    batchSize = atoi(argv[2]);
+    }
+  // a UID prefix (the default is 2.25)
+  if (argc > 3)
+    {
+    vtkDICOMUtilities::SetUIDPrefix(argv[3]);
+    }
+
+  int result = 0;
+  double t0, t1;
+
+  // the legacy method of reading the random bytes
+  double legacyTime = -1.0;
+  unsigned char r[16];
+  t0 = vtksys::SystemTools::GetTime();
+  int i = 0;
+  while (i < numberOfUIDs && LegacyRandomBytes(r, 16))
+    {
+    i++;
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  if (i == numberOfUIDs)
+    {
+    legacyTime = t1 - t0;
+    }
+
+  // generate the UIDs one at a time
+  std::vector<std::string> uids;
+  uids.reserve(numberOfUIDs);
+  t0 = vtksys::SystemTools::GetTime();
+  for (i = 0; i < numberOfUIDs; i++)
+    {
+    uids.push_back(vtkDICOMUtilities::GenerateUID(DC::SOPInstanceUID));
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double singleTime = t1 - t0;
+  if (CheckUIDs(&uids) != 0)
+    {
+    cout << "GenerateUID() produced invalid or duplicate UIDs\n";
+    result = 1;
+    }
+
+  // generate the UIDs in batches
+  uids.clear();
+  vtkStringArray *a = vtkStringArray::New();
+  t0 = vtksys::SystemTools::GetTime();
+  for (i = 0; i < numberOfUIDs; i += batchSize)
+    {
+    int n = numberOfUIDs - i;
+    n = (n < batchSize ? n : batchSize);
+    a->SetNumberOfValues(n);
+    vtkDICOMUtilities::GenerateUIDs(DC::SOPInstanceUID, a);
+    for (int j = 0; j < n; j++)
+      {
+      uids.push_back(a->GetValue(j));
+      }
+    }
+  t1 = vtksys::SystemTools::GetTime();
+  double batchTime = t1 - t0;
+  a->Delete();
+  if (CheckUIDs(&uids) != 0)
+    {
+    cout << "GenerateUIDs() produced invalid or duplicate UIDs\n";
+    result = 1;
+    }
+
+  cout << "UIDs: " << numberOfUIDs << ", batch size: " << batchSize
+       << ", prefix: " << vtkDICOMUtilities::GetUIDPrefix() << "\n";
+  cout << "GenerateUID (s):  " << singleTime << "\n";
+  cout << "GenerateUIDs (s): " << batchTime << "\n";
+  if (legacyTime >= 0)
+    {
+    cout << "open /dev/urandom per UID, bytes only (s): "
+         << legacyTime << "\n";
+    }
+
+  return result;
+}
@@ -0,0 +1,123 @@
+#include "vtkDICOMValueMatcher.h"
+#include "vtkDICOMValue.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// This benchmark compares vtkDICOMValue::Matches(), which interprets the
+// query every time that it is called, with vtkDICOMValueMatcher, which
+// interprets the query just once.  The queries are the kinds that are
+// used by dicomfind: a name with wildcards, a range of dates, a list of
+// UIDs, and a list of words.  It also checks that the results agree.
+
+namespace {
+
+// Match every value with both methods, and report the times
+int MatchValues(
+  const char *name, const std::vector<vtkDICOMValue>& values,
+  const vtkDICOMValue& query)
+{
+  int result = 0;
+  size_t n = values.size();
+  std::vector<char> expected(n);
+  size_t count = 0;
+
+  double t0 = vtksys::SystemTools::GetTime();
+  for (size_t i = 0; i < n; i++)
+    {
+    expected[i] = values[i].Matches(query);
+    }
+  double t1 = vtksys::SystemTools::GetTime();
+  vtkDICOMValueMatcher matcher(query);
+  for (size_t i = 0; i < n; i++)
+    {
+    bool match = matcher.Matches(values[i]);
+    count += match;
+    if (match != (expected[i] != 0))
+      {
+      result = 1;
+      }
+    }
+  double t2 = vtksys::SystemTools::GetTime();
+
+  cout << name << " (s): Matches " << (t1 - t0) << ", matcher "
+       << (t2 - t1) << ", matched " << count << "\n";
+  if (result != 0)
+    {
+    cout << "the matcher did not agree with Matches() for \""
+         << query << "\"\n";
+    }
+
+  return result;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  // the number of values to match against each query
+  int numberOfValues = 1000000;
+  if (argc > 1)
+    {
+    numberOfValues = atoi(argv[1]);
+    }
+
+  static const char *lastNames[8] = {
+    "SMITH", "JONES", "M\xdcLLER", "GARCIA", "NGUYEN", "SCHMIDT",
+    "O'BRIEN", "ROSSI" };
+  static const char *firstNames[5] = {
+    "JOHN", "MARIA", "J\xdcRGEN", "SAMUEL", "ANNE" };
+  static const char *words[6] = {
+    "ORIGINAL", "DERIVED", "PRIMARY", "SECONDARY", "AXIAL", "LOCALIZER" };
+  vtkDICOMCharacterSet cs = vtkDICOMCharacterSet::ISO_IR_100;
+
+  std::vector<vtkDICOMValue> names;
+  std::vector<vtkDICOMValue> dates;
+  std::vector<vtkDICOMValue> uids;
+  std::vector<vtkDICOMValue> types;
+  for (int i = 0; i < numberOfValues; i++)
+    {
+    std::ostringstream name;
+    name << lastNames[i % 8] << "^" << firstNames[(i/8) % 5];
+    names.push_back(vtkDICOMValue(vtkDICOMVR::PN, cs, name.str()));
+
+    char date[16];
+    sprintf(date, "%04d%02d%02d", 1990 + i % 30, 1 + i % 12, 1 + i % 28);
+    dates.push_back(vtkDICOMValue(vtkDICOMVR::DA, date));
+
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143." << (i % 1000);
+    uids.push_back(vtkDICOMValue(vtkDICOMVR::UI, uid.str()));
+
+    std::string type = words[i % 2];
+    type += "\\";
+    type += words[2 + (i/2) % 2];
+    type += "\\";
+    type += words[4 + (i/4) % 2];
+    types.push_back(vtkDICOMValue(vtkDICOMVR::CS, type));
+    }
+
+  int result = 0;
+
+  cout << "values: " << numberOfValues << "\n";
+  result |= MatchValues("PN wildcards", names,
+    vtkDICOMValue(vtkDICOMVR::PN, vtkDICOMCharacterSet::ISO_IR_192,
+                  std::string("m\xc3\xbcller^j*")));
+  result |= MatchValues("DA range    ", dates,
+    vtkDICOMValue(vtkDICOMVR::DA, "20000101-20091231"));
+  result |= MatchValues("UI list     ", uids,
+    vtkDICOMValue(vtkDICOMVR::UI,
+      "1.2.826.0.1.3680043.2.1143.7\\1.2.826.0.1.3680043.2.1143.77\\"
+      "1.2.826.0.1.3680043.2.1143.777"));
+  result |= MatchValues("CS words    ", types,
+    vtkDICOMValue(vtkDICOMVR::CS, "DERIVED\\AXIAL"));
+
+  return result;
+}
@@ -0,0 +1,269 @@
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMParser.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkErrorCode.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// The settings that are used to write a file
+struct WriteOptions
+{
+  const char *Syntax;
+  bool StreamFragments;
+  bool Pipelined;
+  int PipelineDepth;
+  int NumberOfThreads;
+};
+
+// Write a multi-frame file, and return the error code
+unsigned long WriteFile(
+  const char *fname, vtkDICOMMetaData *meta, const WriteOptions& options,
+  const unsigned char *frames, int numFrames, size_t frameSize)
+{
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetTransferSyntaxUID(options.Syntax);
+  compiler->SetSOPInstanceUID("1.2.826.0.1.3680043.2.1143.1");
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->SetStreamFragments(options.StreamFragments);
+  compiler->SetPipelined(options.Pipelined);
+  compiler->SetPipelineDepth(options.PipelineDepth);
+  compiler->SetNumberOfThreads(options.NumberOfThreads);
+  compiler->WriteHeader();
+  for (int i = 0; i < numFrames; i++)
+    {
+    compiler->WriteFrame(frames + i*frameSize, frameSize);
+    }
+  compiler->Close();
+  unsigned long errorCode = compiler->GetErrorCode();
+  compiler->Delete();
+  return errorCode;
+}
+
+// Read a whole file into a string
+std::string ReadFile(const char *fname)
+{
+  std::string contents;
+  FILE *fp = fopen(fname, "rb");
+  if (fp)
+    {
+    char buffer[8192];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+      {
+      contents.append(buffer, n);
+      }
+    fclose(fp);
+    }
+  return contents;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMCompiler");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  std::string serialName = dir + "/TestDICOMCompiler1.dcm";
+  std::string pipelinedName = dir + "/TestDICOMCompiler2.dcm";
+
+  static const char *syntaxes[4] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2",   // implicit little endian
+    "1.2.840.10008.1.2.2", // explicit big endian
+    "1.2.840.10008.1.2.5"  // RLE
+  };
+
+  // image formats: 16-bit greyscale, 8-bit RGB, and 8-bit greyscale
+  // with an odd frame size, so that the pixel data must be padded
+  static const int formats[3][4] = {
+    // rows, columns, samples, bits
+    { 32, 24, 1, 16 },
+    { 16, 20, 3, 8 },
+    { 7, 5, 1, 8 }
+  };
+
+  static const int frameCounts[3] = { 1, 2, 7 };
+  static const int depths[3] = { 1, 2, 5 };
+
+  for (int f = 0; f < 3; f++)
+    {
+    int rows = formats[f][0];
+    int columns = formats[f][1];
+    int samples = formats[f][2];
+    int bits = formats[f][3];
+    size_t frameSize = static_cast<size_t>(rows)*columns*samples*bits/8;
+
+    // frames with smooth and noisy regions, to give both runs and
+    // literals when the frames are compressed
+    int maxFrames = frameCounts[2];
+    std::vector<unsigned char> frames(frameSize*maxFrames);
+    srand(f + 1);
+    for (size_t i = 0; i < frames.size(); i++)
+      {
+      frames[i] = static_cast<unsigned char>(
+        ((i/frameSize) % 2) == 0 ? (i/64) : rand());
+      }
+
+    for (int n = 0; n < 3; n++)
+      {
+      int numFrames = frameCounts[n];
+
+      vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+      meta->SetAttributeValue(DC::SOPClassUID,
+        (bits == 16 ? "1.2.840.10008.5.1.4.1.1.7.3" :
+        (samples == 1 ? "1.2.840.10008.5.1.4.1.1.7.2" :
+         "1.2.840.10008.5.1.4.1.1.7.4")));
+      meta->SetAttributeValue(DC::Modality, "OT");
+      meta->SetAttributeValue(DC::PatientName, "TEST^COMPILER");
+      meta->SetAttributeValue(DC::PatientID, "12345");
+      meta->SetAttributeValue(DC::SamplesPerPixel, samples);
+      meta->SetAttributeValue(DC::PhotometricInterpretation,
+        (samples == 1 ? "MONOCHROME2" : "RGB"));
+      if (samples > 1)
+        {
+        meta->SetAttributeValue(DC::PlanarConfiguration, 0);
+        }
+      meta->SetAttributeValue(DC::NumberOfFrames, numFrames);
+      meta->SetAttributeValue(DC::Rows, rows);
+      meta->SetAttributeValue(DC::Columns, columns);
+      meta->SetAttributeValue(DC::BitsAllocated, bits);
+      meta->SetAttributeValue(DC::BitsStored, bits);
+      meta->SetAttributeValue(DC::HighBit, bits - 1);
+      meta->SetAttributeValue(DC::PixelRepresentation, 0);
+      // add an empty PixelData to be filled in by the compiler
+      unsigned short empty = 0;
+      meta->SetAttributeValue(
+        DC::PixelData, vtkDICOMValue(vtkDICOMVR::OW, &empty, empty));
+
+      for (int k = 0; k < 4; k++)
+        {
+        bool compressed = (k == 3);
+        for (int s = 0; s < (compressed ? 2 : 1); s++)
+          {
+          WriteOptions options;
+          options.Syntax = syntaxes[k];
+          options.StreamFragments = (s != 0);
+          options.Pipelined = false;
+          options.PipelineDepth = 2;
+          options.NumberOfThreads = 1;
+
+          TestAssert(WriteFile(serialName.c_str(), meta, options,
+                               &frames[0], numFrames, frameSize) ==
+                     vtkErrorCode::NoError);
+          std::string serialData = ReadFile(serialName.c_str());
+          TestAssert(serialData.size() > 128);
+
+          // the pipelined files must be identical to the serial file,
+          // for every queue depth and number of encoding threads
+          options.Pipelined = true;
+          for (int d = 0; d < 3; d++)
+            {
+            options.PipelineDepth = depths[d];
+            options.NumberOfThreads = (compressed ? d + 1 : 1);
+            TestAssert(WriteFile(pipelinedName.c_str(), meta, options,
+                                 &frames[0], numFrames, frameSize) ==
+                       vtkErrorCode::NoError);
+            std::string pipelinedData = ReadFile(pipelinedName.c_str());
+            TestAssert(pipelinedData == serialData);
+            }
+          }
+        }
+
+      // the pixel data in the file must match the frames
+      WriteOptions options;
+      options.Syntax = syntaxes[0];
+      options.StreamFragments = false;
+      options.Pipelined = true;
+      options.PipelineDepth = 2;
+      options.NumberOfThreads = 1;
+      TestAssert(WriteFile(pipelinedName.c_str(), meta, options,
+                           &frames[0], numFrames, frameSize) ==
+                 vtkErrorCode::NoError);
+      vtkDICOMMetaData *result = vtkDICOMMetaData::New();
+      vtkDICOMParser *parser = vtkDICOMParser::New();
+      parser->SetMetaData(result);
+      parser->SetFileName(pipelinedName.c_str());
+      parser->Update();
+      TestAssert(parser->GetErrorCode() == vtkErrorCode::NoError);
+      TestAssert(parser->GetPixelDataFound());
+      size_t pixelSize = frameSize*numFrames;
+      TestAssert(parser->GetPixelDataVL() == pixelSize);
+      size_t offset = static_cast<size_t>(parser->GetFileOffset());
+      std::string pipelinedData = ReadFile(pipelinedName.c_str());
+      TestAssert(pipelinedData.size() == offset + pixelSize);
+      TestAssert(pipelinedData.size() < offset + pixelSize ||
+                 memcmp(&pipelinedData[offset], &frames[0], pixelSize) == 0);
+      parser->Delete();
+      result->Delete();
+
+      meta->Delete();
+      }
+    }
+
+  { // a pipelined write that cannot create its file must fail cleanly
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::SamplesPerPixel, 1);
+  meta->SetAttributeValue(DC::PhotometricInterpretation, "MONOCHROME2");
+  meta->SetAttributeValue(DC::Rows, 8);
+  meta->SetAttributeValue(DC::Columns, 8);
+  meta->SetAttributeValue(DC::BitsAllocated, 8);
+  meta->SetAttributeValue(DC::BitsStored, 8);
+  meta->SetAttributeValue(DC::HighBit, 7);
+  meta->SetAttributeValue(DC::PixelRepresentation, 0);
+  unsigned short empty = 0;
+  meta->SetAttributeValue(
+    DC::PixelData, vtkDICOMValue(vtkDICOMVR::OW, &empty, empty));
+  unsigned char frame[64];
+  memset(frame, 0, sizeof(frame));
+  std::string badName = dir + "/TestDICOMCompilerNoDir/x.dcm";
+  WriteOptions options;
+  options.Syntax = syntaxes[0];
+  options.StreamFragments = false;
+  options.Pipelined = true;
+  options.PipelineDepth = 2;
+  options.NumberOfThreads = 1;
+  TestAssert(WriteFile(badName.c_str(), meta, options,
+                       frame, 1, sizeof(frame)) != vtkErrorCode::NoError);
+  TestAssert(!vtksys::SystemTools::FileExists(badName.c_str()));
+  meta->Delete();
+  }
+
+  vtksys::SystemTools::RemoveFile(serialName.c_str());
+  vtksys::SystemTools::RemoveFile(pipelinedName.c_str());
+
+  return rval;
+}
@@ -1,6 +1,8 @@
 #include "vtkDICOMDictionary.h"
 #include "vtkDICOMDictEntry.h"
 
+#include <vtkMultiThreader.h>
+
 #include <sstream>
 
 #include <string.h>
@@ -16,6 +18,71 @@ if (!(t)) \
   rval |= 1; \
 }
 
+namespace {
+
+// a small private dictionary for testing
+vtkDICOMDictEntry::Entry TestDictContents[] = {
+{ 0x0011, 0x0004, 0, vtkDICOMVR::LO, vtkDICOMVM::M1, "TestValue" },
+};
+
+unsigned short TestDictTagHashTable[] = { 1, 1, 0, 0x0004 };
+unsigned short TestDictKeyHashTable[] = { 1, 0 };
+
+vtkDICOMDictionary::Dict TestDict = {
+"TEST_PRIVATE_DICT",
+1,
+1,
+TestDictTagHashTable,
+TestDictKeyHashTable,
+TestDictContents
+};
+
+vtkDICOMDictionary::Dict TestDict2 = {
+"TEST_PRIVATE_DICT_2",
+1,
+1,
+TestDictTagHashTable,
+TestDictKeyHashTable,
+TestDictContents
+};
+
+// thread 0 adds and removes a dictionary, the others do lookups
+struct ThreadTestInfo
+{
+  int NumberOfLoops;
+  int Failures[VTK_MAX_THREADS];
+};
+
+VTK_THREAD_RETURN_TYPE ThreadTestFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  ThreadTestInfo *ti = static_cast<ThreadTestInfo *>(info->UserData);
+  int t = info->ThreadID;
+
+  for (int i = 0; i < ti->NumberOfLoops; i++)
+    {
+    if (t == 0)
+      {
+      vtkDICOMDictionary::AddPrivateDictionary(&TestDict2);
+      vtkDICOMDictionary::RemovePrivateDictionary(TestDict2.Name);
+      }
+    else
+      {
+      vtkDICOMDictEntry e = vtkDICOMDictionary::FindDictEntry(
+        vtkDICOMTag(0x0019,0x0004), "GEMS_ACQU_01");
+      ti->Failures[t] += !e.IsValid();
+      e = vtkDICOMDictionary::FindDictEntry(
+        vtkDICOMTag(0x0011,0x0004), "TEST_PRIVATE_DICT");
+      ti->Failures[t] += !e.IsValid();
+      }
+    }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end anonymous namespace
+
 int main(int argc, char *argv[])
 {
   int rval = 0;
@@ -73,5 +140,44 @@ int main(int argc, char *argv[])
   e = vtkDICOMDictionary::FindDictEntry("", "GEMS_ACQU_01");
   TestAssert(!e.IsValid());
 
+  // test adding and removing a private dictionary
+  ptag = vtkDICOMTag(0x0011,0x0004);
+  vtkDICOMDictionary::AddPrivateDictionary(&TestDict);
+  e = vtkDICOMDictionary::FindDictEntry(ptag, "TEST_PRIVATE_DICT");
+  TestAssert(e.IsValid());
+  TestAssert(e.GetVR() == vtkDICOMVR::LO);
+  e = vtkDICOMDictionary::FindDictEntry("TestValue", "TEST_PRIVATE_DICT ");
+  TestAssert(e.IsValid());
+  TestAssert(e.GetTag() == ptag);
+  vtkDICOMDictionary::RemovePrivateDictionary("TEST_PRIVATE_DICT");
+  e = vtkDICOMDictionary::FindDictEntry(ptag, "TEST_PRIVATE_DICT");
+  TestAssert(!e.IsValid());
+  e = vtkDICOMDictionary::FindDictEntry(vtkDICOMTag(0x0019,0x0004),
+                                        "GEMS_ACQU_01");
+  TestAssert(e.IsValid());
+
+  // test lookups while another thread changes the private dictionaries
+  vtkDICOMDictionary::AddPrivateDictionary(&TestDict);
+  ThreadTestInfo ti;
+  ti.NumberOfLoops = 10000;
+  for (int t = 0; t < VTK_MAX_THREADS; t++)
+    {
+    ti.Failures[t] = 0;
+    }
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(4);
+  threader->SetSingleMethod(ThreadTestFunction, &ti);
+  threader->SingleMethodExecute();
+  threader->Delete();
+  int failures = 0;
+  for (int t = 0; t < VTK_MAX_THREADS; t++)
+    {
+    failures += ti.Failures[t];
+    }
+  TestAssert(failures == 0);
+  e = vtkDICOMDictionary::FindDictEntry(ptag, "TEST_PRIVATE_DICT_2");
+  TestAssert(!e.IsValid());
+  vtkDICOMDictionary::RemovePrivateDictionary("TEST_PRIVATE_DICT");
+
   return rval;
 }
@@ -0,0 +1,511 @@
+#include "vtkDICOMDirectory.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMItem.h"
+#include "vtkDICOMDictionary.h"
+#include "vtkDICOMFile.h"
+#include "vtkDICOMUtilities.h"
+
+#include <vtkStringArray.h>
+#include <vtkIntArray.h>
+#include <vtksys/SystemTools.hxx>
+#include <vtksys/Directory.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <list>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+const int numberOfPatients = 3;
+const int studiesPerPatient = 2;
+const int seriesPerStudy = 2;
+const int imagesPerSeries = 4;
+const int numberOfImages =
+  numberOfPatients*studiesPerPatient*seriesPerStudy*imagesPerSeries;
+
+// Write one image of the series, with UIDs that depend on its position
+void WriteFile(const char *fname, int idx, const char *description)
+{
+  int i = idx % imagesPerSeries;
+  int r = (idx / imagesPerSeries) % seriesPerStudy;
+  int s = (idx / (imagesPerSeries*seriesPerStudy)) % studiesPerPatient;
+  int p = idx / (imagesPerSeries*seriesPerStudy*studiesPerPatient);
+
+  std::ostringstream patientID;
+  patientID << "P" << p;
+  std::ostringstream studyUID;
+  studyUID << "1.2.826.0.1.3680043.2.1143.1." << p << "." << s;
+  std::ostringstream seriesUID;
+  seriesUID << studyUID.str() << "." << r;
+  std::ostringstream instanceUID;
+  instanceUID << seriesUID.str() << "." << i;
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::SOPInstanceUID, instanceUID.str());
+  meta->SetAttributeValue(DC::StudyInstanceUID, studyUID.str());
+  meta->SetAttributeValue(DC::SeriesInstanceUID, seriesUID.str());
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "TEST^DIRECTORY");
+  meta->SetAttributeValue(DC::PatientID, patientID.str());
+  meta->SetAttributeValue(DC::StudyDate, "20150101");
+  meta->SetAttributeValue(DC::StudyTime, "120000");
+  meta->SetAttributeValue(DC::SeriesNumber, r + 1);
+  // the instance numbers are in the reverse order of the UIDs
+  meta->SetAttributeValue(DC::InstanceNumber, imagesPerSeries - i);
+  if (description)
+    {
+    meta->SetAttributeValue(DC::SeriesDescription, description);
+    }
+
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetSOPInstanceUID(instanceUID.str().c_str());
+  compiler->SetSeriesInstanceUID(seriesUID.str().c_str());
+  compiler->SetStudyInstanceUID(studyUID.str().c_str());
+  compiler->WriteHeader();
+  compiler->Close();
+  compiler->Delete();
+  meta->Delete();
+}
+
+// Describe the patients, studies, series, and files that were found
+std::string Describe(vtkDICOMDirectory *d)
+{
+  std::ostringstream os;
+  for (int p = 0; p < d->GetNumberOfPatients(); p++)
+    {
+    const vtkDICOMItem& patient = d->GetPatientRecord(p);
+    os << "patient " << patient.GetAttributeValue(DC::PatientID) << "\n";
+    vtkIntArray *studies = d->GetStudiesForPatient(p);
+    for (vtkIdType k = 0; k < studies->GetNumberOfTuples(); k++)
+      {
+      int s = studies->GetValue(k);
+      const vtkDICOMItem& study = d->GetStudyRecord(s);
+      os << " study " << study.GetAttributeValue(DC::StudyInstanceUID)
+         << "\n";
+      int r0 = d->GetFirstSeriesForStudy(s);
+      int r1 = d->GetLastSeriesForStudy(s);
+      for (int r = r0; r <= r1; r++)
+        {
+        const vtkDICOMItem& series = d->GetSeriesRecord(r);
+        os << "  series " << series.GetAttributeValue(DC::SeriesInstanceUID)
+           << " " << series.GetAttributeValue(DC::SeriesDescription) << "\n";
+        vtkStringArray *files = d->GetFileNamesForSeries(r);
+        for (vtkIdType j = 0; j < files->GetNumberOfValues(); j++)
+          {
+          os << "   " << files->GetValue(j) << "\n";
+          }
+        }
+      }
+    }
+  return os.str();
+}
+
+// Scan the files, and describe what was found
+std::string ScanFiles(
+  vtkStringArray *files, int numThreads, const vtkDICOMItem *query,
+  const char *cacheName, int *numberOfSeries, bool imageLevel=false)
+{
+  vtkDICOMDirectory *d = vtkDICOMDirectory::New();
+  d->SetInputFileNames(files);
+  d->RequirePixelDataOff();
+  d->SetNumberOfThreads(numThreads);
+  if (query)
+    {
+    d->SetFindQuery(*query);
+    }
+  if (imageLevel)
+    {
+    d->SetFindLevelToImage();
+    }
+  d->SetCacheFileName(cacheName);
+  d->Update();
+  std::string description = Describe(d);
+  *numberOfSeries = d->GetNumberOfSeries();
+  d->Delete();
+  return description;
+}
+
+// The attributes that are used to sort a file into a series
+struct SortKey
+{
+  const char *PatientName;
+  const char *PatientID;
+  const char *StudyDate;
+  const char *StudyUID;
+  const char *SeriesUID;
+  unsigned int SeriesNumber;
+  int NumberOfFiles;
+};
+
+// Write a file with the given sort attributes (null means not present)
+void WriteSortFile(const char *fname, const SortKey& key, int idx)
+{
+  std::ostringstream instanceUID;
+  instanceUID << "1.2.826.0.1.3680043.2.1143.9." << idx;
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  if (key.PatientName)
+    {
+    meta->SetAttributeValue(DC::PatientName, key.PatientName);
+    }
+  if (key.PatientID)
+    {
+    meta->SetAttributeValue(DC::PatientID, key.PatientID);
+    }
+  if (key.StudyDate)
+    {
+    meta->SetAttributeValue(DC::StudyDate, key.StudyDate);
+    }
+  meta->SetAttributeValue(DC::SeriesNumber, key.SeriesNumber);
+  meta->SetAttributeValue(DC::InstanceNumber, idx + 1);
+
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetSOPInstanceUID(instanceUID.str().c_str());
+  compiler->SetSeriesInstanceUID(key.SeriesUID);
+  compiler->SetStudyInstanceUID(key.StudyUID);
+  compiler->WriteHeader();
+  compiler->Close();
+  compiler->Delete();
+  meta->Delete();
+}
+
+// Compare a series with a file, in the same way as the original
+// vtkDICOMDirectory code (which is not a strict weak ordering)
+int CompareSortKeys(const SortKey& si, const SortKey& fi)
+{
+  const char *patientName = (fi.PatientName ? fi.PatientName : "");
+  const char *patientID = (fi.PatientID ? fi.PatientID : "");
+  const char *patientName2 = (si.PatientName ? si.PatientName : "");
+  const char *patientID2 = (si.PatientID ? si.PatientID : "");
+  int c = strcmp(patientID2, patientID);
+  if (c != 0 || patientID[0] == '\0')
+    {
+    int c2 = strcmp(patientName2, patientName);
+    c = (c2 == 0 ? c : c2);
+    }
+  if (c == 0)
+    {
+    c = vtkDICOMUtilities::CompareUIDs(fi.StudyUID, si.StudyUID);
+    if (c != 0)
+      {
+      int c2 = 0;
+      if (fi.StudyDate && si.StudyDate)
+        {
+        c2 = strcmp(si.StudyDate, fi.StudyDate);
+        }
+      c = (c2 == 0 ? c : c2);
+      }
+    if (c == 0)
+      {
+      c = vtkDICOMUtilities::CompareUIDs(fi.SeriesUID, si.SeriesUID);
+      if (c != 0)
+        {
+        int c2 = si.SeriesNumber - fi.SeriesNumber;
+        c = (c2 == 0 ? c : c2);
+        }
+      }
+    }
+  return c;
+}
+
+// Sort the files into series with the original list walk
+void SortKeys(const std::vector<SortKey>& files, std::list<SortKey> *series)
+{
+  for (size_t j = 0; j < files.size(); j++)
+    {
+    std::list<SortKey>::iterator li;
+    for (li = series->begin(); li != series->end(); ++li)
+      {
+      int c = CompareSortKeys(*li, files[j]);
+      if (c == 0)
+        {
+        li->NumberOfFiles++;
+        break;
+        }
+      else if (c > 0)
+        {
+        li = series->insert(li, files[j]);
+        break;
+        }
+      }
+    if (li == series->end())
+      {
+      series->push_back(files[j]);
+      }
+    }
+}
+
+// Check that the directory sorted the files into the expected series
+bool SameSeries(vtkDICOMDirectory *d, const std::list<SortKey>& series)
+{
+  if (d->GetNumberOfSeries() != static_cast<int>(series.size()))
+    {
+    return false;
+    }
+  int r = 0;
+  std::list<SortKey>::const_iterator li;
+  for (li = series.begin(); li != series.end(); ++li, ++r)
+    {
+    const vtkDICOMItem& record = d->GetSeriesRecord(r);
+    if (record.GetAttributeValue(DC::SeriesInstanceUID).AsString() !=
+          li->SeriesUID ||
+        d->GetFileNamesForSeries(r)->GetNumberOfValues() !=
+          li->NumberOfFiles)
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMDirectory");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  // write the files, and list them in a scrambled order, with some
+  // files that are not DICOM mixed in
+  vtkStringArray *files = vtkStringArray::New();
+  vtkStringArray *allFiles = vtkStringArray::New();
+  for (int k = 0; k < numberOfImages; k++)
+    {
+    int idx = (k*7) % numberOfImages;
+    std::ostringstream name;
+    name << dir << "/TestDICOMDirectory" << idx << ".dcm";
+    WriteFile(name.str().c_str(), idx, 0);
+    files->InsertNextValue(name.str());
+    allFiles->InsertNextValue(name.str());
+    if (k % 20 == 1)
+      {
+      std::ostringstream textName;
+      textName << dir << "/TestDICOMDirectory" << k << ".txt";
+      FILE *fp = fopen(textName.str().c_str(), "wb");
+      if (fp)
+        {
+        fputs("this is not a DICOM file\n", fp);
+        fclose(fp);
+        }
+      allFiles->InsertNextValue(textName.str());
+      }
+    }
+
+  // each file is opened only once during the scan
+  int numberOfSeries = 0;
+  unsigned long opens = vtkDICOMFile::GetNumberOfOpens();
+  std::string expected = ScanFiles(allFiles, 1, 0, 0, &numberOfSeries);
+  TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens ==
+             static_cast<unsigned long>(allFiles->GetNumberOfValues()));
+  TestAssert(numberOfSeries ==
+             numberOfPatients*studiesPerPatient*seriesPerStudy);
+
+  // the files in each series are sorted by InstanceNumber
+  std::ostringstream firstSeries;
+  for (int i = imagesPerSeries - 1; i >= 0; i--)
+    {
+    firstSeries << "   " << dir << "/TestDICOMDirectory" << i << ".dcm\n";
+    }
+  TestAssert(expected.find(firstSeries.str()) != std::string::npos);
+  TestAssert(expected.find(".txt") == std::string::npos);
+
+  // the result must be the same for any number of threads
+  for (int n = 2; n <= 8; n *= 2)
+    {
+    opens = vtkDICOMFile::GetNumberOfOpens();
+    TestAssert(ScanFiles(allFiles, n, 0, 0, &numberOfSeries) == expected);
+    TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens ==
+               static_cast<unsigned long>(allFiles->GetNumberOfValues()));
+    TestAssert(ScanFiles(allFiles, n + 1, 0, 0, &numberOfSeries) == expected);
+    }
+
+  // and also with a query
+  vtkDICOMItem query;
+  query.SetAttributeValue(
+    DC::PatientID, vtkDICOMValue(vtkDICOMVR::LO, "P1"));
+  std::string expectedQuery =
+    ScanFiles(allFiles, 1, &query, 0, &numberOfSeries);
+  TestAssert(numberOfSeries == studiesPerPatient*seriesPerStudy);
+  TestAssert(expectedQuery.find("patient P1\n") == 0);
+  for (int n = 2; n <= 8; n *= 2)
+    {
+    TestAssert(ScanFiles(allFiles, n, &query, 0, &numberOfSeries) ==
+               expectedQuery);
+    }
+
+  // the cache must give the same results as a scan without the cache,
+  // and the cache file and each input file are opened once per scan
+  std::string cacheName = dir + "/TestDICOMDirectory.cache";
+  const char *cname = cacheName.c_str();
+  vtksys::SystemTools::RemoveFile(cacheName);
+  unsigned long n = static_cast<unsigned long>(files->GetNumberOfValues());
+  opens = vtkDICOMFile::GetNumberOfOpens();
+  TestAssert(ScanFiles(files, 1, 0, cname, &numberOfSeries) == expected);
+  TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens == n + 2);
+
+  // a scan of unchanged files only opens the cache (to read and write it)
+  for (int t = 1; t <= 4; t *= 4)
+    {
+    opens = vtkDICOMFile::GetNumberOfOpens();
+    TestAssert(ScanFiles(files, t, 0, cname, &numberOfSeries) == expected);
+    TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens == 2);
+    }
+
+  // the cache is written to a temporary file that replaces the old cache
+  TestAssert(vtksys::SystemTools::FileExists(cname));
+  vtksys::Directory cacheDir;
+  cacheDir.Load(dir.c_str());
+  std::string tempPrefix = "TestDICOMDirectory.cache.";
+  for (unsigned long i = 0; i < cacheDir.GetNumberOfFiles(); i++)
+    {
+    TestAssert(strncmp(cacheDir.GetFile(i), tempPrefix.c_str(),
+                       tempPrefix.length()) != 0);
+    }
+
+  // rewrite one file so that its size changes, only it must be parsed
+  WriteFile(files->GetValue(5).c_str(), (5*7) % numberOfImages, "CHANGED");
+  std::string changed = ScanFiles(files, 1, 0, 0, &numberOfSeries);
+  TestAssert(changed != expected);
+  TestAssert(changed.find(" CHANGED\n") != std::string::npos);
+  opens = vtkDICOMFile::GetNumberOfOpens();
+  TestAssert(ScanFiles(files, 4, 0, cname, &numberOfSeries) == changed);
+  TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens == 3);
+
+  // rewrite it without changing its size, which must be seen even if
+  // done within the same second (if the file system has the precision)
+  const char *fname5 = files->GetValue(5).c_str();
+  vtkDICOMFile::Size size1 = 0, size2 = 0;
+  long long time1 = 0, time2 = 0;
+  vtkDICOMFile::Stat(fname5, &size1, &time1);
+  WriteFile(fname5, (5*7) % numberOfImages, "CHANGEX");
+  vtkDICOMFile::Stat(fname5, &size2, &time2);
+  if (size1 == size2 && time1 != time2)
+    {
+    changed = ScanFiles(files, 1, 0, 0, &numberOfSeries);
+    TestAssert(changed.find(" CHANGEX\n") != std::string::npos);
+    TestAssert(ScanFiles(files, 4, 0, cname, &numberOfSeries) == changed);
+    }
+
+  // the cache must not be used if the query has changed
+  std::string changedQuery = ScanFiles(files, 1, &query, 0, &numberOfSeries);
+  opens = vtkDICOMFile::GetNumberOfOpens();
+  TestAssert(ScanFiles(files, 1, &query, cname, &numberOfSeries) ==
+             changedQuery);
+  TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens == n + 2);
+  opens = vtkDICOMFile::GetNumberOfOpens();
+  TestAssert(ScanFiles(files, 4, &query, cname, &numberOfSeries) ==
+             changedQuery);
+  TestAssert(vtkDICOMFile::GetNumberOfOpens() - opens == 2);
+  vtksys::SystemTools::RemoveFile(cacheName);
+
+  // an IMAGE-level find stops parsing files when the query fails, but
+  // not if a cache is used, and the results must be the same
+  vtkDICOMItem imageQuery;
+  imageQuery.SetAttributeValue(
+    DC::PatientID, vtkDICOMValue(vtkDICOMVR::LO, "P1"));
+  imageQuery.SetAttributeValue(
+    DC::InstanceNumber, vtkDICOMValue(vtkDICOMVR::IS, "1"));
+  std::string expectedImages =
+    ScanFiles(files, 1, &imageQuery, 0, &numberOfSeries, true);
+  TestAssert(numberOfSeries == studiesPerPatient*seriesPerStudy);
+  TestAssert(expectedImages.find("patient P1\n") == 0);
+  TestAssert(ScanFiles(files, 4, &imageQuery, 0, &numberOfSeries, true) ==
+             expectedImages);
+  TestAssert(ScanFiles(files, 1, &imageQuery, cname, &numberOfSeries, true) ==
+             expectedImages);
+  vtksys::SystemTools::RemoveFile(cacheName);
+
+  { // files where the patient name and ID vary within a series, and
+    // series numbers that wrap around when subtracted, must be sorted
+    // exactly like the original list walk sorted them
+  static const char *names[3] = { "DOE^JOHN", "ROE^JANE", 0 };
+  static const char *ids[3] = { "P1", "P2", 0 };
+  static const char *dates[3] = { "20150101", "20140101", 0 };
+  static const unsigned int numbers[4] = { 0, 2, 2147483647u, 7 };
+  const int numberOfSortSeries = 8;
+  const int numberOfSortFiles = 60;
+  std::vector<SortKey> keys;
+  vtkStringArray *sortFiles = vtkStringArray::New();
+  std::vector<std::string> uids(numberOfSortSeries);
+  for (int r = 0; r < numberOfSortSeries; r++)
+    {
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143.8." << (r % 2) << "." << r;
+    uids[r] = uid.str();
+    }
+  srand(7);
+  for (int k = 0; k < numberOfSortFiles; k++)
+    {
+    int r = rand() % numberOfSortSeries;
+    SortKey key;
+    key.PatientName = names[rand() % 3];
+    key.PatientID = ids[rand() % 3];
+    key.StudyDate = dates[rand() % 3];
+    key.StudyUID = (r % 2 == 0 ? "1.2.826.0.1.3680043.2.1143.8.0" :
+                                 "1.2.826.0.1.3680043.2.1143.8.1");
+    key.SeriesUID = uids[r].c_str();
+    key.SeriesNumber = numbers[r % 4];
+    key.NumberOfFiles = 1;
+    keys.push_back(key);
+    std::ostringstream name;
+    name << dir << "/TestDICOMDirectorySort" << k << ".dcm";
+    WriteSortFile(name.str().c_str(), key, k);
+    sortFiles->InsertNextValue(name.str());
+    allFiles->InsertNextValue(name.str());
+    }
+
+  std::list<SortKey> expectedSeries;
+  SortKeys(keys, &expectedSeries);
+  for (int t = 1; t <= 4; t++)
+    {
+    vtkDICOMDirectory *d = vtkDICOMDirectory::New();
+    d->SetInputFileNames(sortFiles);
+    d->RequirePixelDataOff();
+    d->SetNumberOfThreads(t);
+    d->Update();
+    TestAssert(SameSeries(d, expectedSeries));
+    d->Delete();
+    }
+  sortFiles->Delete();
+  }
+
+  for (vtkIdType i = 0; i < allFiles->GetNumberOfValues(); i++)
+    {
+    vtksys::SystemTools::RemoveFile(allFiles->GetValue(i));
+    }
+  allFiles->Delete();
+  files->Delete();
+
+  return rval;
+}
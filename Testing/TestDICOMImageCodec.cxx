@@ -0,0 +1,799 @@
+#include "vtkDICOMImageCodec.h"
+
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// The parameters for a lossless JPEG test image.
+struct JPEGParameters
+{
+  int Precision;
+  int Rows;
+  int Columns;
+  int Components;
+  int Predictor;
+  int PointTransform;
+  int RestartInterval;
+  bool Interleaved;
+};
+
+// Write the bits of the entropy-coded data, with byte stuffing.
+class BitWriter
+{
+public:
+  BitWriter(std::vector<unsigned char> *out) : Out(out), Bits(0), Count(0) {}
+
+  void Write(unsigned int v, int n) {
+    for (int i = n - 1; i >= 0; i--)
+      {
+      this->Bits = (this->Bits << 1) | ((v >> i) & 1);
+      if (++this->Count == 8)
+        {
+        this->Out->push_back(static_cast<unsigned char>(this->Bits));
+        if (this->Bits == 0xFF)
+          {
+          this->Out->push_back(0);
+          }
+        this->Bits = 0;
+        this->Count = 0;
+        }
+      } }
+
+  // pad the final byte with ones
+  void Flush() {
+    while (this->Count != 0) { this->Write(1, 1); } }
+
+private:
+  std::vector<unsigned char> *Out;
+  unsigned int Bits;
+  int Count;
+};
+
+void WriteShort(std::vector<unsigned char> *out, int v)
+{
+  out->push_back(static_cast<unsigned char>(v >> 8));
+  out->push_back(static_cast<unsigned char>(v));
+}
+
+// Encode an image with lossless JPEG (process 14).  The samples are
+// interleaved by component, and must already have the point transform
+// applied.  This is a simple, separate implementation of the encoder,
+// so that the decoder can be checked against it.
+std::vector<unsigned char> EncodeJPEGLossless(
+  const JPEGParameters& p, const std::vector<int>& image)
+{
+  // a table with codes for all 17 difference categories
+  static const int lengths[17] = {
+    2, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+  static const unsigned char symbols[17] = {
+    3, 0, 1, 2, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 16, 15 };
+  unsigned char counts[16];
+  memset(counts, 0, sizeof(counts));
+  unsigned int codes[17];
+  int codeLengths[17];
+  int code = 0;
+  int k = 0;
+  for (int l = 1; l <= 16; l++)
+    {
+    for (int i = 0; i < 17; i++)
+      {
+      if (lengths[i] == l)
+        {
+        counts[l-1]++;
+        codes[symbols[k]] = code++;
+        codeLengths[symbols[k]] = l;
+        k++;
+        }
+      }
+    code <<= 1;
+    }
+
+  std::vector<unsigned char> out;
+  int n = p.Components;
+  WriteShort(&out, 0xFFD8);
+  WriteShort(&out, 0xFFC3);
+  WriteShort(&out, 8 + 3*n);
+  out.push_back(static_cast<unsigned char>(p.Precision));
+  WriteShort(&out, p.Rows);
+  WriteShort(&out, p.Columns);
+  out.push_back(static_cast<unsigned char>(n));
+  for (int c = 0; c < n; c++)
+    {
+    out.push_back(static_cast<unsigned char>(c + 1));
+    out.push_back(0x11);
+    out.push_back(0);
+    }
+  WriteShort(&out, 0xFFC4);
+  WriteShort(&out, 2 + 17 + 17);
+  out.push_back(0x01);
+  out.insert(out.end(), counts, counts + 16);
+  out.insert(out.end(), symbols, symbols + 17);
+  if (p.RestartInterval)
+    {
+    WriteShort(&out, 0xFFDD);
+    WriteShort(&out, 4);
+    WriteShort(&out, p.RestartInterval);
+    }
+
+  int numScans = (p.Interleaved ? 1 : n);
+  int scanComponents = (p.Interleaved ? n : 1);
+  for (int s = 0; s < numScans; s++)
+    {
+    WriteShort(&out, 0xFFDA);
+    WriteShort(&out, 6 + 2*scanComponents);
+    out.push_back(static_cast<unsigned char>(scanComponents));
+    for (int j = 0; j < scanComponents; j++)
+      {
+      out.push_back(static_cast<unsigned char>(s + j + 1));
+      out.push_back(0x10);
+      }
+    out.push_back(static_cast<unsigned char>(p.Predictor));
+    out.push_back(0);
+    out.push_back(static_cast<unsigned char>(p.PointTransform));
+
+    BitWriter writer(&out);
+    int mcuCount = 0;
+    int restartCount = 0;
+    int restartRow = 0;
+    int restartColumn = 0;
+    for (int y = 0; y < p.Rows; y++)
+      {
+      for (int x = 0; x < p.Columns; x++)
+        {
+        if (p.RestartInterval && mcuCount == p.RestartInterval)
+          {
+          writer.Flush();
+          WriteShort(&out, 0xFFD0 + (restartCount++ & 7));
+          mcuCount = 0;
+          restartRow = y;
+          restartColumn = x;
+          }
+        mcuCount++;
+        int mode = p.Predictor;
+        if (y == restartRow)
+          {
+          mode = (x == restartColumn ? 0 : 1);
+          }
+        else if (x == 0)
+          {
+          mode = 2;
+          }
+        for (int j = 0; j < scanComponents; j++)
+          {
+          int c = s + j;
+          const int *row = &image[y*p.Columns*n + c];
+          const int *above = row - p.Columns*n;
+          int a = (x > 0 ? row[(x-1)*n] : 0);
+          int b = (y > 0 ? above[x*n] : 0);
+          int d = (x > 0 && y > 0 ? above[(x-1)*n] : 0);
+          int px = 0;
+          switch (mode)
+            {
+            case 0: px = 1 << (p.Precision - p.PointTransform - 1); break;
+            case 1: px = a; break;
+            case 2: px = b; break;
+            case 3: px = d; break;
+            case 4: px = a + b - d; break;
+            case 5: px = a + ((b - d) >> 1); break;
+            case 6: px = b + ((a - d) >> 1); break;
+            case 7: px = (a + b) >> 1; break;
+            }
+          // the difference is computed modulo 2^16
+          int diff = ((row[x*n] - px) & 0xFFFF);
+          diff = (diff >= 32768 ? diff - 65536 : diff);
+          int t = 16;
+          if (diff != -32768)
+            {
+            for (t = 0; (diff < 0 ? -diff : diff) >> t; t++) {}
+            }
+          writer.Write(codes[t], codeLengths[t]);
+          if (t > 0 && t < 16)
+            {
+            writer.Write(diff > 0 ? diff : diff + (1 << t) - 1, t);
+            }
+          }
+        }
+      }
+    writer.Flush();
+    }
+  WriteShort(&out, 0xFFD9);
+
+  return out;
+}
+
+// Make an image with smooth areas, edges, and noise.
+std::vector<int> MakeImage(const JPEGParameters& p, int seed)
+{
+  int maxval = (1 << (p.Precision - p.PointTransform)) - 1;
+  std::vector<int> image(p.Rows*p.Columns*p.Components);
+  srand(seed);
+  for (size_t i = 0; i < image.size(); i++)
+    {
+    int v;
+    if (rand() % 8 == 0)
+      {
+      v = rand() % (maxval + 1);
+      }
+    else
+      {
+      v = static_cast<int>((i * 37) % (maxval + 1));
+      }
+    image[i] = v;
+    }
+  // include the extreme values
+  image[0] = maxval;
+  image[image.size() - 1] = 0;
+  return image;
+}
+
+// Decode the stream, and return the error code.
+int DecodeJPEG(
+  const JPEGParameters& p, const unsigned char *data, size_t size,
+  std::vector<unsigned char> *out, int planar=0)
+{
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = static_cast<unsigned short>(p.Rows);
+  format.Columns = static_cast<unsigned short>(p.Columns);
+  format.BitsAllocated = (p.Precision > 8 ? 16 : 8);
+  format.BitsStored = static_cast<unsigned short>(p.Precision);
+  format.SamplesPerPixel = static_cast<unsigned short>(p.Components);
+  format.PlanarConfiguration = static_cast<unsigned short>(planar);
+
+  // allow for a guard byte after the image
+  size_t destSize = static_cast<size_t>(p.Rows)*p.Columns*p.Components*
+                    (format.BitsAllocated/8);
+  out->assign(destSize + 1, 0xA5);
+
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::JPEGLossless);
+  int code = codec.Decode(format, data, size, &(*out)[0], destSize);
+  if ((*out)[destSize] != 0xA5)
+    {
+    cout << "Decode wrote past the end of the destination\n";
+    code = vtkDICOMImageCodec::UnknownError;
+    }
+  return code;
+}
+
+// Encode and decode an image, and check that it is unchanged.
+bool CheckJPEG(const JPEGParameters& p, int planar=0)
+{
+  std::vector<int> image = MakeImage(p, p.Predictor + 10*p.Precision);
+  std::vector<unsigned char> data = EncodeJPEGLossless(p, image);
+  std::vector<unsigned char> out;
+  if (DecodeJPEG(p, &data[0], data.size(), &out, planar) !=
+      vtkDICOMImageCodec::NoError)
+    {
+    return false;
+    }
+
+  int n = p.Components;
+  for (int i = 0; i < p.Rows*p.Columns; i++)
+    {
+    for (int c = 0; c < n; c++)
+      {
+      size_t j = (planar ? c*p.Rows*p.Columns + i : i*n + c);
+      int v = out[j];
+      if (p.Precision > 8)
+        {
+        unsigned short s;
+        memcpy(&s, &out[2*j], 2);
+        v = s;
+        }
+      if (v != (image[i*n + c] << p.PointTransform))
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+// Find the offset of the given marker in the stream.
+size_t FindMarker(const std::vector<unsigned char>& data, unsigned char m)
+{
+  for (size_t i = 0; i + 1 < data.size(); i++)
+    {
+    if (data[i] == 0xFF && data[i+1] == m)
+      {
+      return i;
+      }
+    }
+  return 0;
+}
+
+
+// Fill an RLE test frame with runs of different lengths, including
+// runs of exactly 128 bytes (the longest run that PackBits allows),
+// literals, and bytes that repeat just two or three times.
+void MakeRLEFrame(std::vector<unsigned char> *frame, size_t offset,
+                  size_t size, int seed)
+{
+  static const size_t runs[] = {
+    128, 1, 127, 129, 2, 3, 256, 1, 130, 4, 128, 2, 255, 3, 0 };
+  unsigned char *cp = &(*frame)[offset];
+  srand(seed);
+  size_t i = 0;
+  int r = 0;
+  while (i < size)
+    {
+    size_t n = runs[r++];
+    if (n == 0)
+      {
+      // a stretch of literals, with no repeats
+      n = 200;
+      for (size_t j = 0; j < n && i < size; j++)
+        {
+        cp[i++] = static_cast<unsigned char>(j*7 + (j >> 3));
+        }
+      r = 0;
+      continue;
+      }
+    unsigned char v = static_cast<unsigned char>(rand());
+    for (size_t j = 0; j < n && i < size; j++)
+      {
+      cp[i++] = v;
+      }
+    }
+}
+
+// Encode frames with RLE and decode them again, and check that
+// EncodeFrames() gives the same result as Encode() for each frame.
+bool CheckRLE(int columns, int rows, int bitsAllocated, int spp,
+              int planar, int numFrames, int numThreads)
+{
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = static_cast<unsigned short>(rows);
+  format.Columns = static_cast<unsigned short>(columns);
+  format.BitsAllocated = static_cast<unsigned short>(bitsAllocated);
+  format.BitsStored = static_cast<unsigned short>(bitsAllocated);
+  format.SamplesPerPixel = static_cast<unsigned short>(spp);
+  format.PlanarConfiguration = static_cast<unsigned short>(planar);
+
+  size_t frameSize = static_cast<size_t>(columns)*rows*spp*bitsAllocated/8;
+  std::vector<unsigned char> source(frameSize*numFrames);
+  for (int f = 0; f < numFrames; f++)
+    {
+    MakeRLEFrame(&source, f*frameSize, frameSize, f + columns);
+    }
+
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::RLE);
+  std::vector<unsigned char *> dests(numFrames);
+  std::vector<size_t> destSizes(numFrames);
+  bool success = (codec.EncodeFrames(
+    format, numFrames, &source[0], frameSize, &dests[0], &destSizes[0],
+    numThreads) == vtkDICOMImageCodec::NoError);
+
+  std::vector<unsigned char> out(frameSize + 1);
+  for (int f = 0; f < numFrames; f++)
+    {
+    unsigned char *dest = 0;
+    size_t destSize = 0;
+    const unsigned char *frame = &source[f*frameSize];
+    if (codec.Encode(format, frame, frameSize, &dest, &destSize) !=
+          vtkDICOMImageCodec::NoError ||
+        destSize != destSizes[f] ||
+        destSize > codec.GetMaximumEncodedSize(format, frameSize) ||
+        memcmp(dest, dests[f], destSize) != 0)
+      {
+      success = false;
+      }
+    delete [] dest;
+
+    // decode, and check the guard byte at the end
+    out[frameSize] = 0xA5;
+    if (success)
+      {
+      success = (codec.Decode(
+        format, dests[f], destSizes[f], &out[0], frameSize) ==
+        vtkDICOMImageCodec::NoError &&
+        memcmp(&out[0], frame, frameSize) == 0 &&
+        out[frameSize] == 0xA5);
+      }
+    delete [] dests[f];
+    }
+
+  return success;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMImageCodec");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  { // test a known lossless JPEG stream
+  // a 4x2 image with 8-bit precision, predictor 1, and a table that
+  // has a 1-bit code for category 0 and 2-bit codes for categories 1, 2
+  static const unsigned char stream[] = {
+    0xFF, 0xD8,
+    0xFF, 0xC3, 0x00, 0x0B, 0x08, 0x00, 0x02, 0x00, 0x04, 0x01,
+    0x01, 0x11, 0x00,
+    0xFF, 0xC4, 0x00, 0x16, 0x00,
+    0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02,
+    0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x01, 0x00, 0x00,
+    // the differences 0, +1, 0, -1 and 0, 0, 0, 0 as the bits
+    // 0 101 0 100 and 0 0 0 0, followed by four bits of padding
+    0x54, 0x0F,
+    0xFF, 0xD9 };
+  static const unsigned char expected[8] = {
+    0x80, 0x81, 0x81, 0x80, 0x80, 0x80, 0x80, 0x80 };
+  JPEGParameters p = { 8, 2, 4, 1, 1, 0, 0, true };
+  std::vector<unsigned char> out;
+  TestAssert(DecodeJPEG(p, stream, sizeof(stream), &out) ==
+             vtkDICOMImageCodec::NoError);
+  TestAssert(memcmp(&out[0], expected, 8) == 0);
+  }
+
+  { // test all predictors, with several precisions
+  static const int precisions[] = { 2, 8, 12, 16 };
+  for (int i = 0; i < 4; i++)
+    {
+    for (int predictor = 1; predictor <= 7; predictor++)
+      {
+      JPEGParameters p = {
+        precisions[i], 13, 17, 1, predictor, 0, 0, true };
+      TestAssert(CheckJPEG(p));
+      }
+    }
+  }
+
+  { // test point transforms and restart intervals
+  JPEGParameters p = { 12, 9, 21, 1, 4, 3, 0, true };
+  TestAssert(CheckJPEG(p));
+  p.RestartInterval = 1;
+  TestAssert(CheckJPEG(p));
+  p.RestartInterval = 20;
+  TestAssert(CheckJPEG(p));
+  p.RestartInterval = 50;
+  p.Predictor = 7;
+  TestAssert(CheckJPEG(p));
+  }
+
+  { // test three components, interleaved or in separate scans
+  JPEGParameters p = { 8, 11, 7, 3, 5, 0, 0, true };
+  TestAssert(CheckJPEG(p));
+  TestAssert(CheckJPEG(p, 1));
+  p.Interleaved = false;
+  TestAssert(CheckJPEG(p));
+  TestAssert(CheckJPEG(p, 1));
+  p.Precision = 16;
+  p.RestartInterval = 10;
+  TestAssert(CheckJPEG(p));
+  TestAssert(CheckJPEG(p, 1));
+  }
+
+  { // test streams with invalid Huffman tables
+  JPEGParameters p = { 8, 5, 5, 1, 1, 0, 0, true };
+  std::vector<int> image = MakeImage(p, 1);
+  std::vector<unsigned char> data = EncodeJPEGLossless(p, image);
+  std::vector<unsigned char> out;
+  size_t dht = FindMarker(data, 0xC4);
+  TestAssert(dht != 0);
+
+  // too many codes of length 1 (only two are possible)
+  std::vector<unsigned char> bad = data;
+  bad[dht + 5] = 5;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad[dht + 5] = 3;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // too many codes of length 4, after the shorter codes
+  bad = data;
+  bad[dht + 8] = 12;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a table class or destination that is not allowed
+  bad = data;
+  bad[dht + 4] = 0x11;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad[dht + 4] = 0x05;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // more symbols than the segment holds
+  bad = data;
+  bad[dht + 20] = 200;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // symbols for difference categories that do not exist
+  bad = data;
+  for (size_t i = 0; i < 17; i++)
+    {
+    bad[dht + 21 + i] = 17;
+    }
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::MissingData);
+  }
+
+  { // test streams with invalid frame or scan headers
+  JPEGParameters p = { 8, 5, 5, 1, 1, 0, 0, true };
+  std::vector<int> image = MakeImage(p, 2);
+  std::vector<unsigned char> data = EncodeJPEGLossless(p, image);
+  std::vector<unsigned char> out;
+  size_t sof = FindMarker(data, 0xC3);
+  size_t sos = FindMarker(data, 0xDA);
+  TestAssert(sof != 0 && sos != 0);
+
+  // precisions that are not allowed
+  std::vector<unsigned char> bad = data;
+  bad[sof + 4] = 1;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad[sof + 4] = 9;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad[sof + 4] = 17;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // the wrong image size
+  bad = data;
+  bad[sof + 8] = 6;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a scan with a table that was not defined, or that cannot exist
+  bad = data;
+  bad[sos + 6] = 0x20;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad[sos + 6] = 0xF0;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a scan with a component that is not in the frame
+  bad = data;
+  bad[sos + 5] = 7;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a scan with more components than the frame
+  bad = data;
+  bad[sos + 4] = 2;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a predictor or point transform that is not allowed
+  bad = data;
+  bad[sos + 7] = 8;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  bad = data;
+  bad[sos + 9] = 8;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+
+  // a scan with no frame header
+  bad = data;
+  bad[sof + 1] = 0xFE;
+  TestAssert(DecodeJPEG(p, &bad[0], bad.size(), &out) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  }
+
+  { // test truncated and corrupted streams
+  JPEGParameters p = { 12, 6, 9, 3, 6, 0, 4, false };
+  std::vector<int> image = MakeImage(p, 3);
+  std::vector<unsigned char> data = EncodeJPEGLossless(p, image);
+  std::vector<unsigned char> out;
+
+  // every truncation before the final scan is complete is an error
+  size_t lastScan = data.size() - 2;
+  for (size_t n = 0; n < lastScan; n++)
+    {
+    std::vector<unsigned char> bad(data.begin(), data.begin() + n);
+    bool failed = (DecodeJPEG(p, (n ? &bad[0] : 0), n, &out) !=
+                   vtkDICOMImageCodec::NoError);
+    TestAssert(failed);
+    if (!failed)
+      {
+      cout << "truncated at " << n << " of " << data.size() << "\n";
+      break;
+      }
+    }
+
+  // corrupt the headers, which must not read or write out of bounds
+  size_t dataStart = FindMarker(data, 0xDA) + 14;
+  srand(4);
+  for (int i = 0; i < 2000; i++)
+    {
+    std::vector<unsigned char> bad = data;
+    for (int j = 0; j < 3; j++)
+      {
+      bad[rand() % dataStart] = static_cast<unsigned char>(rand());
+      }
+    int code = DecodeJPEG(p, &bad[0], bad.size(), &out);
+    TestAssert(code != vtkDICOMImageCodec::UnknownError);
+    }
+  }
+
+  { // test RLE decoding of a known frame
+  // a 5x2 image with 16 bits per pixel, so there are two segments:
+  // the high bytes are a literal run followed by a run of eight zeros
+  // (plus a pad byte), and the low bytes are one run of ten 0x34 values
+  std::vector<unsigned char> source(64 + 8);
+  source[0] = 2;
+  source[4] = 64;
+  source[8] = 70;
+  static const unsigned char segments[8] = {
+    0x01, 0x12, 0x56, 0xF9, 0x00, 0x00, 0xF7, 0x34 };
+  memcpy(&source[64], segments, 8);
+
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = 2;
+  format.Columns = 5;
+  format.BitsAllocated = 16;
+  format.SamplesPerPixel = 1;
+  unsigned short expected[10] = {
+    0x1234, 0x5634, 0x0034, 0x0034, 0x0034,
+    0x0034, 0x0034, 0x0034, 0x0034, 0x0034 };
+  unsigned short out[11];
+  out[10] = 0xA5A5;
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::RLE);
+  TestAssert(codec.Decode(format, &source[0], source.size(),
+                          reinterpret_cast<unsigned char *>(out), 20) ==
+             vtkDICOMImageCodec::NoError);
+  TestAssert(memcmp(out, expected, 20) == 0);
+  TestAssert(out[10] == 0xA5A5);
+
+  // a segment that is past the end of the data must give an error
+  std::vector<unsigned char> bad = source;
+  bad[8] = 200;
+  out[0] = 0xFFFF;
+  TestAssert(codec.Decode(format, &bad[0], bad.size(),
+                          reinterpret_cast<unsigned char *>(out), 20) ==
+             vtkDICOMImageCodec::MissingData);
+  TestAssert(out[0] == 0x1200);
+  TestAssert(out[10] == 0xA5A5);
+
+  // an impossible number of segments
+  bad = source;
+  bad[0] = 16;
+  TestAssert(codec.Decode(format, &bad[0], bad.size(),
+                          reinterpret_cast<unsigned char *>(out), 20) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  }
+
+  { // test RLE decoding of truncated and corrupted frames
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = 6;
+  format.Columns = 37;
+  format.BitsAllocated = 8;
+  format.SamplesPerPixel = 3;
+  size_t frameSize = 6*37*3;
+  std::vector<unsigned char> source(frameSize);
+  MakeRLEFrame(&source, 0, frameSize, 5);
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::RLE);
+  unsigned char *dest = 0;
+  size_t destSize = 0;
+  codec.Encode(format, &source[0], frameSize, &dest, &destSize);
+  TestAssert(dest != 0);
+  std::vector<unsigned char> data(dest, dest + destSize);
+  delete [] dest;
+
+  std::vector<unsigned char> out(frameSize + 1);
+  bool truncationFailed = true;
+  for (size_t n = 0; n < data.size() - 1; n++)
+    {
+    out[frameSize] = 0xA5;
+    int code = codec.Decode(format, &data[0], n, &out[0], frameSize);
+    truncationFailed &= (code != vtkDICOMImageCodec::NoError &&
+                         out[frameSize] == 0xA5);
+    }
+  TestAssert(truncationFailed);
+
+  // randomly corrupted data must not write past the end of the output
+  srand(6);
+  bool corruptionSafe = true;
+  for (int i = 0; i < 1000; i++)
+    {
+    std::vector<unsigned char> bad = data;
+    for (int j = 0; j < 4; j++)
+      {
+      bad[rand() % bad.size()] = static_cast<unsigned char>(rand());
+      }
+    out[frameSize] = 0xA5;
+    codec.Decode(format, &bad[0], bad.size(), &out[0], frameSize);
+    corruptionSafe &= (out[frameSize] == 0xA5);
+    }
+  TestAssert(corruptionSafe);
+  }
+
+  { // test RLE encoding and decoding of different pixel formats
+  static const int widths[] = { 1, 3, 127, 128, 129, 257, 0 };
+  for (int i = 0; widths[i] != 0; i++)
+    {
+    int w = widths[i];
+    TestAssert(CheckRLE(w, 5, 8, 1, 0, 1, 1));
+    TestAssert(CheckRLE(w, 5, 16, 1, 0, 1, 2));
+    TestAssert(CheckRLE(w, 3, 32, 1, 0, 1, 4));
+    TestAssert(CheckRLE(w, 5, 8, 3, 0, 1, 3));
+    TestAssert(CheckRLE(w, 5, 8, 3, 1, 1, 3));
+    TestAssert(CheckRLE(w, 2, 16, 3, 0, 1, 6));
+    }
+  // several frames at once, with more threads than segments per frame
+  TestAssert(CheckRLE(129, 7, 16, 1, 0, 5, 4));
+  TestAssert(CheckRLE(31, 9, 8, 3, 1, 4, 8));
+  TestAssert(CheckRLE(300, 2, 32, 1, 0, 3, 16));
+  }
+
+  { // test the segment that is produced for runs of exactly 128 bytes
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = 2;
+  format.Columns = 256;
+  format.BitsAllocated = 8;
+  format.SamplesPerPixel = 1;
+  // one row of 256 copies of one value, and one row of two runs
+  std::vector<unsigned char> source(512, 9);
+  memset(&source[384], 10, 128);
+  unsigned char *dest = 0;
+  size_t destSize = 0;
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::RLE);
+  TestAssert(codec.Encode(format, &source[0], source.size(),
+                          &dest, &destSize) == vtkDICOMImageCodec::NoError);
+  static const unsigned char segment[8] = {
+    0x81, 9, 0x81, 9, 0x81, 9, 0x81, 10 };
+  TestAssert(destSize == 64 + 8);
+  TestAssert(dest != 0 && dest[0] == 1 && dest[4] == 64);
+  TestAssert(dest != 0 && memcmp(dest + 64, segment, 8) == 0);
+  delete [] dest;
+  }
+
+  { // test that dests are cleared when there is no encoder
+  vtkDICOMImageCodec::ImageFormat format;
+  format.Rows = 4;
+  format.Columns = 4;
+  format.BitsAllocated = 8;
+  format.SamplesPerPixel = 1;
+  std::vector<unsigned char> source(32);
+  unsigned char *dests[2];
+  size_t destSizes[2];
+  dests[0] = &source[0];
+  dests[1] = &source[1];
+  destSizes[0] = 1;
+  destSizes[1] = 1;
+  vtkDICOMImageCodec codec(vtkDICOMImageCodec::JPEGBaseline);
+  TestAssert(codec.EncodeFrames(format, 2, &source[0], 16, dests,
+                                destSizes, 2) ==
+             vtkDICOMImageCodec::MissingCodec);
+  TestAssert(dests[0] == 0 && dests[1] == 0);
+  TestAssert(destSizes[0] == 0 && destSizes[1] == 0);
+
+  // too many segments for RLE
+  format.BitsAllocated = 64;
+  format.SamplesPerPixel = 3;
+  dests[0] = &source[0];
+  vtkDICOMImageCodec rle(vtkDICOMImageCodec::RLE);
+  TestAssert(rle.EncodeFrames(format, 1, &source[0], 16, dests,
+                              destSizes, 2) ==
+             vtkDICOMImageCodec::BadPixelFormat);
+  TestAssert(dests[0] == 0 && destSizes[0] == 0);
+  }
+
+  return rval;
+}
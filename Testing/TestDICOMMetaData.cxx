@@ -562,6 +562,230 @@ int main(int argc, char *argv[])
   TestAssert(metaData->GetNumberOfDataElements() == 0);
   mcopy->Delete();
 
+  // ------
+  // Test ShallowCopy, which shares the attributes until one is modified
+  metaData->Initialize();
+  metaData->SetNumberOfInstances(3);
+  metaData->SetAttributeValue(DC::Modality, "CT");
+  metaData->SetAttributeValue(0, DC::Modality, "MR");
+  metaData->SetAttributeValue(DC::AcquisitionDateTime, acquisitionTime);
+
+  mcopy = vtkDICOMMetaData::New();
+  mcopy->ShallowCopy(metaData);
+  TestAssert(mcopy->GetNumberOfInstances() == 3);
+  TestAssert(mcopy->GetNumberOfDataElements() == 2);
+  TestAssert(mcopy->GetAttributeValue(0, DC::Modality).AsString() == "MR");
+  TestAssert(mcopy->GetAttributeValue(1, DC::Modality).AsString() == "CT");
+
+  // modifying the copy must not modify the source
+  mcopy->SetAttributeValue(1, DC::Modality, "PT");
+  mcopy->SetAttributeValue(DC::SeriesNumber, 5);
+  mcopy->RemoveAttribute(DC::AcquisitionDateTime);
+  TestAssert(mcopy->GetNumberOfDataElements() == 2);
+  TestAssert(mcopy->GetAttributeValue(1, DC::Modality).AsString() == "PT");
+  TestAssert(metaData->GetNumberOfDataElements() == 2);
+  TestAssert(metaData->GetAttributeValue(1, DC::Modality).AsString() == "CT");
+  TestAssert(!metaData->HasAttribute(DC::SeriesNumber));
+  TestAssert(metaData->GetAttributeValue(
+    DC::AcquisitionDateTime).AsString() == acquisitionTime);
+
+  // modifying the source must not modify the copy
+  mcopy->ShallowCopy(metaData);
+  metaData->SetAttributeValue(2, DC::Modality, "US");
+  metaData->SetAttributeValue(vtkDICOMTagPath(
+    DC::ReferencedSeriesSequence, 0, DC::SeriesInstanceUID), "1.2.3");
+  TestAssert(mcopy->GetAttributeValue(2, DC::Modality).AsString() == "CT");
+  TestAssert(!mcopy->HasAttribute(DC::ReferencedSeriesSequence));
+  TestAssert(metaData->GetAttributeValue(2, DC::Modality).AsString() == "US");
+  TestAssert(metaData->HasAttribute(DC::ReferencedSeriesSequence));
+
+  // the iterators of the copy must be independent of the source
+  mcopy->ShallowCopy(metaData);
+  metaData->Clear();
+  TestAssert(metaData->GetNumberOfDataElements() == 0);
+  TestAssert(metaData->Begin() == metaData->End());
+  {
+  int count = 0;
+  vtkDICOMDataElementIterator iter = mcopy->Begin();
+  for (; iter != mcopy->End(); ++iter)
+    {
+    count++;
+    }
+  TestAssert(count == 3);
+  TestAssert(count == mcopy->GetNumberOfDataElements());
+  }
+
+  // the copy must remain valid after the source is deleted
+  metaData->SetAttributeValue(DC::Modality, "NM");
+  vtkDICOMMetaData *source = vtkDICOMMetaData::New();
+  source->ShallowCopy(mcopy);
+  mcopy->Delete();
+  mcopy = vtkDICOMMetaData::New();
+  mcopy->ShallowCopy(source);
+  source->Delete();
+  TestAssert(mcopy->GetAttributeValue(2, DC::Modality).AsString() == "US");
+  mcopy->SetAttributeValue(DC::Modality, "OT");
+  TestAssert(mcopy->GetAttributeValue(2, DC::Modality).AsString() == "OT");
+  TestAssert(metaData->GetAttributeValue(DC::Modality).AsString() == "NM");
+  mcopy->Delete();
+
+  // ------
+  // Test insertion and removal of a large number of elements
+  metaData->Initialize();
+  for (unsigned short e = 0x2000; e > 0x1000; e--)
+    {
+    metaData->SetAttributeValue(vtkDICOMTag(0x0011, e), vtkDICOMValue(
+      vtkDICOMVR::US, static_cast<unsigned short>(e)));
+    }
+  TestAssert(metaData->GetNumberOfDataElements() == 4096);
+  for (unsigned short e = 0x1001; e <= 0x2000; e += 3)
+    {
+    metaData->RemoveAttribute(vtkDICOMTag(0x0011, e));
+    }
+  TestAssert(metaData->GetNumberOfDataElements() == 2730);
+  {
+  int count = 0;
+  unsigned short last = 0x1000;
+  bool ordered = true;
+  bool matched = true;
+  vtkDICOMDataElementIterator iter = metaData->Begin();
+  for (; iter != metaData->End(); ++iter)
+    {
+    unsigned short e = iter->GetTag().GetElement();
+    ordered &= (e > last && (e - 0x1001) % 3 != 0);
+    matched &= (iter->GetValue().AsUnsignedShort() == e);
+    matched &= (metaData->Find(iter->GetTag()) == iter);
+    last = e;
+    count++;
+    }
+  TestAssert(count == 2730);
+  TestAssert(ordered);
+  TestAssert(matched);
+  }
+  TestAssert(!metaData->HasAttribute(vtkDICOMTag(0x0011, 0x1001)));
+  TestAssert(metaData->GetAttributeValue(
+    vtkDICOMTag(0x0011, 0x1002)).AsUnsignedShort() == 0x1002);
+  metaData->Clear();
+
+  // ------
+  // Test per-frame lookups in enhanced multi-frame meta data
+  metaData->Initialize();
+  {
+  const int numFrames = 100;
+  metaData->SetAttributeValue(DC::Modality, "MR");
+  metaData->SetAttributeValue(DC::RescaleSlope, 99.0);
+
+  // the shared functional groups, including a private group
+  vtkDICOMItem sharedItem;
+  vtkDICOMItem measuresItem;
+  measuresItem.SetAttributeValue(DC::SliceThickness, 2.0);
+  vtkDICOMSequence measuresSeq;
+  measuresSeq.AddItem(measuresItem);
+  sharedItem.SetAttributeValue(DC::PixelMeasuresSequence, measuresSeq);
+  vtkDICOMItem privateItem;
+  privateItem.SetAttributeValue(DC::WindowWidth, 400.0);
+  vtkDICOMSequence privateSeq;
+  privateSeq.AddItem(privateItem);
+  sharedItem.SetAttributeValue(vtkDICOMTag(0x0029, 0x1010), privateSeq);
+  vtkDICOMSequence sharedSeq;
+  sharedSeq.AddItem(sharedItem);
+  metaData->SetAttributeValue(DC::SharedFunctionalGroupsSequence, sharedSeq);
+
+  // the per-frame functional groups
+  for (int k = 1; k <= 2; k++)
+    {
+    vtkDICOMSequence perFrameSeq;
+    for (int f = 0; f < numFrames; f++)
+      {
+      vtkDICOMItem perFrameItem;
+      vtkDICOMItem contentItem;
+      contentItem.SetAttributeValue(DC::InStackPositionNumber, f + 1);
+      vtkDICOMSequence contentSeq;
+      contentSeq.AddItem(contentItem);
+      perFrameItem.SetAttributeValue(DC::FrameContentSequence, contentSeq);
+      vtkDICOMItem transformItem;
+      transformItem.SetAttributeValue(DC::RescaleSlope, k*(f + 1.0));
+      vtkDICOMSequence transformSeq;
+      transformSeq.AddItem(transformItem);
+      perFrameItem.SetAttributeValue(
+        DC::PixelValueTransformationSequence, transformSeq);
+      perFrameSeq.AddItem(perFrameItem);
+      }
+    // replacing the sequence must discard the old index
+    metaData->SetAttributeValue(
+      DC::PerFrameFunctionalGroupsSequence, perFrameSeq);
+
+    bool matched = true;
+    for (int f = 0; f < numFrames; f++)
+      {
+      matched &= (metaData->GetAttributeValue(
+        0, f, DC::InStackPositionNumber).AsInt() == f + 1);
+      matched &= (metaData->GetAttributeValue(
+        0, f, DC::RescaleSlope).AsDouble() == k*(f + 1.0));
+      matched &= (metaData->GetAttributeValue(
+        0, f, DC::SliceThickness).AsDouble() == 2.0);
+      matched &= (metaData->GetAttributeValue(
+        0, f, DC::WindowWidth).AsDouble() == 400.0);
+      matched &= (metaData->GetAttributeValue(
+        0, f, DC::Modality).AsString() == "MR");
+      matched &= (metaData->GetAttributeValue(
+        0, f, vtkDICOMTagPath(DC::RescaleSlope)).AsDouble() == k*(f + 1.0));
+      }
+    TestAssert(matched);
+    }
+
+  // frames that are not in the per-frame sequence use the root value
+  TestAssert(metaData->GetAttributeValue(
+    0, -1, DC::RescaleSlope).AsDouble() == 99.0);
+  TestAssert(metaData->GetAttributeValue(
+    0, numFrames, DC::RescaleSlope).AsDouble() == 99.0);
+  TestAssert(metaData->GetAttributeValue(
+    0, -1, DC::SliceThickness).AsDouble() == 2.0);
+  TestAssert(!metaData->GetAttributeValue(
+    0, 0, DC::WindowCenter).IsValid());
+
+  // a public value in the root has priority over a private value
+  metaData->SetAttributeValue(DC::WindowWidth, 100.0);
+  TestAssert(metaData->GetAttributeValue(
+    0, 0, DC::WindowWidth).AsDouble() == 100.0);
+
+  // removing the sequence must discard the index
+  metaData->RemoveAttribute(DC::PerFrameFunctionalGroupsSequence);
+  TestAssert(metaData->GetAttributeValue(
+    0, 0, DC::RescaleSlope).AsDouble() == 99.0);
+  }
+  metaData->Clear();
+
+  { // test that copied attributes do not keep a value pool in use
+  metaData->SetUseValuePool(true);
+  vtkDICOMValue::Pool *pool = metaData->GetValuePool();
+  vtkDICOMValue v;
+  char *cp = v.AllocateCharData(vtkDICOMVR::LO, 8, pool);
+  strcpy(cp, "PROTOCOL");
+  v.ComputeNumberOfValuesForCharData();
+  metaData->SetAttributeValue(DC::ProtocolName, v);
+  vtkDICOMItem item;
+  cp = v.AllocateCharData(vtkDICOMVR::SH, 4, pool);
+  strcpy(cp, "CODE");
+  v.ComputeNumberOfValuesForCharData();
+  item.SetAttributeValue(DC::CodeValue, v);
+  metaData->SetAttributeValue(DC::ProcedureCodeSequence, item);
+  v.Clear();
+  item.Clear();
+
+  vtkDICOMMetaData *copy = vtkDICOMMetaData::New();
+  copy->CopyAttributes(metaData);
+  metaData->Clear();
+  // the pool is reused only if none of its values are still in use
+  TestAssert(metaData->GetValuePool() == pool);
+  TestAssert(copy->GetAttributeValue(DC::ProtocolName).AsString() ==
+             "PROTOCOL");
+  TestAssert(copy->GetAttributeValue(vtkDICOMTagPath(
+    DC::ProcedureCodeSequence, 0, DC::CodeValue)).AsString() == "CODE");
+  copy->Delete();
+  metaData->SetUseValuePool(false);
+  }
+
   metaData->Delete();
 
   return rval;
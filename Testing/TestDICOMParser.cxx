@@ -0,0 +1,449 @@
+#include "vtkDICOMParser.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMItem.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkMultiThreader.h>
+#include <vtkErrorCode.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// Parse a file, and return a new metadata object
+vtkDICOMMetaData *ParseFile(const char *fname, unsigned int threshold)
+{
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetDeferredValueThreshold(threshold);
+  parser->SetMetaData(meta);
+  parser->SetFileName(fname);
+  parser->Update();
+  parser->Delete();
+  return meta;
+}
+
+// Count the deferred values that have not been read yet
+int CountDeferred(vtkDICOMMetaData *meta)
+{
+  int count = 0;
+  vtkDICOMDataElementIterator iter;
+  for (iter = meta->Begin(); iter != meta->End(); ++iter)
+    {
+    count += iter->GetValue().IsDeferred();
+    }
+  return count;
+}
+
+// Check that every value in "meta" matches the value in "expected"
+bool CompareMetaData(vtkDICOMMetaData *meta, vtkDICOMMetaData *expected)
+{
+  bool r = (meta->GetNumberOfDataElements() ==
+            expected->GetNumberOfDataElements());
+  vtkDICOMDataElementIterator iter = meta->Begin();
+  vtkDICOMDataElementIterator jter = expected->Begin();
+  for (; r && iter != meta->End(); ++iter, ++jter)
+    {
+    r = (iter->GetTag() == jter->GetTag() &&
+         iter->GetValue() == jter->GetValue());
+    }
+  return r;
+}
+
+// Data shared by the threads that read the same deferred values
+struct ThreadData
+{
+  vtkDICOMMetaData *Meta;
+  vtkDICOMMetaData *Expected;
+  bool Failed[VTK_MAX_THREADS];
+};
+
+VTK_THREAD_RETURN_TYPE ReadThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  ThreadData *data = static_cast<ThreadData *>(info->UserData);
+  data->Failed[info->ThreadID] =
+    !CompareMetaData(data->Meta, data->Expected);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+// Write the file with the compiler, return the error code
+unsigned long WriteFile(const char *fname, vtkDICOMMetaData *meta,
+                        const char *syntax)
+{
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetTransferSyntaxUID(syntax);
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->SetSOPInstanceUID("1.2.826.0.1.3680043.2.1143.4");
+  compiler->WriteHeader();
+  compiler->Close();
+  unsigned long errorCode = compiler->GetErrorCode();
+  compiler->Delete();
+  return errorCode;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMParser");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  // large values of each VR that can be deferred
+  std::vector<unsigned char> blob(1001);
+  for (size_t i = 0; i < blob.size(); i++)
+    {
+    blob[i] = static_cast<unsigned char>(i*7 + 3);
+    }
+  std::vector<unsigned short> overlay(4096);
+  for (size_t i = 0; i < overlay.size(); i++)
+    {
+    overlay[i] = static_cast<unsigned short>(i*0x0101 + 1);
+    }
+  std::vector<float> points(3*300);
+  for (size_t i = 0; i < points.size(); i++)
+    {
+    points[i] = 0.25f*i - 100.0f;
+    }
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::PatientName, "TEST^PARSER");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x0010),
+    vtkDICOMValue(vtkDICOMVR::LO, "TEST"));
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x1010),
+    vtkDICOMValue(vtkDICOMVR::OB, &blob[0], 100));
+  meta->SetAttributeValue(vtkDICOMTag(0x0029, 0x1011),
+    vtkDICOMValue(vtkDICOMVR::OB, &blob[0], 16));
+  meta->SetAttributeValue(DC::OverlayRows, 64);
+  meta->SetAttributeValue(DC::OverlayColumns, 64);
+  meta->SetAttributeValue(DC::OverlayBitsAllocated, 16);
+  meta->SetAttributeValue(DC::OverlayData,
+    vtkDICOMValue(vtkDICOMVR::OW, &overlay[0], overlay.size()));
+  meta->SetAttributeValue(DC::PointCoordinatesData,
+    vtkDICOMValue(vtkDICOMVR::OF, &points[0], points.size()));
+  meta->SetAttributeValue(DC::EncapsulatedDocument,
+    vtkDICOMValue(vtkDICOMVR::OB, &blob[0], blob.size()));
+
+  static const char *syntaxes[3] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2",   // implicit little endian
+    "1.2.840.10008.1.2.2"  // explicit big endian
+  };
+
+  std::string fname = dir + "/TestDICOMParser.dcm";
+  std::string fname2 = dir + "/TestDICOMParser2.dcm";
+
+  for (int k = 0; k < 3; k++)
+    {
+    const char *fn = fname.c_str();
+    TestAssert(WriteFile(fn, meta, syntaxes[k]) == vtkErrorCode::NoError);
+
+    { // test reading the deferred values
+    vtkDICOMMetaData *direct = ParseFile(fn, 0);
+    vtkDICOMMetaData *deferred = ParseFile(fn, 64);
+    TestAssert(CountDeferred(direct) == 0);
+    TestAssert(CountDeferred(deferred) == 4);
+
+    // the VL is known before the data is read
+    const vtkDICOMValue& b =
+      deferred->GetAttributeValue(DC::EncapsulatedDocument);
+    TestAssert(b.IsDeferred());
+    TestAssert(b.GetVL() == 1002);
+    TestAssert(b.GetNumberOfValues() == 1002);
+    TestAssert(b.GetVR() == vtkDICOMVR::OB);
+
+    // a copy shares the data with the original
+    vtkDICOMValue c = b;
+    TestAssert(c.IsDeferred());
+    TestAssert(c.GetUnsignedCharData() != 0);
+    TestAssert(!c.IsDeferred());
+    TestAssert(!b.IsDeferred());
+    TestAssert(c.GetUnsignedCharData() == b.GetUnsignedCharData());
+    TestAssert(memcmp(b.GetUnsignedCharData(), &blob[0], blob.size()) == 0);
+
+    // check the data for each VR, which is swapped if big endian
+    const vtkDICOMValue& o = deferred->GetAttributeValue(DC::OverlayData);
+    TestAssert(o.GetUnsignedShortData() != 0 &&
+               memcmp(o.GetUnsignedShortData(), &overlay[0],
+                      overlay.size()*sizeof(unsigned short)) == 0);
+    const vtkDICOMValue& p =
+      deferred->GetAttributeValue(DC::PointCoordinatesData);
+    TestAssert(p.GetFloatData() != 0 &&
+               memcmp(p.GetFloatData(), &points[0],
+                      points.size()*sizeof(float)) == 0);
+    float pv[4];
+    p.GetValues(pv, 4, 1);
+    TestAssert(pv[0] == points[1] && pv[3] == points[4]);
+    TestAssert(p.AsString() == direct->GetAttributeValue(
+      DC::PointCoordinatesData).AsString());
+
+    // a private value, which will be UN if the file is implicit
+    const vtkDICOMValue& u =
+      deferred->GetAttributeValue(vtkDICOMTag(0x0029, 0x1010));
+    TestAssert(u.GetUnsignedCharData() != 0 &&
+               memcmp(u.GetUnsignedCharData(), &blob[0], 100) == 0);
+
+    TestAssert(CompareMetaData(deferred, direct));
+    TestAssert(CountDeferred(deferred) == 0);
+
+    // writing the deferred metadata gives the same file
+    TestAssert(WriteFile(fname2.c_str(), deferred, syntaxes[k]) ==
+               vtkErrorCode::NoError);
+    vtkDICOMMetaData *rewritten = ParseFile(fname2.c_str(), 0);
+    TestAssert(CompareMetaData(rewritten, direct));
+    rewritten->Delete();
+
+    direct->Delete();
+    deferred->Delete();
+    }
+
+    { // test comparing deferred values without reading them
+    vtkDICOMMetaData *direct = ParseFile(fn, 0);
+    vtkDICOMMetaData *deferred = ParseFile(fn, 64);
+    vtkDICOMMetaData *deferred2 = ParseFile(fn, 64);
+    const vtkDICOMValue& b =
+      deferred->GetAttributeValue(DC::EncapsulatedDocument);
+    const vtkDICOMValue& b2 =
+      deferred2->GetAttributeValue(DC::EncapsulatedDocument);
+    const vtkDICOMValue& o = deferred->GetAttributeValue(DC::OverlayData);
+    TestAssert(b == b2);
+    TestAssert(!(b == o));
+    TestAssert(CountDeferred(deferred) == 4);
+    TestAssert(CountDeferred(deferred2) == 4);
+    // when one side has data, the other side must be read
+    TestAssert(b == direct->GetAttributeValue(DC::EncapsulatedDocument));
+    TestAssert(!b.IsDeferred());
+    TestAssert(b == b2);
+    TestAssert(!b2.IsDeferred());
+    direct->Delete();
+    deferred->Delete();
+    deferred2->Delete();
+    }
+
+    { // test reading the same deferred values from several threads
+    vtkDICOMMetaData *direct = ParseFile(fn, 0);
+    for (int trial = 0; trial < 10; trial++)
+      {
+      vtkDICOMMetaData *deferred = ParseFile(fn, 64);
+      ThreadData data;
+      data.Meta = deferred;
+      data.Expected = direct;
+      int numThreads = 8;
+      for (int i = 0; i < numThreads; i++)
+        {
+        data.Failed[i] = true;
+        }
+      vtkMultiThreader *threader = vtkMultiThreader::New();
+      threader->SetNumberOfThreads(numThreads);
+      threader->SetSingleMethod(ReadThread, &data);
+      threader->SingleMethodExecute();
+      threader->Delete();
+      bool failed = false;
+      for (int i = 0; i < numThreads; i++)
+        {
+        failed |= data.Failed[i];
+        }
+      TestAssert(!failed);
+      TestAssert(CountDeferred(deferred) == 0);
+      deferred->Delete();
+      }
+    direct->Delete();
+    }
+
+    { // test a file that is truncated before the values are read
+    vtkDICOMMetaData *deferred = ParseFile(fn, 64);
+    TestAssert(CountDeferred(deferred) == 4);
+    char buffer[256];
+    FILE *fp = fopen(fn, "rb");
+    size_t n = fread(buffer, 1, sizeof(buffer), fp);
+    fclose(fp);
+    fp = fopen(fn, "wb");
+    fwrite(buffer, 1, n, fp);
+    fclose(fp);
+
+    const vtkDICOMValue& b =
+      deferred->GetAttributeValue(DC::EncapsulatedDocument);
+    TestAssert(b.GetUnsignedCharData() == 0);
+    TestAssert(b.GetVL() == 1002);
+    const vtkDICOMValue& o = deferred->GetAttributeValue(DC::OverlayData);
+    TestAssert(o.GetUnsignedShortData() == 0);
+    unsigned short ov[2] = { 1, 2 };
+    o.GetValues(ov, 2);
+    TestAssert(ov[0] == 1 && ov[1] == 2);
+
+    // the metadata cannot be written without the data
+    vtksys::SystemTools::RemoveFile(fname2.c_str());
+    TestAssert(WriteFile(fname2.c_str(), deferred, syntaxes[k]) ==
+               vtkErrorCode::FileFormatError);
+    TestAssert(!vtksys::SystemTools::FileExists(fname2.c_str()));
+    deferred->Delete();
+    }
+
+    { // test a file that is removed before the values are read
+    TestAssert(WriteFile(fn, meta, syntaxes[k]) == vtkErrorCode::NoError);
+    vtkDICOMMetaData *deferred = ParseFile(fn, 64);
+    vtksys::SystemTools::RemoveFile(fn);
+    const vtkDICOMValue& p =
+      deferred->GetAttributeValue(DC::PointCoordinatesData);
+    TestAssert(p.GetFloatData() == 0);
+    TestAssert(p.IsDeferred());
+    TestAssert(!(p == meta->GetAttributeValue(DC::PointCoordinatesData)));
+    // the small value was not deferred
+    const vtkDICOMValue& s =
+      deferred->GetAttributeValue(vtkDICOMTag(0x0029, 0x1011));
+    TestAssert(!s.IsDeferred());
+    TestAssert(s.GetUnsignedCharData() != 0);
+    deferred->Delete();
+    }
+    }
+
+  { // test stopping the parse as soon as the query fails
+  vtkDICOMSequence seq(2);
+  for (int i = 0; i < 2; i++)
+    {
+    vtkDICOMItem item;
+    item.SetAttributeValue(DC::ReferencedSOPClassUID,
+      vtkDICOMValue(vtkDICOMVR::UI, "1.2.840.10008.5.1.4.1.1.7"));
+    item.SetAttributeValue(DC::ReferencedSOPInstanceUID,
+      vtkDICOMValue(vtkDICOMVR::UI,
+        (i == 0 ? "1.2.826.0.1.3680043.2.1143.5" :
+                  "1.2.826.0.1.3680043.2.1143.6")));
+    seq.SetItem(i, item);
+    }
+  // the sequence follows the Modality, in the same group
+  vtkDICOMMetaData *qmeta = vtkDICOMMetaData::New();
+  qmeta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  qmeta->SetAttributeValue(DC::Modality, "MR");
+  qmeta->SetAttributeValue(DC::ReferencedImageSequence, seq);
+  qmeta->SetAttributeValue(DC::PatientName, "TEST^PARSER");
+  qmeta->SetAttributeValue(DC::PatientID, "12345");
+  const char *fn = fname.c_str();
+  TestAssert(WriteFile(fn, qmeta, syntaxes[0]) == vtkErrorCode::NoError);
+  qmeta->Delete();
+
+  // a query that fails at the Modality, and one that only fails within
+  // the first item of the sequence (but that matches the second item)
+  vtkDICOMItem queries[2];
+  queries[0].SetAttributeValue(
+    DC::Modality, vtkDICOMValue(vtkDICOMVR::CS, "CT"));
+  vtkDICOMItem qitem;
+  qitem.SetAttributeValue(DC::ReferencedSOPInstanceUID,
+    vtkDICOMValue(vtkDICOMVR::UI, "1.2.826.0.1.3680043.2.1143.6"));
+  queries[1].SetAttributeValue(
+    DC::Modality, vtkDICOMValue(vtkDICOMVR::CS, "MR"));
+  queries[1].SetAttributeValue(
+    DC::ReferencedImageSequence, vtkDICOMValue(vtkDICOMVR::SQ, qitem));
+
+  for (int q = 0; q < 2; q++)
+    {
+    bool matched[2];
+    vtkTypeInt64 offset[2];
+    vtkTypeInt64 size[2];
+    for (int stop = 0; stop < 2; stop++)
+      {
+      vtkDICOMMetaData *result = vtkDICOMMetaData::New();
+      vtkDICOMParser *parser = vtkDICOMParser::New();
+      parser->SetQueryItem(queries[q]);
+      parser->SetStopOnQueryFailure(stop != 0);
+      parser->SetMetaData(result);
+      parser->SetFileName(fn);
+      parser->Update();
+      matched[stop] = parser->GetQueryMatched();
+      offset[stop] = parser->GetFileOffset();
+      size[stop] = parser->GetFileSize();
+      parser->Delete();
+      result->Delete();
+      }
+    // the option never changes whether the file matches
+    TestAssert(matched[0] == matched[1]);
+    TestAssert(size[0] == size[1]);
+    if (q == 0)
+      {
+      // the parser stopped before the sequence
+      TestAssert(!matched[1]);
+      TestAssert(offset[1] < size[1]);
+      TestAssert(offset[1] < offset[0]);
+      }
+    else
+      {
+      // a failure within a sequence item does not stop the parse
+      TestAssert(matched[1]);
+      TestAssert(offset[1] == offset[0]);
+      }
+    }
+  }
+
+  { // test files truncated within the meta header, with and without
+    // memory mapping (a mapped file has no slack after its end)
+  const char *fn = fname.c_str();
+  TestAssert(WriteFile(fn, meta, syntaxes[0]) == vtkErrorCode::NoError);
+  unsigned char head[160];
+  FILE *fp = fopen(fn, "rb");
+  size_t total = fread(head, 1, sizeof(head), fp);
+  fclose(fp);
+  TestAssert(total == sizeof(head));
+  for (size_t l = 132; l <= total; l++)
+    {
+    fp = fopen(fname2.c_str(), "wb");
+    fwrite(head, 1, l, fp);
+    fclose(fp);
+    unsigned long errorCode[2];
+    int numberOfElements[2];
+    for (int mapped = 0; mapped < 2; mapped++)
+      {
+      vtkDICOMMetaData *result = vtkDICOMMetaData::New();
+      vtkDICOMParser *parser = vtkDICOMParser::New();
+      parser->SetMemoryMapping(mapped != 0);
+      parser->SetMetaData(result);
+      parser->SetFileName(fname2.c_str());
+      parser->Update();
+      errorCode[mapped] = parser->GetErrorCode();
+      numberOfElements[mapped] = result->GetNumberOfDataElements();
+      TestAssert(parser->GetFileOffset() <= static_cast<vtkTypeInt64>(l));
+      parser->Delete();
+      result->Delete();
+      }
+    TestAssert(errorCode[0] == errorCode[1]);
+    TestAssert(numberOfElements[0] == numberOfElements[1]);
+    }
+  }
+
+  vtksys::SystemTools::RemoveFile(fname.c_str());
+  vtksys::SystemTools::RemoveFile(fname2.c_str());
+  meta->Delete();
+
+  return rval;
+}
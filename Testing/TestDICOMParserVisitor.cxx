@@ -0,0 +1,320 @@
+#include "vtkDICOMParser.h"
+#include "vtkDICOMParserVisitor.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMItem.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// Describe an event as a string, e.g. "S00100010" for StartElement
+std::string EventString(char c, vtkDICOMTag tag)
+{
+  char text[16];
+  sprintf(text, "%c%04X%04X", c, tag.GetGroup(), tag.GetElement());
+  return text;
+}
+
+// A visitor that records the events, and that can skip or stop
+class EventVisitor : public vtkDICOMParserVisitor
+{
+public:
+  EventVisitor() :
+    SkipTag(0xffff, 0xffff), StopTag(0xffff, 0xffff), SkipItem(-1),
+    Depth(0), ItemCount(0), Bytes(0), PixelDataVL(0) {}
+
+  Action StartElement(vtkDICOMTag tag, vtkDICOMVR vr, unsigned int vl, bool)
+  {
+    this->Events.push_back(EventString('S', tag));
+    if (tag == DC::PixelData)
+      {
+      this->PixelDataVR = vr;
+      this->PixelDataVL = vl;
+      }
+    if (tag == this->StopTag)
+      {
+      return Stop;
+      }
+    if (tag == this->SkipTag)
+      {
+      return Skip;
+      }
+    return Continue;
+  }
+
+  Action ElementData(const unsigned char *, size_t n)
+  {
+    this->Bytes += n;
+    return Continue;
+  }
+
+  Action EndElement(vtkDICOMTag tag)
+  {
+    this->Events.push_back(EventString('E', tag));
+    return Continue;
+  }
+
+  Action StartItem(unsigned int)
+  {
+    this->Events.push_back("I");
+    bool skip = (this->Depth == 0 && this->ItemCount++ == this->SkipItem);
+    this->Depth++;
+    return (skip ? Skip : Continue);
+  }
+
+  Action EndItem()
+  {
+    this->Events.push_back("i");
+    this->Depth--;
+    return Continue;
+  }
+
+  vtkDICOMTag SkipTag;
+  vtkDICOMTag StopTag;
+  int SkipItem;
+  int Depth;
+  int ItemCount;
+  size_t Bytes;
+  vtkDICOMVR PixelDataVR;
+  unsigned int PixelDataVL;
+  std::vector<std::string> Events;
+};
+
+// Compute the events that the visitor should see for a parsed data set,
+// return false if the visitor should have stopped
+bool ExpectedEvents(
+  vtkDICOMDataElementIterator iter, vtkDICOMDataElementIterator iterEnd,
+  int depth, const EventVisitor& v, int *itemCount, size_t *bytes,
+  std::vector<std::string> *events)
+{
+  for (; iter != iterEnd; ++iter)
+    {
+    vtkDICOMTag tag = iter->GetTag();
+    const vtkDICOMValue& value = iter->GetValue();
+    events->push_back(EventString('S', tag));
+    if (tag == v.StopTag)
+      {
+      return false;
+      }
+    if (tag != v.SkipTag)
+      {
+      if (value.GetVR() == vtkDICOMVR::SQ)
+        {
+        const vtkDICOMItem *items = value.GetSequenceData();
+        size_t n = value.GetNumberOfValues();
+        for (size_t i = 0; i < n; i++)
+          {
+          events->push_back("I");
+          if (depth != 0 || (*itemCount)++ != v.SkipItem)
+            {
+            if (!ExpectedEvents(items[i].Begin(), items[i].End(),
+                                depth + 1, v, itemCount, bytes, events))
+              {
+              return false;
+              }
+            }
+          events->push_back("i");
+          }
+        }
+      else if (tag != DC::PixelData)
+        {
+        *bytes += value.GetVL();
+        }
+      }
+    events->push_back(EventString('E', tag));
+    }
+  return true;
+}
+
+// Visit the file, and check the events against the parsed meta data
+bool CheckEvents(const char *fname, EventVisitor *visitor,
+                 vtkDICOMMetaData *meta)
+{
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetVisitor(visitor);
+  parser->SetFileName(fname);
+  parser->Update();
+  parser->Delete();
+
+  std::vector<std::string> events;
+  int itemCount = 0;
+  size_t bytes = 0;
+  bool complete = ExpectedEvents(
+    meta->Begin(), meta->End(), 0, *visitor, &itemCount, &bytes, &events);
+
+  // when the parse is stopped, the byte count is only known up to
+  // the buffer size, and the items are left open
+  return (visitor->Events == events &&
+          (!complete || (visitor->Bytes == bytes && visitor->Depth == 0)));
+}
+
+// Write a file with encapsulated pixel data that has one fragment
+void WriteEncapsulatedFile(const char *fname, vtkDICOMMetaData *meta)
+{
+  // the compiler writes the header, up to the PixelData element head
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetTransferSyntaxUID("1.2.840.10008.1.2.4.70");
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->SetSOPInstanceUID("1.2.826.0.1.3680043.2.1143.4");
+  compiler->WriteHeader();
+  compiler->Close();
+  compiler->Delete();
+
+  // an empty offset table, one fragment, and a delimiter
+  static const unsigned char items[40] = {
+    0xFE, 0xFF, 0x00, 0xE0, 0, 0, 0, 0,
+    0xFE, 0xFF, 0x00, 0xE0, 16, 0, 0, 0,
+    0xFF, 0xD8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xD9,
+    0xFE, 0xFF, 0xDD, 0xE0, 0, 0, 0, 0 };
+  FILE *fp = fopen(fname, "ab");
+  if (fp)
+    {
+    fwrite(items, 1, sizeof(items), fp);
+    fclose(fp);
+    }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMParserVisitor");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  // a sequence with a nested sequence in each item
+  vtkDICOMSequence seq(2);
+  for (int i = 0; i < 2; i++)
+    {
+    vtkDICOMItem item;
+    item.SetAttributeValue(DC::ReferencedSOPClassUID,
+      vtkDICOMValue(vtkDICOMVR::UI, "1.2.840.10008.5.1.4.1.1.7"));
+    item.SetAttributeValue(DC::ReferencedSOPInstanceUID,
+      vtkDICOMValue(vtkDICOMVR::UI,
+        (i == 0 ? "1.2.826.0.1.3680043.2.1143.5" :
+                  "1.2.826.0.1.3680043.2.1143.6")));
+    vtkDICOMItem code;
+    code.SetAttributeValue(DC::CodeValue,
+      vtkDICOMValue(vtkDICOMVR::SH, "121311"));
+    code.SetAttributeValue(DC::CodingSchemeDesignator,
+      vtkDICOMValue(vtkDICOMVR::SH, "DCM"));
+    code.SetAttributeValue(DC::CodeMeaning,
+      vtkDICOMValue(vtkDICOMVR::LO, "Localizer"));
+    vtkDICOMSequence codes(1);
+    codes.SetItem(0, code);
+    item.SetAttributeValue(DC::PurposeOfReferenceCodeSequence, codes);
+    seq.SetItem(i, item);
+    }
+
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, "1.2.840.10008.5.1.4.1.1.7");
+  meta->SetAttributeValue(DC::Modality, "OT");
+  meta->SetAttributeValue(DC::ReferencedImageSequence, seq);
+  meta->SetAttributeValue(DC::PatientName, "TEST^VISITOR");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(DC::SamplesPerPixel, 1);
+  meta->SetAttributeValue(DC::PhotometricInterpretation, "MONOCHROME2");
+  meta->SetAttributeValue(DC::Rows, 4);
+  meta->SetAttributeValue(DC::Columns, 4);
+  meta->SetAttributeValue(DC::BitsAllocated, 16);
+  meta->SetAttributeValue(DC::BitsStored, 12);
+  meta->SetAttributeValue(DC::HighBit, 11);
+  meta->SetAttributeValue(DC::PixelRepresentation, 0);
+  // add an empty PixelData to be filled in by the compiler
+  unsigned short empty = 0;
+  meta->SetAttributeValue(
+    DC::PixelData, vtkDICOMValue(vtkDICOMVR::OW, &empty, empty));
+
+  std::string fname = dir + "/TestDICOMParserVisitor.dcm";
+  const char *fn = fname.c_str();
+  WriteEncapsulatedFile(fn, meta);
+  meta->Delete();
+
+  // parse the file into meta data, for the expected events
+  vtkDICOMMetaData *parsed = vtkDICOMMetaData::New();
+  vtkDICOMParser *parser = vtkDICOMParser::New();
+  parser->SetMetaData(parsed);
+  parser->SetFileName(fn);
+  parser->Update();
+  parser->Delete();
+  TestAssert(parsed->GetAttributeValue(
+    DC::ReferencedImageSequence).GetNumberOfValues() == 2);
+
+  { // test that every element, item, and byte is visited
+  EventVisitor visitor;
+  TestAssert(CheckEvents(fn, &visitor, parsed));
+  TestAssert(visitor.ItemCount == 2);
+  // the encapsulated pixel data is reported, but not its fragments
+  TestAssert(visitor.PixelDataVR == vtkDICOMVR::OB);
+  TestAssert(visitor.PixelDataVL == 0xffffffffu);
+  TestAssert(visitor.Events.size() >= 2 &&
+             visitor.Events.back() == EventString('E', DC::PixelData));
+  }
+
+  { // test skipping a sequence
+  EventVisitor visitor;
+  visitor.SkipTag = DC::ReferencedImageSequence;
+  TestAssert(CheckEvents(fn, &visitor, parsed));
+  TestAssert(visitor.ItemCount == 0);
+  TestAssert(visitor.Events.back() == EventString('E', DC::PixelData));
+  }
+
+  { // test skipping the first item of a sequence
+  EventVisitor visitor;
+  visitor.SkipItem = 0;
+  TestAssert(CheckEvents(fn, &visitor, parsed));
+  TestAssert(visitor.ItemCount == 2);
+  TestAssert(visitor.Events.back() == EventString('E', DC::PixelData));
+  }
+
+  { // test stopping within a nested sequence
+  EventVisitor visitor;
+  visitor.StopTag = DC::CodingSchemeDesignator;
+  TestAssert(CheckEvents(fn, &visitor, parsed));
+  TestAssert(visitor.ItemCount == 1);
+  TestAssert(visitor.Events.back() ==
+             EventString('S', DC::CodingSchemeDesignator));
+  }
+
+  { // test stopping at a top-level element
+  EventVisitor visitor;
+  visitor.StopTag = DC::PatientName;
+  TestAssert(CheckEvents(fn, &visitor, parsed));
+  TestAssert(visitor.Events.back() == EventString('S', DC::PatientName));
+  }
+
+  parsed->Delete();
+  vtksys::SystemTools::RemoveFile(fn);
+
+  return rval;
+}
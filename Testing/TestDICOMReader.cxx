@@ -0,0 +1,514 @@
+#include "vtkDICOMReader.h"
+#include "vtkDICOMCompiler.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkIntArray.h>
+#include <vtkStringArray.h>
+#include <vtkErrorCode.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// Write a file with the given frames
+void WriteFile(
+  const char *fname, vtkDICOMMetaData *meta, const char *syntax,
+  const char *instanceUID, const unsigned char *frames, int numFrames,
+  size_t frameSize)
+{
+  vtkDICOMCompiler *compiler = vtkDICOMCompiler::New();
+  compiler->SetFileName(fname);
+  compiler->SetMetaData(meta);
+  compiler->SetTransferSyntaxUID(syntax);
+  compiler->SetSOPInstanceUID(instanceUID);
+  compiler->SetSeriesInstanceUID("1.2.826.0.1.3680043.2.1143.2");
+  compiler->SetStudyInstanceUID("1.2.826.0.1.3680043.2.1143.3");
+  compiler->WriteHeader();
+  for (int i = 0; i < numFrames; i++)
+    {
+    compiler->WriteFrame(frames + i*frameSize, frameSize);
+    }
+  compiler->Close();
+  compiler->Delete();
+}
+
+// Write a file with one frame of already-compressed data
+void WriteEncapsulatedFile(
+  const char *fname, vtkDICOMMetaData *meta, const char *syntax,
+  const std::vector<unsigned char>& data)
+{
+  // the compiler writes the header, up to the PixelData element head
+  WriteFile(fname, meta, syntax, "1.2.826.0.1.3680043.2.1143.1", 0, 0, 0);
+
+  // an empty offset table, one fragment, and a delimiter
+  size_t l = data.size() + (data.size() & 1);
+  unsigned char items[24] = {
+    0xFE, 0xFF, 0x00, 0xE0, 0, 0, 0, 0,
+    0xFE, 0xFF, 0x00, 0xE0, static_cast<unsigned char>(l),
+    static_cast<unsigned char>(l >> 8), 0, 0,
+    0xFE, 0xFF, 0xDD, 0xE0, 0, 0, 0, 0 };
+  FILE *fp = fopen(fname, "ab");
+  if (fp)
+    {
+    fwrite(items, 1, 16, fp);
+    fwrite(&data[0], 1, data.size(), fp);
+    if (l != data.size())
+      {
+      fputc(0, fp);
+      }
+    fwrite(items + 16, 1, 8, fp);
+    fclose(fp);
+    }
+}
+
+// Create the meta data for 16-bit images
+vtkDICOMMetaData *CreateMetaData(
+  const char *sopClass, int rows, int columns, int numFrames)
+{
+  vtkDICOMMetaData *meta = vtkDICOMMetaData::New();
+  meta->SetAttributeValue(DC::SOPClassUID, sopClass);
+  meta->SetAttributeValue(DC::SOPInstanceUID, "1.2.826.0.1.3680043.2.1143.1");
+  meta->SetAttributeValue(DC::SeriesInstanceUID,
+                          "1.2.826.0.1.3680043.2.1143.2");
+  meta->SetAttributeValue(DC::StudyInstanceUID,
+                          "1.2.826.0.1.3680043.2.1143.3");
+  meta->SetAttributeValue(DC::PatientName, "TEST^READER");
+  meta->SetAttributeValue(DC::PatientID, "12345");
+  meta->SetAttributeValue(DC::SamplesPerPixel, 1);
+  meta->SetAttributeValue(DC::PhotometricInterpretation, "MONOCHROME2");
+  if (numFrames > 1)
+    {
+    meta->SetAttributeValue(DC::NumberOfFrames, numFrames);
+    }
+  meta->SetAttributeValue(DC::Rows, rows);
+  meta->SetAttributeValue(DC::Columns, columns);
+  meta->SetAttributeValue(DC::BitsAllocated, 16);
+  meta->SetAttributeValue(DC::BitsStored, 12);
+  meta->SetAttributeValue(DC::HighBit, 11);
+  meta->SetAttributeValue(DC::PixelRepresentation, 0);
+  // add an empty PixelData to be filled in by the compiler
+  unsigned short empty = 0;
+  meta->SetAttributeValue(
+    DC::PixelData, vtkDICOMValue(vtkDICOMVR::OW, &empty, empty));
+  return meta;
+}
+
+// Create frames with smooth and noisy regions
+std::vector<unsigned char> CreateFrames(size_t size, int seed)
+{
+  std::vector<unsigned char> frames(size);
+  srand(seed);
+  for (size_t i = 0; i + 1 < size; i += 2)
+    {
+    int v = (((i/256) % 2) == 0 ? static_cast<int>(i/32) : rand());
+    frames[i] = static_cast<unsigned char>(v);
+    frames[i+1] = static_cast<unsigned char>((v >> 8) & 0x0f);
+    }
+  return frames;
+}
+
+// Create a lossless JPEG frame where every 12-bit pixel is 2048, by
+// encoding each pixel as a one-bit code for a zero difference (if the
+// number of data bytes is too small, the frame is truncated)
+std::vector<unsigned char> CreateJPEGLosslessFrame(
+  int rows, int columns, size_t dataBytes)
+{
+  static const unsigned char header[] = {
+    0xFF, 0xD8, // SOI
+    0xFF, 0xC3, 0, 11, 12, 0, 0, 0, 0, 1, 1, 0x11, 0, // SOF3
+    0xFF, 0xC4, 0, 20, 0x00, 1, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, // DHT
+    0xFF, 0xDA, 0, 8, 1, 1, 0x00, 1, 0, 0 }; // SOS
+  std::vector<unsigned char> frame(header, header + sizeof(header));
+  frame[7] = static_cast<unsigned char>(rows >> 8);
+  frame[8] = static_cast<unsigned char>(rows);
+  frame[9] = static_cast<unsigned char>(columns >> 8);
+  frame[10] = static_cast<unsigned char>(columns);
+  frame.insert(frame.end(), dataBytes, 0);
+  frame.push_back(0xFF);
+  frame.push_back(0xD9); // EOI
+  return frame;
+}
+
+// Create an RLE frame where every 12-bit pixel is 2048, with each of
+// the two segments encoded as runs of 128 bytes (if there are too few
+// runs, the segments are truncated)
+std::vector<unsigned char> CreateRLEFrame(int runs)
+{
+  std::vector<unsigned char> frame(64, 0);
+  frame[0] = 2;
+  frame[4] = 64;
+  frame[8] = static_cast<unsigned char>(64 + 2*runs);
+  for (int seg = 0; seg < 2; seg++)
+    {
+    for (int r = 0; r < runs; r++)
+      {
+      frame.push_back(0x81);
+      frame.push_back(seg == 0 ? 0x08 : 0x00);
+      }
+    }
+  return frame;
+}
+
+// Read the files with the given number of threads, if "raw" is set
+// then the frames are read in file order without rescaling or flipping
+vtkDICOMReader *ReadFiles(
+  vtkStringArray *files, int numThreads, bool memoryMapping, bool raw=false)
+{
+  vtkDICOMReader *reader = vtkDICOMReader::New();
+  reader->SetFileNames(files);
+  reader->SetNumberOfThreads(numThreads);
+  reader->SetMemoryMapping(memoryMapping);
+  if (raw)
+    {
+    reader->SortingOff();
+    reader->AutoRescaleOff();
+    reader->SetMemoryRowOrderToFileNative();
+    }
+  reader->Update();
+  return reader;
+}
+
+// Check whether two meta data objects have identical data elements
+bool SameMetaData(vtkDICOMMetaData *a, vtkDICOMMetaData *b)
+{
+  if (a->GetNumberOfInstances() != b->GetNumberOfInstances() ||
+      a->GetNumberOfDataElements() != b->GetNumberOfDataElements())
+    {
+    return false;
+    }
+  vtkDICOMDataElementIterator i = a->Begin();
+  vtkDICOMDataElementIterator j = b->Begin();
+  for (; i != a->End() && j != b->End(); ++i, ++j)
+    {
+    if (*i != *j)
+      {
+      return false;
+      }
+    }
+  return (i == a->End() && j == b->End());
+}
+
+// Check whether two arrays have identical values
+bool SameArray(vtkIntArray *a, vtkIntArray *b)
+{
+  if (a->GetNumberOfTuples() != b->GetNumberOfTuples() ||
+      a->GetNumberOfComponents() != b->GetNumberOfComponents())
+    {
+    return false;
+    }
+  vtkIdType n = a->GetNumberOfTuples()*a->GetNumberOfComponents();
+  return (n == 0 ||
+          memcmp(a->GetPointer(0), b->GetPointer(0), n*sizeof(int)) == 0);
+}
+
+// Check whether two readers produced identical output
+bool SameOutput(vtkDICOMReader *a, vtkDICOMReader *b)
+{
+  if (a->GetErrorCode() != b->GetErrorCode() ||
+      a->GetRescaleSlope() != b->GetRescaleSlope() ||
+      a->GetRescaleIntercept() != b->GetRescaleIntercept() ||
+      !SameMetaData(a->GetMetaData(), b->GetMetaData()) ||
+      !SameArray(a->GetFileIndexArray(), b->GetFileIndexArray()) ||
+      !SameArray(a->GetFrameIndexArray(), b->GetFrameIndexArray()))
+    {
+    return false;
+    }
+
+  vtkImageData *ia = a->GetOutput();
+  vtkImageData *ib = b->GetOutput();
+  int ea[6], eb[6];
+  ia->GetExtent(ea);
+  ib->GetExtent(eb);
+  if (memcmp(ea, eb, sizeof(ea)) != 0)
+    {
+    return false;
+    }
+
+  vtkDataArray *sa = ia->GetPointData()->GetScalars();
+  vtkDataArray *sb = ib->GetPointData()->GetScalars();
+  if (sa == 0 || sb == 0)
+    {
+    return (sa == sb);
+    }
+  if (sa->GetDataType() != sb->GetDataType() ||
+      sa->GetNumberOfTuples() != sb->GetNumberOfTuples() ||
+      sa->GetNumberOfComponents() != sb->GetNumberOfComponents())
+    {
+    return false;
+    }
+  size_t n = static_cast<size_t>(sa->GetNumberOfTuples())*
+    sa->GetNumberOfComponents()*sa->GetDataTypeSize();
+  return (memcmp(sa->GetVoidPointer(0), sb->GetVoidPointer(0), n) == 0);
+}
+
+// Check whether a "raw" reader output matches the frames that were written
+bool SameFrames(vtkDICOMReader *reader, const std::vector<unsigned char>& f)
+{
+  vtkDataArray *s = reader->GetOutput()->GetPointData()->GetScalars();
+  if (reader->GetErrorCode() != vtkErrorCode::NoError ||
+      s == 0 || s->GetDataType() != VTK_UNSIGNED_SHORT ||
+      static_cast<size_t>(s->GetNumberOfTuples())*
+      s->GetNumberOfComponents()*2 != f.size())
+    {
+    return false;
+    }
+  const unsigned short *p =
+    static_cast<const unsigned short *>(s->GetVoidPointer(0));
+  for (size_t i = 0; i + 1 < f.size(); i += 2)
+    {
+    if (p[i/2] != (f[i] | (f[i+1] << 8)))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMReader");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  const int rows = 24;
+  const int columns = 32;
+  const size_t frameSize = static_cast<size_t>(rows)*columns*2;
+  const int numSlices = 7;
+  const int numFrames = 5;
+
+  vtkStringArray *allFiles = vtkStringArray::New();
+
+  { // a series of CT files, listed out of order and with different
+    // rescaling, so that they must be sorted and rescaled
+  vtkStringArray *files = vtkStringArray::New();
+  vtkDICOMMetaData *meta =
+    CreateMetaData("1.2.840.10008.5.1.4.1.1.2", rows, columns, 1);
+  meta->SetAttributeValue(DC::Modality, "CT");
+  double orientation[6] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+  meta->SetAttributeValue(DC::ImageOrientationPatient,
+    vtkDICOMValue(vtkDICOMVR::DS, orientation, 6));
+  double spacing[2] = { 0.5, 0.5 };
+  meta->SetAttributeValue(
+    DC::PixelSpacing, vtkDICOMValue(vtkDICOMVR::DS, spacing, 2));
+  meta->SetAttributeValue(DC::SliceThickness, 2.5);
+  std::vector<unsigned char> frames = CreateFrames(frameSize*numSlices, 1);
+  for (int i = 0; i < numSlices; i++)
+    {
+    int slice = (i*3) % numSlices;
+    double position[3] = { -8.0, -6.0, 2.5*slice };
+    meta->SetAttributeValue(
+      DC::ImagePositionPatient, vtkDICOMValue(vtkDICOMVR::DS, position, 3));
+    meta->SetAttributeValue(DC::InstanceNumber, slice + 1);
+    meta->SetAttributeValue(DC::RescaleSlope, (i % 2 == 0 ? 1.0 : 2.0));
+    meta->SetAttributeValue(DC::RescaleIntercept, -1024.0);
+    std::ostringstream name;
+    name << dir << "/TestDICOMReader" << i << ".dcm";
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143.1." << i;
+    WriteFile(name.str().c_str(), meta, "1.2.840.10008.1.2.1",
+              uid.str().c_str(), &frames[i*frameSize], 1, frameSize);
+    files->InsertNextValue(name.str());
+    allFiles->InsertNextValue(name.str());
+    }
+  meta->Delete();
+
+  // the output must be the same for any number of threads
+  vtkDICOMReader *serial = ReadFiles(files, 1, false);
+  TestAssert(serial->GetErrorCode() == vtkErrorCode::NoError);
+  TestAssert(serial->GetMetaData()->GetNumberOfInstances() == numSlices);
+  TestAssert(serial->GetFileIndexArray()->GetNumberOfTuples() == numSlices);
+  for (int n = 2; n <= 8; n++)
+    {
+    vtkDICOMReader *threaded = ReadFiles(files, n, false);
+    TestAssert(SameOutput(serial, threaded));
+    threaded->Delete();
+    }
+
+  // and also with memory mapping
+  vtkDICOMReader *mapped = ReadFiles(files, 1, true);
+  TestAssert(SameOutput(serial, mapped));
+  mapped->Delete();
+  mapped = ReadFiles(files, 4, true);
+  TestAssert(SameOutput(serial, mapped));
+  mapped->Delete();
+  serial->Delete();
+
+  // the decoded pixels must match the pixels that were written
+  for (int n = 1; n <= 4; n++)
+    {
+    vtkDICOMReader *raw = ReadFiles(files, n, (n % 2 == 0), true);
+    TestAssert(SameFrames(raw, frames));
+    raw->Delete();
+    }
+
+  // a file that is truncated in its pixel data or in its header must
+  // give the same error and meta data for any number of threads
+  std::string truncName = dir + "/TestDICOMReaderTruncated.dcm";
+  allFiles->InsertNextValue(truncName);
+  std::string original;
+  FILE *fp = fopen(files->GetValue(3).c_str(), "rb");
+  if (fp)
+    {
+    char buffer[8192];
+    size_t l = fread(buffer, 1, sizeof(buffer), fp);
+    fclose(fp);
+    original.assign(buffer, l);
+    }
+  files->SetValue(3, truncName);
+  size_t truncSizes[2] = { original.size() - frameSize/2, 400 };
+  for (int k = 0; k < 2; k++)
+    {
+    fp = fopen(truncName.c_str(), "wb");
+    if (fp)
+      {
+      fwrite(original.data(), 1, truncSizes[k], fp);
+      fclose(fp);
+      }
+    serial = ReadFiles(files, 1, false);
+    TestAssert(serial->GetErrorCode() != vtkErrorCode::NoError);
+    for (int n = 2; n <= 4; n++)
+      {
+      vtkDICOMReader *threaded = ReadFiles(files, n, false);
+      TestAssert(threaded->GetErrorCode() == serial->GetErrorCode());
+      TestAssert(SameMetaData(serial->GetMetaData(),
+                              threaded->GetMetaData()));
+      threaded->Delete();
+      }
+    serial->Delete();
+    }
+  files->Delete();
+  }
+
+  { // multi-frame files, where the frames of compressed files are
+    // decoded by several threads
+  static const char *syntaxes[2] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2.5"  // RLE
+  };
+  vtkDICOMMetaData *meta =
+    CreateMetaData("1.2.840.10008.5.1.4.1.1.7.3", rows, columns, numFrames);
+  meta->SetAttributeValue(DC::Modality, "OT");
+  std::vector<unsigned char> frames = CreateFrames(frameSize*numFrames, 2);
+  for (int k = 0; k < 2; k++)
+    {
+    vtkStringArray *files = vtkStringArray::New();
+    std::ostringstream name;
+    name << dir << "/TestDICOMReaderMultiFrame" << k << ".dcm";
+    WriteFile(name.str().c_str(), meta, syntaxes[k],
+              "1.2.826.0.1.3680043.2.1143.1", &frames[0], numFrames,
+              frameSize);
+    files->InsertNextValue(name.str());
+    allFiles->InsertNextValue(name.str());
+
+    vtkDICOMReader *serial = ReadFiles(files, 1, false);
+    TestAssert(serial->GetErrorCode() == vtkErrorCode::NoError);
+    vtkIntArray *frameArray = serial->GetFrameIndexArray();
+    TestAssert(frameArray->GetNumberOfTuples()*
+               frameArray->GetNumberOfComponents() == numFrames);
+    for (int n = 2; n <= 8; n++)
+      {
+      vtkDICOMReader *threaded = ReadFiles(files, n, (n % 2 == 0));
+      TestAssert(SameOutput(serial, threaded));
+      threaded->Delete();
+      }
+    serial->Delete();
+
+    // the decoded frames must match the frames that were written
+    for (int n = 1; n <= 4; n++)
+      {
+      vtkDICOMReader *raw = ReadFiles(files, n, (n % 2 == 0), true);
+      TestAssert(SameFrames(raw, frames));
+      raw->Delete();
+      }
+    files->Delete();
+    }
+  meta->Delete();
+  }
+
+  { // compressed frames that are decoded natively, where truncated
+    // frames must cause an error instead of producing bad pixels
+  vtkDICOMMetaData *meta =
+    CreateMetaData("1.2.840.10008.5.1.4.1.1.7", rows, columns, 1);
+  meta->SetAttributeValue(DC::Modality, "OT");
+  std::vector<unsigned char> expected(frameSize);
+  for (size_t i = 0; i + 1 < frameSize; i += 2)
+    {
+    expected[i] = 0x00;
+    expected[i+1] = 0x08;
+    }
+  // one bit per pixel for the lossless JPEG data
+  size_t jpegBytes = frameSize/16;
+  vtkStringArray *files = vtkStringArray::New();
+  std::string name = dir + "/TestDICOMReaderEncapsulated.dcm";
+  files->InsertNextValue(name);
+  allFiles->InsertNextValue(name);
+
+  WriteEncapsulatedFile(name.c_str(), meta, "1.2.840.10008.1.2.4.70",
+    CreateJPEGLosslessFrame(rows, columns, jpegBytes));
+  vtkDICOMReader *reader = ReadFiles(files, 1, false, true);
+  TestAssert(SameFrames(reader, expected));
+  reader->Delete();
+
+  WriteEncapsulatedFile(name.c_str(), meta, "1.2.840.10008.1.2.4.70",
+    CreateJPEGLosslessFrame(rows, columns, jpegBytes/4));
+  reader = ReadFiles(files, 1, false, true);
+  TestAssert(reader->GetErrorCode() == vtkErrorCode::FileFormatError);
+  reader->Delete();
+
+  // each RLE segment has one byte per pixel, in runs of 128 bytes
+  int rleRuns = rows*columns/128;
+  WriteEncapsulatedFile(name.c_str(), meta, "1.2.840.10008.1.2.5",
+    CreateRLEFrame(rleRuns));
+  reader = ReadFiles(files, 1, false, true);
+  TestAssert(SameFrames(reader, expected));
+  reader->Delete();
+
+  WriteEncapsulatedFile(name.c_str(), meta, "1.2.840.10008.1.2.5",
+    CreateRLEFrame(1));
+  reader = ReadFiles(files, 1, false, true);
+  TestAssert(reader->GetErrorCode() == vtkErrorCode::FileFormatError);
+  reader->Delete();
+
+  meta->Delete();
+  files->Delete();
+  }
+
+  for (vtkIdType i = 0; i < allFiles->GetNumberOfValues(); i++)
+    {
+    vtksys::SystemTools::RemoveFile(allFiles->GetValue(i));
+    }
+  allFiles->Delete();
+
+  return rval;
+}
@@ -204,5 +204,23 @@ int main(int argc, char *argv[])
   TestAssert(val3.GetVL() == 0xffffffffu);
   TestAssert(val3.GetNumberOfValues() == 0);
 
+  {
+  // set an item's value from a value within the same item, where
+  // inserting the new element shifts the referenced element
+  vtkDICOMItem item;
+  item.SetAttributeValue(DC::Modality, "MR");
+  item.SetAttributeValue(DC::SeriesNumber, 12);
+  item.SetAttributeValue(DC::StudyID,
+    item.GetAttributeValue(DC::SeriesNumber));
+  item.SetAttributeValue(DC::AccessionNumber,
+    item.GetAttributeValue(DC::Modality));
+
+  TestAssert(item.GetNumberOfDataElements() == 4);
+  TestAssert(item.GetAttributeValue(DC::StudyID).AsInt() == 12);
+  TestAssert(item.GetAttributeValue(DC::AccessionNumber).AsString() == "MR");
+  TestAssert(item.GetAttributeValue(DC::Modality).AsString() == "MR");
+  TestAssert(item.GetAttributeValue(DC::SeriesNumber).AsInt() == 12);
+  }
+
   return rval;
 }
@@ -3,10 +3,12 @@
 
 #include "vtkStringArray.h"
 #include "vtkSmartPointer.h"
+#include "vtkMultiThreader.h"
 
 #include <sstream>
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include <string.h>
 #include <stdlib.h>
@@ -21,6 +23,32 @@ if (!(t)) \
   rval |= 1; \
 }
 
+namespace {
+
+struct ThreadTestInfo
+{
+  int NumberOfUIDs;
+  std::vector<std::string> UIDs[VTK_MAX_THREADS];
+};
+
+VTK_THREAD_RETURN_TYPE ThreadTestFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  ThreadTestInfo *ti = static_cast<ThreadTestInfo *>(info->UserData);
+  int t = info->ThreadID;
+
+  for (int i = 0; i < ti->NumberOfUIDs; i++)
+    {
+    ti->UIDs[t].push_back(
+      vtkDICOMUtilities::GenerateUID(DC::SOPInstanceUID));
+    }
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end anonymous namespace
+
 int main(int argc, char *argv[])
 {
   int rval = 0;
@@ -72,6 +100,34 @@ int main(int argc, char *argv[])
     }
   }
 
+  { // Test generation of a large batch of UIDs
+  vtkSmartPointer<vtkStringArray> a = vtkSmartPointer<vtkStringArray>::New();
+  a->SetNumberOfValues(10000);
+  DU::GenerateUIDs(DC::SOPInstanceUID, a);
+  for (int i = 0; i < 9999; i++)
+    {
+    TestAssert(DU::CompareUIDs(a->GetValue(i), a->GetValue(i+1)) < 0);
+    }
+  }
+
+  { // Test UID generation from several threads at once
+  ThreadTestInfo ti;
+  ti.NumberOfUIDs = 2500;
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(4);
+  threader->SetSingleMethod(ThreadTestFunction, &ti);
+  threader->SingleMethodExecute();
+  threader->Delete();
+  std::vector<std::string> uids;
+  for (int t = 0; t < 4; t++)
+    {
+    uids.insert(uids.end(), ti.UIDs[t].begin(), ti.UIDs[t].end());
+    }
+  std::sort(uids.begin(), uids.end());
+  TestAssert(uids.size() == 10000);
+  TestAssert(std::adjacent_find(uids.begin(), uids.end()) == uids.end());
+  }
+
   { // Test DateTime generation
   std::string s = DU::GenerateDateTime("-0600");
   long long l = DU::ConvertDateTime(s.c_str());
@@ -95,5 +151,22 @@ int main(int argc, char *argv[])
   TestAssert(u[0] == t[0] && u[1] == t[1] && u[2] == t[2] && u[3] == t[3]);
   }
 
+  { // Test the file header check, including short files
+  unsigned char h[256];
+  memset(h, 0, sizeof(h));
+  static const unsigned char magic[8] = { 'D', 'I', 'C', 'M', 2, 0, 0, 0 };
+  memcpy(&h[128], magic, 8);
+  TestAssert(DU::IsDICOMFileHeader(h, 256));
+  TestAssert(DU::IsDICOMFileHeader(h, 140));
+  TestAssert(!DU::IsDICOMFileHeader(h, 100));
+  // a meta header without the preamble needs 256 bytes
+  memset(h, 0, sizeof(h));
+  static const unsigned char meta[8] = { 2, 0, 0, 0, 'U', 'L', 4, 0 };
+  memcpy(h, meta, 8);
+  TestAssert(DU::IsDICOMFileHeader(h, 256));
+  TestAssert(!DU::IsDICOMFileHeader(h, 140));
+  TestAssert(!DU::IsDICOMFileHeader(0, 256));
+  }
+
   return rval;
 }
@@ -612,5 +612,99 @@ int main(int argc, char *argv[])
   TestAssert(v.Matches(u));
   }
 
+  { // test allocation from a pool
+  vtkDICOMValue::Pool *pool = vtkDICOMValue::Pool::New();
+  vtkDICOMValue u, v, w;
+  char *cp = v.AllocateCharData(vtkDICOMVR::LO, 5, pool);
+  strcpy(cp, "hello");
+  v.ComputeNumberOfValuesForCharData();
+  unsigned short *sp = w.AllocateUnsignedShortData(vtkDICOMVR::US, 3, pool);
+  sp[0] = 1; sp[1] = 2; sp[2] = 3;
+  double *dp = u.AllocateDoubleData(vtkDICOMVR::FD, 1000, pool);
+  for (int i = 0; i < 1000; i++) { dp[i] = i; }
+  TestAssert(v.GetVL() == 6);
+  TestAssert(v.AsString() == "hello");
+  TestAssert(w.GetNumberOfValues() == 3);
+  TestAssert(w.GetUnsignedShort(2) == 3);
+  TestAssert(u.GetDouble(999) == 999.0);
+  unsigned short sv[3] = { 1, 2, 3 };
+  TestAssert(w == vtkDICOMValue(vtkDICOMVR::US, sv, 3));
+  // the values must remain valid after the pool is released
+  vtkDICOMValue x = w;
+  pool->Release();
+  w.Clear();
+  u.Clear();
+  TestAssert(v.AsString() == "hello");
+  TestAssert(x.GetUnsignedShort(1) == 2);
+  x = v;
+  v.Clear();
+  TestAssert(x.AsString() == "hello");
+
+  // the pool can only be recycled if none of its values are in use
+  pool = vtkDICOMValue::Pool::New();
+  v.AllocateIntData(vtkDICOMVR::SL, 2, pool);
+  v.Clear();
+  TestAssert(pool->Recycle() == pool);
+  v.AllocateIntData(vtkDICOMVR::SL, 2, pool);
+  TestAssert(pool->Recycle() == 0);
+  TestAssert(v.GetNumberOfValues() == 2);
+  }
+
+  { // test copying values out of a pool
+  vtkDICOMValue::Pool *pool = vtkDICOMValue::Pool::New();
+  vtkDICOMValue u, v, w, x, y;
+  char *cp = v.AllocateCharData(
+    vtkDICOMVR::PN, vtkDICOMCharacterSet::ISO_IR_100, 5, pool);
+  strcpy(cp, "h\xe9llo");
+  v.ComputeNumberOfValuesForCharData();
+  float *fp = w.AllocateFloatData(vtkDICOMVR::FL, 7, pool);
+  for (int i = 0; i < 7; i++) { fp[i] = 0.5f*i; }
+  x.AllocateUnsignedCharData(vtkDICOMVR::OB, 0, pool);
+  // an odd-length UI, which has no pad char before the terminator
+  cp = y.AllocateCharData(vtkDICOMVR::UI, 5, pool);
+  strcpy(cp, "1.2.3");
+  y.ComputeNumberOfValuesForCharData();
+  vtkDICOMItem item;
+  item.SetAttributeValue(DC::PatientName, v);
+  item.SetAttributeValue(DC::SliceThickness, w);
+  u = vtkDICOMValue(vtkDICOMVR::SQ, item);
+
+  vtkDICOMValue vc = v.GetUnpooledCopy();
+  vtkDICOMValue wc = w.GetUnpooledCopy();
+  vtkDICOMValue xc = x.GetUnpooledCopy();
+  vtkDICOMValue uc = u.GetUnpooledCopy();
+  vtkDICOMValue yc = y.GetUnpooledCopy();
+  TestAssert(vc == v);
+  TestAssert(vc.GetCharacterSet() == vtkDICOMCharacterSet::ISO_IR_100);
+  TestAssert(vc.GetCharData() != v.GetCharData());
+  TestAssert(wc == w);
+  TestAssert(wc.GetFloat(6) == 3.0f);
+  TestAssert(xc == x);
+  TestAssert(xc.GetVL() == 0);
+  TestAssert(yc == y);
+  TestAssert(yc.GetVL() == 6);
+  TestAssert(uc == u);
+  TestAssert(uc.GetSequenceData()[0].GetAttributeValue(
+    DC::PatientName).GetCharData() != v.GetCharData());
+
+  // none of the copies should keep the pool in use
+  u.Clear();
+  v.Clear();
+  w.Clear();
+  x.Clear();
+  y.Clear();
+  item.Clear();
+  TestAssert(pool->Recycle() == pool);
+  TestAssert(vc.AsString() == "h\xe9llo");
+  TestAssert(yc.AsString() == "1.2.3");
+  TestAssert(uc.GetSequenceData()[0].GetAttributeValue(
+    DC::SliceThickness).GetFloat(1) == 0.5f);
+  pool->Release();
+
+  // values that are not pooled are shared, rather than copied
+  v = vtkDICOMValue(vtkDICOMVR::LO, "hello");
+  TestAssert(v.GetUnpooledCopy().GetCharData() == v.GetCharData());
+  }
+
   return rval;
 }
@@ -0,0 +1,234 @@
+#include "vtkDICOMValueMatcher.h"
+#include "vtkDICOMValue.h"
+#include "vtkDICOMSequence.h"
+#include "vtkDICOMItem.h"
+
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+namespace {
+
+// Make a list of values from a list of strings, with the given VR.
+std::vector<vtkDICOMValue> MakeValues(
+  vtkDICOMVR vr, vtkDICOMCharacterSet cs, const char *const *strings)
+{
+  std::vector<vtkDICOMValue> values;
+  for (const char *const *sp = strings; *sp != 0; sp++)
+    {
+    values.push_back(vtkDICOMValue(vr, cs, *sp, strlen(*sp)));
+    }
+  return values;
+}
+
+// Check every value against every query, and return the number of
+// times that the matcher disagreed with vtkDICOMValue::Matches().
+int CompareMatches(
+  const std::vector<vtkDICOMValue>& values,
+  const std::vector<vtkDICOMValue>& queries)
+{
+  int failures = 0;
+  for (size_t j = 0; j < queries.size(); j++)
+    {
+    vtkDICOMValueMatcher matcher(queries[j]);
+    for (size_t i = 0; i < values.size(); i++)
+      {
+      const vtkDICOMValue& v = values[i];
+      bool match = v.Matches(queries[j]);
+      bool rawMatch = match;
+      if (v.GetCharData())
+        {
+        rawMatch = matcher.Matches(
+          v.GetVR(), v.GetCharacterSet(), v.GetCharData(), v.GetVL());
+        }
+      if (matcher.Matches(v) != match || rawMatch != match)
+        {
+        cout << "value \"" << v << "\" query \"" << queries[j]
+             << "\" should be " << (match ? "true" : "false") << "\n";
+        failures++;
+        }
+      }
+    }
+  return failures;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMValueMatcher");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  vtkDICOMCharacterSet ascii = vtkDICOMCharacterSet::ISO_IR_6;
+  vtkDICOMCharacterSet latin1 = vtkDICOMCharacterSet::ISO_IR_100;
+  vtkDICOMCharacterSet utf8 = vtkDICOMCharacterSet::ISO_IR_192;
+
+  { // test universal matching
+  vtkDICOMValueMatcher matcher;
+  TestAssert(matcher.IsUniversal());
+  TestAssert(matcher.Matches(vtkDICOMValue()));
+  TestAssert(matcher.Matches(vtkDICOMValue(vtkDICOMVR::CS, "HELLO")));
+  matcher.SetQuery(vtkDICOMValue(vtkDICOMVR::CS, ""));
+  TestAssert(matcher.IsUniversal());
+  TestAssert(matcher.Matches(vtkDICOMValue()));
+  matcher.SetQuery(vtkDICOMValue(vtkDICOMVR::CS, "HELLO"));
+  TestAssert(!matcher.IsUniversal());
+  TestAssert(!matcher.Matches(vtkDICOMValue()));
+  TestAssert(matcher.Matches(vtkDICOMValue(vtkDICOMVR::CS, "HELLO ")));
+  TestAssert(!matcher.Matches(vtkDICOMValue(vtkDICOMVR::SH, "HELLO")));
+  TestAssert(matcher.GetQuery() == vtkDICOMValue(vtkDICOMVR::CS, "HELLO"));
+  }
+
+  { // test matching of text with wildcards
+  static const char *values[] = {
+    "", "HELLO", "HELLO ", "HELL", "HELLO\\THERE", "THERE\\HELLO",
+    " HELLO \\ THERE ", "HELLO\\", "\\HELLO", "ELLO", 0 };
+  static const char *queries[] = {
+    "", "*", "HELLO", "*LO", "H?LLO", "H*?LLO", "H?LO", "H*P", "HELL*",
+    "HELLO?", "HELLO\\THERE", "THERE\\HELLO", "HELLO\\THER", "ELLO\\THER",
+    " HELLO ", "HELLO\\", "\\", "*\\*", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::CS, ascii, values),
+    MakeValues(vtkDICOMVR::CS, ascii, queries)) == 0);
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::LO, ascii, values),
+    MakeValues(vtkDICOMVR::LO, ascii, queries)) == 0);
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::LT, ascii, values),
+    MakeValues(vtkDICOMVR::LT, ascii, queries)) == 0);
+  }
+
+  { // test lists of UIDs, and ordered matching of numbers
+  static const char *uids[] = {
+    "10.3000.11.6", "10.3000.10.6", "10.3000.11.6\\10.3000.10.6",
+    "10.3000.11.7", 0 };
+  static const char *uidQueries[] = {
+    "10.3000.11.6", "10.3000.11.6\\10.3000.10.6",
+    "10.3000.10.6\\10.3000.11.6", "10.3000.11.7\\10.3000.10.6",
+    "10.3000.1*", "10.3000.1?.6", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::UI, ascii, uids),
+    MakeValues(vtkDICOMVR::UI, ascii, uidQueries)) == 0);
+
+  static const char *numbers[] = {
+    "5\\6\\10", "5", "6", "10", "10\\5", "5\\10", " 6 \\ 5 ", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::IS, ascii, numbers),
+    MakeValues(vtkDICOMVR::IS, ascii, numbers)) == 0);
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::DS, ascii, numbers),
+    MakeValues(vtkDICOMVR::DS, ascii, numbers)) == 0);
+  }
+
+  { // test dates, times, and datetimes, and their ranges
+  static const char *dates[] = {
+    "", "20150101", "20141231", "20150102", "2015", "201501",
+    "20150101\\20160101", 0 };
+  static const char *dateQueries[] = {
+    "20150101", "2015", "20150101-", "-20150101", "20141231-20150101",
+    "20150101-20141231", "2015*", "201501??", "-", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::DA, ascii, dates),
+    MakeValues(vtkDICOMVR::DA, ascii, dateQueries)) == 0);
+
+  static const char *times[] = {
+    "", "1200", "120000", "120000.5", "235959.999999", "00", "1159", 0 };
+  static const char *timeQueries[] = {
+    "12", "1200", "120000.5", "1200-", "-1200", "1130-1230", "12*", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::TM, ascii, times),
+    MakeValues(vtkDICOMVR::TM, ascii, timeQueries)) == 0);
+
+  static const char *datetimes[] = {
+    "", "20150101120000", "20150101120000.5-0500", "2015010112+0100",
+    "2014", "20150101", 0 };
+  static const char *datetimeQueries[] = {
+    "2015", "20150101", "20150101120000-0500", "2015-", "-2015",
+    "2014-20150101", "20150101-0500-20160101+0100", "2015*", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::DT, ascii, datetimes),
+    MakeValues(vtkDICOMVR::DT, ascii, datetimeQueries)) == 0);
+  }
+
+  { // test person names, which are case-insensitive
+  static const char *names[] = {
+    "", "Doe^John", "DOE^JOHN", "Doe^John^^Dr.", "Doe^Jane\\Doe^John",
+    "Doe", "Smith^John=\xe3\x82\xb9\xe3\x83\x9f\xe3\x82\xb9^", 0 };
+  static const char *nameQueries[] = {
+    "doe^john", "DOE", "Doe^J*", "D?e^John", "*^John", "Smith\\Doe",
+    "Doe^John^^Dr", "=\xe3\x82\xb9*", "Jones\\Smith", 0 };
+  TestAssert(CompareMatches(
+    MakeValues(vtkDICOMVR::PN, utf8, names),
+    MakeValues(vtkDICOMVR::PN, utf8, nameQueries)) == 0);
+
+  vtkDICOMValueMatcher matcher(
+    vtkDICOMValue(vtkDICOMVR::PN, utf8, "doe^j*", 6));
+  TestAssert(matcher.Matches(vtkDICOMValue(vtkDICOMVR::PN, "DOE^JOHN")));
+  TestAssert(!matcher.Matches(vtkDICOMValue(vtkDICOMVR::PN, "DOE^BOB")));
+  }
+
+  { // test values and queries that require conversion to utf-8
+  static const char *latin[] = {
+    "M\xfcller", "M\xdcLLER", "M\xfcller^J\xfcrgen", "Muller",
+    "M\xfcller\\Meyer", 0 };
+  static const char *unicode[] = {
+    "M\xc3\xbcller", "m\xc3\xbcller", "M\xc3\xbc*", "M?ller",
+    "M\xc3\xbcller^j\xc3\xbcrgen", "Meyer\\M\xc3\xbcller", 0 };
+  std::vector<vtkDICOMValue> values;
+  std::vector<vtkDICOMValue> queries;
+  values = MakeValues(vtkDICOMVR::PN, latin1, latin);
+  queries = MakeValues(vtkDICOMVR::PN, utf8, unicode);
+  TestAssert(CompareMatches(values, queries) == 0);
+  queries = MakeValues(vtkDICOMVR::PN, latin1, latin);
+  TestAssert(CompareMatches(values, queries) == 0);
+  values = MakeValues(vtkDICOMVR::LO, latin1, latin);
+  queries = MakeValues(vtkDICOMVR::LO, utf8, unicode);
+  TestAssert(CompareMatches(values, queries) == 0);
+  queries = MakeValues(vtkDICOMVR::LO, latin1, latin);
+  TestAssert(CompareMatches(values, queries) == 0);
+  values = MakeValues(vtkDICOMVR::ST, latin1, latin);
+  queries = MakeValues(vtkDICOMVR::ST, utf8, unicode);
+  TestAssert(CompareMatches(values, queries) == 0);
+  }
+
+  { // test values that are not text
+  std::vector<vtkDICOMValue> values;
+  values.push_back(vtkDICOMValue());
+  values.push_back(vtkDICOMValue(vtkDICOMVR::US, 10));
+  values.push_back(vtkDICOMValue(vtkDICOMVR::US, 9));
+  values.push_back(vtkDICOMValue(vtkDICOMVR::SS, -10));
+  values.push_back(vtkDICOMValue(vtkDICOMVR::FD, 1.5));
+  std::vector<vtkDICOMValue> queries = values;
+  TestAssert(CompareMatches(values, queries) == 0);
+
+  vtkDICOMItem item;
+  item.SetAttributeValue(DC::CodeValue, vtkDICOMValue(vtkDICOMVR::SH, "T1"));
+  vtkDICOMSequence seq(1);
+  seq.SetItem(0, item);
+  vtkDICOMItem query;
+  query.SetAttributeValue(DC::CodeValue, vtkDICOMValue(vtkDICOMVR::SH, "T?"));
+  vtkDICOMSequence qseq(1);
+  qseq.SetItem(0, query);
+  vtkDICOMValueMatcher matcher(qseq);
+  TestAssert(matcher.Matches(seq));
+  TestAssert(!matcher.Matches(vtkDICOMValue()));
+  }
+
+  return rval;
+}
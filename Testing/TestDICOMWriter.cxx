@@ -0,0 +1,282 @@
+#include "vtkDICOMWriter.h"
+#include "vtkDICOMSCGenerator.h"
+#include "vtkDICOMMetaData.h"
+#include "vtkDICOMDictionary.h"
+
+#include <vtkObjectFactory.h>
+#include <vtkImageData.h>
+#include <vtkErrorCode.h>
+#include <vtkVersion.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+// macro for performing tests
+#define TestAssert(t) \
+if (!(t)) \
+{ \
+  cout << exename << ": Assertion Failed: " << #t << "\n"; \
+  cout << __FILE__ << ":" << __LINE__ << "\n"; \
+  cout.flush(); \
+  rval |= 1; \
+}
+
+// A generator that uses fixed UIDs and a fixed creation time, so that
+// the files from separate writes can be compared byte-for-byte
+class TestDICOMWriterGenerator : public vtkDICOMSCGenerator
+{
+public:
+  static TestDICOMWriterGenerator *New();
+  vtkTypeMacro(TestDICOMWriterGenerator, vtkDICOMSCGenerator);
+
+  virtual bool GenerateInstance(vtkInformation *info);
+
+protected:
+  TestDICOMWriterGenerator() {}
+  ~TestDICOMWriterGenerator() {}
+
+private:
+  TestDICOMWriterGenerator(const TestDICOMWriterGenerator&);
+  void operator=(const TestDICOMWriterGenerator&);
+};
+
+vtkStandardNewMacro(TestDICOMWriterGenerator);
+
+bool TestDICOMWriterGenerator::GenerateInstance(vtkInformation *info)
+{
+  if (!this->Superclass::GenerateInstance(info))
+    {
+    return false;
+    }
+
+  vtkDICOMMetaData *meta = this->GetMetaData();
+  meta->SetAttributeValue(
+    DC::StudyInstanceUID, "1.2.826.0.1.3680043.2.1143.3");
+  meta->SetAttributeValue(
+    DC::SeriesInstanceUID, "1.2.826.0.1.3680043.2.1143.2");
+  if (meta->HasAttribute(DC::FrameOfReferenceUID))
+    {
+    meta->SetAttributeValue(
+      DC::FrameOfReferenceUID, "1.2.826.0.1.3680043.2.1143.4");
+    }
+  meta->SetAttributeValue(DC::InstanceCreationDate, "20150101");
+  meta->SetAttributeValue(DC::InstanceCreationTime, "120000.000000");
+  int n = meta->GetNumberOfInstances();
+  for (int i = 0; i < n; i++)
+    {
+    std::ostringstream uid;
+    uid << "1.2.826.0.1.3680043.2.1143.1." << (i + 1);
+    meta->SetAttributeValue(i, DC::SOPInstanceUID, uid.str());
+    }
+
+  return true;
+}
+
+namespace {
+
+// The settings that are used to write a series
+struct WriteOptions
+{
+  const char *Syntax;
+  int RowOrder;
+  bool Streaming;
+  int NumberOfThreads;
+};
+
+// Create an image with smooth and noisy slices
+vtkImageData *CreateImage(
+  int columns, int rows, int slices, int scalarType, int components)
+{
+  vtkImageData *image = vtkImageData::New();
+  image->SetExtent(0, columns - 1, 0, rows - 1, 0, slices - 1);
+  image->SetSpacing(0.5, 0.5, 1.5);
+#if (VTK_MAJOR_VERSION > 5)
+  image->AllocateScalars(scalarType, components);
+#else
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(components);
+  image->AllocateScalars();
+#endif
+
+  unsigned char *ptr =
+    static_cast<unsigned char *>(image->GetScalarPointer());
+  size_t sliceSize = static_cast<size_t>(columns)*rows*components*
+    image->GetScalarSize();
+  size_t n = sliceSize*slices;
+  srand(scalarType + components);
+  for (size_t i = 0; i < n; i++)
+    {
+    ptr[i] = static_cast<unsigned char>(
+      ((i/sliceSize) % 2) == 0 ? (i/64) : rand());
+    }
+
+  return image;
+}
+
+// Write the image as a series of files, and return the error code
+unsigned long WriteFiles(
+  vtkImageData *image, const char *prefix, const WriteOptions& options)
+{
+  TestDICOMWriterGenerator *generator = TestDICOMWriterGenerator::New();
+  vtkDICOMWriter *writer = vtkDICOMWriter::New();
+#if (VTK_MAJOR_VERSION > 5)
+  writer->SetInputData(image);
+#else
+  writer->SetInput(image);
+#endif
+  writer->SetGenerator(generator);
+  writer->SetFilePrefix(prefix);
+  writer->SetFilePattern("%s%03d.dcm");
+  writer->SetFileDimensionality(2);
+  writer->SetTransferSyntaxUID(options.Syntax);
+  writer->SetMemoryRowOrder(options.RowOrder);
+  writer->SetStreaming(options.Streaming);
+  writer->SetNumberOfThreads(options.NumberOfThreads);
+  writer->Write();
+  unsigned long errorCode = writer->GetErrorCode();
+  writer->Delete();
+  generator->Delete();
+  return errorCode;
+}
+
+// Get the name of a file that was written
+std::string FileName(const std::string& prefix, int i)
+{
+  char number[16];
+  sprintf(number, "%03d", i);
+  return prefix + number + ".dcm";
+}
+
+// Read a whole file into a string
+std::string ReadFile(const char *fname)
+{
+  std::string contents;
+  FILE *fp = fopen(fname, "rb");
+  if (fp)
+    {
+    char buffer[8192];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+      {
+      contents.append(buffer, n);
+      }
+    fclose(fp);
+    }
+  return contents;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  int rval = 0;
+  const char *exename = (argc > 0 ? argv[0] : "TestDICOMWriter");
+
+  // remove path portion of exename
+  const char *cp = exename + strlen(exename);
+  while (cp != exename && cp[-1] != '\\' && cp[-1] != '/') { --cp; }
+  exename = cp;
+
+  // the directory for the temporary files
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  std::string serialPrefix = dir + "/TestDICOMWriterS";
+  std::string threadedPrefix = dir + "/TestDICOMWriterT";
+
+  static const char *syntaxes[2] = {
+    "1.2.840.10008.1.2.1", // explicit little endian
+    "1.2.840.10008.1.2.5"  // RLE
+  };
+
+  // image formats: 16-bit greyscale and 8-bit RGB
+  static const int formats[2][5] = {
+    // columns, rows, slices, scalar type, components
+    { 32, 24, 11, VTK_SHORT, 1 },
+    { 20, 16, 6, VTK_UNSIGNED_CHAR, 3 }
+  };
+
+  static const int threadCounts[4] = { 2, 3, 4, 16 };
+
+  for (int f = 0; f < 2; f++)
+    {
+    int numFiles = formats[f][2];
+    vtkImageData *image = CreateImage(
+      formats[f][0], formats[f][1], numFiles, formats[f][3], formats[f][4]);
+
+    for (int k = 0; k < 2; k++)
+      {
+      for (int r = 0; r < 2; r++)
+        {
+        WriteOptions options;
+        options.Syntax = syntaxes[k];
+        options.RowOrder = (r == 0 ?
+          vtkDICOMWriter::BottomUp : vtkDICOMWriter::TopDown);
+        options.Streaming = false;
+        options.NumberOfThreads = 1;
+
+        TestAssert(WriteFiles(image, serialPrefix.c_str(), options) ==
+                   vtkErrorCode::NoError);
+        std::vector<std::string> serialData(numFiles);
+        for (int i = 0; i < numFiles; i++)
+          {
+          serialData[i] = ReadFile(FileName(serialPrefix, i + 1).c_str());
+          TestAssert(serialData[i].size() > 128);
+          }
+        TestAssert(!vtksys::SystemTools::FileExists(
+          FileName(serialPrefix, numFiles + 1).c_str()));
+
+        // the files written by several threads must be identical to
+        // the files written by one thread, also when there are more
+        // threads than files, and when the slices are streamed
+        for (int t = 0; t < 5; t++)
+          {
+          options.Streaming = (t == 4);
+          options.NumberOfThreads = (t < 4 ? threadCounts[t] : 4);
+          TestAssert(WriteFiles(image, threadedPrefix.c_str(), options) ==
+                     vtkErrorCode::NoError);
+          for (int i = 0; i < numFiles; i++)
+            {
+            std::string threadedData =
+              ReadFile(FileName(threadedPrefix, i + 1).c_str());
+            TestAssert(threadedData == serialData[i]);
+            vtksys::SystemTools::RemoveFile(
+              FileName(threadedPrefix, i + 1).c_str());
+            }
+          TestAssert(!vtksys::SystemTools::FileExists(
+            FileName(threadedPrefix, numFiles + 1).c_str()));
+          }
+
+        for (int i = 0; i < numFiles; i++)
+          {
+          vtksys::SystemTools::RemoveFile(
+            FileName(serialPrefix, i + 1).c_str());
+          }
+        }
+      }
+
+    image->Delete();
+    }
+
+  { // a threaded write that cannot create its files must fail
+  vtkImageData *image = CreateImage(8, 8, 6, VTK_UNSIGNED_CHAR, 1);
+  std::string badPrefix = dir + "/TestDICOMWriterNoDir/x";
+  WriteOptions options;
+  options.Syntax = syntaxes[0];
+  options.RowOrder = vtkDICOMWriter::TopDown;
+  options.Streaming = false;
+  options.NumberOfThreads = 3;
+  TestAssert(WriteFiles(image, badPrefix.c_str(), options) !=
+             vtkErrorCode::NoError);
+  TestAssert(!vtksys::SystemTools::FileExists(
+    FileName(badPrefix, 1).c_str()));
+  image->Delete();
+  }
+
+  return rval;
+}